@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "game_world.h"
+#include "tr/tr_frustum.h"
+#include "tr/tr_thread_pool.h"
+#include "tr/tr_transform.h"
+#include "tr/tr_profiler.h"
+
+namespace game {
+
+namespace {
+    using clock = std::chrono::steady_clock;
+
+    // Wraps a system's body so the time each thread spends in it is added to ns.
+    template<typename F>
+    auto timed(std::atomic<int64_t>& ns, F body)
+    {
+        return [&ns, body](flecs::iter& it) {
+            const auto start = clock::now();
+            while(it.next()) {
+                body(it);
+            }
+            ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count(), std::memory_order_relaxed);
+        };
+    }
+}
+
+game_world::game_world(tr::thread_pool& pool)
+    : pool_(pool)
+{
+    timings_[simulate_system].name_ = "simulate";
+    timings_[cull_system].name_ = "cull";
+    timings_[draw_list_system].name_ = "draw list";
+    // Registered up front, the workers mustn't be the first to see them.
+    world_.component<placement>();
+    world_.component<transform>();
+    world_.component<mesh>();
+    world_.component<material>();
+    world_.component<bounds>();
+    world_.component<drawable>();
+    if(pool.concurrency() > 1) {
+        world_.set_threads(static_cast<int32_t>(pool.concurrency()));
+    }
+
+    world_.system<transform, const placement>("simulate")
+        .kind(flecs::OnUpdate)
+        .multi_threaded()
+        .run(timed(system_ns_[simulate_system], [this](flecs::iter& it) {
+            auto t = it.field<transform>(0);
+            auto p = it.field<const placement>(1);
+            for(auto i : it) {
+                glm::mat4 cell = glm::translate(glm::mat4(1.0f), p[i].position_);
+                cell = glm::scale(cell, glm::vec3(p[i].scale_));
+                tr::multiply_matrices(cell, motion_, t[i].world_);
+            }
+        }));
+
+    // Runs on one thread, which gathers the bounds of every table before they
+    // are tested together. The transform takes the mesh straight to clip space,
+    // so each sphere is moved there, its radius grown by the largest scale of
+    // the transform to still hold the mesh, and tested against clip space's box.
+    world_.system<const transform, const bounds, drawable>("cull")
+        .kind(flecs::PostUpdate)
+        .run([this](flecs::iter& it) {
+            const auto start = clock::now();
+            static const tr::frustum clip = tr::frustum::from_matrix(glm::mat4(1.0f));
+            spheres_.clear();
+            cull_targets_.clear();
+            while(it.next()) {
+                auto t = it.field<const transform>(0);
+                auto b = it.field<const bounds>(1);
+                auto d = it.field<drawable>(2);
+                for(auto i : it) {
+                    const glm::mat4& m = t[i].world_;
+                    float scale = 0.0f;
+                    for(int axis = 0; axis < 3; ++axis) {
+                        scale = std::max(scale, glm::length(glm::vec3(m[axis].x, m[axis].y, m[axis].z)));
+                    }
+                    const glm::vec4 centre = m * glm::vec4(b[i].centre_, 1.0f);
+                    spheres_.add(glm::vec3(centre.x, centre.y, centre.z), b[i].radius_ * scale);
+                    d[i].visible_ = false;
+                    cull_targets_.push_back(&d[i]);
+                }
+            }
+            tr::cull_spheres(pool_, spheres_, clip, seen_);
+            for(const uint32_t n : seen_) {
+                cull_targets_[n]->visible_ = true;
+            }
+            visible_.store(seen_.size(), std::memory_order_relaxed);
+            system_ns_[cull_system].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count(), std::memory_order_relaxed);
+        });
+
+    world_.system<const transform, const mesh, const material, const bounds, drawable>("draw list")
+        .kind(flecs::PreStore)
+        .multi_threaded()
+        .run(timed(system_ns_[draw_list_system], [](flecs::iter& it) {
+            auto t = it.field<const transform>(0);
+            auto m = it.field<const mesh>(1);
+            auto mat = it.field<const material>(2);
+            auto b = it.field<const bounds>(3);
+            auto d = it.field<drawable>(4);
+            for(auto i : it) {
+                if(!d[i].visible_) {
+                    continue;
+                }
+                tr::draw_item& item = d[i].item_;
+                item.shader_ = mat[i].shader_;
+                item.transform_location_ = mat[i].transform_location_;
+                item.vo_ = m[i].vo_;
+                item.transform_ = t[i].world_;
+                // Clip space z of the bounds' centre, mapped to [0, 1].
+                const float depth = (t[i].world_ * glm::vec4(b[i].centre_, 1.0f)).z * 0.5f + 0.5f;
+                item.key_ = tr::draw_key::make(0, 0, false, mat[i].id_, 0, m[i].id_, depth);
+            }
+        }));
+
+    draws_ = world_.query_builder<const drawable>()
+        .cached()
+        .build();
+}
+
+flecs::entity game_world::spawn(const placement& where, const mesh& m, const material& mat, const bounds& b)
+{
+    return world_.entity()
+        .set<placement>(where)
+        .set<transform>({ })
+        .set<mesh>(m)
+        .set<material>(mat)
+        .set<bounds>(b)
+        .set<drawable>({ });
+}
+
+void game_world::progress(const glm::mat4& motion, double seconds)
+{
+    TR_PROFILE_ZONE("world progress");
+    const auto start = clock::now();
+    motion_ = motion;
+    visible_.store(0, std::memory_order_relaxed);
+    for(auto& ns : system_ns_) {
+        ns.store(0, std::memory_order_relaxed);
+    }
+    world_.progress(static_cast<float>(seconds));
+    for(size_t s = 0; s < system_count; ++s) {
+        timings_[s].ms_ = static_cast<double>(system_ns_[s].load(std::memory_order_relaxed)) / 1e6;
+    }
+    progress_ms_ = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+}
+
+void game_world::gather(tr::draw_queue& queue) const
+{
+    TR_PROFILE_ZONE("gather draws");
+    auto items = queue.allocate(visible());
+    size_t n = 0;
+    draws_.each([&](const drawable& d) {
+        if(d.visible_ && n < items.size()) {
+            items[n++] = d.item_;
+        }
+    });
+}
+
+size_t game_world::entities() const
+{
+    return static_cast<size_t>(world_.count<drawable>());
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <glm/glm.hpp>
+#include <vector>
+#include <flecs.h>
+
+#include "tr/tr_cull.h"
+#include "tr/tr_draw_queue.h"
+
+namespace tr {
+class tr_shader;
+class thread_pool;
+class vertex_object;
+}
+
+namespace game {
+
+/// @brief Where an entity is laid out, a translation and uniform scale applied after its motion.
+struct placement
+{
+    glm::vec3 position_{ 0.0f };
+    float scale_{ 1.0f };
+};
+
+/// @brief Model matrix, here straight to clip space, written by the simulation.
+struct transform
+{
+    glm::mat4 world_{ 1.0f };
+};
+
+struct mesh
+{
+    const tr::vertex_object* vo_{ nullptr };
+    /// @brief Small id sorted on, so draws of the same mesh are together.
+    uint32_t id_{ 0 };
+};
+
+struct material
+{
+    const tr::tr_shader* shader_{ nullptr };
+    /// @brief Location of the transform uniform in \c shader_, -1 to not set it.
+    int transform_location_{ -1 };
+    uint32_t id_{ 0 };
+};
+
+/// @brief Sphere around the mesh, in its own space.
+struct bounds
+{
+    glm::vec3 centre_{ 0.0f };
+    float radius_{ 0.0f };
+};
+
+/// @brief Whether culling found the entity may be seen, and the draw built for it if so.
+struct drawable
+{
+    bool visible_{ false };
+    tr::draw_item item_{ };
+};
+
+/// @brief Time a system took in the last frame, summed over the threads it ran on.
+struct system_timing
+{
+    const char* name_{ nullptr };
+    double ms_{ 0.0 };
+};
+
+// The game's entities in a flecs world. Each frame the simulation moves them,
+// culling tests their bounds against the view and the draw list system builds
+// a draw for each one seen. The simulation and draw list are split across
+// flecs' workers, culling gathers every entity's bounds and tests them
+// together with cull_spheres() on the pool. A system only reads what an
+// earlier one wrote to the same entity, and each worker is given the same
+// rows of each table by every system, so they need nothing from one another.
+// The draws of the visible entities are then gathered with a cached query
+// into one contiguous list to sort and record.
+class game_world
+{
+public:
+    /// @param pool Culls the entities, the other systems run on as many of flecs' own threads.
+    explicit game_world(tr::thread_pool& pool);
+    /// @brief Adds an entity drawing \c m with \c mat at \c where.
+    flecs::entity spawn(const placement& where, const mesh& m, const material& mat, const bounds& b);
+    /// @brief Runs the systems for one frame, applying \c motion to every entity before its placement.
+    void progress(const glm::mat4& motion, double seconds);
+    /// @brief Appends the draws of the entities seen in the last progress() to \c queue.
+    void gather(tr::draw_queue& queue) const;
+
+    size_t entities() const;
+    size_t visible() const { return visible_.load(std::memory_order_relaxed); }
+    std::span<const system_timing> timings() const { return timings_; }
+    /// @brief Wall time of the last progress().
+    double progress_ms() const { return progress_ms_; }
+
+private:
+    enum system_index
+    {
+        simulate_system,
+        cull_system,
+        draw_list_system,
+        system_count,
+    };
+
+    tr::thread_pool& pool_;
+    flecs::world world_;
+    flecs::query<const drawable> draws_;
+    /// @brief Every entity's bounds in clip space, in the order of \c cull_targets_, rebuilt by culling.
+    tr::sphere_bounds spheres_{ };
+    std::vector<drawable*> cull_targets_{ };
+    std::vector<uint32_t> seen_{ };
+    /// @brief Read by the simulation system while progress() runs.
+    glm::mat4 motion_{ 1.0f };
+    std::atomic<size_t> visible_{ 0 };
+    std::array<std::atomic<int64_t>, system_count> system_ns_{ };
+    std::array<system_timing, system_count> timings_{ };
+    double progress_ms_{ 0.0 };
+
+    game_world(const game_world&) = delete;
+    game_world& operator=(const game_world&) = delete;
+};
+
+}
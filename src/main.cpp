@@ -1,17 +1,24 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 
-#include <assimp/Importer.hpp>      // C++ importer interface
-#include <assimp/scene.h>           // Output data structure
-#include <assimp/postprocess.h>     // Post processing flags
 
 #include <glad/gl.h>
 
 #include <ryml.hpp>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "imgui.h"
 #include "imgui_internal.h"
@@ -24,6 +31,7 @@
 #endif
 
 #include <spdlog/spdlog.h>
+#include <spdlog/fmt/chrono.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <argparse/argparse.hpp>
 
@@ -32,7 +40,35 @@
 #include "tr/tr_shader.h"
 #include "tr/tr_framebuffer.h"
 #include "tr/tr_vertex.h"
+#include "tr/tr_gpu_timer.h"
+#include "tr/tr_dynamic_resolution.h"
+#include "tr/tr_readback.h"
+#include "tr/tr_capture.h"
+#include "tr/tr_frame_stats.h"
+#include "tr/tr_game_loop.h"
+#include "tr/tr_frame_pacer.h"
+#include "tr/tr_redraw.h"
+#include "tr/tr_render_thread.h"
+#include "tr/tr_thread_pool.h"
+#include "tr/tr_command_buffer.h"
+#include "tr/tr_draw_queue.h"
+#include "tr/tr_upload_thread.h"
+#include "tr/tr_gl_texture.h"
+#include "tr/tr_image.h"
+#include "tr/tr_texture_uploader.h"
+#include "tr/tr_atlas.h"
+#include "tr/tr_texture_streamer.h"
+#include "tr/tr_scene_import.h"
+#include "tr/tr_mesh_lod.h"
+#include "tr/tr_meshlet.h"
+#include "tr/tr_animation.h"
+#include "tr/tr_uniform_buffer.h"
+#include "tr/tr_transform.h"
+#include "tr/tr_profiler.h"
+#include "tr/tr_gl_stats.h"
+#include "tr/tr_memory.h"
 #include "tr/resource.h"
+#include "game_world.h"
 
 void CheckGLError(const char* function) {
     GLenum err;
@@ -119,19 +155,6 @@ void test_init()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-void load_scene_file(std::string_view scene_file)
-{
-    Assimp::Importer importer;
-
-    // And have it read the given file with some example postprocessing
-    // Usually - if speed is not the most important aspect for you - you'll
-    // probably to request more postprocessing than we do in this example.
-    const aiScene* scene = importer.ReadFile(std::string(scene_file),
-        aiProcess_Triangulate            |
-        aiProcess_JoinIdenticalVertices  |
-        aiProcess_SortByPType);
-}
-
 void test(tr::framebuffer& fbo)
 {
     tr::scope buffer(fbo);
@@ -142,15 +165,20 @@ void test(tr::framebuffer& fbo)
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
-void init_imgui(tr::tr_window& wnd)
+void init_imgui(tr::tr_window& wnd, bool viewports)
 {
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(
+        [](size_t size, void*) { return tr::memory::allocate(tr::memory_tag::ui, size); },
+        [](void* ptr, void*) { tr::memory::deallocate(tr::memory_tag::ui, ptr); });
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;   // Enable Keyboard Controls
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;    // Enable Gamepad Controls
-    io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;     // Multiple view ports
+    if(viewports) {
+        io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable; // Multiple view ports
+    }
     io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;       // Allow docking of imgui windows
     
     // Setup Dear ImGui style
@@ -462,6 +490,7 @@ void ShowExampleAppDockSpace(bool* p_open, bool resize)
 
         ImGui::DockBuilderDockWindow("Settings", node_settings);
         ImGui::DockBuilderDockWindow("Test", node_test);
+        ImGui::DockBuilderDockWindow("Memory", node_test);
         ImGui::DockBuilderDockWindow("Game", node_game);
         ImGui::DockBuilderDockWindow("Controls", node_controls);
 
@@ -490,17 +519,1151 @@ void dump_gl_extensions(int verbosity)
     }
 }   
 
-#include <filesystem>
+// State of the demo simulation, a quad bouncing around the game view.
+struct sim_state
+{
+    glm::vec2 position{ 0.0f, 0.0f };
+    glm::vec2 velocity{ 0.6f, 0.45f };
+    float angle{ 0.0f };
+};
+
+constexpr float sim_quad_scale = 0.25f;
+/// @brief Spin of the quad in radians per second.
+constexpr float sim_spin = 1.0f;
+
+void tick_sim(sim_state& s, double dt)
+{
+    TR_PROFILE_ZONE("tick_sim");
+    const float step = static_cast<float>(dt);
+    s.position += s.velocity * step;
+    s.angle += sim_spin * step;
+
+    // Bounce off the edges of the view.
+    const float limit = 1.0f - sim_quad_scale;
+    for(int axis = 0; axis < 2; ++axis) {
+        if(s.position[axis] > limit) {
+            s.position[axis] = 2.0f * limit - s.position[axis];
+            s.velocity[axis] = -s.velocity[axis];
+        } else if(s.position[axis] < -limit) {
+            s.position[axis] = -2.0f * limit - s.position[axis];
+            s.velocity[axis] = -s.velocity[axis];
+        }
+    }
+}
+
+/// @brief Transform of the quad interpolated between two simulation states.
+glm::mat4 sim_transform(const sim_state& previous, const sim_state& current, double alpha)
+{
+    const float a = static_cast<float>(alpha);
+    const glm::vec2 position = glm::mix(previous.position, current.position, a);
+    const float angle = glm::mix(previous.angle, current.angle, a);
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(position, 0.0f));
+    m = glm::rotate(m, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(m, glm::vec3(sim_quad_scale));
+}
+
+/// @brief Transform of one copy of the quad, copies are laid out in a grid over the view.
+glm::mat4 instance_transform(const glm::mat4& transform, size_t instance, size_t columns)
+{
+    if(columns <= 1) {
+        return transform;
+    }
+    const float cell = 2.0f / static_cast<float>(columns);
+    const float x = -1.0f + cell * (static_cast<float>(instance % columns) + 0.5f);
+    const float y = -1.0f + cell * (static_cast<float>(instance / columns) + 0.5f);
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+    m = glm::scale(m, glm::vec3(1.0f / static_cast<float>(columns)));
+    return m * transform;
+}
+
+// Fills the world with copies of the quad, one in each cell of the grid
+// instance_transform() lays them out on.
+void spawn_quads(game::game_world& world, const tr::vertex_object& vto, const tr::tr_shader& shader, int transform_location, size_t instances)
+{
+    const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(instances))));
+    const float cell = 2.0f / static_cast<float>(columns);
+    for(size_t n = 0; n < instances; ++n) {
+        game::placement where;
+        if(columns > 1) {
+            where.position_ = glm::vec3(-1.0f + cell * (static_cast<float>(n % columns) + 0.5f), -1.0f + cell * (static_cast<float>(n / columns) + 0.5f), 0.0f);
+            where.scale_ = 1.0f / static_cast<float>(columns);
+        }
+        // The quad spans -1 to 1 on x and y.
+        world.spawn(where, { &vto, 0 }, { &shader, transform_location, 0 }, { glm::vec3(0.0f), std::sqrt(2.0f) });
+    }
+}
+
+// Splits the sorted draws into one command buffer per chunk. Buffers are
+// indexed by chunk, so they replay in the same order whichever worker
+// finishes first.
+void record_sorted(std::vector<tr::command_buffer>& buffers, tr::draw_queue& queue, tr::thread_pool& pool)
+{
+    queue.sort();
+    const size_t chunks = std::clamp<size_t>(queue.size(), 1, pool.concurrency());
+    buffers.resize(chunks);
+    pool.parallel_for(chunks, [&](size_t begin, size_t end) {
+        for(size_t chunk = begin; chunk < end; ++chunk) {
+            tr::command_buffer& cmd = buffers[chunk];
+            cmd.reset();
+            queue.record(cmd, queue.size() * chunk / chunks, queue.size() * (chunk + 1) / chunks);
+        }
+    });
+}
+
+// Records the scene's draws on the pool. The draws are queued and sorted by
+// key first, then the sorted list is split into one command buffer per chunk.
+void record_scene(std::vector<tr::command_buffer>& buffers, tr::draw_queue& queue, tr::thread_pool& pool, const tr::tr_shader& shader,
+    int transform_location, const tr::vertex_object& vto, const glm::mat4& transform, size_t instances)
+{
+    TR_PROFILE_ZONE("record scene");
+    const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(instances))));
+    queue.clear();
+    auto items = queue.allocate(instances);
+    pool.parallel_for(instances, [&](size_t begin, size_t end) {
+        for(size_t n = begin; n < end; ++n) {
+            tr::draw_item& item = items[n];
+            item.shader_ = &shader;
+            item.transform_location_ = transform_location;
+            item.vo_ = &vto;
+            item.transform_ = instance_transform(transform, n, columns);
+            // Clip space z of the quad's centre, mapped to [0, 1].
+            const float depth = item.transform_[3].z * 0.5f + 0.5f;
+            item.key_ = tr::draw_key::make(0, 0, false, 0, 0, 0, depth);
+        }
+    }, 64);
+    record_sorted(buffers, queue, pool);
+}
+
+/// @brief Triangles in the imported meshes drawn against those at full detail.
+struct lod_counts
+{
+    size_t full_triangles_{ 0 };
+    size_t drawn_triangles_{ 0 };
+    /// @brief Meshlets tested for the meshes drawn at full detail.
+    tr::cull_stats meshlets_{ };
+};
+
+// How the imported scene's skinned meshes are drawn. The GPU skins them from
+// each instance's range of the palette buffer, unless cpu_objects_ holds
+// vertices skinned on the CPU, an object for each instance and skinned mesh.
+struct skinned_draws
+{
+    const tr::tr_shader* shader_{ nullptr };
+    int transform_location_{ -1 };
+    unsigned palettes_{ 0 };
+    /// @brief Bytes from one instance's palette to the next.
+    size_t palette_stride_{ 0 };
+    std::span<const tr::vertex_object> cpu_objects_{ };
+};
+
+// Places the copies of the imported scene through a transform hierarchy. Each
+// copy's grid cell is a root, the simulated quad's motion is under it and the
+// fit of the meshes into the cell under that, so the model matrix of a copy
+// is the world matrix of its fit node. Only the motion changes each frame.
+struct scene_layout
+{
+    tr::transform_hierarchy transforms_{ };
+    std::vector<tr::transform_id> motions_{ };
+    std::vector<tr::transform_id> models_{ };
+
+    const glm::mat4& model(size_t instance) const { return transforms_.world(models_[instance]); }
+};
+
+void build_layout(scene_layout& layout, const tr::imported_scene& scene, size_t instances)
+{
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(std::numeric_limits<float>::lowest());
+    for(const auto& mesh : scene.meshes_) {
+        if(mesh.index_count_ > 0) {
+            lo = glm::min(lo, mesh.bounds_min_);
+            hi = glm::max(hi, mesh.bounds_max_);
+        }
+    }
+    const glm::vec3 size = hi - lo;
+    const float extent = std::max({ size.x * 0.5f, size.y * 0.5f, size.z * 0.5f, 1e-6f });
+    const glm::vec4 no_rotation(0.0f, 0.0f, 0.0f, 1.0f);
+    const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(instances))));
+    const float cell = 2.0f / static_cast<float>(columns);
+    for(size_t n = 0; n < instances; ++n) {
+        const tr::transform_id root = layout.transforms_.create();
+        if(columns > 1) {
+            const float x = -1.0f + cell * (static_cast<float>(n % columns) + 0.5f);
+            const float y = -1.0f + cell * (static_cast<float>(n / columns) + 0.5f);
+            layout.transforms_.set_local(root, glm::vec3(x, y, 0.0f), no_rotation, glm::vec3(1.0f / static_cast<float>(columns)));
+        }
+        const tr::transform_id motion = layout.transforms_.create(root);
+        const tr::transform_id model = layout.transforms_.create(motion);
+        layout.transforms_.set_local(model, -(lo + hi) * 0.5f / extent, no_rotation, glm::vec3(1.0f / extent));
+        layout.motions_.push_back(motion);
+        layout.models_.push_back(model);
+    }
+}
+
+// Moves every copy with the simulation, as sim_transform() does, and brings
+// the model matrices up to date.
+void update_layout(scene_layout& layout, const sim_state& previous, const sim_state& current, double alpha, tr::thread_pool& pool)
+{
+    const float a = static_cast<float>(alpha);
+    const glm::vec2 position = glm::mix(previous.position, current.position, a);
+    const float angle = glm::mix(previous.angle, current.angle, a);
+    const glm::vec4 rotation(0.0f, 0.0f, std::sin(angle * 0.5f), std::cos(angle * 0.5f));
+    for(const tr::transform_id motion : layout.motions_) {
+        layout.transforms_.set_local(motion, glm::vec3(position, 0.0f), rotation, glm::vec3(sim_quad_scale));
+    }
+    layout.transforms_.update(&pool);
+}
+
+// Records the imported scene's meshes in place of the quad, scaled to fit each
+// instance's cell. Every mesh of every instance is drawn at the coarsest level
+// of detail whose error stays within max_error_px once projected. Meshes drawn
+// at full detail that have meshlets only draw those that may be seen, the
+// visible ranges are kept in ranges, one list for each draw, until recorded.
+// Skinned meshes move away from their bounds, so they are never culled.
+lod_counts record_meshes(std::vector<tr::command_buffer>& buffers, tr::draw_queue& queue, tr::thread_pool& pool, const tr::tr_shader& shader,
+    int transform_location, const tr::imported_scene& scene, const scene_layout& layout, const glm::vec2& viewport, float max_error_px,
+    std::vector<std::vector<tr::index_range>>& ranges, const skinned_draws& skinned)
+{
+    TR_PROFILE_ZONE("record meshes");
+    // scene.object() draws each mesh with triangles, in order.
+    std::vector<const tr::mesh_data*> meshes;
+    for(const auto& mesh : scene.meshes_) {
+        if(mesh.index_count_ > 0) {
+            meshes.push_back(&mesh);
+        }
+    }
+    // Position of each mesh among the skinned ones, SIZE_MAX if it has no joints.
+    std::vector<size_t> skin_index(meshes.size(), SIZE_MAX);
+    size_t skinned_meshes = 0;
+    for(size_t m = 0; m < meshes.size(); ++m) {
+        if(tr::find_joints(*meshes[m]) != nullptr) {
+            skin_index[m] = skinned_meshes++;
+        }
+    }
+
+    const size_t instances = layout.models_.size();
+    queue.clear();
+    auto items = queue.allocate(instances * meshes.size());
+    ranges.resize(items.size());
+    lod_counts counts{ scene.triangles_ * instances, 0 };
+    std::mutex counts_mutex;
+    pool.parallel_for(instances, [&](size_t begin, size_t end) {
+        size_t triangles = 0;
+        tr::cull_stats culled;
+        for(size_t n = begin; n < end; ++n) {
+            const glm::mat4& model = layout.model(n);
+            // The transform takes the meshes straight to clip space, so its frustum is in their space.
+            const tr::frustum view = tr::frustum::from_matrix(model);
+            for(size_t m = 0; m < meshes.size(); ++m) {
+                const tr::mesh_data& mesh = *meshes[m];
+                const glm::vec3 centre = (mesh.bounds_min_ + mesh.bounds_max_) * 0.5f;
+                tr::draw_item& item = items[n * meshes.size() + m];
+                item.shader_ = &shader;
+                item.transform_location_ = transform_location;
+                item.vo_ = &scene.object(m);
+                item.transform_ = model;
+                item.first_index_ = mesh.first_index_;
+                item.index_count_ = mesh.index_count_;
+                uint32_t program = 0;
+                if(skin_index[m] != SIZE_MAX && !skinned.cpu_objects_.empty()) {
+                    item.vo_ = &skinned.cpu_objects_[n * skinned_meshes + skin_index[m]];
+                } else if(skin_index[m] != SIZE_MAX && skinned.shader_ != nullptr) {
+                    program = 1;
+                    item.shader_ = skinned.shader_;
+                    item.transform_location_ = skinned.transform_location_;
+                    item.uniform_buffer_ = skinned.palettes_;
+                    item.uniform_binding_ = tr::skinning_binding;
+                    item.uniform_offset_ = n * skinned.palette_stride_;
+                    item.uniform_length_ = tr::max_gpu_joints * sizeof(glm::mat4);
+                }
+                size_t level = 0;
+                if(!mesh.lods_.empty()) {
+                    level = tr::select_lod(mesh.lods_, tr::projected_scale(model, centre, viewport), max_error_px);
+                    const tr::mesh_lod& lod = mesh.lods_[level];
+                    item.first_index_ = mesh.first_index_ + lod.first_index_;
+                    item.index_count_ = lod.index_count_;
+                }
+                std::vector<tr::index_range>& visible = ranges[n * meshes.size() + m];
+                visible.clear();
+                if(level == 0 && !mesh.meshlets_.empty() && skin_index[m] == SIZE_MAX) {
+                    const size_t before = culled.triangles_;
+                    tr::cull_meshlets(mesh.meshlets_, view, visible, culled);
+                    item.ranges_ = visible;
+                    item.index_count_ = visible.empty() ? 0 : item.index_count_;
+                    triangles += culled.triangles_ - before;
+                } else {
+                    item.ranges_ = { };
+                    triangles += item.index_count_ / 3;
+                }
+                const float depth = (model * glm::vec4(centre, 1.0f)).z * 0.5f + 0.5f;
+                item.key_ = tr::draw_key::make(0, 0, false, program, 0, static_cast<uint32_t>(m), depth);
+            }
+        }
+        std::lock_guard lock(counts_mutex);
+        counts.drawn_triangles_ += triangles;
+        counts.meshlets_.meshlets_ += culled.meshlets_;
+        counts.meshlets_.frustum_culled_ += culled.frustum_culled_;
+        counts.meshlets_.backface_culled_ += culled.backface_culled_;
+        counts.meshlets_.triangles_ += culled.triangles_;
+    }, 16);
+    record_sorted(buffers, queue, pool);
+    return counts;
+}
+
+// Plays the imported scene's clips with one character on each instance, each
+// starting at its own clip and phase and blending towards the next clip, and
+// keeps the palettes, or the CPU skinned vertices, the draws read up to date.
+struct scene_animation
+{
+    std::vector<tr::animation_state> characters_{ };
+    /// @brief Every character's palette, \c stride_ matrices apart.
+    std::vector<glm::mat4> palettes_{ };
+    size_t stride_{ 0 };
+    std::unique_ptr<tr::uniform_buffer> buffer_{ };
+    /// @brief The skinned meshes drawn, in the order \c record_meshes() numbers them.
+    std::vector<const tr::mesh_data*> meshes_{ };
+    std::vector<tr::vertex_object> cpu_objects_{ };
+    std::vector<std::vector<uint8_t>> cpu_vertices_{ };
+    skinned_draws draws_{ };
+
+    bool active() const { return !characters_.empty(); }
+    bool cpu_skinning() const { return !cpu_objects_.empty(); }
+};
+
+// Sets up the characters if the scene has a skeleton and clips. Skinning
+// falls to the CPU when asked, when there is no skinning shader or when the
+// skeleton has more joints than a uniform block holds.
+void start_animation(scene_animation& anim, const tr::imported_scene& scene, size_t characters, const tr::tr_shader* skinned_shader, bool cpu)
+{
+    const tr::skeleton& skel = scene.skeleton_;
+    if(skel.empty() || scene.clips_.empty() || characters == 0) {
+        return;
+    }
+    for(const auto& mesh : scene.meshes_) {
+        if(mesh.index_count_ > 0 && tr::find_joints(mesh) != nullptr) {
+            anim.meshes_.push_back(&mesh);
+        }
+    }
+    anim.characters_.resize(characters);
+    for(size_t n = 0; n < characters; ++n) {
+        tr::animation_state& s = anim.characters_[n];
+        s.clip_ = &scene.clips_[n % scene.clips_.size()];
+        s.blend_clip_ = &scene.clips_[(n + 1) % scene.clips_.size()];
+        s.blend_weight_ = static_cast<float>(n % 3) * 0.25f;
+        s.time_ = static_cast<float>(n) * 0.37f;
+        s.blend_time_ = s.time_;
+    }
+    cpu = cpu || skinned_shader == nullptr || skel.size() > tr::max_gpu_joints;
+    if(cpu) {
+        anim.stride_ = skel.size();
+        anim.palettes_.resize(characters * anim.stride_);
+        anim.cpu_vertices_.resize(characters * anim.meshes_.size());
+        for(size_t n = 0; n < characters; ++n) {
+            for(size_t m = 0; m < anim.meshes_.size(); ++m) {
+                anim.cpu_objects_.emplace_back(tr::build_vertex_object(*anim.meshes_[m]));
+                anim.cpu_vertices_[n * anim.meshes_.size() + m].resize(anim.meshes_[m]->vertices_.size());
+            }
+        }
+        anim.draws_.cpu_objects_ = anim.cpu_objects_;
+    } else {
+        // Each palette starts where GL allows a range to be bound, and the last is padded so
+        // every bound range covers the whole block.
+        const size_t alignment = tr::uniform_buffer::offset_alignment();
+        const size_t bytes = (skel.size() * sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+        anim.stride_ = bytes / sizeof(glm::mat4);
+        anim.palettes_.resize((characters - 1) * anim.stride_ + tr::max_gpu_joints);
+        anim.buffer_ = std::make_unique<tr::uniform_buffer>(tr::memory_tag::animation);
+        skinned_shader->bind_uniform_block("Bones", tr::skinning_binding);
+        anim.draws_.shader_ = skinned_shader;
+        anim.draws_.transform_location_ = skinned_shader->uniform_location("uTransform");
+        anim.draws_.palettes_ = anim.buffer_->id();
+        anim.draws_.palette_stride_ = bytes;
+    }
+    spdlog::info("Animating {} characters of {} joints with {} clips, skinned on the {}", characters, skel.size(), scene.clips_.size(),
+        cpu ? "CPU" : "GPU");
+}
+
+// Advances and evaluates every character on the pool, then uploads what the draws read.
+void update_animation(scene_animation& anim, const tr::imported_scene& scene, tr::thread_pool& pool, float seconds)
+{
+    TR_PROFILE_ZONE("animation");
+    tr::advance_animations(anim.characters_, seconds);
+    tr::evaluate_palettes(pool, scene.skeleton_, anim.characters_, anim.palettes_, anim.stride_);
+    if(anim.cpu_skinning()) {
+        const size_t meshes = anim.meshes_.size();
+        pool.parallel_for(anim.cpu_vertices_.size(), [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; ++i) {
+                const std::span<const glm::mat4> palette(anim.palettes_.data() + (i / meshes) * anim.stride_, scene.skeleton_.size());
+                tr::skin_vertices(*anim.meshes_[i % meshes], palette, anim.cpu_vertices_[i].data());
+            }
+        });
+        for(size_t i = 0; i < anim.cpu_objects_.size(); ++i) {
+            anim.cpu_objects_[i].update(tr::vertex_object::update_type::vertex, 0, anim.cpu_vertices_[i].data(), anim.cpu_vertices_[i].size());
+        }
+    } else {
+        anim.buffer_->write(anim.palettes_.data(), anim.palettes_.size() * sizeof(glm::mat4));
+    }
+}
+
+// Scene pass, shared by the windowed and headless loops.
+void render_scene(tr::framebuffer& fbo, const std::vector<tr::command_buffer>& commands, tr::gpu_timer& timer)
+{
+    TR_PROFILE_ZONE("scene");
+    TR_PROFILE_GPU_ZONE("scene");
+    TR_GL_PASS("scene");
+    tr::scope buffer(fbo);
+    timer.begin();
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    tr::command_buffer::execute(commands);
+    timer.end();
+}
+
+// Changes to renderer state requested by the UI, run by the renderer before its next frame.
+typedef std::vector<std::function<void()>> render_commands;
+
+struct ui_draw_data_deleter
+{
+    void operator()(ImDrawData* data) const
+    {
+        for(ImDrawList* list : data->CmdLists) {
+            IM_DELETE(list);
+        }
+        IM_DELETE(data);
+    }
+};
+
+typedef std::unique_ptr<ImDrawData, ui_draw_data_deleter> ui_draw_data_ptr;
+
+/// @brief Deep copy of ImGui's draw data, which is reused by the next \c NewFrame().
+ui_draw_data_ptr clone_draw_data(const ImDrawData* source)
+{
+    ui_draw_data_ptr copy(IM_NEW(ImDrawData)(*source));
+    for(ImDrawList*& list : copy->CmdLists) {
+        list = list->CloneOutput();
+    }
+    copy->OwnerViewport = nullptr;
+    return copy;
+}
+
+// Everything the renderer needs for a frame, built on the main thread and not changed after.
+struct frame_snapshot
+{
+    /// @brief The scene's draws, replayed in order.
+    std::vector<tr::command_buffer> scene_;
+    bool render_scene_{ true };
+    tr::framebuffer_layout layout_;
+    /// @brief Draw data of the UI, ImGui's own when rendering on the main thread, otherwise \c ui_copy_.
+    ImDrawData* ui_{ nullptr };
+    ui_draw_data_ptr ui_copy_;
+    /// @brief Render ImGui's platform windows, only possible on the main thread.
+    bool platform_windows_{ false };
+    ImVec4 clear_color_;
+    /// @brief Timestamp of the oldest input handled for this frame, 0 if none.
+    uint64_t input_ns_{ 0 };
+    render_commands commands_;
+};
+
+// Figures about the renderer the UI shows, published after each frame.
+struct render_stats
+{
+    double scene_gpu_ms_{ 0.0 };
+    /// @brief Counts scene timings, so each is fed to the dynamic resolution once.
+    uint64_t scene_samples_{ 0 };
+    double frame_ms_{ 0.0 };
+    double jitter_ms_{ 0.0 };
+    double latency_ms_{ 0.0 };
+    double latency_max_ms_{ 0.0 };
+    double gpu_wait_ms_{ 0.0 };
+    size_t queued_frames_{ 0 };
+    size_t pending_readbacks_{ 0 };
+    size_t pending_uploads_{ 0 };
+    uint64_t bytes_uploaded_{ 0 };
+    size_t scene_meshes_{ 0 };
+    size_t scene_triangles_{ 0 };
+    tr::import_timings import_timings_;
+};
+
+// Objects only the thread owning the GL context may touch.
+struct renderer
+{
+    tr::tr_window& window_;
+    tr::framebuffer& fbo_;
+    tr::gpu_timer& scene_timer_;
+    tr::async_readback& readback_;
+    tr::frame_capture& capture_;
+    tr::frame_pacer& pacer_;
+    tr::upload_thread& uploads_;
+    tr::scene_importer& importer_;
+    /// @brief The imported scene's meshes, built and replaced by the importer's callback.
+    tr::imported_scene& scene_asset_;
+    tr::texture_streamer& streamer_;
+};
+
+// Turns a snapshot into GL calls and presents it, on whichever thread owns the context.
+void render_frame(renderer& r, frame_snapshot& snapshot, render_stats& stats)
+{
+    // Only uploads whose fence has signalled are handed over, so this never waits.
+    r.uploads_.publish();
+    r.importer_.poll(&r.uploads_);
+    for(auto& command : snapshot.commands_) {
+        command();
+    }
+    r.streamer_.update();
+
+    r.fbo_.set_layout(snapshot.layout_);
+    if(r.scene_timer_.poll()) {
+        stats.scene_gpu_ms_ = r.scene_timer_.last_ms();
+        ++stats.scene_samples_;
+    }
+    if(snapshot.render_scene_) {
+        render_scene(r.fbo_, snapshot.scene_, r.scene_timer_);
+    }
+
+    // Read backs complete a frame or more later, without waiting on the GPU.
+    {
+        TR_GL_PASS("readback");
+        r.capture_.update(r.readback_, r.fbo_);
+        r.readback_.poll();
+    }
+
+    {
+        TR_PROFILE_ZONE("ui render");
+        TR_PROFILE_GPU_ZONE("ui");
+        TR_GL_PASS("ui");
+        const ImVec4& c = snapshot.clear_color_;
+        glViewport(0, 0, static_cast<int>(snapshot.ui_->DisplaySize.x), static_cast<int>(snapshot.ui_->DisplaySize.y));
+        glClearColor(c.x * c.w, c.y * c.w, c.z * c.w, c.w);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        ImGui_ImplOpenGL3_RenderDrawData(snapshot.ui_);
+
+        // Update and Render additional Platform Windows
+        if(snapshot.platform_windows_) {
+            SDL_Window* backup_current_window = SDL_GL_GetCurrentWindow();
+            SDL_GLContext backup_current_context = SDL_GL_GetCurrentContext();
+            ImGui::UpdatePlatformWindows();
+            ImGui::RenderPlatformWindowsDefault();
+            SDL_GL_MakeCurrent(backup_current_window, backup_current_context);
+        }
+    }
+
+    // Update the surface
+    r.window_.swap();
+    r.pacer_.end_frame(snapshot.input_ns_);
+    tr::profiler::end_frame();
+    tr::gl_stats::end_frame();
+
+    stats.frame_ms_ = r.pacer_.frame_ms();
+    stats.jitter_ms_ = r.pacer_.jitter_ms();
+    stats.latency_ms_ = r.pacer_.latency_ms();
+    stats.latency_max_ms_ = r.pacer_.latency_max_ms();
+    stats.gpu_wait_ms_ = r.pacer_.gpu_wait_ms();
+    stats.queued_frames_ = r.pacer_.queued_frames();
+    stats.pending_readbacks_ = r.readback_.pending();
+    stats.pending_uploads_ = r.uploads_.pending();
+    stats.bytes_uploaded_ = r.uploads_.bytes_uploaded();
+    stats.scene_meshes_ = r.scene_asset_.drawn_meshes();
+    stats.scene_triangles_ = r.scene_asset_.triangles_;
+    stats.import_timings_ = r.scene_asset_.timings_;
+}
+
+struct headless_options
+{
+    /// @brief Frames to render, 0 to run for \c seconds_ instead.
+    size_t frames_{ 0 };
+    /// @brief Seconds to run for, 0 to run for \c frames_ instead.
+    double seconds_{ 0.0 };
+    /// @brief Frames rendered before measuring starts, they include shader and driver warm up.
+    size_t warmup_frames_{ 10 };
+    /// @brief Where the json statistics are written, "-" for stdout.
+    std::string stats_file_;
+    std::string scene_;
+    /// @brief Where the profiler's Chrome trace is written on exit, empty for none.
+    std::string trace_file_;
+    /// @brief Screen space error, in pixels, the scene's levels of detail may show.
+    float lod_error_px_{ 1.0f };
+    /// @brief Skin the scene's animated meshes on the CPU rather than the GPU.
+    bool cpu_skinning_{ false };
+};
+
+// Adds one frame's counts to the run's totals.
+void accumulate(lod_counts& totals, const lod_counts& frame)
+{
+    totals.full_triangles_ += frame.full_triangles_;
+    totals.drawn_triangles_ += frame.drawn_triangles_;
+    totals.meshlets_.meshlets_ += frame.meshlets_.meshlets_;
+    totals.meshlets_.frustum_culled_ += frame.meshlets_.frustum_culled_;
+    totals.meshlets_.backface_culled_ += frame.meshlets_.backface_culled_;
+    totals.meshlets_.triangles_ += frame.meshlets_.triangles_;
+}
+
+// Renders the scene into the frame buffer only, as fast as possible, and writes
+// the frame time statistics on exit. Used for automated performance runs.
+int run_headless(const headless_options& opts, tr::framebuffer& fbo, const tr::tr_shader& shader, const tr::tr_shader* skinned_shader,
+    const tr::vertex_object& vto, tr::async_readback& readback, tr::frame_capture& capture, tr::thread_pool& pool, size_t instances,
+    const tr::imported_scene& scene_asset)
+{
+    using clock = std::chrono::steady_clock;
+
+    tr::frame_stats stats(opts.frames_);
+    tr::frame_stats gpu_stats(opts.frames_);
+    tr::gpu_timer scene_timer;
+    sim_state previous;
+    sim_state current;
+    const int transform_location = shader.uniform_location("uTransform");
+    std::vector<tr::command_buffer> scene;
+    tr::draw_queue scene_queue;
+    lod_counts lod_totals;
+    std::vector<std::vector<tr::index_range>> visible_ranges;
+    scene_animation animation;
+    start_animation(animation, scene_asset, instances, skinned_shader, opts.cpu_skinning_);
+    tr::frame_stats animation_stats(opts.frames_);
+    scene_layout layout;
+    if(!scene_asset.empty()) {
+        build_layout(layout, scene_asset, instances);
+    }
+    tr::frame_stats layout_stats(opts.frames_);
+
+    spdlog::info("Headless run at {} x {} for {}", fbo.width(), fbo.height(),
+        opts.frames_ != 0 ? fmt::format("{} frames", opts.frames_) : fmt::format("{} seconds", opts.seconds_));
+
+    const auto start = clock::now();
+    auto last = start;
+    bool running{ true };
+    for(size_t frame = 0; running; ++frame) {
+        // Keep SDL's queue drained, a quit request still ends the run early.
+        SDL_Event e;
+        while(SDL_PollEvent(&e)) {
+            if(e.type == SDL_EVENT_QUIT) {
+                running = false;
+            }
+        }
+
+        // Exactly one tick per frame so runs, and any captured frames, are repeatable.
+        previous = current;
+        tick_sim(current, 1.0 / 60.0);
+        if(scene_asset.empty()) {
+            record_scene(scene, scene_queue, pool, shader, transform_location, vto, sim_transform(previous, current, 1.0), instances);
+        } else {
+            if(animation.active()) {
+                const auto animation_start = clock::now();
+                update_animation(animation, scene_asset, pool, 1.0f / 60.0f);
+                if(frame >= opts.warmup_frames_) {
+                    animation_stats.add(std::chrono::duration<double, std::milli>(clock::now() - animation_start).count());
+                }
+            }
+            const auto layout_start = clock::now();
+            update_layout(layout, previous, current, 1.0, pool);
+            if(frame >= opts.warmup_frames_) {
+                layout_stats.add(std::chrono::duration<double, std::milli>(clock::now() - layout_start).count());
+            }
+            const glm::vec2 viewport(static_cast<float>(fbo.width()), static_cast<float>(fbo.height()));
+            const lod_counts counts = record_meshes(scene, scene_queue, pool, shader, transform_location, scene_asset,
+                layout, viewport, opts.lod_error_px_, visible_ranges, animation.draws_);
+            if(frame >= opts.warmup_frames_) {
+                accumulate(lod_totals, counts);
+            }
+        }
+        render_scene(fbo, scene, scene_timer);
+        capture.update(readback, fbo);
+        readback.poll();
+
+        // Nothing is presented, so finish the frame here to make the
+        // measured time include the GPU work and to stop the driver queueing
+        // an unbounded number of frames.
+        glFinish();
+
+        const auto now = clock::now();
+        if(frame >= opts.warmup_frames_) {
+            stats.add(std::chrono::duration<double, std::milli>(now - last).count());
+            if(scene_timer.poll()) {
+                gpu_stats.add(scene_timer.last_ms());
+            }
+        } else {
+            scene_timer.poll();
+        }
+        last = now;
+        tr::profiler::end_frame();
+        tr::gl_stats::end_frame();
+
+        const size_t measured = frame + 1 > opts.warmup_frames_ ? frame + 1 - opts.warmup_frames_ : 0;
+        if(opts.frames_ != 0 && measured >= opts.frames_) {
+            running = false;
+        }
+        if(opts.seconds_ > 0.0 && std::chrono::duration<double>(now - start).count() >= opts.seconds_) {
+            running = false;
+        }
+    }
+    readback.flush();
+    if(!opts.trace_file_.empty()) {
+        tr::profiler::write_chrome_trace(opts.trace_file_);
+    }
+    tr::profiler::shutdown();
+
+    nlohmann::json result{
+        { "scene", opts.scene_.empty() ? "default" : opts.scene_ },
+        { "width", fbo.width() },
+        { "height", fbo.height() },
+        { "instances", instances },
+        { "worker_threads", pool.concurrency() },
+        { "renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)) },
+        { "vendor", reinterpret_cast<const char*>(glGetString(GL_VENDOR)) },
+        { "warmup_frames", opts.warmup_frames_ },
+        { "frame_time", tr::to_json(stats.summarise()) },
+        { "scene_gpu_time", tr::to_json(gpu_stats.summarise()) },
+    };
+    if(!scene_asset.empty()) {
+        const tr::import_timings& t = scene_asset.timings_;
+        result["import"] = {
+            { "meshes", scene_asset.drawn_meshes() },
+            { "triangles", scene_asset.triangles_ },
+            { "read_ms", t.read_ms_ },
+            { "convert_ms", t.convert_ms_ },
+            { "build_ms", t.build_ms_ },
+            { "total_ms", t.total_ms_ },
+        };
+        size_t levels = 0;
+        for(const auto& mesh : scene_asset.meshes_) {
+            levels = std::max(levels, mesh.lods_.size());
+        }
+        const size_t measured = std::max<size_t>(stats.count(), 1);
+        result["lod"] = {
+            { "levels", levels },
+            { "max_error_px", opts.lod_error_px_ },
+            { "full_triangles_per_frame", lod_totals.full_triangles_ / measured },
+            { "drawn_triangles_per_frame", lod_totals.drawn_triangles_ / measured },
+            { "reduction", lod_totals.drawn_triangles_ > 0 ? static_cast<double>(lod_totals.full_triangles_) / static_cast<double>(lod_totals.drawn_triangles_) : 0.0 },
+        };
+        const tr::cull_stats& culled = lod_totals.meshlets_;
+        if(culled.meshlets_ > 0) {
+            result["meshlets"] = {
+                { "tested_per_frame", culled.meshlets_ / measured },
+                { "frustum_culled_per_frame", culled.frustum_culled_ / measured },
+                { "backface_culled_per_frame", culled.backface_culled_ / measured },
+                { "drawn_triangles_per_frame", culled.triangles_ / measured },
+                { "culled_fraction", static_cast<double>(culled.frustum_culled_ + culled.backface_culled_) / static_cast<double>(culled.meshlets_) },
+            };
+        }
+        result["transforms"] = {
+            { "nodes", layout.transforms_.size() },
+            { "levels", layout.transforms_.levels() },
+            { "update_time", tr::to_json(layout_stats.summarise()) },
+        };
+        if(animation.active()) {
+            size_t clip_bytes = 0;
+            size_t uncompressed_bytes = 0;
+            for(const auto& clip : scene_asset.clips_) {
+                clip_bytes += clip.size_bytes();
+                uncompressed_bytes += clip.uncompressed_bytes();
+            }
+            result["animation"] = {
+                { "characters", animation.characters_.size() },
+                { "joints", scene_asset.skeleton_.size() },
+                { "clips", scene_asset.clips_.size() },
+                { "skinning", animation.cpu_skinning() ? "cpu" : "gpu" },
+                { "clip_bytes", clip_bytes },
+                { "uncompressed_clip_bytes", uncompressed_bytes },
+                { "update_time", tr::to_json(animation_stats.summarise()) },
+            };
+        }
+    }
+    result["memory"] = tr::memory::to_json();
+    if(tr::gl_stats::enabled()) {
+        result["gl_calls_per_frame"] = tr::to_json(tr::gl_stats::last_frame());
+    }
+
+    if(opts.stats_file_ == "-") {
+        std::cout << result.dump(4) << std::endl;
+    } else {
+        std::ofstream f{ opts.stats_file_ };
+        if(!f.is_open()) {
+            spdlog::critical("Unable to write frame statistics to \"{}\"", opts.stats_file_);
+            return 1;
+        }
+        f << result.dump(4) << std::endl;
+        spdlog::info("Frame statistics written to \"{}\"", opts.stats_file_);
+    }
+    return 0;
+}
+
+/// @brief If the event is user input, for measuring input latency.
+bool is_input_event(const SDL_Event& e)
+{
+    switch(e.type)
+    {
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_KEY_UP:
+        case SDL_EVENT_TEXT_INPUT:
+        case SDL_EVENT_MOUSE_MOTION:
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+        case SDL_EVENT_MOUSE_BUTTON_UP:
+        case SDL_EVENT_MOUSE_WHEEL:
+        case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+        case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+        case SDL_EVENT_GAMEPAD_BUTTON_UP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Flame graph of the newest profiled frame with its GPU work resolved, one
+// lane per thread and one for the GPU, nested zones stacked below their parent.
+void draw_profiler(const std::string& capture_dir)
+{
+    bool paused = tr::profiler::paused();
+    if(ImGui::Checkbox("Pause profiler", &paused)) {
+        tr::profiler::set_paused(paused);
+    }
+    ImGui::SameLine();
+    if(ImGui::Button("Export trace")) {
+        std::filesystem::create_directories(capture_dir);
+        const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+        tr::profiler::write_chrome_trace(fmt::format("{}/trace_{:%Y%m%d_%H%M%S}.json", capture_dir, now));
+    }
+
+    // The frames may be ended on the render thread.
+    const auto frames_lock = tr::profiler::lock_frames();
+    const tr::profiler::frame* f = tr::profiler::last_resolved_frame();
+    if(f == nullptr) {
+        return;
+    }
+    ImGui::SameLine();
+    ImGui::Text("Frame %llu: %.2f ms, %zu dropped zones", static_cast<unsigned long long>(f->index_),
+        (f->end_ns_ - f->start_ns_) / 1000000.0, tr::profiler::dropped_zones());
+
+    // GPU work runs behind the CPU, widen the range so it is all visible.
+    uint64_t range_start = f->start_ns_;
+    uint64_t range_end = f->end_ns_;
+    for(const auto& z : f->gpu_) {
+        range_start = std::min(range_start, z.start_ns_);
+        range_end = std::max(range_end, z.end_ns_);
+    }
+    const double range_ns = static_cast<double>(std::max<uint64_t>(range_end - range_start, 1));
+
+    struct lane
+    {
+        uint32_t id_;
+        std::string name_;
+        uint32_t depth_;
+    };
+    std::vector<lane> lanes;
+    for(auto& t : tr::profiler::threads()) {
+        lanes.emplace_back(lane{ t.id_, std::move(t.name_), 0 });
+    }
+    lanes.emplace_back(lane{ tr::profiler::gpu_thread_id, "GPU", 0 });
+    auto find_lane = [&](uint32_t id) -> lane* {
+        for(auto& l : lanes) {
+            if(l.id_ == id) {
+                return &l;
+            }
+        }
+        return nullptr;
+    };
+    for(const auto* zones : { &f->cpu_, &f->gpu_ }) {
+        for(const auto& z : *zones) {
+            if(lane* l = find_lane(z.thread_id_)) {
+                l->depth_ = std::max(l->depth_, z.depth_ + 1);
+            }
+        }
+    }
+
+    const float row_height = ImGui::GetTextLineHeight() + 4.0f;
+    const float label_width = 100.0f;
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float graph_width = std::max(ImGui::GetContentRegionAvail().x - label_width, 1.0f);
+    const ImVec2 mouse = ImGui::GetMousePos();
+
+    float y = origin.y;
+    std::vector<float> lane_y;
+    for(const auto& l : lanes) {
+        lane_y.push_back(y);
+        draw->AddText(ImVec2(origin.x, y + 2.0f), ImGui::GetColorU32(ImGuiCol_Text), l.name_.c_str());
+        y += row_height * static_cast<float>(std::max<uint32_t>(l.depth_, 1)) + 4.0f;
+    }
+
+    const tr::profiler::zone* hovered = nullptr;
+    for(const auto* zones : { &f->cpu_, &f->gpu_ }) {
+        for(const auto& z : *zones) {
+            lane* l = find_lane(z.thread_id_);
+            if(l == nullptr || z.end_ns_ < range_start || z.start_ns_ > range_end) {
+                continue;
+            }
+            const float top = lane_y[l - lanes.data()] + row_height * static_cast<float>(z.depth_);
+            const float x0 = origin.x + label_width + static_cast<float>((static_cast<double>(z.start_ns_) - range_start) / range_ns) * graph_width;
+            const float x1 = std::max(x0 + 1.0f, origin.x + label_width + static_cast<float>((static_cast<double>(z.end_ns_) - range_start) / range_ns) * graph_width);
+            const ImVec2 p0(x0, top);
+            const ImVec2 p1(x1, top + row_height - 1.0f);
+
+            // A stable colour per name makes the same zone easy to follow between frames.
+            const size_t h = std::hash<std::string_view>{ }(z.name_);
+            const ImU32 colour = IM_COL32(80 + (h & 0x7F), 80 + ((h >> 8) & 0x7F), 80 + ((h >> 16) & 0x7F), 255);
+            draw->AddRectFilled(p0, p1, colour);
+            draw->PushClipRect(p0, p1, true);
+            draw->AddText(ImVec2(x0 + 2.0f, top + 1.0f), IM_COL32_BLACK, z.name_);
+            draw->PopClipRect();
+
+            if(mouse.x >= p0.x && mouse.x < p1.x && mouse.y >= p0.y && mouse.y < p1.y) {
+                hovered = &z;
+            }
+        }
+    }
+    ImGui::Dummy(ImVec2(label_width + graph_width, y - origin.y));
+
+    if(hovered != nullptr && ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("%s\n%.3f ms", hovered->name_, (hovered->end_ns_ - hovered->start_ns_) / 1000000.0);
+    }
+}
+
+// Current and peak memory per subsystem, GPU figures are estimates.
+void draw_memory(const std::string& capture_dir)
+{
+    if(ImGui::Button("Dump json")) {
+        std::filesystem::create_directories(capture_dir);
+        const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+        tr::memory::write_json(fmt::format("{}/memory_{:%Y%m%d_%H%M%S}.json", capture_dir, now));
+    }
+
+    constexpr double mib = 1024.0 * 1024.0;
+    if(ImGui::BeginTable("memory", 6, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Tag");
+        ImGui::TableSetupColumn("CPU MiB");
+        ImGui::TableSetupColumn("CPU peak");
+        ImGui::TableSetupColumn("Allocs");
+        ImGui::TableSetupColumn("GPU MiB");
+        ImGui::TableSetupColumn("GPU peak");
+        ImGui::TableHeadersRow();
+
+        auto row = [&](const char* name, const tr::memory_usage& cpu, const tr::memory_usage& gpu) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", cpu.current_bytes_ / mib);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", cpu.peak_bytes_ / mib);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", cpu.live_allocations_);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", gpu.current_bytes_ / mib);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", gpu.peak_bytes_ / mib);
+        };
+        for(size_t n = 0; n < static_cast<size_t>(tr::memory_tag::count); ++n) {
+            const auto tag = static_cast<tr::memory_tag>(n);
+            row(tr::to_string(tag), tr::memory::cpu_usage(tag), tr::memory::gpu_usage(tag));
+        }
+        row("total", tr::memory::cpu_total(), tr::memory::gpu_total());
+        ImGui::EndTable();
+    }
+}
+
+// Generated images of assorted sizes, to exercise the atlas packer.
+void fill_test_atlas(tr::texture_atlas& atlas, std::vector<std::string>& names)
+{
+    std::vector<uint8_t> pixels;
+    for(size_t n = 0; n < 64; ++n) {
+        const size_t width = 16 + (n * 37) % 96;
+        const size_t height = 16 + (n * 53) % 80;
+        pixels.resize(width * height * 4);
+        for(size_t y = 0; y < height; ++y) {
+            for(size_t x = 0; x < width; ++x) {
+                uint8_t* p = pixels.data() + (y * width + x) * 4;
+                p[0] = static_cast<uint8_t>(x * 255 / width);
+                p[1] = static_cast<uint8_t>(y * 255 / height);
+                p[2] = static_cast<uint8_t>((n * 40) & 0xff);
+                p[3] = 255;
+            }
+        }
+        std::string name = fmt::format("test_{}", n);
+        if(atlas.insert(name, width, height, pixels.data())) {
+            names.emplace_back(std::move(name));
+        }
+    }
+}
+
+// Packing statistics and the first page, drawn as one batch of quads.
+void draw_atlas(tr::texture_atlas& atlas, const std::vector<std::string>& names)
+{
+    const tr::atlas_stats s = atlas.stats();
+    ImGui::Text("%zu images on %zu pages of %zu, %.1f%% used, %zu evictions", s.entries_, s.pages_, atlas.page_size(), s.efficiency_ * 100.0, s.evictions_);
+
+    const unsigned texture = atlas.page_texture(0);
+    if(texture == 0) {
+        return;
+    }
+    // Every image shares the page's texture, so ImGui merges the quads into one draw.
+    const ImTextureID id = static_cast<ImTextureID>(texture);
+    const float scale = std::min(1.0f, ImGui::GetContentRegionAvail().x / static_cast<float>(atlas.page_size()));
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    tr::atlas_entry e;
+    for(const auto& name : names) {
+        if(atlas.find(name, e) && e.page_ == 0) {
+            const ImVec2 a(origin.x + static_cast<float>(e.x_) * scale, origin.y + static_cast<float>(e.y_) * scale);
+            const ImVec2 b(a.x + static_cast<float>(e.width_) * scale, a.y + static_cast<float>(e.height_) * scale);
+            draw->AddImage(id, a, b, ImVec2(e.u0_, e.v0_), ImVec2(e.u1_, e.v1_));
+        }
+    }
+    ImGui::Dummy(ImVec2(static_cast<float>(atlas.page_size()) * scale, static_cast<float>(atlas.page_size()) * scale));
+}
+
+/// @brief Registers every baked texture in the resources' textures directory.
+void register_streamed_textures(tr::texture_streamer& streamer, std::vector<tr::texture_streamer::handle>& handles)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for(const auto& file : fs::directory_iterator(tr::resource::resolve("textures"), ec)) {
+        if(file.path().extension() != ".trtex") {
+            continue;
+        }
+        const auto h = streamer.register_texture((fs::path("textures") / file.path().filename()).string());
+        if(h != tr::texture_streamer::invalid_handle) {
+            handles.push_back(h);
+        }
+    }
+}
+
+// Entities in the world and what each of its systems took in the last frame.
+void draw_world(const game::game_world& world)
+{
+    ImGui::Text("%zu entities, %zu visible", world.entities(), world.visible());
+    ImGui::Text("Systems %.3f ms", world.progress_ms());
+    if(ImGui::BeginTable("systems", 2, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("System");
+        ImGui::TableSetupColumn("CPU ms");
+        ImGui::TableHeadersRow();
+        for(const auto& t : world.timings()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(t.name_);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", t.ms_);
+        }
+        ImGui::EndTable();
+    }
+}
+
+void draw_streaming(tr::texture_streamer& streamer, const std::vector<tr::texture_streamer::handle>& handles, float& size)
+{
+    constexpr double mib = 1024.0 * 1024.0;
+    const tr::streaming_stats s = streamer.stats();
+    int budget = static_cast<int>(streamer.budget() >> 20);
+    if(ImGui::SliderInt("Budget (MiB)", &budget, 1, 2048)) {
+        streamer.set_budget(static_cast<size_t>(budget) << 20);
+    }
+    ImGui::Text("%zu textures, %.1f MiB resident, %.1f MiB wanted", s.textures_, static_cast<double>(s.resident_bytes_) / mib, static_cast<double>(s.wanted_bytes_) / mib);
+    ImGui::Text("%zu loading, %zu levels held back by the budget", s.pending_loads_, s.deferred_levels_);
+    ImGui::Text("%llu levels loaded (%.1f MiB), %llu dropped", static_cast<unsigned long long>(s.loaded_levels_), static_cast<double>(s.bytes_streamed_) / mib,
+        static_cast<unsigned long long>(s.dropped_levels_));
+    ImGui::SliderFloat("Size", &size, 16.0f, 2048.0f, "%.0f px", ImGuiSliderFlags_Logarithmic);
+    for(const auto h : handles) {
+        ImGui::Text("%s, level %zu", streamer.name(h).c_str(), streamer.resident_level(h));
+        const unsigned texture = streamer.texture_id(h);
+        if(texture == 0) {
+            continue;
+        }
+        ImGui::Image(static_cast<ImTextureID>(texture), ImVec2(size, size));
+        // Only what is on screen counts, a texture scrolled out of view is left to lose its detail.
+        if(ImGui::IsItemVisible()) {
+            streamer.note_usage(h, size, size);
+        }
+    }
+}
+
+// Small transparent window in the corner of the main viewport with the GL
+// counters of the previous frame, the toggle stays visible while disabled.
+void draw_gl_stats_overlay(render_commands& commands)
+{
+    const ImGuiViewport* viewport = ImGui::GetMainViewport();
+    const float pad = 10.0f;
+    ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - pad, viewport->WorkPos.y + pad), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowViewport(viewport->ID);
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_AlwaysAutoResize
+        | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove;
+    if(!ImGui::Begin("GL stats", nullptr, flags)) {
+        ImGui::End();
+        return;
+    }
+
+    bool enabled = tr::gl_stats::enabled();
+    if(ImGui::Checkbox("GL stats", &enabled)) {
+        commands.emplace_back([enabled]() { tr::gl_stats::set_enabled(enabled); });
+    }
+    if(enabled && ImGui::BeginTable("gl_counters", 7, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Pass");
+        ImGui::TableSetupColumn("Draws");
+        ImGui::TableSetupColumn("Programs");
+        ImGui::TableSetupColumn("VAOs");
+        ImGui::TableSetupColumn("FBOs");
+        ImGui::TableSetupColumn("Textures");
+        ImGui::TableSetupColumn("Uploads");
+        ImGui::TableHeadersRow();
+
+        auto row = [](const char* name, const tr::gl_counters& c) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(c.draw_calls_));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(c.program_binds_));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(c.vao_binds_));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(c.fbo_binds_));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(c.texture_binds_));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu (%.1f KiB)", static_cast<unsigned long long>(c.uploads_), c.upload_bytes_ / 1024.0);
+        };
+        const auto& frame = tr::gl_stats::last_frame();
+        for(const auto& pass : frame.passes_) {
+            row(pass.name_.c_str(), pass.counters_);
+        }
+        row("frame", frame.total_);
+        ImGui::EndTable();
+        ImGui::Text("%llu redundant binds", static_cast<unsigned long long>(frame.total_.redundant_binds_));
+    }
+    ImGui::End();
+}
 
 int main(int argc, char* argv[])
 {
     auto console = spdlog::stdout_color_mt("console");
+    // Before any trees are created, they keep the callbacks they were created with.
+    tr::memory::track_ryml();
 
     bool windowed{ false };
     size_t width{ 1440 };
     size_t height{ 960 };
     int verbosity{ 0 };
     std::string resource_path;
+    bool dynamic_res{ false };
+    float target_frame_ms{ 16.0f };
+    float min_render_scale{ 0.5f };
+    float max_render_scale{ 1.0f };
+    std::string capture_dir;
+    bool record{ false };
+    size_t record_frames{ 0 };
+    bool headless{ false };
+    headless_options headless_opts;
+    double tick_rate{ 60.0 };
+    bool sim_threaded{ false };
+    std::string present_mode_name;
+    double fps_limit{ 60.0 };
+    size_t max_queued_frames{ 2 };
+    std::string trace_file;
+    bool gl_stats{ false };
+    bool reactive{ false };
+    bool render_threaded{ false };
+    size_t scene_instances{ 1 };
+    size_t worker_threads{ 0 };
+    size_t texture_budget_mib{ 256 };
+    size_t lod_levels{ 4 };
+    bool meshlets{ false };
 
     argparse::ArgumentParser program(argv[0], "1.0", argparse::default_arguments::none);
     program.add_argument("--help")
@@ -514,6 +1677,61 @@ int main(int argc, char* argv[])
     program.add_argument("-h", "--height").default_value(height).nargs(1).scan<'d', size_t>().store_into(height);
     program.add_argument("--windowed").default_value(windowed).nargs(0).implicit_value(true).store_into(windowed);
     program.add_argument("-r", "--resources", "--resource-path").default_value("resources").nargs(1).store_into(resource_path);
+    program.add_argument("--dynamic-resolution").default_value(dynamic_res).nargs(0).implicit_value(true).store_into(dynamic_res)
+        .help("scale the game view resolution to stay within the GPU frame time budget");
+    program.add_argument("--target-frame-ms").default_value(target_frame_ms).nargs(1).scan<'g', float>().store_into(target_frame_ms)
+        .help("GPU time budget for the scene pass, in milliseconds");
+    program.add_argument("--min-render-scale").default_value(min_render_scale).nargs(1).scan<'g', float>().store_into(min_render_scale);
+    program.add_argument("--max-render-scale").default_value(max_render_scale).nargs(1).scan<'g', float>().store_into(max_render_scale);
+    program.add_argument("--capture-dir").default_value("captures").nargs(1).store_into(capture_dir)
+        .help("directory screenshots (F12) and recorded frames are written to");
+    program.add_argument("--record").default_value(record).nargs(0).implicit_value(true).store_into(record)
+        .help("write every frame of the game view as a PNG sequence from startup");
+    program.add_argument("--record-frames").default_value(record_frames).nargs(1).scan<'d', size_t>().store_into(record_frames)
+        .help("stop recording after this many frames, 0 for no limit");
+    program.add_argument("--headless").default_value(headless).nargs(0).implicit_value(true).store_into(headless)
+        .help("render offscreen without a window or vsync and write frame time statistics on exit");
+    program.add_argument("--frames").default_value(headless_opts.frames_).nargs(1).scan<'d', size_t>().store_into(headless_opts.frames_)
+        .help("frames to render in headless mode");
+    program.add_argument("--seconds").default_value(headless_opts.seconds_).nargs(1).scan<'g', double>().store_into(headless_opts.seconds_)
+        .help("seconds to run for in headless mode");
+    program.add_argument("--warmup-frames").default_value(headless_opts.warmup_frames_).nargs(1).scan<'d', size_t>().store_into(headless_opts.warmup_frames_);
+    program.add_argument("--stats-out").default_value("frame_stats.json").nargs(1).store_into(headless_opts.stats_file_)
+        .help("file the headless frame statistics are written to, - for stdout");
+    program.add_argument("--scene").default_value("").nargs(1).store_into(headless_opts.scene_)
+        .help("scene file to load, a baked .trmesh is drawn straight from its file");
+    program.add_argument("--tick-rate").default_value(tick_rate).nargs(1).scan<'g', double>().store_into(tick_rate)
+        .help("simulation ticks per second");
+    program.add_argument("--sim-thread").default_value(sim_threaded).nargs(0).implicit_value(true).store_into(sim_threaded)
+        .help("run the simulation on its own thread");
+    program.add_argument("--present-mode").default_value("vsync").nargs(1).store_into(present_mode_name)
+        .help("vsync, adaptive, uncapped or limited");
+    program.add_argument("--fps-limit").default_value(fps_limit).nargs(1).scan<'g', double>().store_into(fps_limit)
+        .help("frame rate held by the limited present mode");
+    program.add_argument("--max-queued-frames").default_value(max_queued_frames).nargs(1).scan<'d', size_t>().store_into(max_queued_frames)
+        .help("frames the CPU may run ahead of the GPU, 0 for no limit");
+    program.add_argument("--trace-out").default_value("").nargs(1).store_into(trace_file)
+        .help("write the profiler's recent frames as a Chrome trace on exit");
+    program.add_argument("--gl-stats").default_value(gl_stats).nargs(0).implicit_value(true).store_into(gl_stats)
+        .help("count GL draws, binds and uploads per frame");
+    program.add_argument("--reactive").default_value(reactive).nargs(0).implicit_value(true).store_into(reactive)
+        .help("only redraw the editor on input or when the scene changes, starts with the simulation paused");
+    program.add_argument("--render-thread").default_value(render_threaded).nargs(0).implicit_value(true).store_into(render_threaded)
+        .help("submit GL and present on a separate thread that owns the context, disables ImGui platform windows");
+    program.add_argument("--instances").default_value(scene_instances).nargs(1).scan<'d', size_t>().store_into(scene_instances)
+        .help("copies of the scene to draw, recorded in parallel");
+    program.add_argument("--workers").default_value(worker_threads).nargs(1).scan<'d', size_t>().store_into(worker_threads)
+        .help("worker threads for parallel work, 0 for one less than the hardware threads");
+    program.add_argument("--texture-budget").default_value(texture_budget_mib).nargs(1).scan<'d', size_t>().store_into(texture_budget_mib)
+        .help("GPU memory for streamed textures, in MiB");
+    program.add_argument("--lods").default_value(lod_levels).nargs(1).scan<'d', size_t>().store_into(lod_levels)
+        .help("simplified levels of detail generated for each of the scene's meshes, 0 for none");
+    program.add_argument("--lod-error").default_value(headless_opts.lod_error_px_).nargs(1).scan<'g', float>().store_into(headless_opts.lod_error_px_)
+        .help("screen space error, in pixels, a level of detail may show");
+    program.add_argument("--meshlets").default_value(meshlets).nargs(0).implicit_value(true).store_into(meshlets)
+        .help("split the scene's meshes into meshlets and cull them on the CPU before drawing");
+    program.add_argument("--cpu-skinning").default_value(headless_opts.cpu_skinning_).nargs(0).implicit_value(true).store_into(headless_opts.cpu_skinning_)
+        .help("skin the scene's animated characters on the CPU instead of the GPU");
     // program.add_argument("--font-size").default_value(font_size).store_into(font_size);
 
     try {
@@ -535,7 +1753,35 @@ int main(int argc, char* argv[])
         spdlog::set_level(spdlog::level::err);
     }
 
+    if(min_render_scale <= 0.0f || min_render_scale > max_render_scale || max_render_scale > 2.0f) {
+        spdlog::critical("Render scale bounds must satisfy 0 < min ({}) <= max ({}) <= 2.", min_render_scale, max_render_scale);
+        std::exit(1);
+    }
+    if(target_frame_ms <= 0.0f) {
+        spdlog::critical("Target frame time must be positive, was {}.", target_frame_ms);
+        std::exit(1);
+    }
+
+    if(tick_rate <= 0.0) {
+        spdlog::critical("Simulation tick rate must be positive, was {}.", tick_rate);
+        std::exit(1);
+    }
+
+    const auto mode = tr::present_mode_from_string(present_mode_name);
+    if(!mode) {
+        spdlog::critical("Unknown present mode \"{}\", expected vsync, adaptive, uncapped or limited.", present_mode_name);
+        std::exit(1);
+    }
+
+    if(headless && headless_opts.frames_ == 0 && headless_opts.seconds_ <= 0.0) {
+        headless_opts.frames_ = 600;
+    }
+
+    tr::profiler::set_thread_name("main");
+    headless_opts.trace_file_ = trace_file;
+
     tr::tr_window main_window{ "SDL3 Tutorial: Hello SDL3+OpenGL3", width, height, !windowed };
+    main_window.set_headless(headless);
 
     if(!main_window.init()) {
         std::exit(1);
@@ -546,6 +1792,9 @@ int main(int argc, char* argv[])
     }
 
     dump_gl_extensions(verbosity);
+    // Before the upload, render and flecs threads exist, the wrappers are never swapped after this.
+    tr::gl_stats::install();
+    tr::gl_stats::set_enabled(gl_stats);
 
     // XXX Load resources here
     tr::resource::set_resource_path(resource_path);
@@ -553,7 +1802,20 @@ int main(int argc, char* argv[])
     ryml::Tree game_data = tr::resource::load_structured("game.yml");
     tr::tr_shader_list shaders = tr::load_shaders(game_data.rootref()["shader_programs"]);
 
-    init_imgui(main_window);
+    // Meshes are read and converted off this thread, their vertex objects are built when the renderer polls.
+    tr::scene_importer importer(worker_threads);
+    tr::imported_scene scene_asset;
+    if(headless_opts.scene_.ends_with(".trmesh")) {
+        if(!tr::load_baked_scene(headless_opts.scene_, scene_asset)) {
+            spdlog::critical("Unable to load the baked scene \"{}\"", headless_opts.scene_);
+            std::exit(1);
+        }
+    } else if(!headless_opts.scene_.empty()) {
+        tr::import_options import_opts;
+        import_opts.lod_.levels_ = lod_levels;
+        import_opts.meshlets_ = meshlets;
+        importer.import(headless_opts.scene_, import_opts, [&scene_asset](tr::imported_scene&& s) { scene_asset = std::move(s); });
+    }
 
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
@@ -563,6 +1825,17 @@ int main(int argc, char* argv[])
 
     //test_init();
     tr::framebuffer fbo(width, height);
+    fbo.set_max_scale(max_render_scale);
+
+    tr::gpu_timer scene_timer;
+    tr::dynamic_resolution dyn_res(target_frame_ms, min_render_scale, max_render_scale);
+    fbo.set_scale(dynamic_res ? dyn_res.scale() : 1.0f);
+
+    tr::async_readback readback;
+    tr::frame_capture capture(capture_dir);
+    if(record) {
+        capture.start_recording(record_frames);
+    }
 
     // GLAD_GL_ARB_vertex_attrib_binding = 0;
     // GLAD_GL_ARB_direct_state_access = 0;
@@ -614,18 +1887,124 @@ int main(int argc, char* argv[])
 
     // vto.build(true, tr::data_format::UINT32);
 
+    tr::thread_pool workers(worker_threads);
+    // Resolved here, recording threads can't make GL calls.
+    const int transform_location = shaders.front().uniform_location("uTransform");
+    tr::draw_queue scene_queue;
+
+    if(headless) {
+        // The window is destroyed last, after the GL objects above have released their resources.
+        // Measured runs start with the scene loaded.
+        importer.finish();
+        const auto skinned = std::find_if(shaders.begin(), shaders.end(), [](const tr::tr_shader& s) { return s.name() == "skinned"; });
+        return run_headless(headless_opts, fbo, shaders.front(), skinned != shaders.end() ? &*skinned : nullptr, vto, readback, capture, workers,
+            scene_instances, scene_asset);
+    }
+
+    // The game's entities, simulated, culled and turned into draws by the world's systems.
+    game::game_world world(workers);
+    spawn_quads(world, vto, shaders.front(), transform_location, scene_instances);
+
+    init_imgui(main_window, !render_threaded);
+
+    // The simulation either runs here, between frames, or on its own thread.
+    tr::fixed_timestep timestep(tick_rate);
+    sim_state sim_previous;
+    sim_state sim_current;
+    std::unique_ptr<tr::sim_thread<sim_state>> sim_worker;
+    if(sim_threaded) {
+        sim_worker = std::make_unique<tr::sim_thread<sim_state>>(tick_rate, sim_current, tick_sim);
+    }
+    auto last_frame = std::chrono::steady_clock::now();
+    // A running simulation animates the scene, so it has to be paused for the reactive loop to go idle.
+    bool sim_paused{ reactive };
+    if(sim_worker) {
+        sim_worker->set_paused(sim_paused);
+    }
+
+    tr::redraw_scheduler redraw(reactive);
+    // The scene is re-rendered when it changes, or every frame outside of reactive mode.
+    bool scene_dirty{ true };
+
+    tr::present_mode present = *mode;
+    tr::frame_pacer pacer(present, fps_limit, max_queued_frames);
+    pacer.apply(main_window);
+
+    // The main thread owns the frame buffer's layout, the renderer applies it
+    // each frame. The texture keeps its name when it is resized.
+    tr::framebuffer_layout layout = fbo.layout();
+    const ImTextureID scene_texture = static_cast<ImTextureID>(fbo.texture_id());
+    uint64_t scene_samples_seen = 0;
+
     // The running flag
     bool running{ true };
 
     ImGuiIO& io = ImGui::GetIO();
-    auto font_data = tr::resource::load_binary("fonts/roboto/Roboto-VariableFont_wdth,wght.ttf");
+    auto font_data = tr::resource::load_binary("fonts/roboto/Roboto-VariableFont_wdth,wght.ttf", tr::memory_tag::ui);
     ImFontConfig font_cfg = ImFontConfig();
     font_cfg.FontDataOwnedByAtlas = false;
     io.Fonts->AddFontFromMemoryTTF(font_data.data(), static_cast<int>(font_data.size()), 20.0f, &font_cfg);
 
+    // Created while the context is still current here, before a render thread takes it.
+    tr::upload_thread uploads(main_window);
+    // Baked textures are streamed at the detail they are shown at.
+    tr::texture_streamer streamer(texture_budget_mib << 20);
+    std::vector<tr::texture_streamer::handle> streamed;
+    register_streamed_textures(streamer, streamed);
+    renderer render_state{ main_window, fbo, scene_timer, readback, capture, pacer, uploads, importer, scene_asset, streamer };
+
+    // The preview image is decoded off the main thread, its texture is created by
+    // the thread rendering and filled by the upload thread, and the texture's name
+    // is published once the pixels are there.
+    tr::image_decoder decoder;
+    std::unique_ptr<tr::gl_texture> preview;
+    std::atomic<unsigned> preview_texture{ 0 };
+    std::shared_ptr<tr::image> preview_image;
+    ImVec2 preview_size{ 0.0f, 0.0f };
+    decoder.decode("preview.png", [&](tr::image&& img) {
+        if(!img.empty()) {
+            preview_size = ImVec2(static_cast<float>(img.width_), static_cast<float>(img.height_));
+            preview_image = std::make_shared<tr::image>(std::move(img));
+        }
+    });
+
+    // Small images packed at runtime, everything on a page is drawn with one texture
+    // and its changes are staged through the uploader by the thread rendering.
+    tr::texture_uploader texture_uploads;
+    tr::texture_atlas atlas(1024, 2, 4);
+    std::vector<std::string> atlas_names;
+    bool atlas_dirty = true;
+    fill_test_atlas(atlas, atlas_names);
+    decoder.decode("hello-sdl3.bmp", [&](tr::image&& img) {
+        if(!img.empty() && atlas.insert("hello-sdl3", img)) {
+            atlas_names.emplace_back("hello-sdl3");
+            atlas_dirty = true;
+        }
+    });
+    float streamed_size = 128.0f;
+    render_stats stats;
+    // Written by the render thread after each frame and copied by the main thread before the next.
+    std::mutex shared_stats_mutex;
+    render_stats shared_stats;
+    render_stats render_thread_stats;
+    std::unique_ptr<tr::render_thread<frame_snapshot>> render_worker;
+    if(render_threaded) {
+        // The font texture and shaders have to exist before the context moves,
+        // ImGui_ImplOpenGL3_NewFrame() is then never called on this thread.
+        ImGui_ImplOpenGL3_CreateDeviceObjects();
+        render_worker = std::make_unique<tr::render_thread<frame_snapshot>>(main_window, [&](frame_snapshot& snapshot) {
+            pacer.wait_for_gpu();
+            render_frame(render_state, snapshot, render_thread_stats);
+            std::lock_guard lock(shared_stats_mutex);
+            shared_stats = render_thread_stats;
+        }, 2);
+    }
+
     //The event data
     SDL_Event e;
     SDL_zero(e);
+    // Commands for the thread rendering, kept across iterations that skip drawing until a frame takes them.
+    render_commands commands;
     //The main loop
 #ifdef __EMSCRIPTEN__
     // For an Emscripten build we are disabling file-system access, so let's not attempt to do a fopen() of the imgui.ini file.
@@ -635,10 +2014,41 @@ int main(int argc, char* argv[])
 #else // !__EMSCRIPTEN__
     while(running) {
 #endif // __EMSCRIPTEN__
+        if(!render_worker) {
+            // Wait for the GPU before sampling input, so the input is as fresh as possible.
+            pacer.wait_for_gpu();
+        }
+
+        // Oldest input event handled this frame.
+        uint64_t input_ns = 0;
+
+        decoder.poll();
+        if(preview_image) {
+            commands.emplace_back([&preview, &preview_texture, &uploads, img = std::move(preview_image)]() {
+                tr::texture_desc desc;
+                desc.width_ = img->width_;
+                desc.height_ = img->height_;
+                desc.levels_ = 0;
+                preview = std::make_unique<tr::gl_texture>(desc);
+                const unsigned texture = preview->texture_id();
+                // The callback holds the image until its pixels have been written.
+                uploads.write_texture(texture, img->width_, img->height_, img->pixels_.data(), true, [&preview_texture, texture, img]() {
+                    preview_texture = texture;
+                });
+            });
+        }
         //Get event data
-        while(SDL_PollEvent(&e)) {
-            
+        TR_PROFILE_NAMED_ZONE(events_zone, "events");
+        // With nothing to draw, block until the next event instead of polling.
+        bool has_event = redraw.should_render() ? SDL_PollEvent(&e) : redraw.wait(e);
+        while(has_event) {
+        
             ImGui_ImplSDL3_ProcessEvent(&e);
+            redraw.mark_dirty();
+
+            if(is_input_event(e) && (input_ns == 0 || e.common.timestamp < input_ns)) {
+                input_ns = e.common.timestamp;
+            }
 
             //If event is quit type
             if(e.type == SDL_EVENT_QUIT) {
@@ -657,39 +2067,214 @@ int main(int argc, char* argv[])
                 width = static_cast<size_t>(w);
                 height = static_cast<size_t>(h);
                 resize = true;
+            } else if(e.type == SDL_EVENT_KEY_DOWN && e.key.key == SDLK_F12 && !e.key.repeat) {
+                commands.emplace_back([&capture]() { capture.screenshot(); });
             }
+
+            has_event = SDL_PollEvent(&e);
         }
+        TR_PROFILE_END_ZONE(events_zone);
 
         if(SDL_GetWindowFlags(main_window.window()) & SDL_WINDOW_MINIMIZED) {
-            SDL_Delay(10);
+            // Nothing is visible, sleep until an event such as the restore arrives.
+            redraw.sleep_until_event();
+            continue;
+        }
+
+        if(render_worker) {
+            std::lock_guard lock(shared_stats_mutex);
+            stats = shared_stats;
+        }
+
+        // Work in progress keeps the loop drawing until it completes, without waiting on input.
+        if(!sim_paused || capture.recording() || stats.pending_readbacks_ > 0 || streamer.stats().pending_loads_ > 0 || io.WantTextInput
+            || !commands.empty() || atlas_dirty) {
+            redraw.request_continuous();
+        }
+        if(!redraw.should_render()) {
             continue;
         }
 
+        // Queued only for a frame that is drawn, so a change made while nothing is drawn isn't dropped.
+        atlas.begin_frame();
+        if(atlas_dirty) {
+            commands.emplace_back([&atlas, &texture_uploads]() { atlas.flush(texture_uploads); });
+            atlas_dirty = false;
+        }
+
+        const auto frame_start = std::chrono::steady_clock::now();
+        // Time spent idle isn't simulated or counted as a frame.
+        const double frame_seconds = redraw.was_idle() ? 0.0 : std::chrono::duration<double>(frame_start - last_frame).count();
+        last_frame = frame_start;
+        if(redraw.was_idle()) {
+            commands.emplace_back([&pacer]() { pacer.resume(); });
+        }
+
+        glm::mat4 scene_transform;
+        double sim_alpha = 0.0;
+        uint64_t sim_ticks = 0;
+        if(sim_worker) {
+            const auto snap = sim_worker->read();
+            sim_alpha = snap.alpha_;
+            sim_ticks = snap.tick_;
+            scene_transform = sim_transform(snap.previous_, snap.current_, snap.alpha_);
+        } else {
+            sim_alpha = sim_paused ? timestep.alpha() : timestep.advance(frame_seconds, [&](double dt) {
+                sim_previous = sim_current;
+                tick_sim(sim_current, dt);
+            });
+            sim_ticks = timestep.ticks();
+            scene_transform = sim_transform(sim_previous, sim_current, sim_alpha);
+        }
+
+        // Pick the scale before building the frame so the scene and the presented region agree.
+        if(stats.scene_samples_ != scene_samples_seen) {
+            scene_samples_seen = stats.scene_samples_;
+            if(dynamic_res) {
+                const float scale = dyn_res.update(stats.scene_gpu_ms_);
+                scene_dirty = scene_dirty || scale != layout.scale_;
+                layout.set_scale(scale);
+            }
+        }
+
+        TR_PROFILE_NAMED_ZONE(ui_zone, "ui");
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
+        if(!render_worker) {
+            ImGui_ImplOpenGL3_NewFrame();
+        }
         ImGui_ImplSDL3_NewFrame();
         ImGui::NewFrame();
 
         ShowExampleAppDockSpace(&show_demo_window, resize);
 
         ImGui::Begin("Settings");
-        ImGui::Text("Hello World a");
-        ImGui::Text("Hello World a");
-        ImGui::Text("Hello World a");
-        ImGui::Text("Hello World a");
-        ImGui::Text("Hello World a");
-        ImGui::Text("Hello World a");
-        ImGui::Text("Hello World a");
+        if(ImGui::Checkbox("Dynamic resolution", &dynamic_res)) {
+            dyn_res.reset();
+            layout.set_scale(dynamic_res ? dyn_res.scale() : 1.0f);
+            scene_dirty = true;
+        }
+        if(dynamic_res) {
+            float target = dyn_res.target_ms();
+            if(ImGui::SliderFloat("Target (ms)", &target, 1.0f, 50.0f, "%.1f")) {
+                dyn_res.set_target_ms(target);
+            }
+        }
+        ImGui::Text("Render scale %.2f (%zu x %zu)", layout.scale_, layout.render_width(), layout.render_height());
+        ImGui::Text("Scene GPU %.3f ms (avg %.3f ms)", stats.scene_gpu_ms_, dyn_res.smoothed_ms());
+        ImGui::Separator();
+        ImGui::Text("Simulation %.0f Hz%s", tick_rate, sim_worker ? " (thread)" : "");
+        ImGui::Text("Tick %llu, alpha %.2f", static_cast<unsigned long long>(sim_ticks), sim_alpha);
+        if(!sim_worker) {
+            ImGui::Text("Dropped %.3f s", timestep.dropped_seconds());
+        }
+        if(ImGui::Checkbox("Pause simulation", &sim_paused)) {
+            if(sim_worker) {
+                sim_worker->set_paused(sim_paused);
+            }
+            scene_dirty = true;
+        }
+        if(ImGui::Checkbox("Reactive rendering", &reactive)) {
+            redraw.set_enabled(reactive);
+        }
+        if(reactive) {
+            ImGui::Text("%llu frames drawn, idle %.1f s", static_cast<unsigned long long>(redraw.frames_rendered()), redraw.idle_ms() / 1000.0);
+        }
+        ImGui::Separator();
+        int mode_index = static_cast<int>(present);
+        if(ImGui::Combo("Present", &mode_index, "vsync\0adaptive\0uncapped\0limited\0")) {
+            present = static_cast<tr::present_mode>(mode_index);
+            commands.emplace_back([&pacer, &main_window, present]() {
+                pacer.set_mode(present);
+                pacer.apply(main_window);
+            });
+        }
+        if(present == tr::present_mode::limited) {
+            float fps = static_cast<float>(fps_limit);
+            if(ImGui::SliderFloat("FPS limit", &fps, 10.0f, 360.0f, "%.0f")) {
+                fps_limit = fps;
+                commands.emplace_back([&pacer, fps]() { pacer.set_target_fps(fps); });
+            }
+        }
+        int queued = static_cast<int>(max_queued_frames);
+        if(ImGui::SliderInt("Max queued frames", &queued, 0, 4)) {
+            max_queued_frames = static_cast<size_t>(queued);
+            commands.emplace_back([&pacer, queued]() { pacer.set_max_queued_frames(static_cast<size_t>(queued)); });
+        }
+        ImGui::Text("Frame %.2f ms, jitter %.2f ms", stats.frame_ms_, stats.jitter_ms_);
+        ImGui::Text("Input latency %.1f ms (max %.1f ms)", stats.latency_ms_, stats.latency_max_ms_);
+        ImGui::Text("GPU wait %.2f ms, %zu queued", stats.gpu_wait_ms_, stats.queued_frames_);
+        ImGui::Text("Uploads %zu pending, %.1f MiB total", stats.pending_uploads_, static_cast<double>(stats.bytes_uploaded_) / (1024.0 * 1024.0));
+        if(stats.scene_meshes_ > 0) {
+            const tr::import_timings& t = stats.import_timings_;
+            ImGui::Text("Scene %zu meshes, %zu triangles", stats.scene_meshes_, stats.scene_triangles_);
+            ImGui::Text("Import read %.1f ms, convert %.1f ms, build %.1f ms, %.1f ms in all", t.read_ms_, t.convert_ms_, t.build_ms_, t.total_ms_);
+        }
+        if(render_worker) {
+            ImGui::Text("Render thread %zu / %zu queued, submit wait %.2f ms", render_worker->queued(), render_worker->max_queued(), render_worker->submit_wait_ms());
+        }
         ImGui::End();
 
         ImGui::Begin("Test");
         ImGui::Text("Hello World b");
+        if(const unsigned texture = preview_texture.load(); texture != 0) {
+            const float scale = std::min(1.0f, ImGui::GetContentRegionAvail().x / std::max(preview_size.x, 1.0f));
+            ImGui::Image(static_cast<ImTextureID>(texture), ImVec2(preview_size.x * scale, preview_size.y * scale));
+        }
+        ImGui::End();
+
+        ImGui::Begin("Memory");
+        draw_memory(capture_dir);
+        ImGui::End();
+
+        ImGui::Begin("Atlas");
+        draw_atlas(atlas, atlas_names);
+        ImGui::End();
+
+        ImGui::Begin("Streaming");
+        draw_streaming(streamer, streamed, streamed_size);
+        ImGui::End();
+
+        ImGui::Begin("World");
+        draw_world(world);
         ImGui::End();
 
         ImGui::Begin("Controls");
-        ImGui::Text("Hello World c");
+        if(ImGui::Button("Screenshot")) {
+            commands.emplace_back([&capture]() { capture.screenshot(); });
+        }
+        ImGui::SameLine();
+        if(capture.recording()) {
+            if(ImGui::Button("Stop recording")) {
+                commands.emplace_back([&capture]() { capture.stop_recording(); });
+            }
+        } else if(ImGui::Button("Record")) {
+            commands.emplace_back([&capture]() { capture.start_recording(); });
+        }
+        ImGui::SameLine();
+        ImGui::Text("%s: %zu written, %zu queued, %zu dropped", capture.directory().c_str(), capture.written(), capture.queued(), capture.dropped());
+        draw_profiler(capture_dir);
+        ImGui::End();
+
+        if(tr::gl_stats::available()) {
+            draw_gl_stats_overlay(commands);
+        }
+
+        ImGui::Begin("Game");
+        if(resize) {
+            ImVec2 v = ImGui::GetContentRegionAvail();
+            spdlog::info("Resize content size {} x {}", v.x, v.y);
+            layout.width_ = static_cast<size_t>(v.x);
+            layout.height_ = static_cast<size_t>(v.y);
+            scene_dirty = true;
+        }
+        // // Render the FBO texture to an imgui window.
+        // Only the scaled region is rendered, it is stretched to the panel size here.
+        ImGui::Image(scene_texture, ImVec2(static_cast<float>(layout.width_), static_cast<float>(layout.height_)), ImVec2(0.f, layout.v_max()), ImVec2(layout.u_max(), 0.f));
         ImGui::End();
 
+        ImGui::Render();
+        TR_PROFILE_END_ZONE(ui_zone);
+
         // if(show_demo_window) {
         //     ShowExampleAppDockSpace(&show_demo_window);
         // }
@@ -730,47 +2315,31 @@ int main(int argc, char* argv[])
         //     ImGui::End();
         // }
 
-        shaders.front().apply();
-        // Renders the code to a texture attached to the FBO
-        //test(fbo);
-
-        // Imaginary syntax
-        // with shaders, fbo:
-        //    vto.draw();
-        {
-            tr::scope buffer(fbo);
-            vto.draw();
+        frame_snapshot snapshot;
+        // In reactive mode the scene is only rendered when it changed, the UI shows the last image otherwise.
+        snapshot.render_scene_ = scene_dirty || !reactive || !sim_paused;
+        scene_dirty = false;
+        if(snapshot.render_scene_) {
+            world.progress(scene_transform, frame_seconds);
+            scene_queue.clear();
+            world.gather(scene_queue);
+            record_sorted(snapshot.scene_, scene_queue, workers);
         }
-
-        ImGui::Begin("Game");
-        if(resize) {
-            ImVec2 v = ImGui::GetContentRegionAvail();
-            spdlog::info("Resize content size {} x {}", v.x, v.y);
-            fbo.resize(static_cast<size_t>(v.x), static_cast<size_t>(v.y));
+        snapshot.layout_ = layout;
+        snapshot.clear_color_ = clear_color;
+        snapshot.input_ns_ = input_ns;
+        snapshot.commands_ = std::move(commands);
+        commands.clear();
+        if(render_worker) {
+            snapshot.ui_copy_ = clone_draw_data(ImGui::GetDrawData());
+            snapshot.ui_ = snapshot.ui_copy_.get();
+            render_worker->submit(std::move(snapshot));
+        } else {
+            snapshot.ui_ = ImGui::GetDrawData();
+            snapshot.platform_windows_ = (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) != 0;
+            render_frame(render_state, snapshot, stats);
         }
-        // // Render the FBO texture to an imgui window.
-        ImGui::Image(fbo.texture_id(), ImVec2(fbo.widthf(), fbo.heightf()), ImVec2(0.f, 1.f), ImVec2(1.f, 0.f));
-        ImGui::End();
-
-
-        ImGui::Render();
-        glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-        glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        // Update and Render additional Platform Windows
-        if(io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
-            SDL_Window* backup_current_window = SDL_GL_GetCurrentWindow();
-            SDL_GLContext backup_current_context = SDL_GL_GetCurrentContext();
-            ImGui::UpdatePlatformWindows();
-            ImGui::RenderPlatformWindowsDefault();
-            SDL_GL_MakeCurrent(backup_current_window, backup_current_context);
-        }
-
-        // Update the surface
-        main_window.swap();
+        redraw.frame_rendered();
 
         resize = false;
     } // while(running)
@@ -778,6 +2347,17 @@ int main(int argc, char* argv[])
     EMSCRIPTEN_MAINLOOP_END;
 #endif // __EMSCRIPTEN__
 
+    // Finish the queued frames and take the context back.
+    render_worker.reset();
+
+    // Write out anything still in flight before the capture worker is stopped.
+    readback.flush();
+
+    if(!trace_file.empty()) {
+        tr::profiler::write_chrome_trace(trace_file);
+    }
+    tr::profiler::shutdown();
+
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
@@ -786,9 +2366,8 @@ int main(int argc, char* argv[])
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL3_Shutdown();
     ImGui::DestroyContext();
-    
-    main_window.destroy();
-    main_window.quit();
 
+    // The locals declared after the window own GL objects and are destroyed before it
+    // when main returns, the window's destructor then destroys the context and quits SDL.
     return 0;
 }
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <argparse/argparse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "tr/tr_cull.h"
+#include "tr/tr_frustum.h"
+#include "tr/tr_frame_stats.h"
+#include "tr/tr_thread_pool.h"
+
+// Measures culling spheres scattered through a cube against a camera in its
+// middle, one test of each sphere against frustum::intersects(), the SIMD
+// structure of arrays path on one thread and the same split across the pool,
+// at 10k, 100k and 1M objects unless told otherwise.
+//
+//  cull_bench --iterations 100 --out cull_bench.json
+int main(int argc, char* argv[])
+{
+    std::vector<size_t> counts{ 10000, 100000, 1000000 };
+    std::string out_file;
+    size_t iterations{ 50 };
+    size_t threads{ 0 };
+
+    argparse::ArgumentParser program(argv[0], "1.0");
+    program.add_argument("--objects").nargs(argparse::nargs_pattern::at_least_one).scan<'d', size_t>()
+        .help("object counts to measure, 10000 100000 1000000 if not given");
+    program.add_argument("--iterations").default_value(iterations).nargs(1).scan<'d', size_t>().store_into(iterations);
+    program.add_argument("--threads").default_value(threads).nargs(1).scan<'d', size_t>().store_into(threads)
+        .help("worker threads, 0 for one less than the hardware threads");
+    program.add_argument("--out").default_value("-").nargs(1).store_into(out_file)
+        .help("file the results are written to, - for stdout");
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::exception& err) {
+        spdlog::critical("Parsing command line arguments failed. {}", err.what());
+        std::cout << program;
+        std::exit(1);
+    }
+    if(program.is_used("--objects")) {
+        counts = program.get<std::vector<size_t>>("--objects");
+    }
+    iterations = std::max<size_t>(iterations, 1);
+
+    using clock = std::chrono::steady_clock;
+    tr::thread_pool pool(threads);
+    constexpr float half_size = 500.0f;
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, half_size);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const tr::frustum frustum = tr::frustum::from_matrix(projection * view);
+
+    nlohmann::json runs = nlohmann::json::array();
+    for(const size_t count : counts) {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> position(-half_size, half_size);
+        std::uniform_real_distribution<float> radius(0.5f, 4.0f);
+        tr::sphere_bounds bounds;
+        std::vector<glm::vec4> spheres;
+        bounds.reserve(count);
+        spheres.reserve(count);
+        for(size_t n = 0; n < count; ++n) {
+            const glm::vec4 s(position(rng), position(rng), position(rng), radius(rng));
+            bounds.add(glm::vec3(s.x, s.y, s.z), s.w);
+            spheres.push_back(s);
+        }
+
+        std::vector<uint32_t> reference;
+        std::vector<uint32_t> single;
+        std::vector<uint32_t> parallel;
+        tr::frame_stats scalar_stats(iterations);
+        tr::frame_stats simd_stats(iterations);
+        tr::frame_stats pool_stats(iterations);
+        for(size_t n = 0; n < iterations; ++n) {
+            auto start = clock::now();
+            reference.clear();
+            for(size_t i = 0; i < spheres.size(); ++i) {
+                if(frustum.intersects(glm::vec3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w)) {
+                    reference.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            scalar_stats.add(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+            start = clock::now();
+            tr::cull_spheres(bounds, frustum, single);
+            simd_stats.add(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+            start = clock::now();
+            tr::cull_spheres(pool, bounds, frustum, parallel);
+            pool_stats.add(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+        }
+
+        auto measured = [count](const tr::frame_stats& stats) {
+            const auto s = stats.summarise();
+            nlohmann::json j = tr::to_json(s);
+            j["objects_per_ms"] = s.mean_ms_ > 0.0 ? static_cast<double>(count) / s.mean_ms_ : 0.0;
+            return j;
+        };
+        runs.push_back({
+            { "objects", count },
+            { "visible", reference.size() },
+            { "matches", single == reference && parallel == reference },
+            { "scalar", measured(scalar_stats) },
+            { "simd", measured(simd_stats) },
+            { "simd_threaded", measured(pool_stats) },
+        });
+    }
+
+    nlohmann::json result{
+        { "iterations", iterations },
+        { "threads", pool.concurrency() },
+        { "runs", runs },
+    };
+    if(out_file == "-") {
+        std::cout << result.dump(4) << std::endl;
+    } else {
+        std::ofstream f{ out_file };
+        if(!f.is_open()) {
+            spdlog::critical("Unable to write results to \"{}\"", out_file);
+            return 1;
+        }
+        f << result.dump(4) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <spdlog/spdlog.h>
+#include <argparse/argparse.hpp>
+
+#include "tr/tr_scene_import.h"
+#include "tr/tr_mesh_bake.h"
+#include "tr/tr_thread_pool.h"
+
+// Offline mesh baker, imports a scene with Assimp once and writes the streams
+// tr::load_mesh_file() uploads without any processing at runtime.
+//
+//  mesh_bake level.gltf level.trmesh
+int main(int argc, char* argv[])
+{
+    std::string input;
+    std::string output;
+    bool no_normals{ false };
+    bool no_texcoords{ false };
+    bool colours{ false };
+    bool optimise{ false };
+    size_t lods{ 4 };
+    float lod_error{ 0.05f };
+    size_t threads{ 0 };
+    int verbosity{ 0 };
+
+    argparse::ArgumentParser program(argv[0], "1.0");
+    program.add_argument("input").store_into(input)
+        .help("scene to bake, any format Assimp reads");
+    program.add_argument("output").store_into(output)
+        .help("baked mesh to write");
+    program.add_argument("--no-normals").default_value(no_normals).nargs(0).implicit_value(true).store_into(no_normals);
+    program.add_argument("--no-texcoords").default_value(no_texcoords).nargs(0).implicit_value(true).store_into(no_texcoords);
+    program.add_argument("--colours").default_value(colours).nargs(0).implicit_value(true).store_into(colours)
+        .help("keep the first set of vertex colours");
+    program.add_argument("--optimise").default_value(optimise).nargs(0).implicit_value(true).store_into(optimise)
+        .help("let Assimp merge meshes and optimise the vertex cache order");
+    program.add_argument("--lods").default_value(lods).nargs(1).scan<'d', size_t>().store_into(lods)
+        .help("simplified levels of detail generated for each mesh, 0 for none");
+    program.add_argument("--lod-error").default_value(lod_error).nargs(1).scan<'g', float>().store_into(lod_error)
+        .help("largest simplification error, as a fraction of each mesh's bounding radius");
+    program.add_argument("--threads").default_value(threads).nargs(1).scan<'d', size_t>().store_into(threads)
+        .help("worker threads, 0 for one less than the hardware threads");
+    program.add_argument("-V", "--verbose").action([&](const auto&) { ++verbosity; }).append().default_value(false).implicit_value(true).nargs(0);
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::exception& err) {
+        spdlog::critical("Parsing command line arguments failed. {}", err.what());
+        std::cout << program;
+        std::exit(1);
+    }
+    spdlog::set_level(verbosity > 0 ? spdlog::level::debug : spdlog::level::info);
+
+    tr::import_options opts;
+    opts.normals_ = !no_normals;
+    opts.texcoords_ = !no_texcoords;
+    opts.colours_ = colours;
+    opts.lod_.levels_ = lods;
+    opts.lod_.max_error_ = lod_error;
+    if(optimise) {
+        opts.post_process_ |= aiProcess_OptimizeMeshes | aiProcess_ImproveCacheLocality;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    tr::thread_pool pool(threads);
+    tr::imported_scene scene;
+    if(!tr::import_meshes(input, opts, pool, scene)) {
+        std::exit(1);
+    }
+    tr::baked_mesh baked;
+    if(!tr::bake_meshes(scene.meshes_, baked) || !tr::write_mesh_file(output, baked)) {
+        std::exit(1);
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Baked \"{}\" to \"{}\" in {:.1f} ms, {} submeshes, {} vertices of {} bytes, {} indices, {:.1f} KiB",
+        input, output, ms, baked.submeshes_.size(), baked.vertex_count_, baked.stride_, baked.index_count_,
+        static_cast<double>(baked.vertices_.size() + baked.indices_.size()) / 1024.0);
+    if(baked.index_count_ > baked.full_index_count_) {
+        size_t coarsest = 0;
+        for(const auto& s : baked.submeshes_) {
+            coarsest += s.lods_.back().index_count_;
+        }
+        spdlog::info("Levels of detail take {} indices, the coarsest has {} of the full {} triangles",
+            baked.index_count_ - baked.full_index_count_, coarsest / 3, baked.full_index_count_ / 3);
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <spdlog/spdlog.h>
+#include <argparse/argparse.hpp>
+
+#include "tr/tr_scene_import.h"
+#include "tr/tr_mesh_bake.h"
+#include "tr/tr_mesh_file.h"
+#include "tr/tr_mapped_file.h"
+#include "tr/tr_frame_stats.h"
+#include "tr/tr_thread_pool.h"
+
+// Compares getting a scene's meshes ready for upload through Assimp with
+// mapping the baked file. The Assimp path is the import and conversion the
+// editor runs, the baked path is mapping, validating and reading every byte
+// of the streams, which is all the loader does before handing them to GL.
+// The GL upload itself is the same for both and isn't measured.
+//
+//  mesh_bench level.gltf --iterations 20 --out mesh_bench.json
+int main(int argc, char* argv[])
+{
+    std::string input;
+    std::string baked_path;
+    std::string out_file;
+    size_t iterations{ 10 };
+    size_t threads{ 0 };
+
+    argparse::ArgumentParser program(argv[0], "1.0");
+    program.add_argument("input").store_into(input)
+        .help("scene to import with Assimp");
+    program.add_argument("--baked").default_value("").nargs(1).store_into(baked_path)
+        .help("baked mesh to compare with, baked from the input next to it if not given");
+    program.add_argument("--iterations").default_value(iterations).nargs(1).scan<'d', size_t>().store_into(iterations);
+    program.add_argument("--threads").default_value(threads).nargs(1).scan<'d', size_t>().store_into(threads)
+        .help("worker threads for the Assimp path's conversion, 0 for one less than the hardware threads");
+    program.add_argument("--out").default_value("-").nargs(1).store_into(out_file)
+        .help("file the results are written to, - for stdout");
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::exception& err) {
+        spdlog::critical("Parsing command line arguments failed. {}", err.what());
+        std::cout << program;
+        std::exit(1);
+    }
+    spdlog::set_level(spdlog::level::warn);
+    iterations = std::max<size_t>(iterations, 1);
+
+    using clock = std::chrono::steady_clock;
+    tr::thread_pool pool(threads);
+    tr::import_options opts;
+    tr::frame_stats assimp_stats(iterations);
+    size_t triangles = 0;
+    tr::imported_scene scene;
+    for(size_t n = 0; n < iterations; ++n) {
+        scene = tr::imported_scene{ };
+        const auto start = clock::now();
+        if(!tr::import_meshes(input, opts, pool, scene)) {
+            std::exit(1);
+        }
+        assimp_stats.add(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+        triangles = scene.triangles_;
+    }
+
+    if(baked_path.empty()) {
+        baked_path = input + ".trmesh";
+        tr::baked_mesh baked;
+        if(!tr::bake_meshes(scene.meshes_, baked) || !tr::write_mesh_file(baked_path, baked)) {
+            std::exit(1);
+        }
+    }
+
+    tr::frame_stats baked_stats(iterations);
+    uint64_t checksum = 0;
+    size_t file_bytes = 0;
+    for(size_t n = 0; n < iterations; ++n) {
+        const auto start = clock::now();
+        tr::mapped_file file(baked_path);
+        tr::mesh_file_view view;
+        if(!file.is_open() || !tr::parse_mesh_file(file.bytes(), view, baked_path)) {
+            std::exit(1);
+        }
+        // Reads every page, as the driver's copy would, a word at a time.
+        uint64_t sum = 0;
+        for(const auto stream : { view.vertices_, view.indices_ }) {
+            for(size_t i = 0; i + sizeof(uint64_t) <= stream.size(); i += sizeof(uint64_t)) {
+                uint64_t word;
+                std::memcpy(&word, stream.data() + i, sizeof(word));
+                sum += word;
+            }
+        }
+        checksum ^= sum;
+        baked_stats.add(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+        file_bytes = file.size();
+    }
+
+    const auto assimp = assimp_stats.summarise();
+    const auto mapped = baked_stats.summarise();
+    nlohmann::json result{
+        { "input", input },
+        { "baked", baked_path },
+        { "iterations", iterations },
+        { "triangles", triangles },
+        { "baked_bytes", file_bytes },
+        { "assimp", tr::to_json(assimp) },
+        { "baked_load", tr::to_json(mapped) },
+        { "speedup", mapped.mean_ms_ > 0.0 ? assimp.mean_ms_ / mapped.mean_ms_ : 0.0 },
+        { "checksum", checksum },
+    };
+    if(out_file == "-") {
+        std::cout << result.dump(4) << std::endl;
+    } else {
+        std::ofstream f{ out_file };
+        if(!f.is_open()) {
+            spdlog::critical("Unable to write results to \"{}\"", out_file);
+            return 1;
+        }
+        f << result.dump(4) << std::endl;
+    }
+    return 0;
+}
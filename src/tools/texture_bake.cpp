@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <spdlog/spdlog.h>
+#include <argparse/argparse.hpp>
+
+#include "tr/tr_gl_texture.h"
+#include "tr/tr_image.h"
+#include "tr/tr_texture_bake.h"
+#include "tr/tr_thread_pool.h"
+
+// Offline texture baker, converts an image into the block compressed container
+// tr::load_texture_file() uploads without decoding.
+//
+//  texture_bake albedo.png albedo.trtex --format bc3_srgb
+int main(int argc, char* argv[])
+{
+    std::string input;
+    std::string output;
+    std::string format_name;
+    bool no_mips{ false };
+    size_t threads{ 0 };
+    int verbosity{ 0 };
+
+    argparse::ArgumentParser program(argv[0], "1.0");
+    program.add_argument("input").store_into(input)
+        .help("image to bake, any format SDL_image reads");
+    program.add_argument("output").store_into(output)
+        .help("baked texture to write");
+    program.add_argument("-f", "--format").default_value("bc3_srgb").nargs(1).store_into(format_name)
+        .help("bc1, bc1_srgb, bc3, bc3_srgb, bc4, bc5, r8, rg8, rgba8 or srgb8_alpha8");
+    program.add_argument("--no-mips").default_value(no_mips).nargs(0).implicit_value(true).store_into(no_mips)
+        .help("only bake the top level");
+    program.add_argument("--threads").default_value(threads).nargs(1).scan<'d', size_t>().store_into(threads)
+        .help("worker threads, 0 for one less than the hardware threads");
+    program.add_argument("-V", "--verbose").action([&](const auto&) { ++verbosity; }).append().default_value(false).implicit_value(true).nargs(0);
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::exception& err) {
+        spdlog::critical("Parsing command line arguments failed. {}", err.what());
+        std::cout << program;
+        std::exit(1);
+    }
+    spdlog::set_level(verbosity > 0 ? spdlog::level::debug : spdlog::level::info);
+
+    tr::bake_options opts;
+    opts.mipmaps_ = !no_mips;
+    if(!tr::parse_texture_format(format_name, opts.format_)) {
+        spdlog::critical("Unknown texture format \"{}\".", format_name);
+        std::exit(1);
+    }
+
+    tr::image img;
+    if(!tr::load_image(input, img)) {
+        std::exit(1);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    tr::thread_pool pool(threads);
+    tr::baked_texture baked;
+    if(!tr::bake_texture(img, opts, pool, baked)) {
+        std::exit(1);
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if(!tr::write_texture_file(output, baked)) {
+        std::exit(1);
+    }
+
+    size_t baked_bytes = 0;
+    size_t rgba_bytes = 0;
+    for(size_t n = 0; n < baked.levels_.size(); ++n) {
+        baked_bytes += baked.levels_[n].size();
+        rgba_bytes += tr::level_bytes(tr::texture_format::rgba8, std::max<size_t>(img.width_ >> n, 1), std::max<size_t>(img.height_ >> n, 1));
+    }
+    spdlog::info("Baked \"{}\" {}x{} to {} with {} levels in {:.1f} ms, {} bytes against {} as RGBA8 ({:.1f}:1)",
+        input, img.width_, img.height_, tr::to_string(opts.format_), baked.levels_.size(), ms,
+        baked_bytes, rgba_bytes, static_cast<double>(rgba_bytes) / static_cast<double>(baked_bytes));
+    return 0;
+}
@@ -19,14 +19,17 @@ void set_resource_path(std::string_view base_path)
     resource_path = base_path;
 }
 
-std::vector<uint8_t> load_binary(std::string_view filename)
+std::string resolve(std::string_view filename)
 {
-    fs::path p;
     if(!resource_path.empty()) {
-        p = fs::path(resource_path) / filename;
-    } else {
-        p = fs::path(filename);
+        return (fs::path(resource_path) / filename).string();
     }
+    return std::string(filename);
+}
+
+byte_buffer_t load_binary(std::string_view filename, memory_tag tag)
+{
+    const fs::path p = resolve(filename);
 
     std::error_code ec;
     if(!fs::exists(p, ec)) {
@@ -41,7 +44,7 @@ std::vector<uint8_t> load_binary(std::string_view filename)
         std::exit(1);
     }
 
-    std::vector<uint8_t> vec;
+    byte_buffer_t vec{ tracked_allocator<uint8_t>(tag) };
     std::ifstream f{ p, std::ios::in | std::ios::binary };
     if(!f.is_open() || f.bad()) {
         spdlog::critical("File \"{}\" could not be opened or was bad.", p.string());
@@ -58,12 +61,7 @@ std::vector<uint8_t> load_binary(std::string_view filename)
 
 std::string load(std::string_view filename)
 {
-    fs::path p;
-    if(!resource_path.empty()) {
-        p = fs::path(resource_path) / filename;
-    } else {
-        p = fs::path(filename);
-    }
+    const fs::path p = resolve(filename);
 
     std::error_code ec;
     if(!fs::exists(p, ec)) {
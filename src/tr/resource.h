@@ -5,12 +5,19 @@
 #include <json.hpp>
 #include <ryml.hpp>
 
+#include "tr_memory.h"
+
 namespace tr {
 namespace resource {
 
+typedef tracked_vector<uint8_t> byte_buffer_t;
+
 void set_resource_path(std::string_view base_path);
+/// @brief Path of a resource, for code that opens files itself.
+std::string resolve(std::string_view filename);
 std::string load(std::string_view filename);
-std::vector<uint8_t> load_binary(std::string_view filename);
+/// @brief Loads a file, accounting its memory to \c tag.
+byte_buffer_t load_binary(std::string_view filename, memory_tag tag = memory_tag::resource);
 nlohmann::json load_json(std::string_view filename);
 ryml::Tree load_structured(std::string_view filename);
 
@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#include "tr_animation.h"
+#include "tr_scene_import.h"
+#include "tr_simd.h"
+#include "tr_thread_pool.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    constexpr float quantise_range = 65535.0f;
+    constexpr float rotation_range = 32767.0f;
+    /// @brief The smallest three components of a unit quaternion lie within +-1/sqrt(2).
+    constexpr float rotation_bound = 0.70710678f;
+
+    float wrap_time(float time, float duration)
+    {
+        if(duration <= 0.0f) {
+            return 0.0f;
+        }
+        time = std::fmod(time, duration);
+        return time < 0.0f ? time + duration : time;
+    }
+
+    float quat_dot(const glm::vec4& a, const glm::vec4& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    }
+
+    glm::vec4 quat_normalize(const glm::vec4& q)
+    {
+        const float length = std::sqrt(quat_dot(q, q));
+        return length > 0.0f ? q / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    glm::vec4 quat_slerp(const glm::vec4& a, glm::vec4 b, float t)
+    {
+        float cosine = quat_dot(a, b);
+        if(cosine < 0.0f) {
+            b = -b;
+            cosine = -cosine;
+        }
+        // Close enough that the arc is a line, and the sine below would lose precision.
+        if(cosine > 0.9995f) {
+            return quat_normalize(a + (b - a) * t);
+        }
+        const float angle = std::acos(cosine);
+        const float sine = std::sin(angle);
+        return a * (std::sin((1.0f - t) * angle) / sine) + b * (std::sin(t * angle) / sine);
+    }
+
+    template<typename T, typename F>
+    T sample_track(const std::vector<std::pair<float, T>>& keys, float time, const T& fallback, F interpolate)
+    {
+        if(keys.empty()) {
+            return fallback;
+        }
+        auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const auto& key) { return t < key.first; });
+        if(next == keys.begin()) {
+            return next->second;
+        }
+        if(next == keys.end()) {
+            return keys.back().second;
+        }
+        const auto previous = next - 1;
+        const float span = next->first - previous->first;
+        const float t = span > 0.0f ? (time - previous->first) / span : 0.0f;
+        return interpolate(previous->second, next->second, t);
+    }
+
+    joint_transform sample_keys(const joint_keys& keys, const joint_transform& bind, float time)
+    {
+        joint_transform t;
+        auto lerp = [](const glm::vec3& a, const glm::vec3& b, float f) { return a + (b - a) * f; };
+        t.translation_ = sample_track(keys.translations_, time, bind.translation_, lerp);
+        t.rotation_ = quat_normalize(sample_track(keys.rotations_, time, bind.rotation_, quat_slerp));
+        t.scale_ = sample_track(keys.scales_, time, bind.scale_, lerp);
+        return t;
+    }
+
+    void encode_range(const glm::vec3& value, const glm::vec3& min, const glm::vec3& step, uint16_t* out)
+    {
+        for(int k = 0; k < 3; ++k) {
+            const float q = step[k] > 0.0f ? (value[k] - min[k]) / step[k] : 0.0f;
+            out[k] = static_cast<uint16_t>(std::clamp(q + 0.5f, 0.0f, quantise_range));
+        }
+    }
+
+    glm::vec3 decode_range(const uint16_t* in, const glm::vec3& min, const glm::vec3& step)
+    {
+        return min + glm::vec3(in[0], in[1], in[2]) * step;
+    }
+
+    // The largest component's index goes in the top bits of the first two words.
+    void encode_rotation(glm::vec4 q, uint16_t* out)
+    {
+        q = quat_normalize(q);
+        int largest = 0;
+        for(int k = 1; k < 4; ++k) {
+            if(std::abs(q[k]) > std::abs(q[largest])) {
+                largest = k;
+            }
+        }
+        // q and -q are the same rotation, keeping the largest positive means it needn't be stored.
+        if(q[largest] < 0.0f) {
+            q = -q;
+        }
+        int n = 0;
+        for(int k = 0; k < 4; ++k) {
+            if(k == largest) {
+                continue;
+            }
+            const float unit = (std::clamp(q[k] / rotation_bound, -1.0f, 1.0f) + 1.0f) * 0.5f;
+            out[n++] = static_cast<uint16_t>(unit * rotation_range + 0.5f);
+        }
+        out[0] |= static_cast<uint16_t>((largest & 1) << 15);
+        out[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+    }
+
+    glm::vec4 decode_rotation(const uint16_t* in)
+    {
+        const int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+        float c[3];
+        float sum = 0.0f;
+        for(int k = 0; k < 3; ++k) {
+            c[k] = (static_cast<float>(in[k] & 0x7fff) / rotation_range * 2.0f - 1.0f) * rotation_bound;
+            sum += c[k] * c[k];
+        }
+        glm::vec4 q;
+        int n = 0;
+        for(int k = 0; k < 4; ++k) {
+            q[k] = k == largest ? std::sqrt(std::max(0.0f, 1.0f - sum)) : c[n++];
+        }
+        return q;
+    }
+
+    void decode_frame(const animation_clip& clip, size_t frame, pose& out)
+    {
+        const uint16_t* words = clip.frames_.data() + frame * clip.frame_stride_;
+        for(size_t j = 0; j < clip.tracks_.size(); ++j) {
+            const auto& track = clip.tracks_[j];
+            joint_transform t = track.constant_;
+            const uint16_t* p = words + track.offset_;
+            if(track.flags_ & animation_clip::animated_translation) {
+                t.translation_ = decode_range(p, track.translation_min_, track.translation_step_);
+                p += 3;
+            }
+            if(track.flags_ & animation_clip::animated_rotation) {
+                t.rotation_ = decode_rotation(p);
+                p += 3;
+            }
+            if(track.flags_ & animation_clip::animated_scale) {
+                t.scale_ = decode_range(p, track.scale_min_, track.scale_step_);
+            }
+            out.set(j, t);
+        }
+    }
+
+    simd4f lerp(simd4f a, simd4f b, simd4f t)
+    {
+        return madd(b - a, t, a);
+    }
+
+    // Blends four joints at once. Rotations take the shorter way round by
+    // flipping b where it is in the other hemisphere, then are renormalised,
+    // which is close enough to a slerp over the small steps between frames and
+    // keeps the lanes free of branches.
+    void lerp_group(const soa_transform& a, const soa_transform& b, float weight, soa_transform& out)
+    {
+        const simd4f t = simd4f::splat(weight);
+        lerp(simd4f::load(a.tx_), simd4f::load(b.tx_), t).store(out.tx_);
+        lerp(simd4f::load(a.ty_), simd4f::load(b.ty_), t).store(out.ty_);
+        lerp(simd4f::load(a.tz_), simd4f::load(b.tz_), t).store(out.tz_);
+        lerp(simd4f::load(a.sx_), simd4f::load(b.sx_), t).store(out.sx_);
+        lerp(simd4f::load(a.sy_), simd4f::load(b.sy_), t).store(out.sy_);
+        lerp(simd4f::load(a.sz_), simd4f::load(b.sz_), t).store(out.sz_);
+
+        const simd4f ax = simd4f::load(a.rx_);
+        const simd4f ay = simd4f::load(a.ry_);
+        const simd4f az = simd4f::load(a.rz_);
+        const simd4f aw = simd4f::load(a.rw_);
+        simd4f bx = simd4f::load(b.rx_);
+        simd4f by = simd4f::load(b.ry_);
+        simd4f bz = simd4f::load(b.rz_);
+        simd4f bw = simd4f::load(b.rw_);
+        const simd4f sign = sign_bits(ax * bx + ay * by + az * bz + aw * bw);
+        bx = bx ^ sign;
+        by = by ^ sign;
+        bz = bz ^ sign;
+        bw = bw ^ sign;
+        const simd4f x = lerp(ax, bx, t);
+        const simd4f y = lerp(ay, by, t);
+        const simd4f z = lerp(az, bz, t);
+        const simd4f w = lerp(aw, bw, t);
+        const simd4f length = max(sqrt(x * x + y * y + z * z + w * w), simd4f::splat(1e-12f));
+        (x / length).store(out.rx_);
+        (y / length).store(out.ry_);
+        (z / length).store(out.rz_);
+        (w / length).store(out.rw_);
+    }
+
+    void bind_pose(const skeleton& skel, pose& out)
+    {
+        out.resize(skel.size());
+        for(size_t j = 0; j < skel.size(); ++j) {
+            out.set(j, skel.bind_pose_[j]);
+        }
+    }
+}
+
+int32_t skeleton::find(std::string_view name) const
+{
+    for(size_t j = 0; j < names_.size(); ++j) {
+        if(names_[j] == name) {
+            return static_cast<int32_t>(j);
+        }
+    }
+    return -1;
+}
+
+void pose::resize(size_t joints)
+{
+    joint_count_ = joints;
+    groups_.resize((joints + 3) / 4);
+    // The lanes past the last joint are kept as identities, so they blend without dividing by zero.
+    for(size_t j = joints; j < groups_.size() * 4; ++j) {
+        set(j, joint_transform{ });
+    }
+}
+
+joint_transform pose::get(size_t joint) const
+{
+    const soa_transform& g = groups_[joint / 4];
+    const size_t n = joint % 4;
+    joint_transform t;
+    t.translation_ = glm::vec3(g.tx_[n], g.ty_[n], g.tz_[n]);
+    t.rotation_ = glm::vec4(g.rx_[n], g.ry_[n], g.rz_[n], g.rw_[n]);
+    t.scale_ = glm::vec3(g.sx_[n], g.sy_[n], g.sz_[n]);
+    return t;
+}
+
+void pose::set(size_t joint, const joint_transform& t)
+{
+    soa_transform& g = groups_[joint / 4];
+    const size_t n = joint % 4;
+    g.tx_[n] = t.translation_.x;
+    g.ty_[n] = t.translation_.y;
+    g.tz_[n] = t.translation_.z;
+    g.rx_[n] = t.rotation_.x;
+    g.ry_[n] = t.rotation_.y;
+    g.rz_[n] = t.rotation_.z;
+    g.rw_[n] = t.rotation_.w;
+    g.sx_[n] = t.scale_.x;
+    g.sy_[n] = t.scale_.y;
+    g.sz_[n] = t.scale_.z;
+}
+
+animation_clip compress_clip(const raw_clip& clip, const skeleton& bind, const clip_options& opts)
+{
+    TR_PROFILE_ZONE("compress clip");
+    animation_clip out;
+    out.name_ = clip.name_;
+    out.duration_ = std::max(clip.duration_, 0.0f);
+    const size_t joints = bind.size();
+    // Frames are spread evenly over the clip so the last lands on its end.
+    out.frame_count_ = out.duration_ > 0.0f ? std::max<size_t>(2, static_cast<size_t>(std::ceil(out.duration_ * opts.sample_rate_)) + 1) : 1;
+    out.sample_rate_ = out.frame_count_ > 1 ? static_cast<float>(out.frame_count_ - 1) / out.duration_ : opts.sample_rate_;
+
+    std::vector<joint_transform> samples(out.frame_count_ * joints);
+    for(size_t j = 0; j < joints; ++j) {
+        const joint_keys empty;
+        const joint_keys& keys = j < clip.joints_.size() ? clip.joints_[j] : empty;
+        for(size_t f = 0; f < out.frame_count_; ++f) {
+            const float time = out.frame_count_ > 1 ? out.duration_ * static_cast<float>(f) / static_cast<float>(out.frame_count_ - 1) : 0.0f;
+            samples[f * joints + j] = sample_keys(keys, bind.bind_pose_[j], time);
+        }
+    }
+
+    out.tracks_.resize(joints);
+    out.frame_stride_ = 0;
+    for(size_t j = 0; j < joints; ++j) {
+        auto& track = out.tracks_[j];
+        const joint_transform& first = samples[j];
+        track.constant_ = first;
+        glm::vec3 t_lo = first.translation_, t_hi = first.translation_;
+        glm::vec3 s_lo = first.scale_, s_hi = first.scale_;
+        float rotation_change = 0.0f;
+        for(size_t f = 1; f < out.frame_count_; ++f) {
+            const joint_transform& s = samples[f * joints + j];
+            t_lo = glm::min(t_lo, s.translation_);
+            t_hi = glm::max(t_hi, s.translation_);
+            s_lo = glm::min(s_lo, s.scale_);
+            s_hi = glm::max(s_hi, s.scale_);
+            rotation_change = std::max(rotation_change, 1.0f - std::abs(quat_dot(s.rotation_, first.rotation_)));
+        }
+        const glm::vec3 t_extent = t_hi - t_lo;
+        const glm::vec3 s_extent = s_hi - s_lo;
+        track.offset_ = static_cast<uint32_t>(out.frame_stride_);
+        if(std::max({ t_extent.x, t_extent.y, t_extent.z }) > opts.translation_tolerance_) {
+            track.flags_ |= animation_clip::animated_translation;
+            track.translation_min_ = t_lo;
+            track.translation_step_ = t_extent / quantise_range;
+            out.frame_stride_ += 3;
+        }
+        if(rotation_change > opts.rotation_tolerance_) {
+            track.flags_ |= animation_clip::animated_rotation;
+            out.frame_stride_ += 3;
+        }
+        if(std::max({ s_extent.x, s_extent.y, s_extent.z }) > opts.scale_tolerance_) {
+            track.flags_ |= animation_clip::animated_scale;
+            track.scale_min_ = s_lo;
+            track.scale_step_ = s_extent / quantise_range;
+            out.frame_stride_ += 3;
+        }
+    }
+
+    out.frames_.resize(out.frame_count_ * out.frame_stride_);
+    for(size_t f = 0; f < out.frame_count_; ++f) {
+        uint16_t* words = out.frames_.data() + f * out.frame_stride_;
+        for(size_t j = 0; j < joints; ++j) {
+            const auto& track = out.tracks_[j];
+            const joint_transform& s = samples[f * joints + j];
+            uint16_t* p = words + track.offset_;
+            if(track.flags_ & animation_clip::animated_translation) {
+                encode_range(s.translation_, track.translation_min_, track.translation_step_, p);
+                p += 3;
+            }
+            if(track.flags_ & animation_clip::animated_rotation) {
+                encode_rotation(s.rotation_, p);
+                p += 3;
+            }
+            if(track.flags_ & animation_clip::animated_scale) {
+                encode_range(s.scale_, track.scale_min_, track.scale_step_, p);
+            }
+        }
+    }
+    spdlog::debug("Clip \"{}\", {:.2f} s, {} frames of {} joints in {} bytes, {} as floats", out.name_, out.duration_, out.frame_count_,
+        joints, out.size_bytes(), out.uncompressed_bytes());
+    return out;
+}
+
+void sample_clip(const animation_clip& clip, float time, pose& out)
+{
+    out.resize(clip.joint_count());
+    const float frame = wrap_time(time, clip.duration_) * clip.sample_rate_;
+    const size_t last = clip.frame_count_ > 0 ? clip.frame_count_ - 1 : 0;
+    const size_t f0 = std::min(static_cast<size_t>(frame), last);
+    const size_t f1 = std::min(f0 + 1, last);
+    decode_frame(clip, f0, out);
+    if(f1 == f0) {
+        return;
+    }
+    thread_local pose next;
+    next.resize(clip.joint_count());
+    decode_frame(clip, f1, next);
+    const float weight = std::clamp(frame - static_cast<float>(f0), 0.0f, 1.0f);
+    for(size_t g = 0; g < out.groups_.size(); ++g) {
+        lerp_group(out.groups_[g], next.groups_[g], weight, out.groups_[g]);
+    }
+}
+
+void blend_poses(const pose& a, const pose& b, float weight, pose& out)
+{
+    const size_t joints = std::min(a.joint_count_, b.joint_count_);
+    out.resize(joints);
+    for(size_t g = 0; g < out.groups_.size(); ++g) {
+        lerp_group(a.groups_[g], b.groups_[g], weight, out.groups_[g]);
+    }
+}
+
+void skinning_palette(const skeleton& skel, const pose& p, std::span<glm::mat4> model, std::span<glm::mat4> palette)
+{
+    const size_t joints = std::min({ skel.size(), p.joint_count_, model.size(), palette.size() });
+    for(size_t g = 0; g * 4 < joints; ++g) {
+        compose_matrices(p.groups_[g], joints - g * 4, &model[g * 4]);
+    }
+    // Parents come first, so theirs are already in model space.
+    for(size_t j = 0; j < joints; ++j) {
+        const int32_t parent = skel.parents_[j];
+        if(parent >= 0) {
+            multiply_matrices(model[parent], model[j], model[j]);
+        }
+        multiply_matrices(model[j], skel.inverse_bind_[j], palette[j]);
+    }
+}
+
+void advance_animations(std::span<animation_state> states, float seconds)
+{
+    for(auto& s : states) {
+        if(s.clip_ != nullptr) {
+            s.time_ = wrap_time(s.time_ + seconds * s.speed_, s.clip_->duration_);
+        }
+        if(s.blend_clip_ != nullptr) {
+            s.blend_time_ = wrap_time(s.blend_time_ + seconds * s.speed_, s.blend_clip_->duration_);
+        }
+    }
+}
+
+void evaluate_palettes(thread_pool& pool, const skeleton& skel, std::span<const animation_state> states, std::span<glm::mat4> palettes,
+    size_t stride)
+{
+    TR_PROFILE_ZONE("evaluate palettes");
+    pool.parallel_for(states.size(), [&](size_t begin, size_t end) {
+        thread_local pose current;
+        thread_local pose blended;
+        thread_local std::vector<glm::mat4> model;
+        model.resize(skel.size());
+        for(size_t n = begin; n < end; ++n) {
+            const animation_state& s = states[n];
+            if(s.clip_ != nullptr) {
+                sample_clip(*s.clip_, s.time_, current);
+            } else {
+                bind_pose(skel, current);
+            }
+            if(s.blend_clip_ != nullptr && s.blend_weight_ > 0.0f) {
+                sample_clip(*s.blend_clip_, s.blend_time_, blended);
+                blend_poses(current, blended, s.blend_weight_, current);
+            }
+            skinning_palette(skel, current, model, palettes.subspan(n * stride, skel.size()));
+        }
+    }, 4);
+}
+
+const vertex_format* find_joints(const mesh_data& mesh)
+{
+    for(const auto& f : mesh.formats_) {
+        if(f.attrib_ == mesh_joints) {
+            return &f;
+        }
+    }
+    return nullptr;
+}
+
+void skin_vertices(const mesh_data& mesh, std::span<const glm::mat4> palette, uint8_t* out)
+{
+    const vertex_format* joints = nullptr;
+    const vertex_format* weights = nullptr;
+    const vertex_format* position = nullptr;
+    const vertex_format* normal = nullptr;
+    for(const auto& f : mesh.formats_) {
+        switch(f.attrib_) {
+            case mesh_position: position = &f; break;
+            case mesh_normal: normal = &f; break;
+            case mesh_joints: joints = &f; break;
+            case mesh_weights: weights = &f; break;
+            default: break;
+        }
+    }
+    std::memcpy(out, mesh.vertices_.data(), mesh.vertices_.size());
+    if(joints == nullptr || weights == nullptr || position == nullptr || palette.empty()) {
+        return;
+    }
+    const bool wide = joints->type_ == data_format::UINT16;
+    for(size_t v = 0; v < mesh.vertex_count_; ++v) {
+        const uint8_t* src = mesh.vertices_.data() + v * mesh.stride_;
+        uint8_t* dst = out + v * mesh.stride_;
+        glm::mat4 skin(0.0f);
+        for(size_t k = 0; k < 4; ++k) {
+            uint32_t joint;
+            if(wide) {
+                uint16_t j16;
+                std::memcpy(&j16, src + joints->offset_ + k * sizeof(uint16_t), sizeof(j16));
+                joint = j16;
+            } else {
+                joint = src[joints->offset_ + k];
+            }
+            const float weight = static_cast<float>(src[weights->offset_ + k]) / 255.0f;
+            if(weight > 0.0f) {
+                const glm::mat4& m = palette[std::min<size_t>(joint, palette.size() - 1)];
+                for(int c = 0; c < 4; ++c) {
+                    skin[c] += m[c] * weight;
+                }
+            }
+        }
+        float p[3];
+        std::memcpy(p, src + position->offset_, sizeof(p));
+        const glm::vec4 skinned = skin * glm::vec4(p[0], p[1], p[2], 1.0f);
+        const float skinned_position[3] = { skinned.x, skinned.y, skinned.z };
+        std::memcpy(dst + position->offset_, skinned_position, sizeof(skinned_position));
+        if(normal != nullptr) {
+            float n[3];
+            std::memcpy(n, src + normal->offset_, sizeof(n));
+            // Joints are assumed to scale evenly, so the normals needn't use the inverse transpose.
+            const glm::vec4 direction = skin * glm::vec4(n[0], n[1], n[2], 0.0f);
+            const glm::vec3 unit = glm::normalize(glm::vec3(direction.x, direction.y, direction.z));
+            const float skinned_normal[3] = { unit.x, unit.y, unit.z };
+            std::memcpy(dst + normal->offset_, skinned_normal, sizeof(skinned_normal));
+        }
+    }
+}
+
+}
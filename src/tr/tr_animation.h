@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "tr_memory.h"
+#include "tr_transform.h"
+#include "tr_vertex.h"
+
+namespace tr {
+
+class thread_pool;
+struct mesh_data;
+
+/// @brief Joints a GPU skinned mesh may use, 256 std140 matrices fill the 16 KiB every GL guarantees a uniform block.
+constexpr size_t max_gpu_joints = 256;
+/// @brief Uniform block binding the bone palettes are bound to, skinning shaders name the block "Bones".
+constexpr unsigned skinning_binding = 0;
+
+/// @brief A joint's transform relative to its parent, the rotation a quaternion as (x, y, z, w).
+struct joint_transform
+{
+    glm::vec3 translation_{ 0.0f };
+    glm::vec4 rotation_{ 0.0f, 0.0f, 0.0f, 1.0f };
+    glm::vec3 scale_{ 1.0f };
+};
+
+struct skeleton
+{
+    std::vector<std::string> names_{ };
+    /// @brief Index of each joint's parent, -1 for a root. Parents come before their children.
+    std::vector<int32_t> parents_{ };
+    std::vector<joint_transform> bind_pose_{ };
+    /// @brief From the skinned meshes' space to each joint's.
+    std::vector<glm::mat4> inverse_bind_{ };
+
+    size_t size() const { return parents_.size(); }
+    bool empty() const { return parents_.empty(); }
+    /// @brief Index of a joint by name, -1 if there is none.
+    int32_t find(std::string_view name) const;
+};
+
+/// @brief A joint's keyframes as imported, each track in time order, empty tracks hold the bind pose.
+struct joint_keys
+{
+    std::vector<std::pair<float, glm::vec3>> translations_{ };
+    std::vector<std::pair<float, glm::vec4>> rotations_{ };
+    std::vector<std::pair<float, glm::vec3>> scales_{ };
+};
+
+struct raw_clip
+{
+    std::string name_{ };
+    /// @brief In seconds.
+    float duration_{ 0.0f };
+    /// @brief One for each joint of the skeleton.
+    std::vector<joint_keys> joints_{ };
+};
+
+struct clip_options
+{
+    /// @brief Frames per second the keyframes are resampled at.
+    float sample_rate_{ 30.0f };
+    /// @brief Tracks that move less than this over the clip are stored once, as a constant.
+    float translation_tolerance_{ 1e-4f };
+    float rotation_tolerance_{ 1e-5f };
+    float scale_tolerance_{ 1e-4f };
+};
+
+/// @brief Local transforms of every joint of a skeleton, in groups of four so they are sampled,
+/// blended and converted together.
+struct pose
+{
+    std::vector<soa_transform> groups_{ };
+    size_t joint_count_{ 0 };
+
+    void resize(size_t joints);
+    joint_transform get(size_t joint) const;
+    void set(size_t joint, const joint_transform& t);
+};
+
+// A clip resampled at a fixed rate and quantised. Each frame holds the
+// animated components of every joint next to each other, so sampling reads
+// two short runs of memory. Rotations are stored as their three smallest
+// components in 15 bits each, the largest rebuilt from unit length, and
+// translations and scales as 16 bits across the range each track covers.
+// Tracks that don't move are kept once, at full precision, outside the frames.
+struct animation_clip
+{
+    enum track_flags : uint8_t
+    {
+        animated_translation = 1 << 0,
+        animated_rotation = 1 << 1,
+        animated_scale = 1 << 2,
+    };
+    struct joint_track
+    {
+        uint8_t flags_{ 0 };
+        /// @brief Where the joint's animated components start within a frame, in 16 bit words.
+        uint32_t offset_{ 0 };
+        glm::vec3 translation_min_{ 0.0f };
+        /// @brief Size of one quantisation step, per axis.
+        glm::vec3 translation_step_{ 0.0f };
+        glm::vec3 scale_min_{ 0.0f };
+        glm::vec3 scale_step_{ 0.0f };
+        /// @brief The components not animated.
+        joint_transform constant_{ };
+    };
+
+    std::string name_{ };
+    float duration_{ 0.0f };
+    float sample_rate_{ 30.0f };
+    size_t frame_count_{ 0 };
+    /// @brief 16 bit words in each frame.
+    size_t frame_stride_{ 0 };
+    std::vector<joint_track> tracks_{ };
+    tracked_vector<uint16_t> frames_{ tracked_allocator<uint16_t>(memory_tag::animation) };
+
+    size_t joint_count() const { return tracks_.size(); }
+    size_t size_bytes() const { return frames_.size() * sizeof(uint16_t) + tracks_.size() * sizeof(joint_track); }
+    /// @brief What the frames would take as floats, for comparison.
+    size_t uncompressed_bytes() const { return frame_count_ * tracks_.size() * sizeof(float) * 10; }
+};
+
+/// @brief Resamples and quantises a clip's keyframes, joints with no keys hold \c bind's pose.
+animation_clip compress_clip(const raw_clip& clip, const skeleton& bind, const clip_options& opts = { });
+/// @brief Samples a clip at \c time seconds, which wraps around the clip's duration.
+void sample_clip(const animation_clip& clip, float time, pose& out);
+/// @brief Blends from \c a towards \c b by \c weight, 0 is all \c a.
+void blend_poses(const pose& a, const pose& b, float weight, pose& out);
+/// @brief Joint matrices from the skinned meshes' space into the pose's, what skinning applies.
+/// @param model Scratch for the joints' model space matrices, at least the skeleton's size.
+void skinning_palette(const skeleton& skel, const pose& p, std::span<glm::mat4> model, std::span<glm::mat4> palette);
+
+/// @brief What a character plays, an optional second clip is blended over the first.
+struct animation_state
+{
+    const animation_clip* clip_{ nullptr };
+    float time_{ 0.0f };
+    const animation_clip* blend_clip_{ nullptr };
+    float blend_time_{ 0.0f };
+    /// @brief How much of \c blend_clip_ is seen, 0 for none.
+    float blend_weight_{ 0.0f };
+    float speed_{ 1.0f };
+};
+
+/// @brief Moves every state on by \c seconds, wrapping around the clips.
+void advance_animations(std::span<animation_state> states, float seconds);
+/// @brief Evaluates the palette of every character across the pool, each worker sampling and
+/// blending the characters of its chunk with its own scratch poses.
+/// @param palettes Character n's palette starts at \c palettes[n * stride].
+void evaluate_palettes(thread_pool& pool, const skeleton& skel, std::span<const animation_state> states, std::span<glm::mat4> palettes,
+    size_t stride);
+
+/// @brief The vertex attribute a mesh's joints are in, nullptr if the mesh isn't skinned.
+const vertex_format* find_joints(const mesh_data& mesh);
+/// @brief Skins a mesh's positions and normals on the CPU, for when the GPU can't, copying the other
+/// attributes as they are. \c out has room for the mesh's vertices in its own layout.
+void skin_vertices(const mesh_data& mesh, std::span<const glm::mat4> palette, uint8_t* out);
+
+}
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+#include "tr_atlas.h"
+#include "tr_gl_texture.h"
+#include "tr_image.h"
+#include "tr_texture_uploader.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+skyline_packer::skyline_packer(size_t width, size_t height)
+    : width_(width)
+    , height_(height)
+{
+    clear();
+}
+
+void skyline_packer::clear()
+{
+    skyline_.clear();
+    skyline_.push_back(segment{ 0, 0, width_ });
+}
+
+bool skyline_packer::fit(size_t index, size_t width, size_t height, size_t& y) const
+{
+    const size_t x = skyline_[index].x_;
+    if(x + width > width_) {
+        return false;
+    }
+    // The rectangle rests on the highest segment it spans.
+    y = 0;
+    size_t remaining = width;
+    for(size_t n = index; remaining > 0; ++n) {
+        y = std::max(y, skyline_[n].y_);
+        if(y + height > height_) {
+            return false;
+        }
+        remaining -= std::min(remaining, skyline_[n].width_);
+    }
+    return true;
+}
+
+bool skyline_packer::insert(size_t width, size_t height, size_t& x, size_t& y)
+{
+    size_t best_index = skyline_.size();
+    size_t best_top = std::numeric_limits<size_t>::max();
+    size_t best_width = std::numeric_limits<size_t>::max();
+    for(size_t n = 0; n < skyline_.size(); ++n) {
+        size_t top = 0;
+        if(!fit(n, width, height, top)) {
+            continue;
+        }
+        if(top + height < best_top || (top + height == best_top && skyline_[n].width_ < best_width)) {
+            best_index = n;
+            best_top = top + height;
+            best_width = skyline_[n].width_;
+            y = top;
+        }
+    }
+    if(best_index == skyline_.size()) {
+        return false;
+    }
+    x = skyline_[best_index].x_;
+    place(best_index, x, y, width, height);
+    return true;
+}
+
+void skyline_packer::place(size_t index, size_t x, size_t y, size_t width, size_t height)
+{
+    skyline_.insert(skyline_.begin() + index, segment{ x, y + height, width });
+
+    // Trim or remove the segments the new one now covers.
+    for(size_t n = index + 1; n < skyline_.size();) {
+        segment& s = skyline_[n];
+        const size_t end = x + width;
+        if(s.x_ >= end) {
+            break;
+        }
+        const size_t shrink = end - s.x_;
+        if(shrink >= s.width_) {
+            skyline_.erase(skyline_.begin() + n);
+            continue;
+        }
+        s.x_ += shrink;
+        s.width_ -= shrink;
+        break;
+    }
+
+    // Neighbours at the same height become one segment.
+    for(size_t n = 0; n + 1 < skyline_.size();) {
+        if(skyline_[n].y_ == skyline_[n + 1].y_) {
+            skyline_[n].width_ += skyline_[n + 1].width_;
+            skyline_.erase(skyline_.begin() + n + 1);
+        } else {
+            ++n;
+        }
+    }
+}
+
+texture_atlas::texture_atlas(size_t page_size, size_t padding, size_t max_pages)
+    : page_size_(page_size)
+    , padding_(padding)
+    , max_pages_(max_pages)
+{
+    // Each level halves the padding, so stop before it is under a texel.
+    levels_ = std::clamp<size_t>(static_cast<size_t>(std::bit_width(padding_)), 1, mip_count(page_size_, page_size_));
+}
+
+texture_atlas::~texture_atlas()
+{
+}
+
+bool texture_atlas::insert(std::string_view name, const image& img)
+{
+    return insert(name, img.width_, img.height_, img.pixels_.data());
+}
+
+bool texture_atlas::insert(std::string_view name, size_t width, size_t height, const uint8_t* pixels)
+{
+    TR_PROFILE_ZONE("atlas insert");
+    const size_t padded_width = width + padding_ * 2;
+    const size_t padded_height = height + padding_ * 2;
+    if(padded_width > page_size_ || padded_height > page_size_) {
+        spdlog::error("Image \"{}\" of {}x{} is too large for an atlas page of {}.", name, width, height, page_size_);
+        return false;
+    }
+
+    // Extrude the edge texels into the padding.
+    pending_upload upload;
+    upload.width_ = padded_width;
+    upload.height_ = padded_height;
+    upload.pixels_.resize(padded_width * padded_height * 4);
+    for(size_t y = 0; y < padded_height; ++y) {
+        const size_t sy = std::clamp<size_t>(y, padding_, padding_ + height - 1) - padding_;
+        uint8_t* row = upload.pixels_.data() + y * padded_width * 4;
+        const uint8_t* src = pixels + sy * width * 4;
+        for(size_t x = 0; x < padding_; ++x) {
+            std::memcpy(row + x * 4, src, 4);
+            std::memcpy(row + (padding_ + width + x) * 4, src + (width - 1) * 4, 4);
+        }
+        std::memcpy(row + padding_ * 4, src, width * 4);
+    }
+
+    std::lock_guard lock(mutex_);
+    erase_locked(name);
+    size_t page_index = 0;
+    if(!allocate(padded_width, padded_height, page_index, upload.x_, upload.y_)) {
+        return false;
+    }
+    page& p = pages_[page_index];
+    p.used_texels_ += width * height;
+    p.last_used_ = frame_;
+
+    atlas_entry entry;
+    entry.page_ = page_index;
+    entry.x_ = upload.x_ + padding_;
+    entry.y_ = upload.y_ + padding_;
+    entry.width_ = width;
+    entry.height_ = height;
+    const float size = static_cast<float>(page_size_);
+    entry.u0_ = static_cast<float>(entry.x_) / size;
+    entry.v0_ = static_cast<float>(entry.y_) / size;
+    entry.u1_ = static_cast<float>(entry.x_ + width) / size;
+    entry.v1_ = static_cast<float>(entry.y_ + height) / size;
+    entries_.insert_or_assign(std::string(name), entry);
+
+    upload.page_ = page_index;
+    pending_.emplace_back(std::move(upload));
+    return true;
+}
+
+bool texture_atlas::allocate(size_t width, size_t height, size_t& page_index, size_t& x, size_t& y)
+{
+    for(size_t n = 0; n < pages_.size(); ++n) {
+        if(pages_[n].packer_.insert(width, height, x, y)) {
+            page_index = n;
+            return true;
+        }
+    }
+    if(max_pages_ == 0 || pages_.size() < max_pages_) {
+        pages_.emplace_back(page_size_);
+        page_index = pages_.size() - 1;
+        return pages_.back().packer_.insert(width, height, x, y);
+    }
+
+    auto lru = std::min_element(pages_.begin(), pages_.end(), [](const page& a, const page& b) { return a.last_used_ < b.last_used_; });
+    page_index = static_cast<size_t>(lru - pages_.begin());
+    evict_locked(page_index);
+    return pages_[page_index].packer_.insert(width, height, x, y);
+}
+
+bool texture_atlas::find(std::string_view name, atlas_entry& entry)
+{
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(std::string(name));
+    if(it == entries_.end()) {
+        return false;
+    }
+    entry = it->second;
+    pages_[entry.page_].last_used_ = frame_;
+    return true;
+}
+
+void texture_atlas::erase(std::string_view name)
+{
+    std::lock_guard lock(mutex_);
+    erase_locked(name);
+}
+
+void texture_atlas::erase_locked(std::string_view name)
+{
+    // The space isn't reclaimed until the page is evicted, a skyline can't free rectangles.
+    auto it = entries_.find(std::string(name));
+    if(it != entries_.end()) {
+        pages_[it->second.page_].used_texels_ -= it->second.width_ * it->second.height_;
+        entries_.erase(it);
+    }
+}
+
+void texture_atlas::evict_page(size_t page_index)
+{
+    std::lock_guard lock(mutex_);
+    evict_locked(page_index);
+}
+
+void texture_atlas::evict_locked(size_t page_index)
+{
+    if(page_index >= pages_.size()) {
+        return;
+    }
+    std::erase_if(entries_, [page_index](const auto& e) { return e.second.page_ == page_index; });
+    std::erase_if(pending_, [page_index](const pending_upload& u) { return u.page_ == page_index; });
+    page& p = pages_[page_index];
+    p.packer_.clear();
+    p.used_texels_ = 0;
+    ++evictions_;
+    spdlog::debug("Evicted atlas page {}", page_index);
+}
+
+void texture_atlas::begin_frame()
+{
+    std::lock_guard lock(mutex_);
+    ++frame_;
+}
+
+void texture_atlas::flush(texture_uploader& uploader)
+{
+    std::lock_guard lock(mutex_);
+    if(pending_.empty()) {
+        return;
+    }
+    TR_PROFILE_ZONE("atlas flush");
+    for(auto& u : pending_) {
+        page& p = pages_[u.page_];
+        if(!p.texture_) {
+            texture_desc desc;
+            desc.width_ = page_size_;
+            desc.height_ = page_size_;
+            desc.levels_ = levels_;
+            p.texture_ = std::make_unique<gl_texture>(desc);
+        }
+        uploader.upload(*p.texture_, 0, 0, u.x_, u.y_, u.width_, u.height_, u.pixels_.data());
+        p.dirty_ = true;
+    }
+    pending_.clear();
+
+    for(auto& p : pages_) {
+        if(p.dirty_) {
+            p.texture_->generate_mipmaps();
+            p.dirty_ = false;
+        }
+    }
+}
+
+unsigned texture_atlas::page_texture(size_t page_index) const
+{
+    std::lock_guard lock(mutex_);
+    if(page_index >= pages_.size() || !pages_[page_index].texture_) {
+        return 0;
+    }
+    return pages_[page_index].texture_->texture_id();
+}
+
+atlas_stats texture_atlas::stats() const
+{
+    std::lock_guard lock(mutex_);
+    atlas_stats s;
+    s.pages_ = pages_.size();
+    s.entries_ = entries_.size();
+    s.evictions_ = evictions_;
+    size_t used = 0;
+    for(const auto& p : pages_) {
+        used += p.used_texels_;
+    }
+    if(!pages_.empty()) {
+        s.efficiency_ = static_cast<double>(used) / static_cast<double>(pages_.size() * page_size_ * page_size_);
+    }
+    return s;
+}
+
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+class gl_texture;
+class texture_uploader;
+struct image;
+
+// Bottom-left skyline packer for one page.
+// The skyline is the top edge of everything placed so far, a rectangle goes
+// where it leaves the skyline lowest, ties going to the narrowest segment so
+// wide gaps are kept for wide rectangles.
+class skyline_packer
+{
+public:
+    skyline_packer(size_t width, size_t height);
+    /// @return false if the rectangle doesn't fit.
+    bool insert(size_t width, size_t height, size_t& x, size_t& y);
+    void clear();
+    size_t width() const { return width_; }
+    size_t height() const { return height_; }
+private:
+    struct segment
+    {
+        size_t x_;
+        size_t y_;
+        size_t width_;
+    };
+    /// @brief Where a rectangle placed on segment \c index would sit, false if it doesn't fit there.
+    bool fit(size_t index, size_t width, size_t height, size_t& y) const;
+    void place(size_t index, size_t x, size_t y, size_t width, size_t height);
+
+    size_t width_{ 0 };
+    size_t height_{ 0 };
+    std::vector<segment> skyline_{ };
+};
+
+/// @brief Where an image is in the atlas, the UVs have (0, 0) at the top left of the page.
+struct atlas_entry
+{
+    size_t page_{ 0 };
+    size_t x_{ 0 };
+    size_t y_{ 0 };
+    size_t width_{ 0 };
+    size_t height_{ 0 };
+    float u0_{ 0.0f };
+    float v0_{ 0.0f };
+    float u1_{ 0.0f };
+    float v1_{ 0.0f };
+};
+
+struct atlas_stats
+{
+    size_t pages_{ 0 };
+    size_t entries_{ 0 };
+    /// @brief Texels of the images over the texels of every page, padding counts as waste.
+    double efficiency_{ 0.0 };
+    size_t evictions_{ 0 };
+};
+
+// Packs images into RGBA8 atlas pages at runtime, so everything on one page
+// can be drawn with a single texture bound. Each image is surrounded by
+// padding filled with its edge texels, so filtering and the first few mip
+// levels don't bleed in from its neighbours. Insertion is incremental, a page
+// is added when an image doesn't fit the existing ones, and once the page
+// limit is reached the page used least recently is evicted with everything
+// on it.
+//
+// Packing and lookups may happen on any thread, the GL work is deferred until
+// flush() is called by the thread owning the context.
+class texture_atlas
+{
+public:
+    /// @param padding Texels around each image, the number of mip levels follows from it.
+    /// @param max_pages Pages before the least recently used one is evicted, 0 for no limit.
+    explicit texture_atlas(size_t page_size = 2048, size_t padding = 2, size_t max_pages = 0);
+    ~texture_atlas();
+
+    /// @brief Packs RGBA8 pixels, rows top first, replacing any image with the same name.
+    /// @return false if the image is larger than a page.
+    bool insert(std::string_view name, size_t width, size_t height, const uint8_t* pixels);
+    bool insert(std::string_view name, const image& img);
+    /// @brief Looks an image up, marking its page used this frame.
+    /// @return false if it isn't in the atlas, or was evicted.
+    bool find(std::string_view name, atlas_entry& entry);
+    void erase(std::string_view name);
+    /// @brief Drops a page and every image on it.
+    void evict_page(size_t page);
+    /// @brief Advances the frame counter that decides which page is least recently used.
+    void begin_frame();
+
+    /// @brief Creates page textures and uploads the images packed since the last flush.
+    void flush(texture_uploader& uploader);
+    /// @brief Texture name of a page, 0 until it has been flushed.
+    unsigned page_texture(size_t page) const;
+    size_t page_size() const { return page_size_; }
+    atlas_stats stats() const;
+private:
+    struct page
+    {
+        explicit page(size_t size) : packer_(size, size) {}
+        skyline_packer packer_;
+        std::unique_ptr<gl_texture> texture_{ };
+        uint64_t last_used_{ 0 };
+        /// @brief Texels of the images on the page, without padding.
+        size_t used_texels_{ 0 };
+        bool dirty_{ false };
+    };
+    /// @brief Texels waiting for flush(), padding included.
+    struct pending_upload
+    {
+        size_t page_{ 0 };
+        size_t x_{ 0 };
+        size_t y_{ 0 };
+        size_t width_{ 0 };
+        size_t height_{ 0 };
+        tracked_vector<uint8_t> pixels_{ tracked_allocator<uint8_t>(memory_tag::texture) };
+    };
+    /// @brief Finds room on a page, evicting or adding one as needed.
+    bool allocate(size_t width, size_t height, size_t& page_index, size_t& x, size_t& y);
+    void erase_locked(std::string_view name);
+    void evict_locked(size_t page);
+
+    size_t page_size_{ 2048 };
+    size_t padding_{ 2 };
+    size_t max_pages_{ 0 };
+    size_t levels_{ 1 };
+    uint64_t frame_{ 1 };
+    size_t evictions_{ 0 };
+
+    mutable std::mutex mutex_;
+    std::vector<page> pages_{ };
+    std::unordered_map<std::string, atlas_entry> entries_{ };
+    std::vector<pending_upload> pending_{ };
+
+    texture_atlas(const texture_atlas&) = delete;
+    texture_atlas(texture_atlas&&) = delete;
+    texture_atlas& operator=(const texture_atlas&) = delete;
+    texture_atlas& operator=(texture_atlas&&) = delete;
+};
+
+}
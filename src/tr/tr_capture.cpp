@@ -0,0 +1,152 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <SDL3/SDL.h>
+#include <SDL3_image/SDL_image.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/chrono.h>
+
+#include "tr_capture.h"
+#include "tr_readback.h"
+#include "tr_framebuffer.h"
+
+namespace tr {
+
+namespace fs = std::filesystem;
+
+frame_capture::frame_capture(std::string_view directory, size_t max_queued)
+    : directory_(directory)
+    , max_queued_(max_queued)
+{
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if(ec) {
+        spdlog::error("Unable to create capture directory \"{}\": {}", directory_, ec.message());
+    }
+    thread_ = std::thread(&frame_capture::worker, this);
+}
+
+frame_capture::~frame_capture()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void frame_capture::screenshot()
+{
+    screenshot_pending_ = true;
+}
+
+void frame_capture::start_recording(size_t frame_limit)
+{
+    recording_ = true;
+    frame_limit_ = frame_limit;
+    frames_requested_ = 0;
+    spdlog::info("Recording frames to \"{}\"", directory_);
+}
+
+void frame_capture::stop_recording()
+{
+    if(recording_) {
+        spdlog::info("Stopped recording after {} frames", frames_requested_);
+    }
+    recording_ = false;
+}
+
+size_t frame_capture::queued() const
+{
+    std::lock_guard lock(mutex_);
+    return jobs_.size();
+}
+
+void frame_capture::update(async_readback& readback, const framebuffer& fbo)
+{
+    if(screenshot_pending_) {
+        const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+        std::string path = (fs::path(directory_) / fmt::format("screenshot_{:%Y%m%d_%H%M%S}.png", now)).string();
+        const bool queued = readback.request(fbo, [this, path = std::move(path)](const readback_image& img) {
+            enqueue(path, img.width_, img.height_, img.pitch_, img.pixels_);
+        });
+        // A screenshot isn't dropped, it is retried on the next frame instead.
+        screenshot_pending_ = !queued;
+    }
+
+    if(recording_) {
+        std::string path = (fs::path(directory_) / fmt::format("frame_{:06}.png", sequence_++)).string();
+        const bool queued = readback.request(fbo, [this, path = std::move(path)](const readback_image& img) {
+            enqueue(path, img.width_, img.height_, img.pitch_, img.pixels_);
+        });
+        if(!queued) {
+            ++dropped_;
+        }
+        ++frames_requested_;
+        if(frame_limit_ != 0 && frames_requested_ >= frame_limit_) {
+            stop_recording();
+        }
+    }
+}
+
+void frame_capture::enqueue(std::string path, size_t width, size_t height, size_t pitch, const uint8_t* pixels)
+{
+    job j;
+    j.path_ = std::move(path);
+    j.width_ = width;
+    j.height_ = height;
+    j.pixels_.resize(width * height * 4);
+    // Rows are copied as they are, the flip is left to the worker.
+    const size_t row = width * 4;
+    if(pitch == row) {
+        std::memcpy(j.pixels_.data(), pixels, row * height);
+    } else {
+        for(size_t y = 0; y < height; ++y) {
+            std::memcpy(j.pixels_.data() + y * row, pixels + y * pitch, row);
+        }
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        if(jobs_.size() >= max_queued_) {
+            ++dropped_;
+            return;
+        }
+        jobs_.emplace_back(std::move(j));
+    }
+    cv_.notify_one();
+}
+
+void frame_capture::worker()
+{
+    for(;;) {
+        job j;
+        {
+            std::unique_lock lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if(jobs_.empty()) {
+                // Only reached when stopping, everything queued has been written.
+                return;
+            }
+            j = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        SDL_Surface* surface = SDL_CreateSurfaceFrom(static_cast<int>(j.width_), static_cast<int>(j.height_), SDL_PIXELFORMAT_RGBA32, j.pixels_.data(), static_cast<int>(j.width_ * 4));
+        if(surface == nullptr) {
+            spdlog::error("Unable to create surface for \"{}\": {}", j.path_, SDL_GetError());
+            continue;
+        }
+        // OpenGL returns the bottom row first.
+        SDL_FlipSurface(surface, SDL_FLIP_VERTICAL);
+        if(IMG_SavePNG(surface, j.path_.c_str())) {
+            ++written_;
+        } else {
+            spdlog::error("Unable to write \"{}\": {}", j.path_, SDL_GetError());
+        }
+        SDL_DestroySurface(surface);
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+class async_readback;
+class framebuffer;
+
+// Screenshots and frame dumps built on top of \c async_readback.
+// Pixels are copied out of the mapped buffer in the readback callback and
+// handed to a worker thread that encodes them as PNG files, so neither the
+// read back nor the encoding costs any time on the render thread. Apart from
+// the statistics it must be used from the thread that calls update().
+class frame_capture
+{
+public:
+    /// @param directory Where files are written, created if it doesn't exist.
+    /// @param max_queued Frames allowed to wait for encoding before new ones are dropped.
+    explicit frame_capture(std::string_view directory, size_t max_queued = 64);
+    /// @brief Waits for the queued frames to be written.
+    ~frame_capture();
+    /// @brief Captures the next frame passed to \c update() as a screenshot.
+    void screenshot();
+    /// @brief Starts writing every frame as a numbered PNG sequence.
+    /// @param frame_limit Stop after this many frames, 0 for no limit.
+    void start_recording(size_t frame_limit = 0);
+    void stop_recording();
+    bool recording() const { return recording_; }
+    /// @brief Requests read backs for the frame that has just been rendered.
+    void update(async_readback& readback, const framebuffer& fbo);
+    /// @brief Frames waiting to be encoded.
+    size_t queued() const;
+    /// @brief Files written so far.
+    size_t written() const { return written_; }
+    /// @brief Frames lost because the readback ring or the encode queue were full.
+    size_t dropped() const { return dropped_; }
+    const std::string& directory() const { return directory_; }
+private:
+    struct job
+    {
+        std::string path_;
+        size_t width_{ 0 };
+        size_t height_{ 0 };
+        tracked_vector<uint8_t> pixels_{ tracked_allocator<uint8_t>(memory_tag::capture) };
+    };
+    void enqueue(std::string path, size_t width, size_t height, size_t pitch, const uint8_t* pixels);
+    void worker();
+    std::string directory_;
+    size_t max_queued_{ 0 };
+    bool screenshot_pending_{ false };
+    std::atomic<bool> recording_{ false };
+    size_t frame_limit_{ 0 };
+    size_t frames_requested_{ 0 };
+    /// @brief Number of the next frame in the recorded sequence.
+    size_t sequence_{ 0 };
+    std::atomic<size_t> written_{ 0 };
+    std::atomic<size_t> dropped_{ 0 };
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<job> jobs_{ };
+    bool stop_{ false };
+    std::thread thread_;
+
+    frame_capture(const frame_capture&) = delete;
+    frame_capture(frame_capture&&) = delete;
+    frame_capture& operator=(const frame_capture&) = delete;
+    frame_capture& operator=(frame_capture&&) = delete;
+};
+
+}
@@ -0,0 +1,333 @@
+#include <cstring>
+#include <type_traits>
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+
+#include "tr_command_buffer.h"
+#include "tr_framebuffer.h"
+#include "tr_shader.h"
+#include "tr_gl_texture.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Records start on this boundary, so payloads can be read in place.
+    constexpr size_t record_alignment = 8;
+
+    struct command_header
+    {
+        command_type type_;
+        uint8_t flags_;
+        /// @brief Bytes of the record, header and padding included.
+        uint16_t size_;
+    };
+
+    struct framebuffer_cmd
+    {
+        framebuffer* fbo_;
+    };
+
+    struct viewport_cmd
+    {
+        int32_t x_;
+        int32_t y_;
+        int32_t width_;
+        int32_t height_;
+    };
+
+    struct clear_cmd
+    {
+        float colour_[4];
+        uint32_t mask_;
+    };
+
+    struct shader_cmd
+    {
+        const tr_shader* shader_;
+    };
+
+    struct uniform_cmd
+    {
+        const tr_shader* shader_;
+        int32_t location_;
+        uint8_t type_;
+    };
+
+    struct texture_cmd
+    {
+        uint32_t unit_;
+        uint32_t texture_;
+        uint32_t target_;
+    };
+
+    struct uniform_range_cmd
+    {
+        uint32_t binding_;
+        uint32_t buffer_;
+        uint64_t offset_;
+        uint64_t length_;
+    };
+
+    struct update_cmd
+    {
+        vertex_object* vo_;
+        uint64_t index_;
+        /// @brief Where the data starts in the buffer's data blob.
+        uint64_t offset_;
+        uint64_t length_;
+        uint8_t type_;
+    };
+
+    struct draw_cmd
+    {
+        const vertex_object* vo_;
+        uint64_t instance_count_;
+        uint64_t first_index_;
+        uint64_t index_count_;
+    };
+
+    struct draw_ranges_cmd
+    {
+        const vertex_object* vo_;
+        /// @brief Where the ranges start in the buffer's data blob.
+        uint64_t offset_;
+        uint64_t count_;
+    };
+
+    constexpr size_t align_up(size_t n)
+    {
+        return (n + record_alignment - 1) & ~(record_alignment - 1);
+    }
+
+    template<typename T>
+    T read(const uint8_t* p)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Commands must be POD");
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+}
+
+command_buffer::command_buffer()
+    : commands_(tracked_allocator<uint8_t>(memory_tag::commands))
+    , data_(tracked_allocator<uint8_t>(memory_tag::commands))
+{
+}
+
+void command_buffer::reset()
+{
+    commands_.clear();
+    data_.clear();
+    count_ = 0;
+}
+
+template<typename T>
+void command_buffer::push(command_type type, const T& payload, const void* extra, size_t extra_length)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Commands must be POD");
+    const size_t payload_offset = align_up(sizeof(command_header));
+    const size_t size = align_up(payload_offset + sizeof(T) + extra_length);
+
+    const size_t start = commands_.size();
+    commands_.resize(start + size);
+    uint8_t* p = commands_.data() + start;
+    const command_header header{ type, 0, static_cast<uint16_t>(size) };
+    std::memcpy(p, &header, sizeof(header));
+    std::memcpy(p + payload_offset, &payload, sizeof(T));
+    if(extra_length != 0) {
+        std::memcpy(p + payload_offset + sizeof(T), extra, extra_length);
+    }
+    ++count_;
+}
+
+void command_buffer::bind_framebuffer(framebuffer* fbo)
+{
+    push(command_type::bind_framebuffer, framebuffer_cmd{ fbo });
+}
+
+void command_buffer::set_viewport(int x, int y, int width, int height)
+{
+    push(command_type::set_viewport, viewport_cmd{ x, y, width, height });
+}
+
+void command_buffer::clear(const glm::vec4& colour, bool depth, bool stencil)
+{
+    clear_cmd c{ { colour.x, colour.y, colour.z, colour.w }, GL_COLOR_BUFFER_BIT };
+    if(depth) {
+        c.mask_ |= GL_DEPTH_BUFFER_BIT;
+    }
+    if(stencil) {
+        c.mask_ |= GL_STENCIL_BUFFER_BIT;
+    }
+    push(command_type::clear, c);
+}
+
+void command_buffer::use_shader(const tr_shader& shader)
+{
+    push(command_type::use_shader, shader_cmd{ &shader });
+}
+
+void command_buffer::push_uniform(const tr_shader& shader, int location, uniform_type type, const void* value, size_t length)
+{
+    push(command_type::set_uniform, uniform_cmd{ &shader, location, static_cast<uint8_t>(type) }, value, length);
+}
+
+void command_buffer::set_uniform(const tr_shader& shader, int location, int value)
+{
+    push_uniform(shader, location, uniform_type::int1, &value, sizeof(value));
+}
+
+void command_buffer::set_uniform(const tr_shader& shader, int location, float value)
+{
+    push_uniform(shader, location, uniform_type::float1, &value, sizeof(value));
+}
+
+void command_buffer::set_uniform(const tr_shader& shader, int location, const glm::vec2& value)
+{
+    push_uniform(shader, location, uniform_type::vec2, &value, sizeof(value));
+}
+
+void command_buffer::set_uniform(const tr_shader& shader, int location, const glm::vec4& value)
+{
+    push_uniform(shader, location, uniform_type::vec4, &value, sizeof(value));
+}
+
+void command_buffer::set_uniform(const tr_shader& shader, int location, const glm::mat4& value)
+{
+    push_uniform(shader, location, uniform_type::mat4, &value, sizeof(value));
+}
+
+void command_buffer::bind_texture(uint32_t unit, unsigned texture)
+{
+    push(command_type::bind_texture, texture_cmd{ unit, texture, GL_TEXTURE_2D });
+}
+
+void command_buffer::bind_texture(uint32_t unit, const gl_texture& texture)
+{
+    push(command_type::bind_texture, texture_cmd{ unit, texture.texture_id(), texture.target() });
+}
+
+void command_buffer::bind_uniform_range(uint32_t binding, unsigned buffer, size_t offset, size_t length)
+{
+    push(command_type::bind_uniform_range, uniform_range_cmd{ binding, buffer, offset, length });
+}
+
+void command_buffer::update(vertex_object& vo, vertex_object::update_type type, size_t index, const void* data, size_t length)
+{
+    const size_t offset = data_.size();
+    data_.resize(offset + length);
+    std::memcpy(data_.data() + offset, data, length);
+    push(command_type::update_buffer, update_cmd{ &vo, index, offset, length, static_cast<uint8_t>(type) });
+}
+
+void command_buffer::draw(const vertex_object& vo, size_t instance_count)
+{
+    push(command_type::draw, draw_cmd{ &vo, instance_count, 0, vertex_object::all_indices });
+}
+
+void command_buffer::draw_range(const vertex_object& vo, size_t first, size_t count, size_t instance_count)
+{
+    push(command_type::draw, draw_cmd{ &vo, instance_count, first, count });
+}
+
+void command_buffer::draw_ranges(const vertex_object& vo, std::span<const index_range> ranges)
+{
+    static_assert(std::is_trivially_copyable_v<index_range>, "Ranges are copied as bytes");
+    // Ranges are read in place, so they start on their own alignment in the blob.
+    const size_t offset = (data_.size() + alignof(index_range) - 1) & ~(alignof(index_range) - 1);
+    data_.resize(offset + ranges.size_bytes());
+    std::memcpy(data_.data() + offset, ranges.data(), ranges.size_bytes());
+    push(command_type::draw_ranges, draw_ranges_cmd{ &vo, offset, ranges.size() });
+}
+
+void command_buffer::execute() const
+{
+    TR_PROFILE_ZONE("command_buffer::execute");
+    const size_t payload_offset = align_up(sizeof(command_header));
+    const uint8_t* p = commands_.data();
+    const uint8_t* end = p + commands_.size();
+    while(p < end) {
+        const auto header = read<command_header>(p);
+        const uint8_t* payload = p + payload_offset;
+        switch(header.type_)
+        {
+            case command_type::bind_framebuffer: {
+                const auto c = read<framebuffer_cmd>(payload);
+                if(c.fbo_ != nullptr) {
+                    c.fbo_->apply();
+                } else {
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                }
+                break;
+            }
+            case command_type::set_viewport: {
+                const auto c = read<viewport_cmd>(payload);
+                glViewport(c.x_, c.y_, c.width_, c.height_);
+                break;
+            }
+            case command_type::clear: {
+                const auto c = read<clear_cmd>(payload);
+                glClearColor(c.colour_[0], c.colour_[1], c.colour_[2], c.colour_[3]);
+                glClear(c.mask_);
+                break;
+            }
+            case command_type::use_shader:
+                read<shader_cmd>(payload).shader_->apply();
+                break;
+            case command_type::set_uniform: {
+                const auto c = read<uniform_cmd>(payload);
+                const uint8_t* value = payload + sizeof(uniform_cmd);
+                switch(static_cast<uniform_type>(c.type_))
+                {
+                    case uniform_type::int1:    c.shader_->set_uniform(c.location_, read<int>(value)); break;
+                    case uniform_type::float1:  c.shader_->set_uniform(c.location_, read<float>(value)); break;
+                    case uniform_type::vec2:    c.shader_->set_uniform(c.location_, read<glm::vec2>(value)); break;
+                    case uniform_type::vec4:    c.shader_->set_uniform(c.location_, read<glm::vec4>(value)); break;
+                    case uniform_type::mat4:    c.shader_->set_uniform(c.location_, read<glm::mat4>(value)); break;
+                }
+                break;
+            }
+            case command_type::bind_texture: {
+                const auto c = read<texture_cmd>(payload);
+                glActiveTexture(GL_TEXTURE0 + c.unit_);
+                glBindTexture(c.target_, c.texture_);
+                break;
+            }
+            case command_type::bind_uniform_range: {
+                const auto c = read<uniform_range_cmd>(payload);
+                glBindBufferRange(GL_UNIFORM_BUFFER, c.binding_, c.buffer_, static_cast<GLintptr>(c.offset_), static_cast<GLsizeiptr>(c.length_));
+                break;
+            }
+            case command_type::update_buffer: {
+                const auto c = read<update_cmd>(payload);
+                c.vo_->update(static_cast<vertex_object::update_type>(c.type_), c.index_, data_.data() + c.offset_, c.length_);
+                break;
+            }
+            case command_type::draw: {
+                const auto c = read<draw_cmd>(payload);
+                c.vo_->draw_range(c.first_index_, c.index_count_, c.instance_count_);
+                break;
+            }
+            case command_type::draw_ranges: {
+                const auto c = read<draw_ranges_cmd>(payload);
+                c.vo_->draw_ranges({ reinterpret_cast<const index_range*>(data_.data() + c.offset_), static_cast<size_t>(c.count_) });
+                break;
+            }
+            default:
+                spdlog::critical("Unknown command {} in command buffer.", static_cast<unsigned>(header.type_));
+                std::exit(1);
+        }
+        p += header.size_;
+    }
+}
+
+void command_buffer::execute(std::span<const command_buffer> buffers)
+{
+    for(const auto& b : buffers) {
+        b.execute();
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <glm/glm.hpp>
+
+#include "tr_memory.h"
+#include "tr_vertex.h"
+
+namespace tr {
+
+class framebuffer;
+class tr_shader;
+class gl_texture;
+
+enum class command_type : uint8_t
+{
+    bind_framebuffer,
+    set_viewport,
+    clear,
+    use_shader,
+    set_uniform,
+    bind_texture,
+    update_buffer,
+    draw,
+    draw_ranges,
+    bind_uniform_range,
+};
+
+// Records render work without calling GL, so any thread can build one.
+// Commands are small POD records packed into a byte stream, data to upload is
+// copied into a separate blob, so a buffer owns everything it needs except the
+// objects it refers to, which must outlive its execution. A buffer is recorded
+// by one thread at a time, parallel recording gives each worker its own and
+// executes them in an order the caller fixes, not the order they finished in.
+// Execution replays the commands on the thread owning the GL context.
+class command_buffer
+{
+public:
+    command_buffer();
+    /// @brief Drops the recorded commands, keeping the memory for the next recording.
+    void reset();
+
+    /// @brief Binds a frame buffer and sets the viewport to its rendered region, nullptr for the window.
+    void bind_framebuffer(framebuffer* fbo);
+    void set_viewport(int x, int y, int width, int height);
+    void clear(const glm::vec4& colour, bool depth = true, bool stencil = false);
+    void use_shader(const tr_shader& shader);
+    /// @brief Sets a uniform by location, look locations up with \c tr_shader::uniform_location() before recording.
+    void set_uniform(const tr_shader& shader, int location, int value);
+    void set_uniform(const tr_shader& shader, int location, float value);
+    void set_uniform(const tr_shader& shader, int location, const glm::vec2& value);
+    void set_uniform(const tr_shader& shader, int location, const glm::vec4& value);
+    void set_uniform(const tr_shader& shader, int location, const glm::mat4& value);
+    /// @brief Binds a 2D texture name to a texture unit.
+    void bind_texture(uint32_t unit, unsigned texture);
+    /// @brief Binds a texture, 2D or array, to a texture unit.
+    void bind_texture(uint32_t unit, const gl_texture& texture);
+    /// @brief Binds part of a uniform buffer to a uniform block binding, \c offset aligned as GL requires.
+    void bind_uniform_range(uint32_t binding, unsigned buffer, size_t offset, size_t length);
+    /// @brief Uploads vertex or index data, which is copied into the buffer now.
+    void update(vertex_object& vo, vertex_object::update_type type, size_t index, const void* data, size_t length);
+    void draw(const vertex_object& vo, size_t instance_count = 0);
+    /// @brief Draws a range of the indices, such as one level of detail.
+    void draw_range(const vertex_object& vo, size_t first, size_t count, size_t instance_count = 0);
+    /// @brief Draws several ranges in one call, the ranges are copied into the buffer now.
+    void draw_ranges(const vertex_object& vo, std::span<const index_range> ranges);
+
+    bool empty() const { return count_ == 0; }
+    size_t command_count() const { return count_; }
+    /// @brief Bytes used by the commands and the uploaded data.
+    size_t size_bytes() const { return commands_.size() + data_.size(); }
+
+    /// @brief Replays the commands, on the thread owning the GL context.
+    void execute() const;
+    /// @brief Replays several buffers, in the order given.
+    static void execute(std::span<const command_buffer> buffers);
+private:
+    enum class uniform_type : uint8_t
+    {
+        int1,
+        float1,
+        vec2,
+        vec4,
+        mat4,
+    };
+
+    /// @brief Appends a command, \c extra bytes are stored in the stream right after the payload.
+    template<typename T>
+    void push(command_type type, const T& payload, const void* extra = nullptr, size_t extra_length = 0);
+    void push_uniform(const tr_shader& shader, int location, uniform_type type, const void* value, size_t length);
+
+    tracked_vector<uint8_t> commands_;
+    tracked_vector<uint8_t> data_;
+    size_t count_{ 0 };
+};
+
+}
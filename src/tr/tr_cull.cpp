@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#include "tr_cull.h"
+#include "tr_simd.h"
+#include "tr_thread_pool.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Radius of the padding spheres, no plane distance is ever at least -radius.
+    constexpr float never_seen = -std::numeric_limits<float>::infinity();
+    /// @brief Groups of four spheres a chunk is given at least, enough to hide the pool's overhead.
+    constexpr size_t min_chunk_groups = 1024;
+
+    // Writes the indices of the spheres in groups [begin, end) that may be
+    // seen to out, which has room for all of them, and returns how many. The
+    // plane tests add in the same order frustum::intersects() does.
+    size_t cull_groups(const sphere_bounds& bounds, const frustum& view, size_t begin, size_t end, uint32_t* out)
+    {
+        simd4f px[frustum::plane_count];
+        simd4f py[frustum::plane_count];
+        simd4f pz[frustum::plane_count];
+        simd4f pw[frustum::plane_count];
+        for(size_t p = 0; p < frustum::plane_count; ++p) {
+            px[p] = simd4f::splat(view.planes_[p].x);
+            py[p] = simd4f::splat(view.planes_[p].y);
+            pz[p] = simd4f::splat(view.planes_[p].z);
+            pw[p] = simd4f::splat(view.planes_[p].w);
+        }
+        const simd4f zero = simd4f::zero();
+        size_t count = 0;
+        for(size_t g = begin; g < end; ++g) {
+            const size_t first = g * 4;
+            const simd4f x = simd4f::load(bounds.x() + first);
+            const simd4f y = simd4f::load(bounds.y() + first);
+            const simd4f z = simd4f::load(bounds.z() + first);
+            const simd4f neg_radius = zero - simd4f::load(bounds.radius() + first);
+            simd4f inside = px[0] * x + py[0] * y + pz[0] * z + pw[0] >= neg_radius;
+            for(size_t p = 1; p < frustum::plane_count; ++p) {
+                inside = inside & (px[p] * x + py[p] * y + pz[p] * z + pw[p] >= neg_radius);
+            }
+            for(unsigned mask = static_cast<unsigned>(move_mask(inside)); mask != 0; mask &= mask - 1) {
+                out[count++] = static_cast<uint32_t>(first + std::countr_zero(mask));
+            }
+        }
+        return count;
+    }
+}
+
+void sphere_bounds::clear()
+{
+    x_.clear();
+    y_.clear();
+    z_.clear();
+    radius_.clear();
+    count_ = 0;
+}
+
+void sphere_bounds::reserve(size_t count)
+{
+    const size_t padded = (count + 3) & ~size_t(3);
+    x_.reserve(padded);
+    y_.reserve(padded);
+    z_.reserve(padded);
+    radius_.reserve(padded);
+}
+
+uint32_t sphere_bounds::add(const glm::vec3& centre, float radius)
+{
+    const uint32_t index = static_cast<uint32_t>(count_++);
+    // A new group of four starts with padding the following spheres replace.
+    if(index % 4 == 0) {
+        x_.resize(x_.size() + 4, 0.0f);
+        y_.resize(y_.size() + 4, 0.0f);
+        z_.resize(z_.size() + 4, 0.0f);
+        radius_.resize(radius_.size() + 4, never_seen);
+    }
+    set(index, centre, radius);
+    return index;
+}
+
+void sphere_bounds::set(uint32_t index, const glm::vec3& centre, float radius)
+{
+    x_[index] = centre.x;
+    y_[index] = centre.y;
+    z_[index] = centre.z;
+    radius_[index] = radius;
+}
+
+void cull_spheres(const sphere_bounds& bounds, const frustum& view, std::vector<uint32_t>& visible)
+{
+    TR_PROFILE_ZONE("cull spheres");
+    const size_t groups = (bounds.size() + 3) / 4;
+    visible.resize(groups * 4);
+    visible.resize(cull_groups(bounds, view, 0, groups, visible.data()));
+}
+
+void cull_spheres(thread_pool& pool, const sphere_bounds& bounds, const frustum& view, std::vector<uint32_t>& visible)
+{
+    TR_PROFILE_ZONE("cull spheres");
+    const size_t groups = (bounds.size() + 3) / 4;
+    // The chunks are fixed up front so each writes its indices where its
+    // spheres start, then they are moved down next to one another in order.
+    const size_t chunks = std::clamp<size_t>(groups / min_chunk_groups, 1, pool.concurrency() * 4);
+    if(chunks == 1) {
+        cull_spheres(bounds, view, visible);
+        return;
+    }
+    visible.resize(groups * 4);
+    std::vector<size_t> counts(chunks);
+    pool.parallel_for(chunks, [&](size_t begin, size_t end) {
+        for(size_t c = begin; c < end; ++c) {
+            const size_t first = groups * c / chunks;
+            counts[c] = cull_groups(bounds, view, first, groups * (c + 1) / chunks, visible.data() + first * 4);
+        }
+    });
+    size_t count = 0;
+    for(size_t c = 0; c < chunks; ++c) {
+        const size_t first = groups * c / chunks * 4;
+        if(first != count) {
+            std::memmove(visible.data() + count, visible.data() + first, counts[c] * sizeof(uint32_t));
+        }
+        count += counts[c];
+    }
+    visible.resize(count);
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "tr_frustum.h"
+#include "tr_memory.h"
+
+namespace tr {
+
+class thread_pool;
+
+// World space bounding spheres of many objects, each component in its own
+// array so culling loads four objects' centres and radii at once. The arrays
+// are padded to a multiple of four with spheres that are never seen, so the
+// last group needs no special case.
+class sphere_bounds
+{
+public:
+    void clear();
+    void reserve(size_t count);
+    /// @return The sphere's index, what culling reports it by.
+    uint32_t add(const glm::vec3& centre, float radius);
+    void set(uint32_t index, const glm::vec3& centre, float radius);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    const float* x() const { return x_.data(); }
+    const float* y() const { return y_.data(); }
+    const float* z() const { return z_.data(); }
+    const float* radius() const { return radius_.data(); }
+
+private:
+    tracked_vector<float> x_{ tracked_allocator<float>(memory_tag::culling) };
+    tracked_vector<float> y_{ tracked_allocator<float>(memory_tag::culling) };
+    tracked_vector<float> z_{ tracked_allocator<float>(memory_tag::culling) };
+    tracked_vector<float> radius_{ tracked_allocator<float>(memory_tag::culling) };
+    size_t count_{ 0 };
+};
+
+/// @brief Replaces \c visible with the indices of the spheres that may be seen, in order. Tests four
+/// spheres against all six planes at a time, so it agrees with \c frustum::intersects().
+/// @param view Frustum in world space, the spheres' space.
+void cull_spheres(const sphere_bounds& bounds, const frustum& view, std::vector<uint32_t>& visible);
+/// @brief The same split across the pool, each chunk compacts its own indices before they are joined.
+void cull_spheres(thread_pool& pool, const sphere_bounds& bounds, const frustum& view, std::vector<uint32_t>& visible);
+
+}
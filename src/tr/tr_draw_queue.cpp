@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <array>
+
+#include "tr_draw_queue.h"
+#include "tr_command_buffer.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    uint64_t field(uint32_t value, unsigned bits)
+    {
+        return static_cast<uint64_t>(value) & ((uint64_t{ 1 } << bits) - 1);
+    }
+
+    uint64_t quantise(float depth, unsigned bits)
+    {
+        const uint64_t max = (uint64_t{ 1 } << bits) - 1;
+        return static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(max) + 0.5f);
+    }
+
+    bool same_state(const draw_item& a, const draw_item& b)
+    {
+        return a.shader_ == b.shader_ && a.texture_ == b.texture_ && a.vo_ == b.vo_;
+    }
+}
+
+uint64_t draw_key::make(uint32_t layer, uint32_t pass, bool blended, uint32_t program, uint32_t material, uint32_t mesh, float depth)
+{
+    uint64_t key = field(layer, 4) << 60 | field(pass, 4) << 56;
+    if(blended) {
+        // Farthest first, so the depth is inverted.
+        const uint64_t max = (uint64_t{ 1 } << 24) - 1;
+        key |= uint64_t{ 1 } << 55;
+        key |= (max - quantise(depth, 24)) << 30;
+        key |= field(program, 10) << 20 | field(material, 10) << 10 | field(mesh, 10);
+    } else {
+        key |= field(program, 10) << 44 | field(material, 14) << 30 | field(mesh, 14) << 16;
+        key |= quantise(depth, 16);
+    }
+    return key;
+}
+
+draw_queue::draw_queue()
+    : items_(tracked_allocator<draw_item>(memory_tag::commands))
+    , order_(tracked_allocator<entry>(memory_tag::commands))
+    , scratch_(tracked_allocator<entry>(memory_tag::commands))
+{
+}
+
+void draw_queue::clear()
+{
+    items_.clear();
+    order_.clear();
+}
+
+void draw_queue::submit(const draw_item& item)
+{
+    items_.push_back(item);
+}
+
+std::span<draw_item> draw_queue::allocate(size_t count)
+{
+    const size_t start = items_.size();
+    items_.resize(start + count);
+    return std::span<draw_item>(items_).subspan(start);
+}
+
+void draw_queue::sort()
+{
+    TR_PROFILE_ZONE("draw_queue::sort");
+    const size_t count = items_.size();
+    order_.resize(count);
+    scratch_.resize(count);
+    uint64_t all_or = 0;
+    uint64_t all_and = ~uint64_t{ 0 };
+    for(size_t n = 0; n < count; ++n) {
+        order_[n] = entry{ items_[n].key_, static_cast<uint32_t>(n) };
+        all_or |= items_[n].key_;
+        all_and &= items_[n].key_;
+    }
+    // Bits that are the same in every key don't affect the order.
+    const uint64_t varying = all_or ^ all_and;
+
+    for(unsigned shift = 0; shift < 64; shift += 8) {
+        if(((varying >> shift) & 0xff) == 0) {
+            continue;
+        }
+        std::array<size_t, 256> offsets{ };
+        for(const auto& e : order_) {
+            ++offsets[(e.key_ >> shift) & 0xff];
+        }
+        size_t total = 0;
+        for(auto& o : offsets) {
+            const size_t c = o;
+            o = total;
+            total += c;
+        }
+        for(const auto& e : order_) {
+            scratch_[offsets[(e.key_ >> shift) & 0xff]++] = e;
+        }
+        order_.swap(scratch_);
+    }
+}
+
+void draw_queue::record(command_buffer& cmd, size_t begin, size_t end) const
+{
+    const tr_shader* shader = nullptr;
+    unsigned texture = 0;
+    bool texture_bound = false;
+    const draw_item* uniforms = nullptr;
+    for(size_t n = begin; n < end; ++n) {
+        const draw_item& item = sorted(n);
+        if(item.ranges_.empty() && item.index_count_ == 0) {
+            continue;
+        }
+        if(item.shader_ != shader) {
+            shader = item.shader_;
+            cmd.use_shader(*shader);
+        }
+        if(!texture_bound || item.texture_ != texture) {
+            texture = item.texture_;
+            texture_bound = true;
+            cmd.bind_texture(0, texture);
+        }
+        if(item.transform_location_ >= 0) {
+            cmd.set_uniform(*shader, item.transform_location_, item.transform_);
+        }
+        if(item.uniform_buffer_ != 0 && (uniforms == nullptr || uniforms->uniform_buffer_ != item.uniform_buffer_
+            || uniforms->uniform_binding_ != item.uniform_binding_ || uniforms->uniform_offset_ != item.uniform_offset_)) {
+            uniforms = &item;
+            cmd.bind_uniform_range(item.uniform_binding_, item.uniform_buffer_, item.uniform_offset_, item.uniform_length_);
+        }
+        if(!item.ranges_.empty()) {
+            cmd.draw_ranges(*item.vo_, item.ranges_);
+        } else {
+            cmd.draw_range(*item.vo_, item.first_index_, item.index_count_, item.instance_count_);
+        }
+    }
+}
+
+size_t draw_queue::state_changes() const
+{
+    size_t changes = 0;
+    for(size_t n = 0; n < order_.size(); ++n) {
+        if(n == 0 || !same_state(sorted(n - 1), sorted(n))) {
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+}
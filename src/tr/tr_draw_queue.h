@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <glm/glm.hpp>
+
+#include "tr_memory.h"
+#include "tr_vertex.h"
+
+namespace tr {
+
+class tr_shader;
+class command_buffer;
+
+// Packs what a draw's order depends on into 64 bits, so sorting the keys as
+// integers gives the submission order. From the most significant bit:
+//
+//  layer:4 | pass:4 | blended:1 | opaque:    program:10 | material:14 | mesh:14 | depth:16
+//                                 blended:   depth:24 | program:10 | material:10 | mesh:10
+//
+// Opaque draws group by state and go front to back within it, blended draws
+// go back to front regardless of state, as blending needs. The ids are small
+// indices the caller assigns, they are truncated to their field, so a
+// collision only costs a state change, never a wrong result.
+struct draw_key
+{
+    /// @param depth View depth normalised to [0, 1], 0 nearest.
+    static uint64_t make(uint32_t layer, uint32_t pass, bool blended, uint32_t program, uint32_t material, uint32_t mesh, float depth);
+
+    static uint32_t layer(uint64_t key) { return static_cast<uint32_t>(key >> 60); }
+    static uint32_t pass(uint64_t key) { return static_cast<uint32_t>(key >> 56) & 0xf; }
+    static bool blended(uint64_t key) { return ((key >> 55) & 1) != 0; }
+};
+
+struct draw_item
+{
+    uint64_t key_{ 0 };
+    const tr_shader* shader_{ nullptr };
+    /// @brief Location of the transform uniform in \c shader_, -1 to not set it.
+    int transform_location_{ -1 };
+    /// @brief 2D texture bound to unit 0, 0 for none.
+    unsigned texture_{ 0 };
+    const vertex_object* vo_{ nullptr };
+    size_t instance_count_{ 0 };
+    /// @brief The indices of \c vo_ drawn, every one by default, nothing is drawn for none.
+    size_t first_index_{ 0 };
+    size_t index_count_{ SIZE_MAX };
+    /// @brief Drawn in one call in place of \c first_index_ and \c index_count_ if not empty,
+    /// the ranges must last until the queue is recorded.
+    std::span<const index_range> ranges_{ };
+    glm::mat4 transform_{ 1.0f };
+    /// @brief Range of a uniform buffer bound to \c uniform_binding_, such as a bone palette, none for buffer 0.
+    unsigned uniform_buffer_{ 0 };
+    uint32_t uniform_binding_{ 0 };
+    size_t uniform_offset_{ 0 };
+    size_t uniform_length_{ 0 };
+};
+
+// Collects a frame's draws, sorts them by key and records them into command
+// buffers, skipping binds of what is already bound. The sort is a least
+// significant digit radix sort over (key, index) pairs, stable and linear in
+// the number of draws, and skips digits every key shares.
+class draw_queue
+{
+public:
+    draw_queue();
+    /// @brief Drops the draws, keeping the memory for the next frame.
+    void clear();
+    void submit(const draw_item& item);
+    /// @brief Appends \c count default items to fill in, from several threads if need be.
+    std::span<draw_item> allocate(size_t count);
+    void sort();
+
+    size_t size() const { return items_.size(); }
+    bool empty() const { return items_.empty(); }
+    /// @brief Item at a position in sorted order, valid after \c sort().
+    const draw_item& sorted(size_t n) const { return items_[order_[n].index_]; }
+
+    /// @brief Records the sorted draws [begin, end), a range starts with no state assumed bound.
+    void record(command_buffer& cmd, size_t begin, size_t end) const;
+    void record(command_buffer& cmd) const { record(cmd, 0, size()); }
+    /// @brief Shader, texture and mesh changes in the sorted order, to gauge the sort.
+    size_t state_changes() const;
+private:
+    struct entry
+    {
+        uint64_t key_;
+        uint32_t index_;
+    };
+
+    tracked_vector<draw_item> items_;
+    tracked_vector<entry> order_;
+    tracked_vector<entry> scratch_;
+};
+
+}
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cmath>
+#include "tr_dynamic_resolution.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Weight given to a new measurement in the moving average.
+    constexpr double smoothing = 0.1;
+    /// @brief Aim slightly under the target so noise doesn't push us over it.
+    constexpr double headroom = 0.95;
+    /// @brief Largest change of scale applied in a single step.
+    constexpr float max_step = 0.05f;
+    /// @brief Changes smaller than this are ignored to avoid constant resizing.
+    constexpr float min_step = 1.0f / 64.0f;
+    /// @brief Measurements ignored after each change of scale.
+    constexpr size_t settle_frames = 8;
+}
+
+dynamic_resolution::dynamic_resolution(float target_ms, float min_scale, float max_scale)
+    : target_ms_(target_ms)
+    , min_scale_(min_scale)
+    , max_scale_(max_scale)
+    , scale_(max_scale)
+{
+}
+
+void dynamic_resolution::reset()
+{
+    scale_ = max_scale_;
+    smoothed_ms_ = 0.0;
+    settle_ = 0;
+}
+
+float dynamic_resolution::update(double gpu_ms)
+{
+    if(gpu_ms <= 0.0) {
+        return scale_;
+    }
+
+    smoothed_ms_ = smoothed_ms_ == 0.0 ? gpu_ms : smoothed_ms_ + (gpu_ms - smoothed_ms_) * smoothing;
+
+    if(settle_ > 0) {
+        --settle_;
+        return scale_;
+    }
+
+    // Cost is proportional to the pixel count, i.e. the square of the scale.
+    const double ratio = (target_ms_ * headroom) / smoothed_ms_;
+    const float desired = static_cast<float>(scale_ * std::sqrt(ratio));
+    const float step = std::clamp(desired - scale_, -max_step, max_step);
+    const float next = std::clamp(scale_ + step, min_scale_, max_scale_);
+
+    if(std::abs(next - scale_) >= min_step || next == min_scale_ || next == max_scale_) {
+        if(next != scale_) {
+            scale_ = next;
+            settle_ = settle_frames;
+        }
+    }
+    return scale_;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+namespace tr {
+
+// Picks an internal render scale so that the measured GPU time of a pass
+// converges on a target frame time. The scale applies to both axes, so the
+// pixel cost is treated as proportional to the square of the scale.
+class dynamic_resolution
+{
+public:
+    explicit dynamic_resolution(float target_ms, float min_scale, float max_scale);
+    /// @brief Feed a new GPU time measurement for the pass being scaled.
+    /// @return The render scale to use from now on.
+    float update(double gpu_ms);
+    /// @brief Resets the scale to the maximum and discards the history.
+    void reset();
+    float scale() const { return scale_; }
+    float min_scale() const { return min_scale_; }
+    float max_scale() const { return max_scale_; }
+    float target_ms() const { return target_ms_; }
+    /// @brief Smoothed GPU time the controller is working from.
+    double smoothed_ms() const { return smoothed_ms_; }
+    void set_target_ms(float target_ms) { target_ms_ = target_ms; }
+private:
+    float target_ms_{ 16.0f };
+    float min_scale_{ 0.5f };
+    float max_scale_{ 1.0f };
+    float scale_{ 1.0f };
+    double smoothed_ms_{ 0.0 };
+    /// @brief Measurements to skip after a change, the timer results lag behind
+    /// the frame they were issued on and the average needs to catch up.
+    size_t settle_{ 0 };
+};
+
+}
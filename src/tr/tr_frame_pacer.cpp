@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <SDL3/SDL.h>
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+
+#include "tr_frame_pacer.h"
+#include "tr_window.h"
+
+namespace tr {
+
+namespace {
+    /// @brief The part of a limited frame that is spun rather than slept.
+    constexpr auto spin_margin = std::chrono::microseconds(1500);
+    /// @brief Longest wait on a frame fence before giving up on it.
+    constexpr uint64_t max_fence_wait_ns = 100000000;
+
+    double mean(const double* values, size_t count)
+    {
+        if(count == 0) {
+            return 0.0;
+        }
+        double total = 0.0;
+        for(size_t n = 0; n < count; ++n) {
+            total += values[n];
+        }
+        return total / static_cast<double>(count);
+    }
+}
+
+std::optional<present_mode> present_mode_from_string(std::string_view name)
+{
+    if(name == "vsync") {
+        return present_mode::vsync;
+    } else if(name == "adaptive" || name == "adaptive-vsync") {
+        return present_mode::adaptive_vsync;
+    } else if(name == "uncapped" || name == "immediate") {
+        return present_mode::uncapped;
+    } else if(name == "limited" || name == "limit") {
+        return present_mode::limited;
+    }
+    return std::nullopt;
+}
+
+const char* to_string(present_mode mode)
+{
+    switch(mode)
+    {
+        case present_mode::vsync:           return "vsync";
+        case present_mode::adaptive_vsync:  return "adaptive";
+        case present_mode::uncapped:        return "uncapped";
+        case present_mode::limited:         return "limited";
+    }
+    return "unknown";
+}
+
+frame_pacer::frame_pacer(present_mode mode, double target_fps, size_t max_queued_frames)
+    : mode_(mode)
+    , max_queued_frames_(max_queued_frames)
+{
+    set_target_fps(target_fps);
+}
+
+frame_pacer::~frame_pacer()
+{
+    for(auto& f : fences_) {
+        glDeleteSync(static_cast<GLsync>(f.sync_));
+    }
+}
+
+void frame_pacer::set_target_fps(double target_fps)
+{
+    if(target_fps <= 0.0) {
+        spdlog::critical("Frame rate limit must be positive, was {}.", target_fps);
+        std::exit(1);
+    }
+    target_fps_ = target_fps;
+}
+
+void frame_pacer::apply(tr_window& wnd)
+{
+    switch(mode_)
+    {
+        case present_mode::vsync:
+            wnd.set_swap_interval(1);
+            break;
+        case present_mode::adaptive_vsync:
+            if(!wnd.set_swap_interval(-1)) {
+                spdlog::warn("Adaptive vsync is not supported, falling back to vsync.");
+                mode_ = present_mode::vsync;
+                wnd.set_swap_interval(1);
+            }
+            break;
+        case present_mode::uncapped:
+        case present_mode::limited:
+            wnd.set_swap_interval(0);
+            break;
+    }
+    deadline_ = clock::now();
+}
+
+void frame_pacer::wait_for_gpu()
+{
+    const auto start = clock::now();
+    // Collect whatever has completed, then block while too many frames are queued.
+    while(retire(0)) {
+    }
+    while(max_queued_frames_ != 0 && fences_.size() >= max_queued_frames_) {
+        retire(max_fence_wait_ns);
+    }
+    gpu_wait_ms_ = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+}
+
+bool frame_pacer::retire(uint64_t timeout_ns)
+{
+    if(fences_.empty()) {
+        return false;
+    }
+
+    fence& f = fences_.front();
+    const GLenum status = glClientWaitSync(static_cast<GLsync>(f.sync_), GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+    if(status == GL_TIMEOUT_EXPIRED) {
+        if(timeout_ns == 0) {
+            return false;
+        }
+        spdlog::warn("Frame fence did not signal within {} ms, dropping it.", timeout_ns / 1000000);
+    } else if(f.input_ns_ != 0) {
+        // The frame's GPU work is done, which is as close to the present as GL lets us see.
+        latency_[latency_next_] = static_cast<double>(SDL_GetTicksNS() - f.input_ns_) / 1000000.0;
+        latency_next_ = (latency_next_ + 1) % history;
+        latency_count_ = std::min(latency_count_ + 1, history);
+    }
+
+    glDeleteSync(static_cast<GLsync>(f.sync_));
+    fences_.pop_front();
+    return true;
+}
+
+void frame_pacer::end_frame(uint64_t input_ns)
+{
+    fence f;
+    f.sync_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    f.input_ns_ = input_ns;
+    fences_.emplace_back(f);
+
+    if(mode_ == present_mode::limited) {
+        limit();
+    }
+
+    const auto now = clock::now();
+    if(last_frame_ != clock::time_point{ }) {
+        frame_times_[frame_next_] = std::chrono::duration<double, std::milli>(now - last_frame_).count();
+        frame_next_ = (frame_next_ + 1) % history;
+        frame_count_ = std::min(frame_count_ + 1, history);
+    }
+    last_frame_ = now;
+}
+
+void frame_pacer::resume()
+{
+    last_frame_ = clock::time_point{ };
+    deadline_ = clock::now();
+}
+
+void frame_pacer::limit()
+{
+    const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / target_fps_));
+    deadline_ += period;
+
+    auto now = clock::now();
+    if(now > deadline_ + period) {
+        // More than a frame late, start counting from now rather than rushing to catch up.
+        deadline_ = now;
+        return;
+    }
+
+    if(deadline_ - now > spin_margin) {
+        std::this_thread::sleep_for(deadline_ - now - spin_margin);
+    }
+    while(clock::now() < deadline_) {
+        std::this_thread::yield();
+    }
+}
+
+double frame_pacer::latency_ms() const
+{
+    return mean(latency_.data(), latency_count_);
+}
+
+double frame_pacer::latency_max_ms() const
+{
+    return latency_count_ == 0 ? 0.0 : *std::max_element(latency_.begin(), latency_.begin() + latency_count_);
+}
+
+double frame_pacer::frame_ms() const
+{
+    return mean(frame_times_.data(), frame_count_);
+}
+
+double frame_pacer::jitter_ms() const
+{
+    if(frame_count_ < 2) {
+        return 0.0;
+    }
+    const double m = frame_ms();
+    double variance = 0.0;
+    for(size_t n = 0; n < frame_count_; ++n) {
+        variance += (frame_times_[n] - m) * (frame_times_[n] - m);
+    }
+    return std::sqrt(variance / static_cast<double>(frame_count_));
+}
+
+}
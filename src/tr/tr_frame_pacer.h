@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string_view>
+
+namespace tr {
+
+class tr_window;
+
+enum class present_mode
+{
+    /// @brief Wait for vertical blank on every swap.
+    vsync,
+    /// @brief Wait for vertical blank, but swap immediately if the frame is late.
+    adaptive_vsync,
+    /// @brief Never wait, present as fast as possible.
+    uncapped,
+    /// @brief No vsync, the pacer sleeps to hold a target frame rate.
+    limited,
+};
+
+std::optional<present_mode> present_mode_from_string(std::string_view name);
+const char* to_string(present_mode mode);
+
+// Controls when frames are started and presented.
+// Besides the swap interval for the present mode it limits how many frames
+// the CPU may queue ahead of the GPU, using a fence per frame, which bounds
+// input latency. In \c present_mode::limited it holds the target frame rate by
+// sleeping most of the remaining time and spinning for the last part, since
+// sleeps alone overshoot by up to a scheduler quantum.
+class frame_pacer
+{
+public:
+    explicit frame_pacer(present_mode mode = present_mode::vsync, double target_fps = 60.0, size_t max_queued_frames = 2);
+    ~frame_pacer();
+    /// @brief Sets the swap interval on the window for the current mode.
+    /// Adaptive vsync falls back to vsync when the driver doesn't support it.
+    void apply(tr_window& wnd);
+    void set_mode(present_mode mode) { mode_ = mode; }
+    void set_target_fps(double target_fps);
+    /// @brief Frames the CPU may run ahead of the GPU, 0 disables the limit.
+    void set_max_queued_frames(size_t frames) { max_queued_frames_ = frames; }
+    /// @brief Blocks until the GPU has caught up to within the queue limit.
+    /// Call before reading input for a new frame.
+    void wait_for_gpu();
+    /// @brief Call after the swap. Fences the frame and holds the frame rate when limited.
+    /// @param input_ns Timestamp, from \c SDL_GetTicksNS(), of the oldest input handled this frame, 0 if none.
+    void end_frame(uint64_t input_ns);
+    /// @brief Call before the first frame after the loop was idle, so the idle time isn't counted as a frame.
+    void resume();
+
+    present_mode mode() const { return mode_; }
+    double target_fps() const { return target_fps_; }
+    size_t max_queued_frames() const { return max_queued_frames_; }
+    /// @brief Frames submitted to the GPU that haven't completed.
+    size_t queued_frames() const { return fences_.size(); }
+    /// @brief Time spent in the last \c wait_for_gpu(), in milliseconds.
+    double gpu_wait_ms() const { return gpu_wait_ms_; }
+    /// @brief Mean and worst input to frame completion latency over the recent frames.
+    double latency_ms() const;
+    double latency_max_ms() const;
+    /// @brief Mean frame time over the recent frames.
+    double frame_ms() const;
+    /// @brief Standard deviation of the recent frame times.
+    double jitter_ms() const;
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct fence
+    {
+        void* sync_{ nullptr };
+        uint64_t input_ns_{ 0 };
+    };
+
+    /// @brief Number of recent frames the statistics are taken over.
+    static constexpr size_t history = 120;
+
+    /// @brief Retires completed fences, waiting up to \c timeout_ns for the oldest.
+    bool retire(uint64_t timeout_ns);
+    /// @brief Sleeps and spins until the next frame deadline.
+    void limit();
+
+    present_mode mode_{ present_mode::vsync };
+    double target_fps_{ 60.0 };
+    size_t max_queued_frames_{ 2 };
+    std::deque<fence> fences_{ };
+    clock::time_point deadline_{ };
+    clock::time_point last_frame_{ };
+    double gpu_wait_ms_{ 0.0 };
+
+    std::array<double, history> latency_{ };
+    size_t latency_count_{ 0 };
+    size_t latency_next_{ 0 };
+    std::array<double, history> frame_times_{ };
+    size_t frame_count_{ 0 };
+    size_t frame_next_{ 0 };
+
+    frame_pacer(const frame_pacer&) = delete;
+    frame_pacer(frame_pacer&&) = delete;
+    frame_pacer& operator=(const frame_pacer&) = delete;
+    frame_pacer& operator=(frame_pacer&&) = delete;
+};
+
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "tr_frame_stats.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Nearest rank percentile of an already sorted list.
+    double percentile(const std::vector<double>& sorted, double p)
+    {
+        const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+}
+
+frame_stats::frame_stats(size_t reserve)
+{
+    samples_.reserve(reserve);
+}
+
+void frame_stats::add(double frame_ms)
+{
+    samples_.emplace_back(frame_ms);
+}
+
+frame_stats::summary frame_stats::summarise() const
+{
+    summary s;
+    if(samples_.empty()) {
+        return s;
+    }
+
+    std::vector<double> sorted{ samples_ };
+    std::sort(sorted.begin(), sorted.end());
+
+    s.frames_ = sorted.size();
+    s.total_ms_ = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+    s.mean_ms_ = s.total_ms_ / static_cast<double>(s.frames_);
+    s.min_ms_ = sorted.front();
+    s.max_ms_ = sorted.back();
+    s.p50_ms_ = percentile(sorted, 50.0);
+    s.p95_ms_ = percentile(sorted, 95.0);
+    s.p99_ms_ = percentile(sorted, 99.0);
+
+    double variance = 0.0;
+    for(double v : sorted) {
+        variance += (v - s.mean_ms_) * (v - s.mean_ms_);
+    }
+    s.stddev_ms_ = std::sqrt(variance / static_cast<double>(s.frames_));
+    return s;
+}
+
+nlohmann::json to_json(const frame_stats::summary& s)
+{
+    return nlohmann::json{
+        { "frames", s.frames_ },
+        { "total_ms", s.total_ms_ },
+        { "mean_ms", s.mean_ms_ },
+        { "min_ms", s.min_ms_ },
+        { "p50_ms", s.p50_ms_ },
+        { "p95_ms", s.p95_ms_ },
+        { "p99_ms", s.p99_ms_ },
+        { "max_ms", s.max_ms_ },
+        { "stddev_ms", s.stddev_ms_ },
+    };
+}
+
+}
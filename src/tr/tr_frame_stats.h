@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <json.hpp>
+
+namespace tr {
+
+// Collects frame times and reduces them to the figures used to compare runs.
+class frame_stats
+{
+public:
+    struct summary
+    {
+        size_t frames_{ 0 };
+        double total_ms_{ 0.0 };
+        double mean_ms_{ 0.0 };
+        double min_ms_{ 0.0 };
+        double p50_ms_{ 0.0 };
+        double p95_ms_{ 0.0 };
+        double p99_ms_{ 0.0 };
+        double max_ms_{ 0.0 };
+        /// @brief Standard deviation, a measure of frame time jitter.
+        double stddev_ms_{ 0.0 };
+    };
+
+    explicit frame_stats(size_t reserve = 0);
+    void add(double frame_ms);
+    void clear() { samples_.clear(); }
+    size_t count() const { return samples_.size(); }
+    const std::vector<double>& samples() const { return samples_; }
+    summary summarise() const;
+private:
+    std::vector<double> samples_{ };
+};
+
+/// @brief Converts a summary to json, with times in milliseconds.
+nlohmann::json to_json(const frame_stats::summary& s);
+
+}
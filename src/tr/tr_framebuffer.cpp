@@ -1,26 +1,55 @@
+#include <algorithm>
+#include <cmath>
 #include <spdlog/spdlog.h>
 #include <glad/gl.h>
 #include "tr_framebuffer.h"
 
 namespace tr {
 
+size_t framebuffer_layout::storage_width() const
+{
+    return std::max<size_t>(1, static_cast<size_t>(std::ceil(static_cast<float>(width_) * max_scale_)));
+}
+
+size_t framebuffer_layout::storage_height() const
+{
+    return std::max<size_t>(1, static_cast<size_t>(std::ceil(static_cast<float>(height_) * max_scale_)));
+}
+
+size_t framebuffer_layout::render_width() const
+{
+    return std::clamp<size_t>(static_cast<size_t>(std::lround(static_cast<float>(width_) * scale_)), 1, storage_width());
+}
+
+size_t framebuffer_layout::render_height() const
+{
+    return std::clamp<size_t>(static_cast<size_t>(std::lround(static_cast<float>(height_) * scale_)), 1, storage_height());
+}
+
+void framebuffer_layout::set_scale(float scale)
+{
+    scale_ = std::clamp(scale, 0.0f, max_scale_);
+}
+
 framebuffer::framebuffer(size_t width, size_t height)
-    : width_(width)
-    , height_(height)
+    : layout_{ width, height }
 {
     glGenFramebuffers(1, &fbo_);
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
 
     glGenTextures(1, &tex_);
+    glGenRenderbuffers(1, &rbo_);
+    allocate();
+
+    // Linear filtering so a reduced render scale is upscaled smoothly when presented.
     glBindTexture(GL_TEXTURE_2D, tex_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_, 0);
 
-    glGenRenderbuffers(1, &rbo_);
     glBindRenderbuffer(GL_RENDERBUFFER, rbo_);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo_);
 
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
@@ -33,7 +62,9 @@ framebuffer::framebuffer(size_t width, size_t height)
 
 framebuffer::~framebuffer()
 {
-
+    glDeleteFramebuffers(1, &fbo_);
+    glDeleteRenderbuffers(1, &rbo_);
+    glDeleteTextures(1, &tex_);
 }
 
 void framebuffer::unbind()
@@ -51,6 +82,7 @@ void framebuffer::apply()
         std::exit(1);
     }
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, static_cast<GLsizei>(render_width()), static_cast<GLsizei>(render_height()));
 }
 
 void framebuffer::unapply()
@@ -60,16 +92,57 @@ void framebuffer::unapply()
 
 void framebuffer::resize(size_t width, size_t height)
 {
-    width_ = width;
-    height_ = height;
+    layout_.width_ = width;
+    layout_.height_ = height;
+    allocate();
+}
+
+void framebuffer::set_scale(float scale)
+{
+    layout_.set_scale(scale);
+}
+
+void framebuffer::set_max_scale(float max_scale)
+{
+    if(max_scale <= 0.0f) {
+        spdlog::critical("Framebuffer maximum scale must be positive, was {}.", max_scale);
+        std::exit(1);
+    }
+    if(max_scale != layout_.max_scale_) {
+        layout_.max_scale_ = max_scale;
+        layout_.scale_ = std::min(layout_.scale_, layout_.max_scale_);
+        allocate();
+    }
+}
+
+void framebuffer::set_layout(const framebuffer_layout& layout)
+{
+    if(layout.max_scale_ <= 0.0f) {
+        spdlog::critical("Framebuffer maximum scale must be positive, was {}.", layout.max_scale_);
+        std::exit(1);
+    }
+    const bool reallocate = layout.storage_width() != layout_.storage_width() || layout.storage_height() != layout_.storage_height();
+    layout_ = layout;
+    layout_.set_scale(layout.scale_);
+    if(reallocate) {
+        allocate();
+    }
+}
+
+void framebuffer::allocate()
+{
+    const size_t storage_width = layout_.storage_width();
+    const size_t storage_height = layout_.storage_height();
 
     glBindTexture(GL_TEXTURE_2D, tex_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, static_cast<GLsizei>(width_), static_cast<GLsizei>(height_), 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, static_cast<GLsizei>(storage_width), static_cast<GLsizei>(storage_height), 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glBindTexture(GL_TEXTURE_2D, 0);
+    tex_memory_.set(memory::gpu_texture_bytes(GL_RGB8, storage_width, storage_height));
 
     glBindRenderbuffer(GL_RENDERBUFFER, rbo_);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, static_cast<GLsizei>(width_), static_cast<GLsizei>(height_));
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, static_cast<GLsizei>(storage_width), static_cast<GLsizei>(storage_height));
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    rbo_memory_.set(memory::gpu_texture_bytes(GL_DEPTH24_STENCIL8, storage_width, storage_height));
 }
 
 }
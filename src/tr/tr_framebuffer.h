@@ -1,38 +1,92 @@
 #pragma once
 
 #include "tr_scope.h"
+#include "tr_memory.h"
 
 namespace tr {
 
+// Logical size and render scale of a frame buffer and the storage they need.
+// Kept apart from the GL objects so a thread that doesn't own the context can
+// work out the rendered region, e.g. for the texture co-ordinates it's shown with.
+struct framebuffer_layout
+{
+    size_t width_{ 0 };
+    size_t height_{ 0 };
+    /// @brief Fraction of the logical size that is rendered.
+    float scale_{ 1.0f };
+    /// @brief Largest render scale the attachments are sized for.
+    float max_scale_{ 1.0f };
+
+    /// @brief Allocated width of the attachments.
+    size_t storage_width() const;
+    /// @brief Allocated height of the attachments.
+    size_t storage_height() const;
+    /// @brief Width of the region that is actually rendered to.
+    size_t render_width() const;
+    /// @brief Height of the region that is actually rendered to.
+    size_t render_height() const;
+    /// @brief Texture co-ordinate of the right edge of the rendered region.
+    float u_max() const { return static_cast<float>(render_width()) / static_cast<float>(storage_width()); }
+    /// @brief Texture co-ordinate of the top edge of the rendered region.
+    float v_max() const { return static_cast<float>(render_height()) / static_cast<float>(storage_height()); }
+    /// @brief Sets the scale, clamped to the maximum scale.
+    void set_scale(float scale);
+};
+
 // Represents a single instance of a frame buffer.
+// The frame buffer has a logical size, which is the size it is presented at,
+// and a render scale. Rendering only covers the scaled region in the lower left
+// of the attachments, which are sized for the maximum scale so changing the
+// scale never reallocates them.
 class framebuffer : public scoped_object
 {
 public:
-    explicit framebuffer(size_t width, size_t height);    
+    explicit framebuffer(size_t width, size_t height);
     virtual ~framebuffer() override;
     void resize(size_t width, size_t height);
+    /// @brief Sets the fraction of the logical size that is rendered, clamped to the maximum scale.
+    void set_scale(float scale);
+    /// @brief Sets the largest scale that can be used, reallocating the attachments if needed.
+    void set_max_scale(float max_scale);
+    /// @brief Applies a layout, reallocating the attachments only if its size or maximum scale changed.
+    void set_layout(const framebuffer_layout& layout);
+    const framebuffer_layout& layout() const { return layout_; }
     void apply() override;
     void unapply() override;
-    size_t width() const { return width_; }
-    float widthf() const { return static_cast<float>(width_); }
-    size_t height() const { return height_; }
-    float heightf() const { return static_cast<float>(height_); }
+    size_t width() const { return layout_.width_; }
+    float widthf() const { return static_cast<float>(layout_.width_); }
+    size_t height() const { return layout_.height_; }
+    float heightf() const { return static_cast<float>(layout_.height_); }
+    float scale() const { return layout_.scale_; }
+    /// @brief Width of the region that is actually rendered to.
+    size_t render_width() const { return layout_.render_width(); }
+    /// @brief Height of the region that is actually rendered to.
+    size_t render_height() const { return layout_.render_height(); }
+    /// @brief Texture co-ordinate of the right edge of the rendered region.
+    float u_max() const { return layout_.u_max(); }
+    /// @brief Texture co-ordinate of the top edge of the rendered region.
+    float v_max() const { return layout_.v_max(); }
     unsigned texture_id() const { return tex_; }
+    unsigned framebuffer_id() const { return fbo_; }
 private:
     /// @brief Helper function to unbind the currently bound buffers.
     void unbind();
-    /// @brief Width of the frame buffer.
-    size_t width_{ 0 };
-    /// @brief Height of the frame buffer.
-    size_t height_{ 0 };
+    /// @brief (Re)allocates the attachment storage for the current size and maximum scale.
+    void allocate();
+    /// @brief Size and scale of the frame buffer, the attachments are allocated for it.
+    framebuffer_layout layout_;
     /// @brief  Frame buffer object.
     unsigned fbo_{ 0 };
     /// @brief  Render buffer object.
     unsigned rbo_{ 0 };
     /// @brief ID for the texture bound to the framebuffer.
     unsigned tex_{ 0 };
+    /// @brief Estimated size of the colour texture.
+    gpu_allocation tex_memory_{ memory_tag::framebuffer };
+    /// @brief Estimated size of the depth stencil render buffer.
+    gpu_allocation rbo_memory_{ memory_tag::framebuffer };
 };
 
 typedef std::unique_ptr<framebuffer> framebuffer_ptr_t;
 
-}
\ No newline at end of file
+}
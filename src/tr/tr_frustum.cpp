@@ -0,0 +1,50 @@
+#include <cmath>
+
+#include "tr_frustum.h"
+
+namespace tr {
+
+frustum frustum::from_matrix(const glm::mat4& m)
+{
+    // glm is column major, row i of the matrix is m[0][i] ... m[3][i].
+    auto row = [&m](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    const glm::vec4 x = row(0);
+    const glm::vec4 y = row(1);
+    const glm::vec4 z = row(2);
+    const glm::vec4 w = row(3);
+
+    frustum f;
+    f.planes_[left_plane] = w + x;
+    f.planes_[right_plane] = w - x;
+    f.planes_[bottom_plane] = w + y;
+    f.planes_[top_plane] = w - y;
+    f.planes_[near_plane] = w + z;
+    f.planes_[far_plane] = w - z;
+    for(auto& p : f.planes_) {
+        const float length = glm::length(glm::vec3(p.x, p.y, p.z));
+        if(length > 0.0f) {
+            p = p / length;
+        }
+    }
+
+    // The eye projects to the point at infinity on clip space's z axis.
+    const glm::vec4 eye = glm::inverse(m) * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+    if(std::abs(eye.w) > 1e-6f * glm::length(glm::vec3(eye.x, eye.y, eye.z))) {
+        f.eye_ = glm::vec4(glm::vec3(eye.x, eye.y, eye.z) / eye.w, 1.0f);
+    } else {
+        f.eye_ = glm::vec4(glm::normalize(glm::vec3(eye.x, eye.y, eye.z)), 0.0f);
+    }
+    return f;
+}
+
+bool frustum::intersects(const glm::vec3& centre, float radius) const
+{
+    for(const auto& p : planes_) {
+        if(p.x * centre.x + p.y * centre.y + p.z * centre.z + p.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
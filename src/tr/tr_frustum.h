@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace tr {
+
+// The six planes bounding what a projection sees, facing inwards, in the
+// space the matrix transforms from. Built from a model-view-projection the
+// planes are in object space, so bounds can be tested without transforming
+// them first.
+struct frustum
+{
+    enum plane
+    {
+        left_plane,
+        right_plane,
+        bottom_plane,
+        top_plane,
+        near_plane,
+        far_plane,
+        plane_count,
+    };
+    /// @brief Each plane as (normal, distance), normalised, a point p is inside when dot(normal, p) + distance >= 0.
+    glm::vec4 planes_[plane_count]{ };
+    /// @brief The viewer in the same space, (position, 1) for a perspective projection,
+    /// (direction towards the viewer, 0) for an orthographic one.
+    glm::vec4 eye_{ 0.0f, 0.0f, 1.0f, 0.0f };
+
+    /// @brief Extracts the planes of a projection, Gribb and Hartmann's method for GL's clip space.
+    static frustum from_matrix(const glm::mat4& m);
+
+    /// @brief If any of a sphere may be seen, spheres near a corner can pass when they are outside.
+    bool intersects(const glm::vec3& centre, float radius) const;
+};
+
+}
@@ -0,0 +1,23 @@
+#include <spdlog/spdlog.h>
+#include "tr_game_loop.h"
+
+namespace tr {
+
+fixed_timestep::fixed_timestep(double tick_rate, size_t max_ticks_per_frame)
+    : max_ticks_per_frame_(max_ticks_per_frame)
+{
+    set_tick_rate(tick_rate);
+}
+
+void fixed_timestep::set_tick_rate(double tick_rate)
+{
+    if(tick_rate <= 0.0) {
+        spdlog::critical("Simulation tick rate must be positive, was {}.", tick_rate);
+        std::exit(1);
+    }
+    step_ = 1.0 / tick_rate;
+    // A single frame never adds more time than the maximum number of ticks can consume.
+    max_frame_time_ = step_ * static_cast<double>(max_ticks_per_frame_);
+}
+
+}
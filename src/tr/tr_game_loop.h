@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "tr_profiler.h"
+
+namespace tr {
+
+// Runs a simulation at a fixed tick rate regardless of the frame rate.
+// Real time is accumulated each frame and consumed in fixed steps; what is
+// left over is returned as the interpolation alpha between the previous and
+// the current simulation state. Long frames are clamped so a slow frame can't
+// schedule more ticks than the next one can run (the spiral of death).
+class fixed_timestep
+{
+public:
+    explicit fixed_timestep(double tick_rate, size_t max_ticks_per_frame = 8);
+    /// @brief Adds the elapsed real time and runs the ticks that are due.
+    /// @param tick Called with the step, in seconds, once per tick.
+    /// @return Interpolation alpha in [0, 1) between the last two states.
+    template<typename F>
+    double advance(double elapsed_seconds, F&& tick)
+    {
+        accumulator_ += std::min(elapsed_seconds, max_frame_time_);
+        size_t ticks = 0;
+        while(accumulator_ >= step_) {
+            if(ticks == max_ticks_per_frame_) {
+                // Still behind after the maximum number of ticks, drop the rest
+                // rather than falling further behind every frame.
+                dropped_seconds_ += accumulator_ - step_;
+                accumulator_ = step_ * 0.999;
+                break;
+            }
+            tick(step_);
+            accumulator_ -= step_;
+            ++ticks;
+        }
+        ticks_ += ticks;
+        ticks_last_frame_ = ticks;
+        alpha_ = accumulator_ / step_;
+        return alpha_;
+    }
+    void set_tick_rate(double tick_rate);
+    double tick_rate() const { return 1.0 / step_; }
+    /// @brief Length of a tick, in seconds.
+    double step() const { return step_; }
+    double alpha() const { return alpha_; }
+    uint64_t ticks() const { return ticks_; }
+    size_t ticks_last_frame() const { return ticks_last_frame_; }
+    /// @brief Simulation time that was discarded because the frames were too slow.
+    double dropped_seconds() const { return dropped_seconds_; }
+private:
+    double step_{ 1.0 / 60.0 };
+    size_t max_ticks_per_frame_{ 8 };
+    /// @brief The most real time a single frame may add to the accumulator.
+    double max_frame_time_{ 8.0 / 60.0 };
+    double accumulator_{ 0.0 };
+    double alpha_{ 0.0 };
+    uint64_t ticks_{ 0 };
+    size_t ticks_last_frame_{ 0 };
+    double dropped_seconds_{ 0.0 };
+};
+
+// Runs a fixed timestep simulation on its own thread.
+// The simulation thread owns the working state. After every tick it publishes
+// the previous and current states into the back half of a double buffer and
+// flips it, so the renderer always reads a consistent pair without waiting for
+// a tick to complete.
+template<typename State>
+class sim_thread
+{
+public:
+    typedef std::function<void(State&, double)> tick_fn;
+
+    struct snapshot
+    {
+        State previous_{ };
+        State current_{ };
+        /// @brief Interpolation alpha based on how long ago \c current_ was published.
+        double alpha_{ 0.0 };
+        uint64_t tick_{ 0 };
+    };
+
+    explicit sim_thread(double tick_rate, const State& initial, tick_fn tick)
+        : step_(1.0 / tick_rate)
+        , tick_(std::move(tick))
+    {
+        for(auto& b : buffers_) {
+            b.previous_ = initial;
+            b.current_ = initial;
+            b.published_ = clock::now();
+        }
+        thread_ = std::thread(&sim_thread::run, this);
+    }
+
+    ~sim_thread()
+    {
+        stop_ = true;
+        thread_.join();
+    }
+
+    /// @brief Copies the latest published pair of states.
+    snapshot read() const
+    {
+        snapshot s;
+        clock::time_point published;
+        {
+            std::lock_guard lock(mutex_);
+            const buffer& b = buffers_[front_];
+            s.previous_ = b.previous_;
+            s.current_ = b.current_;
+            s.tick_ = b.tick_;
+            published = b.published_;
+        }
+        const double since = std::chrono::duration<double>(clock::now() - published).count();
+        s.alpha_ = std::clamp(since / step_, 0.0, 1.0);
+        return s;
+    }
+
+    double step() const { return step_; }
+    /// @brief Stops ticking while set, the published states are held.
+    void set_paused(bool paused) { paused_ = paused; }
+    bool paused() const { return paused_; }
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct buffer
+    {
+        State previous_{ };
+        State current_{ };
+        uint64_t tick_{ 0 };
+        clock::time_point published_{ };
+    };
+
+    void run()
+    {
+        profiler::set_thread_name("simulation");
+        State previous = buffers_[0].current_;
+        State current = previous;
+        uint64_t tick = 0;
+        const auto step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(step_));
+        auto next = clock::now() + step;
+
+        while(!stop_) {
+            std::this_thread::sleep_until(next);
+            if(paused_) {
+                // Resume from the current time, not with a burst of the ticks missed while paused.
+                next = clock::now() + step;
+                continue;
+            }
+            previous = current;
+            tick_(current, step_);
+            ++tick;
+
+            // Fill the buffer the reader isn't using, then flip.
+            {
+                std::lock_guard lock(mutex_);
+                buffer& b = buffers_[1 - front_];
+                b.previous_ = previous;
+                b.current_ = current;
+                b.tick_ = tick;
+                b.published_ = clock::now();
+                front_ = 1 - front_;
+            }
+
+            next += step;
+            // If the thread fell far behind, resynchronise instead of bursting.
+            const auto now = clock::now();
+            if(now - next > step * 8) {
+                next = now + step;
+            }
+        }
+    }
+
+    double step_{ 1.0 / 60.0 };
+    tick_fn tick_;
+    buffer buffers_[2]{ };
+    size_t front_{ 0 };
+    mutable std::mutex mutex_;
+    std::atomic<bool> stop_{ false };
+    std::atomic<bool> paused_{ false };
+    std::thread thread_;
+
+    sim_thread(const sim_thread&) = delete;
+    sim_thread(sim_thread&&) = delete;
+    sim_thread& operator=(const sim_thread&) = delete;
+    sim_thread& operator=(sim_thread&&) = delete;
+};
+
+}
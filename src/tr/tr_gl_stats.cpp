@@ -0,0 +1,624 @@
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+
+#include "tr_gl_stats.h"
+
+namespace tr {
+
+gl_counters& gl_counters::operator+=(const gl_counters& rhs)
+{
+    draw_calls_ += rhs.draw_calls_;
+    instances_ += rhs.instances_;
+    program_binds_ += rhs.program_binds_;
+    vao_binds_ += rhs.vao_binds_;
+    fbo_binds_ += rhs.fbo_binds_;
+    texture_binds_ += rhs.texture_binds_;
+    redundant_binds_ += rhs.redundant_binds_;
+    uploads_ += rhs.uploads_;
+    upload_bytes_ += rhs.upload_bytes_;
+    return *this;
+}
+
+gl_counters& gl_counters::operator-=(const gl_counters& rhs)
+{
+    draw_calls_ -= rhs.draw_calls_;
+    instances_ -= rhs.instances_;
+    program_binds_ -= rhs.program_binds_;
+    vao_binds_ -= rhs.vao_binds_;
+    fbo_binds_ -= rhs.fbo_binds_;
+    texture_binds_ -= rhs.texture_binds_;
+    redundant_binds_ -= rhs.redundant_binds_;
+    uploads_ -= rhs.uploads_;
+    upload_bytes_ -= rhs.upload_bytes_;
+    return *this;
+}
+
+gl_counters operator-(gl_counters lhs, const gl_counters& rhs)
+{
+    lhs -= rhs;
+    return lhs;
+}
+
+nlohmann::json to_json(const gl_counters& c)
+{
+    return nlohmann::json{
+        { "draw_calls", c.draw_calls_ },
+        { "instances", c.instances_ },
+        { "program_binds", c.program_binds_ },
+        { "vao_binds", c.vao_binds_ },
+        { "fbo_binds", c.fbo_binds_ },
+        { "texture_binds", c.texture_binds_ },
+        { "redundant_binds", c.redundant_binds_ },
+        { "uploads", c.uploads_ },
+        { "upload_bytes", c.upload_bytes_ },
+    };
+}
+
+nlohmann::json to_json(const gl_frame_counters& f)
+{
+    nlohmann::json passes = nlohmann::json::object();
+    for(const auto& p : f.passes_) {
+        passes[p.name_] = to_json(p.counters_);
+    }
+    return nlohmann::json{
+        { "total", to_json(f.total_) },
+        { "passes", passes },
+    };
+}
+
+namespace gl_stats {
+
+namespace {
+    std::atomic<bool> is_enabled{ false };
+    bool installed{ false };
+    gl_counters frame_start{ };
+    std::vector<gl_pass_counters> passes{ };
+    // The previous frame is read by the UI, which may run on another thread than the renderer.
+    std::mutex previous_mutex;
+    gl_frame_counters previous{ };
+}
+
+#if TR_GL_INSTRUMENTATION
+
+namespace {
+    // Updated from whichever thread makes the call, a shared context may upload from another thread.
+    struct live_counters
+    {
+        std::atomic<uint64_t> draw_calls_{ 0 };
+        std::atomic<uint64_t> instances_{ 0 };
+        std::atomic<uint64_t> program_binds_{ 0 };
+        std::atomic<uint64_t> vao_binds_{ 0 };
+        std::atomic<uint64_t> fbo_binds_{ 0 };
+        std::atomic<uint64_t> texture_binds_{ 0 };
+        std::atomic<uint64_t> redundant_binds_{ 0 };
+        std::atomic<uint64_t> uploads_{ 0 };
+        std::atomic<uint64_t> upload_bytes_{ 0 };
+    };
+
+    live_counters live;
+
+    // The wrappers stay installed while disabled, they only stop counting.
+    void add(std::atomic<uint64_t>& counter, uint64_t value = 1)
+    {
+        if(is_enabled.load(std::memory_order_relaxed)) {
+            counter.fetch_add(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Bound objects as last set through glad, tracked per thread as each context has its own state.
+    // Binds are tracked while disabled too, so enabling the layer needn't query what is bound.
+    // A thread reads what is bound on its first bind, as it may take over a context already in use.
+    constexpr size_t tracked_units = 32;
+    struct bind_state
+    {
+        bool initialised_{ false };
+        GLuint program_{ 0 };
+        GLuint vao_{ 0 };
+        GLuint draw_fbo_{ 0 };
+        GLuint read_fbo_{ 0 };
+        GLuint active_unit_{ 0 };
+        std::array<GLuint, tracked_units> textures_{ };
+    };
+    thread_local bind_state thread_binds{ };
+
+    /// @brief The calling thread's bind state, read from its current context the first time.
+    bind_state& current_binds()
+    {
+        bind_state& b = thread_binds;
+        if(b.initialised_) {
+            return b;
+        }
+        b.initialised_ = true;
+        GLint value = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+        b.program_ = static_cast<GLuint>(value);
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+        b.vao_ = static_cast<GLuint>(value);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &value);
+        b.draw_fbo_ = static_cast<GLuint>(value);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &value);
+        b.read_fbo_ = static_cast<GLuint>(value);
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &value);
+        b.active_unit_ = static_cast<GLuint>(value) - GL_TEXTURE0;
+        // Unknown texture bindings are marked with an id that is never generated.
+        b.textures_.fill(~0u);
+        return b;
+    }
+
+    /// @brief Records a bind, counting it as redundant if the object was already bound.
+    void track(std::atomic<uint64_t>& counter, GLuint& current, GLuint object)
+    {
+        add(counter);
+        if(current == object) {
+            add(live.redundant_binds_);
+        }
+        current = object;
+    }
+
+    void upload(uint64_t bytes)
+    {
+        add(live.uploads_);
+        add(live.upload_bytes_, bytes);
+    }
+
+    /// @brief Approximate size of uncompressed pixel data, ignoring row alignment.
+    uint64_t pixel_bytes(GLenum format, GLenum type, GLsizei width, GLsizei height, GLsizei depth)
+    {
+        uint64_t components = 4;
+        switch(format)
+        {
+            case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+                components = 1; break;
+            case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+                components = 2; break;
+            case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+                components = 3; break;
+            default:
+                break;
+        }
+
+        uint64_t texel = 4;
+        switch(type)
+        {
+            case GL_UNSIGNED_BYTE: case GL_BYTE:
+                texel = components; break;
+            case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+                texel = components * 2; break;
+            case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT:
+                texel = components * 4; break;
+            case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_5_5_5_1:
+                texel = 2; break;
+            default:
+                // Packed 32 bit formats.
+                texel = 4; break;
+        }
+        return texel * static_cast<uint64_t>(width) * static_cast<uint64_t>(height) * static_cast<uint64_t>(depth);
+    }
+
+    // The driver's entry points, set once when the wrappers are installed.
+    struct entry_points
+    {
+        PFNGLDRAWARRAYSPROC draw_arrays_{ nullptr };
+        PFNGLDRAWELEMENTSPROC draw_elements_{ nullptr };
+        PFNGLDRAWRANGEELEMENTSPROC draw_range_elements_{ nullptr };
+        PFNGLDRAWELEMENTSBASEVERTEXPROC draw_elements_base_vertex_{ nullptr };
+        PFNGLDRAWARRAYSINSTANCEDPROC draw_arrays_instanced_{ nullptr };
+        PFNGLDRAWELEMENTSINSTANCEDPROC draw_elements_instanced_{ nullptr };
+        PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC draw_elements_instanced_base_vertex_{ nullptr };
+        PFNGLMULTIDRAWARRAYSPROC multi_draw_arrays_{ nullptr };
+        PFNGLMULTIDRAWELEMENTSPROC multi_draw_elements_{ nullptr };
+        PFNGLMULTIDRAWELEMENTSINDIRECTPROC multi_draw_elements_indirect_{ nullptr };
+        PFNGLUSEPROGRAMPROC use_program_{ nullptr };
+        PFNGLBINDVERTEXARRAYPROC bind_vertex_array_{ nullptr };
+        PFNGLBINDFRAMEBUFFERPROC bind_framebuffer_{ nullptr };
+        PFNGLACTIVETEXTUREPROC active_texture_{ nullptr };
+        PFNGLBINDTEXTUREPROC bind_texture_{ nullptr };
+        PFNGLBINDTEXTUREUNITPROC bind_texture_unit_{ nullptr };
+        PFNGLBUFFERDATAPROC buffer_data_{ nullptr };
+        PFNGLBUFFERSUBDATAPROC buffer_sub_data_{ nullptr };
+        PFNGLBUFFERSTORAGEPROC buffer_storage_{ nullptr };
+        PFNGLNAMEDBUFFERDATAPROC named_buffer_data_{ nullptr };
+        PFNGLNAMEDBUFFERSUBDATAPROC named_buffer_sub_data_{ nullptr };
+        PFNGLNAMEDBUFFERSTORAGEPROC named_buffer_storage_{ nullptr };
+        PFNGLMAPBUFFERRANGEPROC map_buffer_range_{ nullptr };
+        PFNGLMAPNAMEDBUFFERRANGEPROC map_named_buffer_range_{ nullptr };
+        PFNGLTEXIMAGE2DPROC tex_image_2d_{ nullptr };
+        PFNGLTEXSUBIMAGE2DPROC tex_sub_image_2d_{ nullptr };
+        PFNGLTEXSUBIMAGE3DPROC tex_sub_image_3d_{ nullptr };
+        PFNGLTEXTURESUBIMAGE2DPROC texture_sub_image_2d_{ nullptr };
+        PFNGLTEXTURESUBIMAGE3DPROC texture_sub_image_3d_{ nullptr };
+        PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC compressed_tex_sub_image_2d_{ nullptr };
+        PFNGLCOMPRESSEDTEXTURESUBIMAGE2DPROC compressed_texture_sub_image_2d_{ nullptr };
+    };
+
+    entry_points real{ };
+
+    void GLAD_API_PTR counted_draw_arrays(GLenum mode, GLint first, GLsizei count)
+    {
+        add(live.draw_calls_);
+        add(live.instances_);
+        real.draw_arrays_(mode, first, count);
+    }
+
+    void GLAD_API_PTR counted_draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        add(live.draw_calls_);
+        add(live.instances_);
+        real.draw_elements_(mode, count, type, indices);
+    }
+
+    void GLAD_API_PTR counted_draw_range_elements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices)
+    {
+        add(live.draw_calls_);
+        add(live.instances_);
+        real.draw_range_elements_(mode, start, end, count, type, indices);
+    }
+
+    void GLAD_API_PTR counted_draw_elements_base_vertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint base_vertex)
+    {
+        add(live.draw_calls_);
+        add(live.instances_);
+        real.draw_elements_base_vertex_(mode, count, type, indices, base_vertex);
+    }
+
+    void GLAD_API_PTR counted_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count)
+    {
+        add(live.draw_calls_);
+        add(live.instances_, static_cast<uint64_t>(instance_count));
+        real.draw_arrays_instanced_(mode, first, count, instance_count);
+    }
+
+    void GLAD_API_PTR counted_draw_elements_instanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instance_count)
+    {
+        add(live.draw_calls_);
+        add(live.instances_, static_cast<uint64_t>(instance_count));
+        real.draw_elements_instanced_(mode, count, type, indices, instance_count);
+    }
+
+    void GLAD_API_PTR counted_draw_elements_instanced_base_vertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instance_count, GLint base_vertex)
+    {
+        add(live.draw_calls_);
+        add(live.instances_, static_cast<uint64_t>(instance_count));
+        real.draw_elements_instanced_base_vertex_(mode, count, type, indices, instance_count, base_vertex);
+    }
+
+    void GLAD_API_PTR counted_multi_draw_arrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei draw_count)
+    {
+        add(live.draw_calls_, static_cast<uint64_t>(draw_count));
+        add(live.instances_, static_cast<uint64_t>(draw_count));
+        real.multi_draw_arrays_(mode, first, count, draw_count);
+    }
+
+    void GLAD_API_PTR counted_multi_draw_elements(GLenum mode, const GLsizei* count, GLenum type, const void* const* indices, GLsizei draw_count)
+    {
+        add(live.draw_calls_, static_cast<uint64_t>(draw_count));
+        add(live.instances_, static_cast<uint64_t>(draw_count));
+        real.multi_draw_elements_(mode, count, type, indices, draw_count);
+    }
+
+    void GLAD_API_PTR counted_multi_draw_elements_indirect(GLenum mode, GLenum type, const void* indirect, GLsizei draw_count, GLsizei stride)
+    {
+        // Instance counts live in the indirect buffer, out of reach of the CPU.
+        add(live.draw_calls_, static_cast<uint64_t>(draw_count));
+        real.multi_draw_elements_indirect_(mode, type, indirect, draw_count, stride);
+    }
+
+    void GLAD_API_PTR counted_use_program(GLuint program)
+    {
+        bind_state& bound = current_binds();
+        track(live.program_binds_, bound.program_, program);
+        real.use_program_(program);
+    }
+
+    void GLAD_API_PTR counted_bind_vertex_array(GLuint vao)
+    {
+        bind_state& bound = current_binds();
+        track(live.vao_binds_, bound.vao_, vao);
+        real.bind_vertex_array_(vao);
+    }
+
+    void GLAD_API_PTR counted_bind_framebuffer(GLenum target, GLuint fbo)
+    {
+        bind_state& bound = current_binds();
+        if(target == GL_READ_FRAMEBUFFER) {
+            track(live.fbo_binds_, bound.read_fbo_, fbo);
+        } else if(target == GL_DRAW_FRAMEBUFFER) {
+            track(live.fbo_binds_, bound.draw_fbo_, fbo);
+        } else {
+            const bool redundant = bound.read_fbo_ == fbo && bound.draw_fbo_ == fbo;
+            add(live.fbo_binds_);
+            if(redundant) {
+                add(live.redundant_binds_);
+            }
+            bound.read_fbo_ = fbo;
+            bound.draw_fbo_ = fbo;
+        }
+        real.bind_framebuffer_(target, fbo);
+    }
+
+    void GLAD_API_PTR counted_active_texture(GLenum unit)
+    {
+        bind_state& bound = current_binds();
+        bound.active_unit_ = unit - GL_TEXTURE0;
+        real.active_texture_(unit);
+    }
+
+    void GLAD_API_PTR counted_bind_texture(GLenum target, GLuint texture)
+    {
+        bind_state& bound = current_binds();
+        if(bound.active_unit_ < tracked_units) {
+            track(live.texture_binds_, bound.textures_[bound.active_unit_], texture);
+        } else {
+            add(live.texture_binds_);
+        }
+        real.bind_texture_(target, texture);
+    }
+
+    void GLAD_API_PTR counted_bind_texture_unit(GLuint unit, GLuint texture)
+    {
+        bind_state& bound = current_binds();
+        if(unit < tracked_units) {
+            track(live.texture_binds_, bound.textures_[unit], texture);
+        } else {
+            add(live.texture_binds_);
+        }
+        real.bind_texture_unit_(unit, texture);
+    }
+
+    void GLAD_API_PTR counted_buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        if(data != nullptr) {
+            upload(static_cast<uint64_t>(size));
+        }
+        real.buffer_data_(target, size, data, usage);
+    }
+
+    void GLAD_API_PTR counted_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        upload(static_cast<uint64_t>(size));
+        real.buffer_sub_data_(target, offset, size, data);
+    }
+
+    void GLAD_API_PTR counted_buffer_storage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)
+    {
+        if(data != nullptr) {
+            upload(static_cast<uint64_t>(size));
+        }
+        real.buffer_storage_(target, size, data, flags);
+    }
+
+    void GLAD_API_PTR counted_named_buffer_data(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        if(data != nullptr) {
+            upload(static_cast<uint64_t>(size));
+        }
+        real.named_buffer_data_(buffer, size, data, usage);
+    }
+
+    void GLAD_API_PTR counted_named_buffer_sub_data(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        upload(static_cast<uint64_t>(size));
+        real.named_buffer_sub_data_(buffer, offset, size, data);
+    }
+
+    void GLAD_API_PTR counted_named_buffer_storage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags)
+    {
+        if(data != nullptr) {
+            upload(static_cast<uint64_t>(size));
+        }
+        real.named_buffer_storage_(buffer, size, data, flags);
+    }
+
+    void* GLAD_API_PTR counted_map_buffer_range(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        if(access & GL_MAP_WRITE_BIT) {
+            upload(static_cast<uint64_t>(length));
+        }
+        return real.map_buffer_range_(target, offset, length, access);
+    }
+
+    void* GLAD_API_PTR counted_map_named_buffer_range(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        if(access & GL_MAP_WRITE_BIT) {
+            upload(static_cast<uint64_t>(length));
+        }
+        return real.map_named_buffer_range_(buffer, offset, length, access);
+    }
+
+    void GLAD_API_PTR counted_tex_image_2d(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        if(pixels != nullptr) {
+            upload(pixel_bytes(format, type, width, height, 1));
+        }
+        real.tex_image_2d_(target, level, internal_format, width, height, border, format, type, pixels);
+    }
+
+    void GLAD_API_PTR counted_tex_sub_image_2d(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+    {
+        upload(pixel_bytes(format, type, width, height, 1));
+        real.tex_sub_image_2d_(target, level, x, y, width, height, format, type, pixels);
+    }
+
+    void GLAD_API_PTR counted_tex_sub_image_3d(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        upload(pixel_bytes(format, type, width, height, depth));
+        real.tex_sub_image_3d_(target, level, x, y, z, width, height, depth, format, type, pixels);
+    }
+
+    void GLAD_API_PTR counted_texture_sub_image_2d(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+    {
+        upload(pixel_bytes(format, type, width, height, 1));
+        real.texture_sub_image_2d_(texture, level, x, y, width, height, format, type, pixels);
+    }
+
+    void GLAD_API_PTR counted_texture_sub_image_3d(GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        upload(pixel_bytes(format, type, width, height, depth));
+        real.texture_sub_image_3d_(texture, level, x, y, z, width, height, depth, format, type, pixels);
+    }
+
+    void GLAD_API_PTR counted_compressed_tex_sub_image_2d(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLsizei image_size, const void* data)
+    {
+        upload(static_cast<uint64_t>(image_size));
+        real.compressed_tex_sub_image_2d_(target, level, x, y, width, height, format, image_size, data);
+    }
+
+    void GLAD_API_PTR counted_compressed_texture_sub_image_2d(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLsizei image_size, const void* data)
+    {
+        upload(static_cast<uint64_t>(image_size));
+        real.compressed_texture_sub_image_2d_(texture, level, x, y, width, height, format, image_size, data);
+    }
+
+    /// @brief Swaps a glad entry point for its wrapper, entry points the driver lacks are left alone.
+    template<typename T>
+    void hook(T& slot, T& original, T wrapper)
+    {
+        if(slot != nullptr && slot != wrapper) {
+            original = slot;
+            slot = wrapper;
+        }
+    }
+
+    void hook_all()
+    {
+        hook(glad_glDrawArrays, real.draw_arrays_, &counted_draw_arrays);
+        hook(glad_glDrawElements, real.draw_elements_, &counted_draw_elements);
+        hook(glad_glDrawRangeElements, real.draw_range_elements_, &counted_draw_range_elements);
+        hook(glad_glDrawElementsBaseVertex, real.draw_elements_base_vertex_, &counted_draw_elements_base_vertex);
+        hook(glad_glDrawArraysInstanced, real.draw_arrays_instanced_, &counted_draw_arrays_instanced);
+        hook(glad_glDrawElementsInstanced, real.draw_elements_instanced_, &counted_draw_elements_instanced);
+        hook(glad_glDrawElementsInstancedBaseVertex, real.draw_elements_instanced_base_vertex_, &counted_draw_elements_instanced_base_vertex);
+        hook(glad_glMultiDrawArrays, real.multi_draw_arrays_, &counted_multi_draw_arrays);
+        hook(glad_glMultiDrawElements, real.multi_draw_elements_, &counted_multi_draw_elements);
+        hook(glad_glMultiDrawElementsIndirect, real.multi_draw_elements_indirect_, &counted_multi_draw_elements_indirect);
+        hook(glad_glUseProgram, real.use_program_, &counted_use_program);
+        hook(glad_glBindVertexArray, real.bind_vertex_array_, &counted_bind_vertex_array);
+        hook(glad_glBindFramebuffer, real.bind_framebuffer_, &counted_bind_framebuffer);
+        hook(glad_glActiveTexture, real.active_texture_, &counted_active_texture);
+        hook(glad_glBindTexture, real.bind_texture_, &counted_bind_texture);
+        hook(glad_glBindTextureUnit, real.bind_texture_unit_, &counted_bind_texture_unit);
+        hook(glad_glBufferData, real.buffer_data_, &counted_buffer_data);
+        hook(glad_glBufferSubData, real.buffer_sub_data_, &counted_buffer_sub_data);
+        hook(glad_glBufferStorage, real.buffer_storage_, &counted_buffer_storage);
+        hook(glad_glNamedBufferData, real.named_buffer_data_, &counted_named_buffer_data);
+        hook(glad_glNamedBufferSubData, real.named_buffer_sub_data_, &counted_named_buffer_sub_data);
+        hook(glad_glNamedBufferStorage, real.named_buffer_storage_, &counted_named_buffer_storage);
+        hook(glad_glMapBufferRange, real.map_buffer_range_, &counted_map_buffer_range);
+        hook(glad_glMapNamedBufferRange, real.map_named_buffer_range_, &counted_map_named_buffer_range);
+        hook(glad_glTexImage2D, real.tex_image_2d_, &counted_tex_image_2d);
+        hook(glad_glTexSubImage2D, real.tex_sub_image_2d_, &counted_tex_sub_image_2d);
+        hook(glad_glTexSubImage3D, real.tex_sub_image_3d_, &counted_tex_sub_image_3d);
+        hook(glad_glTextureSubImage2D, real.texture_sub_image_2d_, &counted_texture_sub_image_2d);
+        hook(glad_glTextureSubImage3D, real.texture_sub_image_3d_, &counted_texture_sub_image_3d);
+        hook(glad_glCompressedTexSubImage2D, real.compressed_tex_sub_image_2d_, &counted_compressed_tex_sub_image_2d);
+        hook(glad_glCompressedTextureSubImage2D, real.compressed_texture_sub_image_2d_, &counted_compressed_texture_sub_image_2d);
+    }
+}
+
+void install()
+{
+    if(installed) {
+        return;
+    }
+    hook_all();
+    installed = true;
+}
+
+void set_enabled(bool enabled)
+{
+    if(enabled == is_enabled) {
+        return;
+    }
+    if(enabled && !installed) {
+        spdlog::warn("GL stats can't be enabled, the counting wrappers weren't installed at startup.");
+        return;
+    }
+    is_enabled = enabled;
+    // Don't let the frame that was in progress straddle the change.
+    frame_start = totals();
+    passes.clear();
+}
+
+gl_counters totals()
+{
+    gl_counters c;
+    c.draw_calls_ = live.draw_calls_.load(std::memory_order_relaxed);
+    c.instances_ = live.instances_.load(std::memory_order_relaxed);
+    c.program_binds_ = live.program_binds_.load(std::memory_order_relaxed);
+    c.vao_binds_ = live.vao_binds_.load(std::memory_order_relaxed);
+    c.fbo_binds_ = live.fbo_binds_.load(std::memory_order_relaxed);
+    c.texture_binds_ = live.texture_binds_.load(std::memory_order_relaxed);
+    c.redundant_binds_ = live.redundant_binds_.load(std::memory_order_relaxed);
+    c.uploads_ = live.uploads_.load(std::memory_order_relaxed);
+    c.upload_bytes_ = live.upload_bytes_.load(std::memory_order_relaxed);
+    return c;
+}
+
+#else
+
+void install()
+{
+}
+
+void set_enabled(bool enabled)
+{
+    if(enabled) {
+        spdlog::warn("GL instrumentation was not compiled in, build with TR_GL_INSTRUMENTATION on.");
+    }
+}
+
+gl_counters totals()
+{
+    return gl_counters{ };
+}
+
+#endif
+
+bool enabled()
+{
+    return is_enabled;
+}
+
+void end_frame()
+{
+    if(!is_enabled) {
+        return;
+    }
+    const gl_counters now = totals();
+    {
+        std::lock_guard lock(previous_mutex);
+        previous.total_ = now - frame_start;
+        previous.passes_.swap(passes);
+    }
+    passes.clear();
+    frame_start = now;
+}
+
+gl_frame_counters last_frame()
+{
+    std::lock_guard lock(previous_mutex);
+    return previous;
+}
+
+pass_scope::pass_scope(const char* name)
+    : name_(name)
+{
+    if(is_enabled) {
+        active_ = true;
+        start_ = totals();
+    }
+}
+
+pass_scope::~pass_scope()
+{
+    if(active_ && is_enabled) {
+        passes.emplace_back(gl_pass_counters{ name_, totals() - start_ });
+    }
+}
+
+}
+
+}
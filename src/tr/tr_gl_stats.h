@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+// Counts GL calls, state changes and uploads per frame and per pass.
+//
+// The glad function pointers for draws, binds and uploads are replaced once at
+// startup with counting wrappers that forward to the driver. Swapping them later
+// would race the threads making GL calls, so enabling and disabling the layer
+// only flips a flag the wrappers check, a disabled layer costs that check.
+// With TR_GL_INSTRUMENTATION defined to 0 the wrappers aren't compiled at all
+// and TR_GL_PASS compiles to nothing.
+//
+// Only calls made through glad are seen, the ImGui backend loads its own
+// function pointers and so isn't counted.
+
+#ifndef TR_GL_INSTRUMENTATION
+#define TR_GL_INSTRUMENTATION 1
+#endif
+
+namespace tr {
+
+struct gl_counters
+{
+    uint64_t draw_calls_{ 0 };
+    /// @brief Instances drawn, 1 per non-instanced draw.
+    uint64_t instances_{ 0 };
+    uint64_t program_binds_{ 0 };
+    uint64_t vao_binds_{ 0 };
+    uint64_t fbo_binds_{ 0 };
+    uint64_t texture_binds_{ 0 };
+    /// @brief Binds of the object that was already bound.
+    uint64_t redundant_binds_{ 0 };
+    /// @brief Buffer and texture uploads, including buffers mapped for writing.
+    uint64_t uploads_{ 0 };
+    uint64_t upload_bytes_{ 0 };
+
+    gl_counters& operator+=(const gl_counters& rhs);
+    gl_counters& operator-=(const gl_counters& rhs);
+};
+
+gl_counters operator-(gl_counters lhs, const gl_counters& rhs);
+nlohmann::json to_json(const gl_counters& c);
+
+struct gl_pass_counters
+{
+    std::string name_;
+    gl_counters counters_;
+};
+
+struct gl_frame_counters
+{
+    gl_counters total_;
+    /// @brief Passes in the order they ended, nested passes include their children.
+    std::vector<gl_pass_counters> passes_;
+};
+
+nlohmann::json to_json(const gl_frame_counters& f);
+
+namespace gl_stats {
+
+/// @brief If the layer was compiled in.
+constexpr bool available() { return TR_GL_INSTRUMENTATION != 0; }
+/// @brief Installs the counting wrappers. Call once after the GL functions are loaded, on the
+/// thread that renders and before any other thread makes GL calls.
+void install();
+/// @brief Starts or stops counting, needs the wrappers installed.
+void set_enabled(bool enabled);
+bool enabled();
+/// @brief Counters accumulated since the layer was first enabled.
+gl_counters totals();
+/// @brief Closes the frame's counters, call once per frame after the swap.
+void end_frame();
+/// @brief Counters of the previous complete frame, safe to call from any thread.
+gl_frame_counters last_frame();
+
+// Attributes the calls made during its lifetime to a named pass.
+class pass_scope
+{
+public:
+    explicit pass_scope(const char* name);
+    ~pass_scope();
+private:
+    const char* name_;
+    gl_counters start_;
+    bool active_{ false };
+
+    pass_scope(const pass_scope&) = delete;
+    pass_scope& operator=(const pass_scope&) = delete;
+};
+
+}
+
+}
+
+#define TR_GL_CONCAT_INNER(a, b) a##b
+#define TR_GL_CONCAT(a, b) TR_GL_CONCAT_INNER(a, b)
+
+#if TR_GL_INSTRUMENTATION
+#define TR_GL_PASS(name) ::tr::gl_stats::pass_scope TR_GL_CONCAT(tr_gl_pass_, __LINE__){ name }
+#else
+#define TR_GL_PASS(name)
+#endif
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <bit>
+#include <utility>
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+
+#include "tr_gl_texture.h"
+
+namespace tr {
+
+namespace {
+    struct gl_format
+    {
+        GLenum internal_;
+        GLenum format_;
+        GLenum type_;
+    };
+
+    gl_format to_gl(texture_format format)
+    {
+        switch(format) {
+            case texture_format::r8:            return { GL_R8, GL_RED, GL_UNSIGNED_BYTE };
+            case texture_format::rg8:           return { GL_RG8, GL_RG, GL_UNSIGNED_BYTE };
+            case texture_format::rgba8:         return { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE };
+            case texture_format::srgb8_alpha8:  return { GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE };
+            case texture_format::rgba16f:       return { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT };
+            case texture_format::bc1:           return { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_RGB, GL_UNSIGNED_BYTE };
+            case texture_format::bc1_srgb:      return { GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, GL_RGB, GL_UNSIGNED_BYTE };
+            case texture_format::bc3:           return { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, GL_UNSIGNED_BYTE };
+            case texture_format::bc3_srgb:      return { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, GL_RGBA, GL_UNSIGNED_BYTE };
+            case texture_format::bc4:           return { GL_COMPRESSED_RED_RGTC1, GL_RED, GL_UNSIGNED_BYTE };
+            case texture_format::bc5:           return { GL_COMPRESSED_RG_RGTC2, GL_RG, GL_UNSIGNED_BYTE };
+        }
+        spdlog::critical("Unknown texture format {}", static_cast<unsigned>(format));
+        std::exit(1);
+    }
+}
+
+const char* to_string(texture_format format)
+{
+    switch(format) {
+        case texture_format::r8:            return "r8";
+        case texture_format::rg8:           return "rg8";
+        case texture_format::rgba8:         return "rgba8";
+        case texture_format::srgb8_alpha8:  return "srgb8_alpha8";
+        case texture_format::rgba16f:       return "rgba16f";
+        case texture_format::bc1:           return "bc1";
+        case texture_format::bc1_srgb:      return "bc1_srgb";
+        case texture_format::bc3:           return "bc3";
+        case texture_format::bc3_srgb:      return "bc3_srgb";
+        case texture_format::bc4:           return "bc4";
+        case texture_format::bc5:           return "bc5";
+    }
+    return "unknown";
+}
+
+bool parse_texture_format(std::string_view name, texture_format& format)
+{
+    for(unsigned n = 0; n <= static_cast<unsigned>(texture_format::bc5); ++n) {
+        if(name == to_string(static_cast<texture_format>(n))) {
+            format = static_cast<texture_format>(n);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool is_compressed(texture_format format)
+{
+    return format >= texture_format::bc1;
+}
+
+bool is_supported(texture_format format)
+{
+    switch(format) {
+        case texture_format::bc1:
+        case texture_format::bc3:
+            return GLAD_GL_EXT_texture_compression_s3tc != 0;
+        case texture_format::bc1_srgb:
+        case texture_format::bc3_srgb:
+            return GLAD_GL_EXT_texture_compression_s3tc != 0 && GLAD_GL_EXT_texture_sRGB != 0;
+        default:
+            // The rest are core in GL 3.3.
+            return true;
+    }
+}
+
+size_t bytes_per_pixel(texture_format format)
+{
+    switch(format) {
+        case texture_format::r8:            return 1;
+        case texture_format::rg8:           return 2;
+        case texture_format::rgba8:         return 4;
+        case texture_format::srgb8_alpha8:  return 4;
+        case texture_format::rgba16f:       return 8;
+        default:
+            break;
+    }
+    spdlog::critical("Texture format {} has no bytes per pixel.", to_string(format));
+    std::exit(1);
+}
+
+size_t bytes_per_block(texture_format format)
+{
+    switch(format) {
+        case texture_format::bc1:
+        case texture_format::bc1_srgb:
+        case texture_format::bc4:
+            return 8;
+        case texture_format::bc3:
+        case texture_format::bc3_srgb:
+        case texture_format::bc5:
+            return 16;
+        default:
+            break;
+    }
+    spdlog::critical("Texture format {} isn't block compressed.", to_string(format));
+    std::exit(1);
+}
+
+size_t level_bytes(texture_format format, size_t width, size_t height)
+{
+    if(is_compressed(format)) {
+        return ((width + 3) / 4) * ((height + 3) / 4) * bytes_per_block(format);
+    }
+    return width * height * bytes_per_pixel(format);
+}
+
+size_t mip_count(size_t width, size_t height)
+{
+    return static_cast<size_t>(std::bit_width(std::max<size_t>({ width, height, 1 })));
+}
+
+gl_texture::gl_texture(const texture_desc& desc)
+    : desc_(desc)
+{
+    if(desc_.width_ == 0 || desc_.height_ == 0) {
+        spdlog::critical("Texture of {}x{} has no texels.", desc_.width_, desc_.height_);
+        std::exit(1);
+    }
+    const size_t full_chain = mip_count(desc_.width_, desc_.height_);
+    desc_.levels_ = desc_.levels_ == 0 ? full_chain : std::min(desc_.levels_, full_chain);
+    target_ = desc_.layers_ == 0 ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+
+    const gl_format fmt = to_gl(desc_.format_);
+    const GLsizei w = static_cast<GLsizei>(desc_.width_);
+    const GLsizei h = static_cast<GLsizei>(desc_.height_);
+    const GLsizei levels = static_cast<GLsizei>(desc_.levels_);
+    const GLsizei layer_count = static_cast<GLsizei>(layers());
+    if(GLAD_GL_ARB_direct_state_access) {
+        glCreateTextures(target_, 1, &tex_);
+        if(target_ == GL_TEXTURE_2D) {
+            glTextureStorage2D(tex_, levels, fmt.internal_, w, h);
+        } else {
+            glTextureStorage3D(tex_, levels, fmt.internal_, w, h, layer_count);
+        }
+    } else {
+        glGenTextures(1, &tex_);
+        glBindTexture(target_, tex_);
+        if(GLAD_GL_ARB_texture_storage) {
+            if(target_ == GL_TEXTURE_2D) {
+                glTexStorage2D(target_, levels, fmt.internal_, w, h);
+            } else {
+                glTexStorage3D(target_, levels, fmt.internal_, w, h, layer_count);
+            }
+        } else {
+            // Mutable storage, each level is allocated separately and the chain is capped to match.
+            for(size_t level = 0; level < desc_.levels_; ++level) {
+                const GLint l = static_cast<GLint>(level);
+                const GLsizei lw = static_cast<GLsizei>(level_width(level));
+                const GLsizei lh = static_cast<GLsizei>(level_height(level));
+                if(is_compressed(desc_.format_)) {
+                    const GLsizei length = static_cast<GLsizei>(level_bytes(desc_.format_, level_width(level), level_height(level)) * layers());
+                    if(target_ == GL_TEXTURE_2D) {
+                        glCompressedTexImage2D(target_, l, fmt.internal_, lw, lh, 0, length, nullptr);
+                    } else {
+                        glCompressedTexImage3D(target_, l, fmt.internal_, lw, lh, layer_count, 0, length, nullptr);
+                    }
+                } else if(target_ == GL_TEXTURE_2D) {
+                    glTexImage2D(target_, l, fmt.internal_, lw, lh, 0, fmt.format_, fmt.type_, nullptr);
+                } else {
+                    glTexImage3D(target_, l, fmt.internal_, lw, lh, layer_count, 0, fmt.format_, fmt.type_, nullptr);
+                }
+            }
+            glTexParameteri(target_, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        }
+    }
+
+    const GLint mag = desc_.linear_ ? GL_LINEAR : GL_NEAREST;
+    GLint min = mag;
+    if(desc_.levels_ > 1) {
+        min = desc_.linear_ ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_NEAREST;
+    }
+    const GLint wrap = desc_.repeat_ ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    if(GLAD_GL_ARB_direct_state_access) {
+        glTextureParameteri(tex_, GL_TEXTURE_MAG_FILTER, mag);
+        glTextureParameteri(tex_, GL_TEXTURE_MIN_FILTER, min);
+        glTextureParameteri(tex_, GL_TEXTURE_WRAP_S, wrap);
+        glTextureParameteri(tex_, GL_TEXTURE_WRAP_T, wrap);
+    } else {
+        glTexParameteri(target_, GL_TEXTURE_MAG_FILTER, mag);
+        glTexParameteri(target_, GL_TEXTURE_MIN_FILTER, min);
+        glTexParameteri(target_, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(target_, GL_TEXTURE_WRAP_T, wrap);
+        glBindTexture(target_, 0);
+    }
+
+    size_t bytes = 0;
+    for(size_t level = 0; level < desc_.levels_; ++level) {
+        bytes += level_bytes(desc_.format_, level_width(level), level_height(level)) * layers();
+    }
+    memory_.set(bytes);
+}
+
+gl_texture::~gl_texture()
+{
+    destroy();
+}
+
+gl_texture::gl_texture(gl_texture&& rhs) noexcept
+    : desc_(rhs.desc_)
+    , tex_(std::exchange(rhs.tex_, 0))
+    , target_(rhs.target_)
+    , memory_(std::move(rhs.memory_))
+{
+}
+
+gl_texture& gl_texture::operator=(gl_texture&& rhs) noexcept
+{
+    if(this != &rhs) {
+        destroy();
+        desc_ = rhs.desc_;
+        tex_ = std::exchange(rhs.tex_, 0);
+        target_ = rhs.target_;
+        memory_ = std::move(rhs.memory_);
+    }
+    return *this;
+}
+
+void gl_texture::destroy()
+{
+    if(tex_ != 0) {
+        glDeleteTextures(1, &tex_);
+        tex_ = 0;
+    }
+    memory_.set(0);
+}
+
+size_t gl_texture::level_width(size_t level) const
+{
+    return std::max<size_t>(desc_.width_ >> level, 1);
+}
+
+size_t gl_texture::level_height(size_t level) const
+{
+    return std::max<size_t>(desc_.height_ >> level, 1);
+}
+
+void gl_texture::bind(unsigned unit) const
+{
+    if(GLAD_GL_ARB_direct_state_access) {
+        glBindTextureUnit(unit, tex_);
+    } else {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target_, tex_);
+    }
+}
+
+void gl_texture::upload(size_t level, size_t layer, size_t x, size_t y, size_t width, size_t height, const void* pixels)
+{
+    if(is_compressed(desc_.format_)) {
+        spdlog::critical("Texel upload to a {} texture, compressed textures take blocks.", to_string(desc_.format_));
+        std::exit(1);
+    }
+    if(level >= desc_.levels_ || layer >= layers() || x + width > level_width(level) || y + height > level_height(level)) {
+        spdlog::critical("Texture upload of {}x{} at {},{} layer {} is outside level {} of {}x{}.",
+            width, height, x, y, layer, level, level_width(level), level_height(level));
+        std::exit(1);
+    }
+    const gl_format fmt = to_gl(desc_.format_);
+    const GLint l = static_cast<GLint>(level);
+    const GLint ox = static_cast<GLint>(x);
+    const GLint oy = static_cast<GLint>(y);
+    const GLsizei w = static_cast<GLsizei>(width);
+    const GLsizei h = static_cast<GLsizei>(height);
+    // Rows are tightly packed, the caller's alignment is put back afterwards.
+    GLint alignment = 4;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if(GLAD_GL_ARB_direct_state_access) {
+        if(target_ == GL_TEXTURE_2D) {
+            glTextureSubImage2D(tex_, l, ox, oy, w, h, fmt.format_, fmt.type_, pixels);
+        } else {
+            glTextureSubImage3D(tex_, l, ox, oy, static_cast<GLint>(layer), w, h, 1, fmt.format_, fmt.type_, pixels);
+        }
+    } else {
+        glBindTexture(target_, tex_);
+        if(target_ == GL_TEXTURE_2D) {
+            glTexSubImage2D(target_, l, ox, oy, w, h, fmt.format_, fmt.type_, pixels);
+        } else {
+            glTexSubImage3D(target_, l, ox, oy, static_cast<GLint>(layer), w, h, 1, fmt.format_, fmt.type_, pixels);
+        }
+        glBindTexture(target_, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+void gl_texture::upload_compressed(size_t level, size_t layer, const void* blocks, size_t length)
+{
+    const size_t expected = level < desc_.levels_ && is_compressed(desc_.format_) ? level_bytes(desc_.format_, level_width(level), level_height(level)) : 0;
+    if(layer >= layers() || length != expected) {
+        spdlog::critical("Compressed upload of {} bytes to level {} layer {} of a {} texture, expected {}.",
+            length, level, layer, to_string(desc_.format_), expected);
+        std::exit(1);
+    }
+    const GLenum internal = to_gl(desc_.format_).internal_;
+    const GLint l = static_cast<GLint>(level);
+    const GLsizei w = static_cast<GLsizei>(level_width(level));
+    const GLsizei h = static_cast<GLsizei>(level_height(level));
+    const GLsizei size = static_cast<GLsizei>(length);
+    if(GLAD_GL_ARB_direct_state_access) {
+        if(target_ == GL_TEXTURE_2D) {
+            glCompressedTextureSubImage2D(tex_, l, 0, 0, w, h, internal, size, blocks);
+        } else {
+            glCompressedTextureSubImage3D(tex_, l, 0, 0, static_cast<GLint>(layer), w, h, 1, internal, size, blocks);
+        }
+    } else {
+        glBindTexture(target_, tex_);
+        if(target_ == GL_TEXTURE_2D) {
+            glCompressedTexSubImage2D(target_, l, 0, 0, w, h, internal, size, blocks);
+        } else {
+            glCompressedTexSubImage3D(target_, l, 0, 0, static_cast<GLint>(layer), w, h, 1, internal, size, blocks);
+        }
+        glBindTexture(target_, 0);
+    }
+}
+
+void gl_texture::generate_mipmaps()
+{
+    if(desc_.levels_ <= 1) {
+        return;
+    }
+    if(GLAD_GL_ARB_direct_state_access) {
+        glGenerateTextureMipmap(tex_);
+    } else {
+        glBindTexture(target_, tex_);
+        glGenerateMipmap(target_);
+        glBindTexture(target_, 0);
+    }
+}
+
+void gl_texture::set_base_level(size_t level)
+{
+    const GLint base = static_cast<GLint>(std::min(level, desc_.levels_ - 1));
+    if(GLAD_GL_ARB_direct_state_access) {
+        glTextureParameteri(tex_, GL_TEXTURE_BASE_LEVEL, base);
+    } else {
+        glBindTexture(target_, tex_);
+        glTexParameteri(target_, GL_TEXTURE_BASE_LEVEL, base);
+        glBindTexture(target_, 0);
+    }
+}
+
+bool gl_texture::copy_level(size_t level, const gl_texture& src, size_t src_level)
+{
+    if(!GLAD_GL_ARB_copy_image) {
+        return false;
+    }
+    glCopyImageSubData(src.tex_, src.target_, static_cast<GLint>(src_level), 0, 0, 0,
+        tex_, target_, static_cast<GLint>(level), 0, 0, 0,
+        static_cast<GLsizei>(level_width(level)), static_cast<GLsizei>(level_height(level)), static_cast<GLsizei>(layers()));
+    return true;
+}
+
+}
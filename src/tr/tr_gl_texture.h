@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+enum class texture_format : uint8_t
+{
+    r8,
+    rg8,
+    rgba8,
+    srgb8_alpha8,
+    rgba16f,
+    // Block compressed, 4x4 texels per block. The values are stored in baked
+    // texture files, so new formats go at the end.
+    bc1,
+    bc1_srgb,
+    bc3,
+    bc3_srgb,
+    bc4,
+    bc5,
+};
+
+const char* to_string(texture_format format);
+/// @return false if \c name isn't a format.
+bool parse_texture_format(std::string_view name, texture_format& format);
+bool is_compressed(texture_format format);
+/// @brief If the driver can sample the format, the S3TC formats are an extension.
+bool is_supported(texture_format format);
+/// @brief Bytes one texel takes in client memory, uncompressed formats only.
+size_t bytes_per_pixel(texture_format format);
+/// @brief Bytes of a 4x4 block, compressed formats only.
+size_t bytes_per_block(texture_format format);
+/// @brief Bytes of one level of one layer.
+size_t level_bytes(texture_format format, size_t width, size_t height);
+/// @brief Levels in a full mip chain down to 1x1.
+size_t mip_count(size_t width, size_t height);
+
+struct texture_desc
+{
+    size_t width_{ 0 };
+    size_t height_{ 0 };
+    /// @brief 0 for a 2D texture, otherwise the number of layers of a 2D array.
+    size_t layers_{ 0 };
+    /// @brief Mip levels, 0 for a full chain.
+    size_t levels_{ 1 };
+    texture_format format_{ texture_format::rgba8 };
+    /// @brief Linear filtering, nearest otherwise.
+    bool linear_{ true };
+    /// @brief Repeat outside [0, 1], clamp to the edge otherwise.
+    bool repeat_{ false };
+};
+
+// A texture for the GL pipeline, a 2D texture or a 2D array with a mip chain.
+// Storage is allocated once, immutable where GL_ARB_texture_storage is
+// available, and filled with upload(). The name can be bound for a shader's
+// sampler or cast to an ImTextureID for ImGui::Image().
+class gl_texture
+{
+public:
+    explicit gl_texture(const texture_desc& desc);
+    ~gl_texture();
+    unsigned texture_id() const { return tex_; }
+    /// @brief GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY.
+    unsigned target() const { return target_; }
+    const texture_desc& desc() const { return desc_; }
+    size_t width() const { return desc_.width_; }
+    size_t height() const { return desc_.height_; }
+    /// @brief Layers of an array, 1 for a 2D texture.
+    size_t layers() const { return desc_.layers_ == 0 ? 1 : desc_.layers_; }
+    size_t levels() const { return desc_.levels_; }
+    size_t level_width(size_t level) const;
+    size_t level_height(size_t level) const;
+    /// @brief GPU memory of every level and layer.
+    size_t size_bytes() const { return memory_.bytes(); }
+
+    /// @brief Binds to a texture unit, for the sampler uniform set to the same unit.
+    void bind(unsigned unit) const;
+    /// @brief Replaces a region of one level of one layer, rows tightly packed.
+    /// @note With a pixel unpack buffer bound \c pixels is an offset into it.
+    void upload(size_t level, size_t layer, size_t x, size_t y, size_t width, size_t height, const void* pixels);
+    /// @brief Replaces a whole level of one layer of a compressed texture with blocks as stored.
+    void upload_compressed(size_t level, size_t layer, const void* blocks, size_t length);
+    /// @brief Fills the levels below the first from it.
+    void generate_mipmaps();
+    /// @brief Restricts sampling to \c level and smaller, for levels not filled yet.
+    void set_base_level(size_t level);
+    /// @brief Copies every layer of a level of \c src, which must be the same size and format, on the GPU.
+    /// @return false without GL_ARB_copy_image.
+    bool copy_level(size_t level, const gl_texture& src, size_t src_level);
+
+    // moveable, but not copyable as the texture is owned.
+    gl_texture(gl_texture&& rhs) noexcept;
+    gl_texture& operator=(gl_texture&& rhs) noexcept;
+private:
+    void destroy();
+
+    texture_desc desc_{ };
+    unsigned tex_{ 0 };
+    unsigned target_{ 0 };
+    gpu_allocation memory_{ memory_tag::texture };
+
+    gl_texture(const gl_texture&) = delete;
+    gl_texture& operator=(const gl_texture&) = delete;
+};
+
+}
@@ -0,0 +1,58 @@
+#include <glad/gl.h>
+#include "tr_gpu_timer.h"
+
+namespace tr {
+
+gpu_timer::gpu_timer()
+{
+    glGenQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+}
+
+gpu_timer::~gpu_timer()
+{
+    glDeleteQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+}
+
+void gpu_timer::begin()
+{
+    // If the ring is full the GPU is running too far behind, skip measuring
+    // this frame rather than overwriting a query that is still in flight.
+    if(pending_[write_]) {
+        active_ = false;
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries_[write_]);
+    active_ = true;
+}
+
+void gpu_timer::end()
+{
+    if(!active_) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    pending_[write_] = true;
+    write_ = (write_ + 1) % query_count;
+    active_ = false;
+}
+
+bool gpu_timer::poll()
+{
+    bool updated = false;
+    while(pending_[read_]) {
+        GLint available = 0;
+        glGetQueryObjectiv(queries_[read_], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) {
+            break;
+        }
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(queries_[read_], GL_QUERY_RESULT, &elapsed_ns);
+        last_ms_ = static_cast<double>(elapsed_ns) / 1000000.0;
+        pending_[read_] = false;
+        read_ = (read_ + 1) % query_count;
+        updated = true;
+    }
+    return updated;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+namespace tr {
+
+// Measures the GPU time spent between begin() and end() using GL_TIME_ELAPSED
+// queries. Queries are kept in a small ring and only read back once the driver
+// reports them as available, so the CPU never waits on the GPU for a result.
+class gpu_timer
+{
+public:
+    /// @brief Number of frames that can be in flight before a measurement is skipped.
+    static constexpr size_t query_count = 4;
+
+    gpu_timer();
+    ~gpu_timer();
+    void begin();
+    void end();
+    /// @brief Collects any results that are ready.
+    /// @return true if \c last_ms() was updated.
+    bool poll();
+    /// @brief Most recently collected GPU time, in milliseconds.
+    double last_ms() const { return last_ms_; }
+private:
+    std::array<unsigned, query_count> queries_{ };
+    std::array<bool, query_count> pending_{ };
+    /// @brief Next query to be issued.
+    size_t write_{ 0 };
+    /// @brief Oldest query still waiting for a result.
+    size_t read_{ 0 };
+    /// @brief If a query was started by \c begin() and has to be ended.
+    bool active_{ false };
+    double last_ms_{ 0.0 };
+
+    gpu_timer(const gpu_timer&) = delete;
+    gpu_timer(gpu_timer&&) = delete;
+    gpu_timer& operator=(const gpu_timer&) = delete;
+    gpu_timer& operator=(gpu_timer&&) = delete;
+};
+
+}
@@ -0,0 +1,112 @@
+#include <cstring>
+#include <SDL3/SDL.h>
+#include <SDL3_image/SDL_image.h>
+#include <spdlog/spdlog.h>
+
+#include "tr_image.h"
+#include "resource.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+bool load_image(std::string_view filename, image& out)
+{
+    TR_PROFILE_ZONE("decode image");
+    const auto file = resource::load_binary(filename, memory_tag::texture);
+    SDL_Surface* decoded = IMG_Load_IO(SDL_IOFromConstMem(file.data(), file.size()), true);
+    if(decoded == nullptr) {
+        spdlog::error("Unable to decode image \"{}\": {}", filename, SDL_GetError());
+        return false;
+    }
+    // RGBA32 is R, G, B, A in memory whatever the byte order, as GL_RGBA expects.
+    SDL_Surface* rgba = SDL_ConvertSurface(decoded, SDL_PIXELFORMAT_RGBA32);
+    SDL_DestroySurface(decoded);
+    if(rgba == nullptr) {
+        spdlog::error("Unable to convert image \"{}\" to RGBA: {}", filename, SDL_GetError());
+        return false;
+    }
+
+    out.path_ = filename;
+    out.width_ = static_cast<size_t>(rgba->w);
+    out.height_ = static_cast<size_t>(rgba->h);
+    const size_t row = out.width_ * 4;
+    out.pixels_.resize(row * out.height_);
+    // The surface's rows may be padded, the image's aren't.
+    for(size_t y = 0; y < out.height_; ++y) {
+        std::memcpy(out.pixels_.data() + y * row, static_cast<const uint8_t*>(rgba->pixels) + y * rgba->pitch, row);
+    }
+    SDL_DestroySurface(rgba);
+    return true;
+}
+
+image_decoder::image_decoder()
+{
+    thread_ = std::thread(&image_decoder::worker, this);
+}
+
+image_decoder::~image_decoder()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void image_decoder::decode(std::string_view filename, ready_fn on_ready)
+{
+    {
+        std::lock_guard lock(mutex_);
+        job& j = queued_.emplace_back();
+        j.image_.path_ = filename;
+        j.on_ready_ = std::move(on_ready);
+    }
+    cv_.notify_one();
+}
+
+size_t image_decoder::poll()
+{
+    std::deque<job> decoded;
+    {
+        std::lock_guard lock(mutex_);
+        decoded.swap(decoded_);
+    }
+    for(auto& j : decoded) {
+        j.on_ready_(std::move(j.image_));
+    }
+    return decoded.size();
+}
+
+size_t image_decoder::pending() const
+{
+    std::lock_guard lock(mutex_);
+    return queued_.size() + decoded_.size() + (busy_ ? 1 : 0);
+}
+
+void image_decoder::worker()
+{
+    profiler::set_thread_name("image decode");
+    std::unique_lock lock(mutex_);
+    while(true) {
+        cv_.wait(lock, [this] { return stop_ || !queued_.empty(); });
+        if(stop_) {
+            break;
+        }
+        job j = std::move(queued_.front());
+        queued_.pop_front();
+        busy_ = true;
+
+        lock.unlock();
+        const std::string path = j.image_.path_;
+        if(!load_image(path, j.image_)) {
+            j.image_.pixels_.clear();
+        }
+        lock.lock();
+
+        busy_ = false;
+        decoded_.emplace_back(std::move(j));
+    }
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+/// @brief Decoded RGBA8 pixels, top row first as they are stored in the file.
+/// @note Uploaded as is, (0, 0) samples the top left, which is what ImGui::Image() expects.
+struct image
+{
+    std::string path_{ };
+    size_t width_{ 0 };
+    size_t height_{ 0 };
+    tracked_vector<uint8_t> pixels_{ tracked_allocator<uint8_t>(memory_tag::texture) };
+
+    bool empty() const { return pixels_.empty(); }
+};
+
+/// @brief Decodes a resource with SDL_image on the calling thread, converting it to RGBA8.
+/// @return false if the file couldn't be decoded.
+bool load_image(std::string_view filename, image& out);
+
+// Decodes images with SDL_image on a worker thread, so the decode never costs
+// the frame anything. Finished images wait until poll() is called, on the
+// caller's thread, which hands them to their callbacks in request order.
+class image_decoder
+{
+public:
+    typedef std::function<void(image&&)> ready_fn;
+
+    image_decoder();
+    /// @brief Drops queued requests and waits for the one being decoded.
+    ~image_decoder();
+    /// @brief Queues a resource for decoding, a failed decode is passed on as an empty image.
+    void decode(std::string_view filename, ready_fn on_ready);
+    /// @brief Passes decoded images to their callbacks.
+    /// @return The number of images passed on.
+    size_t poll();
+    /// @brief Requests not yet passed on.
+    size_t pending() const;
+private:
+    struct job
+    {
+        image image_{ };
+        ready_fn on_ready_{ };
+    };
+    void worker();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<job> queued_{ };
+    std::deque<job> decoded_{ };
+    bool busy_{ false };
+    bool stop_{ false };
+    std::thread thread_;
+
+    image_decoder(const image_decoder&) = delete;
+    image_decoder(image_decoder&&) = delete;
+    image_decoder& operator=(const image_decoder&) = delete;
+    image_decoder& operator=(image_decoder&&) = delete;
+};
+
+}
@@ -0,0 +1,143 @@
+#include <string>
+#include <utility>
+#include <spdlog/spdlog.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "tr_mapped_file.h"
+
+namespace tr {
+
+mapped_file::mapped_file(std::string_view path)
+{
+    open(path);
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+mapped_file::mapped_file(mapped_file&& rhs) noexcept
+    : data_(std::exchange(rhs.data_, nullptr))
+    , size_(std::exchange(rhs.size_, 0))
+#if defined(_WIN32)
+    , file_(std::exchange(rhs.file_, nullptr))
+    , mapping_(std::exchange(rhs.mapping_, nullptr))
+#endif
+{
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& rhs) noexcept
+{
+    if(this != &rhs) {
+        close();
+        data_ = std::exchange(rhs.data_, nullptr);
+        size_ = std::exchange(rhs.size_, 0);
+#if defined(_WIN32)
+        file_ = std::exchange(rhs.file_, nullptr);
+        mapping_ = std::exchange(rhs.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#if defined(_WIN32)
+
+bool mapped_file::open(std::string_view path)
+{
+    close();
+    const std::string p(path);
+    HANDLE file = CreateFileA(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE) {
+        spdlog::error("Unable to open \"{}\" for mapping, error {}", p, GetLastError());
+        return false;
+    }
+    LARGE_INTEGER size{ };
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        spdlog::error("Unable to map \"{}\", it is empty or its size is unknown.", p);
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if(view == nullptr) {
+        spdlog::error("Unable to map \"{}\", error {}", p, GetLastError());
+        if(mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = view;
+    size_ = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void mapped_file::close()
+{
+    if(data_ != nullptr) {
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+    }
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+bool mapped_file::open(std::string_view path)
+{
+    close();
+    const std::string p(path);
+    const int fd = ::open(p.c_str(), O_RDONLY);
+    if(fd < 0) {
+        spdlog::error("Unable to open \"{}\" for mapping.", p);
+        return false;
+    }
+    struct stat st{ };
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        spdlog::error("Unable to map \"{}\", it is empty or its size is unknown.", p);
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file referenced, the descriptor isn't needed.
+    ::close(fd);
+    if(view == MAP_FAILED) {
+        spdlog::error("Unable to map \"{}\".", p);
+        return false;
+    }
+    // The whole file is about to be read, start reading it in now.
+    madvise(view, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+    data_ = view;
+    size_ = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void mapped_file::close()
+{
+    if(data_ != nullptr) {
+        munmap(const_cast<void*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace tr {
+
+// A read-only view of a whole file mapped into memory.
+// Pages are read in by the OS on first touch, so data can go from the file to
+// the driver without being copied into a buffer of our own first.
+class mapped_file
+{
+public:
+    mapped_file() = default;
+    explicit mapped_file(std::string_view path);
+    ~mapped_file();
+    /// @return false if the file couldn't be opened or mapped.
+    bool open(std::string_view path);
+    void close();
+    bool is_open() const { return data_ != nullptr; }
+    const uint8_t* data() const { return static_cast<const uint8_t*>(data_); }
+    size_t size() const { return size_; }
+    std::span<const uint8_t> bytes() const { return { data(), size_ }; }
+
+    // moveable, but not copyable as the mapping is owned.
+    mapped_file(mapped_file&& rhs) noexcept;
+    mapped_file& operator=(mapped_file&& rhs) noexcept;
+private:
+    const void* data_{ nullptr };
+    size_t size_{ 0 };
+#if defined(_WIN32)
+    void* file_{ nullptr };
+    void* mapping_{ nullptr };
+#endif
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+};
+
+}
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+#include <ryml.hpp>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+const char* to_string(memory_tag tag)
+{
+    switch(tag)
+    {
+        case memory_tag::other:         return "other";
+        case memory_tag::resource:      return "resource";
+        case memory_tag::vertex:        return "vertex";
+        case memory_tag::shader:        return "shader";
+        case memory_tag::ui:            return "ui";
+        case memory_tag::texture:       return "texture";
+        case memory_tag::framebuffer:   return "framebuffer";
+        case memory_tag::capture:       return "capture";
+        case memory_tag::commands:      return "commands";
+        case memory_tag::animation:     return "animation";
+        case memory_tag::culling:       return "culling";
+        case memory_tag::count:         break;
+    }
+    return "unknown";
+}
+
+namespace memory {
+
+namespace {
+    constexpr size_t tag_count = static_cast<size_t>(memory_tag::count);
+    /// @brief Size of the header in front of blocks from allocate(), keeps the block maximally aligned.
+    constexpr size_t header_size = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+    struct counter
+    {
+        std::atomic<size_t> current_{ 0 };
+        std::atomic<size_t> peak_{ 0 };
+        std::atomic<size_t> live_{ 0 };
+        std::atomic<size_t> total_{ 0 };
+    };
+
+    std::array<counter, tag_count> cpu{ };
+    std::array<counter, tag_count> gpu{ };
+    // Peaks of the totals are kept separately, the sum of per tag peaks overstates them.
+    counter cpu_all{ };
+    counter gpu_all{ };
+
+    void add(counter& c, size_t bytes)
+    {
+        const size_t now = c.current_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = c.peak_.load(std::memory_order_relaxed);
+        while(now > peak && !c.peak_.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+        }
+        c.live_.fetch_add(1, std::memory_order_relaxed);
+        c.total_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void remove(counter& c, size_t bytes)
+    {
+        c.current_.fetch_sub(bytes, std::memory_order_relaxed);
+        c.live_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    memory_usage read(const counter& c)
+    {
+        memory_usage u;
+        u.current_bytes_ = c.current_.load(std::memory_order_relaxed);
+        u.peak_bytes_ = c.peak_.load(std::memory_order_relaxed);
+        u.live_allocations_ = c.live_.load(std::memory_order_relaxed);
+        u.total_allocations_ = c.total_.load(std::memory_order_relaxed);
+        return u;
+    }
+
+    size_t index(memory_tag tag)
+    {
+        return std::min(static_cast<size_t>(tag), tag_count - 1);
+    }
+
+    void* ryml_allocate(size_t len, void* /* hint */, void* /* user_data */)
+    {
+        return allocate(memory_tag::resource, len);
+    }
+
+    void ryml_free(void* mem, size_t /* size */, void* /* user_data */)
+    {
+        deallocate(memory_tag::resource, mem);
+    }
+
+    nlohmann::json usage_json(const memory_usage& u)
+    {
+        return nlohmann::json{
+            { "current_bytes", u.current_bytes_ },
+            { "peak_bytes", u.peak_bytes_ },
+            { "live_allocations", u.live_allocations_ },
+            { "total_allocations", u.total_allocations_ },
+        };
+    }
+}
+
+void track_alloc(memory_tag tag, size_t bytes)
+{
+    add(cpu[index(tag)], bytes);
+    add(cpu_all, bytes);
+}
+
+void track_free(memory_tag tag, size_t bytes)
+{
+    remove(cpu[index(tag)], bytes);
+    remove(cpu_all, bytes);
+}
+
+void track_gpu_alloc(memory_tag tag, size_t bytes)
+{
+    add(gpu[index(tag)], bytes);
+    add(gpu_all, bytes);
+}
+
+void track_gpu_free(memory_tag tag, size_t bytes)
+{
+    remove(gpu[index(tag)], bytes);
+    remove(gpu_all, bytes);
+}
+
+memory_usage cpu_usage(memory_tag tag)
+{
+    return read(cpu[index(tag)]);
+}
+
+memory_usage gpu_usage(memory_tag tag)
+{
+    return read(gpu[index(tag)]);
+}
+
+memory_usage cpu_total()
+{
+    return read(cpu_all);
+}
+
+memory_usage gpu_total()
+{
+    return read(gpu_all);
+}
+
+void* allocate(memory_tag tag, size_t bytes)
+{
+    auto* block = static_cast<uint8_t*>(std::malloc(bytes + header_size));
+    if(block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = bytes;
+    track_alloc(tag, bytes);
+    return block + header_size;
+}
+
+void deallocate(memory_tag tag, void* ptr)
+{
+    if(ptr == nullptr) {
+        return;
+    }
+    auto* block = static_cast<uint8_t*>(ptr) - header_size;
+    track_free(tag, *reinterpret_cast<size_t*>(block));
+    std::free(block);
+}
+
+void track_ryml()
+{
+    // Keep ryml's error handling, only the allocation hooks are replaced.
+    ryml::Callbacks callbacks = ryml::get_callbacks();
+    callbacks.m_allocate = &ryml_allocate;
+    callbacks.m_free = &ryml_free;
+    ryml::set_callbacks(callbacks);
+}
+
+size_t gpu_texture_bytes(unsigned internal_format, size_t width, size_t height, size_t depth, size_t levels)
+{
+    // Block compressed formats, bytes per 4x4 block.
+    size_t block_bytes = 0;
+    // Otherwise bytes per texel, three component formats are padded to four by most drivers.
+    size_t texel_bytes = 4;
+    switch(internal_format)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_SIGNED_RED_RGTC1:
+            block_bytes = 8;
+            break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_SIGNED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB:
+            block_bytes = 16;
+            break;
+        case GL_R8: case GL_RED: case GL_STENCIL_INDEX8:
+            texel_bytes = 1;
+            break;
+        case GL_RG8: case GL_RG: case GL_R16F: case GL_R16: case GL_DEPTH_COMPONENT16:
+            texel_bytes = 2;
+            break;
+        case GL_RGBA16F: case GL_RGB16F: case GL_RG32F: case GL_RGBA16: case GL_DEPTH32F_STENCIL8:
+            texel_bytes = 8;
+            break;
+        case GL_RGBA32F: case GL_RGB32F:
+            texel_bytes = 16;
+            break;
+        default:
+            // GL_RGB(A)8, sRGB, 10:10:10:2, R32F, RG16F and 24/32 bit depth formats.
+            texel_bytes = 4;
+            break;
+    }
+
+    size_t total = 0;
+    for(size_t level = 0; level < std::max<size_t>(levels, 1); ++level) {
+        const size_t w = std::max<size_t>(width >> level, 1);
+        const size_t h = std::max<size_t>(height >> level, 1);
+        if(block_bytes != 0) {
+            total += ((w + 3) / 4) * ((h + 3) / 4) * block_bytes * depth;
+        } else {
+            total += w * h * texel_bytes * depth;
+        }
+    }
+    return total;
+}
+
+nlohmann::json to_json()
+{
+    nlohmann::json tags = nlohmann::json::object();
+    for(size_t n = 0; n < tag_count; ++n) {
+        const auto tag = static_cast<memory_tag>(n);
+        tags[to_string(tag)] = nlohmann::json{
+            { "cpu", usage_json(cpu_usage(tag)) },
+            { "gpu_estimate", usage_json(gpu_usage(tag)) },
+        };
+    }
+    return nlohmann::json{
+        { "cpu", usage_json(cpu_total()) },
+        { "gpu_estimate", usage_json(gpu_total()) },
+        { "tags", tags },
+    };
+}
+
+bool write_json(std::string_view filename)
+{
+    std::ofstream f{ std::string(filename) };
+    if(!f.is_open()) {
+        spdlog::error("Unable to write memory report to \"{}\"", filename);
+        return false;
+    }
+    f << to_json().dump(4) << std::endl;
+    spdlog::info("Memory report written to \"{}\"", filename);
+    return true;
+}
+
+}
+
+gpu_allocation::~gpu_allocation()
+{
+    set(0);
+}
+
+gpu_allocation::gpu_allocation(gpu_allocation&& rhs) noexcept
+    : tag_(rhs.tag_)
+    , bytes_(rhs.bytes_)
+{
+    rhs.bytes_ = 0;
+}
+
+gpu_allocation& gpu_allocation::operator=(gpu_allocation&& rhs) noexcept
+{
+    if(this != &rhs) {
+        set(0);
+        tag_ = rhs.tag_;
+        bytes_ = rhs.bytes_;
+        rhs.bytes_ = 0;
+    }
+    return *this;
+}
+
+void gpu_allocation::set(size_t bytes)
+{
+    if(bytes_ != 0) {
+        memory::track_gpu_free(tag_, bytes_);
+    }
+    bytes_ = bytes;
+    if(bytes_ != 0) {
+        memory::track_gpu_alloc(tag_, bytes_);
+    }
+}
+
+}
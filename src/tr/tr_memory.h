@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <json.hpp>
+
+namespace tr {
+
+// Subsystems memory is accounted to.
+enum class memory_tag : uint8_t
+{
+    other,
+    resource,
+    vertex,
+    shader,
+    ui,
+    texture,
+    framebuffer,
+    capture,
+    commands,
+    animation,
+    culling,
+    count,
+};
+
+const char* to_string(memory_tag tag);
+
+struct memory_usage
+{
+    size_t current_bytes_{ 0 };
+    /// @brief High-water mark since startup.
+    size_t peak_bytes_{ 0 };
+    size_t live_allocations_{ 0 };
+    size_t total_allocations_{ 0 };
+};
+
+// Tagged memory accounting.
+// CPU allocations are counted where they are made, through tracked_allocator,
+// memory::allocate() or the ryml and ImGui hooks, not by replacing the global
+// allocator, so untagged heap use isn't seen. GPU memory is an estimate from
+// the sizes and formats requested of GL, drivers add padding and alignment.
+// All counters are atomic and may be updated from any thread.
+namespace memory {
+
+void track_alloc(memory_tag tag, size_t bytes);
+void track_free(memory_tag tag, size_t bytes);
+void track_gpu_alloc(memory_tag tag, size_t bytes);
+void track_gpu_free(memory_tag tag, size_t bytes);
+
+memory_usage cpu_usage(memory_tag tag);
+memory_usage gpu_usage(memory_tag tag);
+memory_usage cpu_total();
+memory_usage gpu_total();
+
+/// @brief Allocates and tracks a block, suitably aligned for any type.
+void* allocate(memory_tag tag, size_t bytes);
+/// @brief Releases a block from \c allocate(), null is ignored.
+void deallocate(memory_tag tag, void* ptr);
+
+/// @brief Routes ryml's tree and arena allocations through the tracker as resource memory.
+void track_ryml();
+
+/// @brief Estimated size of a texture or renderbuffer, including its mip levels.
+size_t gpu_texture_bytes(unsigned internal_format, size_t width, size_t height, size_t depth = 1, size_t levels = 1);
+
+nlohmann::json to_json();
+bool write_json(std::string_view filename);
+
+}
+
+// Standard allocator that accounts its allocations to a tag chosen at construction.
+template<typename T>
+class tracked_allocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    tracked_allocator() noexcept = default;
+    explicit tracked_allocator(memory_tag tag) noexcept : tag_(tag) {}
+    template<typename U>
+    tracked_allocator(const tracked_allocator<U>& rhs) noexcept : tag_(rhs.tag()) {}
+
+    T* allocate(size_t n)
+    {
+        T* p = std::allocator<T>{ }.allocate(n);
+        memory::track_alloc(tag_, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        memory::track_free(tag_, n * sizeof(T));
+        std::allocator<T>{ }.deallocate(p, n);
+    }
+
+    memory_tag tag() const { return tag_; }
+
+    template<typename U>
+    bool operator==(const tracked_allocator<U>& rhs) const { return tag_ == rhs.tag(); }
+private:
+    memory_tag tag_{ memory_tag::other };
+};
+
+template<typename T>
+using tracked_vector = std::vector<T, tracked_allocator<T>>;
+
+// Accounts the GPU memory of one object, replacing the previous size on each set().
+class gpu_allocation
+{
+public:
+    explicit gpu_allocation(memory_tag tag) : tag_(tag) {}
+    ~gpu_allocation();
+    gpu_allocation(gpu_allocation&& rhs) noexcept;
+    gpu_allocation& operator=(gpu_allocation&& rhs) noexcept;
+    void set(size_t bytes);
+    size_t bytes() const { return bytes_; }
+private:
+    memory_tag tag_;
+    size_t bytes_{ 0 };
+
+    gpu_allocation(const gpu_allocation&) = delete;
+    gpu_allocation& operator=(const gpu_allocation&) = delete;
+};
+
+}
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+#include "tr_mesh_bake.h"
+#include "tr_scene_import.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    size_t attribute_bytes(const vertex_format& f)
+    {
+        switch(f.type_) {
+            case data_format::INT8:
+            case data_format::UINT8: return static_cast<size_t>(f.count_);
+            case data_format::INT16:
+            case data_format::UINT16:
+            case data_format::FLOAT16:
+            case data_format::FIXED16: return static_cast<size_t>(f.count_) * 2;
+            default: return static_cast<size_t>(f.count_) * 4;
+        }
+    }
+
+    const vertex_format* find_attribute(const vertex_format_list_t& formats, int attrib)
+    {
+        const auto it = std::find_if(formats.begin(), formats.end(), [attrib](const vertex_format& f) { return f.attrib_ == attrib; });
+        return it == formats.end() ? nullptr : &*it;
+    }
+
+    uint64_t align(uint64_t offset)
+    {
+        return (offset + mesh_file_alignment - 1) & ~uint64_t{ mesh_file_alignment - 1 };
+    }
+
+    /// @brief Copies \c count of a mesh's indices from \c first, offset onto the merged vertex stream.
+    void rebase_indices(const mesh_data& mesh, size_t first, size_t count, uint32_t base_vertex, bool small, uint8_t* dst)
+    {
+        const size_t mesh_index_size = mesh.index_format_ == data_format::UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        const size_t index_size = small ? sizeof(uint16_t) : sizeof(uint32_t);
+        const uint8_t* src = mesh.indices_.data() + first * mesh_index_size;
+        for(size_t n = 0; n < count; ++n, src += mesh_index_size, dst += index_size) {
+            uint32_t index = 0;
+            if(mesh_index_size == sizeof(uint16_t)) {
+                uint16_t i16;
+                std::memcpy(&i16, src, sizeof(i16));
+                index = i16;
+            } else {
+                std::memcpy(&index, src, sizeof(index));
+            }
+            index += base_vertex;
+            if(small) {
+                const uint16_t i16 = static_cast<uint16_t>(index);
+                std::memcpy(dst, &i16, sizeof(i16));
+            } else {
+                std::memcpy(dst, &index, sizeof(index));
+            }
+        }
+    }
+
+    size_t stored_indices(const mesh_data& mesh)
+    {
+        return mesh.indices_.size() / (mesh.index_format_ == data_format::UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+    }
+}
+
+bool bake_meshes(const std::vector<mesh_data>& meshes, baked_mesh& out)
+{
+    TR_PROFILE_ZONE("bake meshes");
+    // The merged layout has every attribute any mesh has, in attribute order.
+    out.formats_.clear();
+    int offset = 0;
+    for(int attrib = mesh_position; attrib <= mesh_colour; ++attrib) {
+        for(const auto& mesh : meshes) {
+            if(const vertex_format* f = find_attribute(mesh.formats_, attrib); f != nullptr && mesh.index_count_ > 0) {
+                out.formats_.emplace_back(f->attrib_, f->count_, f->type_, f->conversion_, offset);
+                offset += static_cast<int>(attribute_bytes(*f));
+                break;
+            }
+        }
+    }
+    out.stride_ = static_cast<size_t>(offset);
+
+    out.vertex_count_ = 0;
+    out.index_count_ = 0;
+    out.full_index_count_ = 0;
+    for(const auto& mesh : meshes) {
+        if(mesh.index_count_ > 0) {
+            out.vertex_count_ += mesh.vertex_count_;
+            out.index_count_ += stored_indices(mesh);
+            out.full_index_count_ += mesh.index_count_;
+        }
+    }
+    if(out.full_index_count_ == 0) {
+        spdlog::error("Nothing to bake, the meshes have no triangles.");
+        return false;
+    }
+    if(out.vertex_count_ > std::numeric_limits<uint32_t>::max()) {
+        spdlog::error("Unable to bake {} vertices, more than 32 bit indices can reach.", out.vertex_count_);
+        return false;
+    }
+    const bool small = out.vertex_count_ <= std::numeric_limits<uint16_t>::max() + size_t(1);
+    out.index_format_ = small ? data_format::UINT16 : data_format::UINT32;
+    const size_t index_size = small ? sizeof(uint16_t) : sizeof(uint32_t);
+    out.vertices_.assign(out.vertex_count_ * out.stride_, 0);
+    out.indices_.resize(out.index_count_ * index_size);
+    out.submeshes_.clear();
+    out.bounds_min_ = glm::vec3(std::numeric_limits<float>::max());
+    out.bounds_max_ = glm::vec3(std::numeric_limits<float>::lowest());
+
+    size_t base_vertex = 0;
+    size_t first_index = 0;
+    size_t lod_index = out.full_index_count_;
+    for(const auto& mesh : meshes) {
+        if(mesh.index_count_ == 0) {
+            continue;
+        }
+        // Attributes are copied one at a time, the mesh's layout may be narrower than the merged one.
+        for(const auto& dst : out.formats_) {
+            const vertex_format* src = find_attribute(mesh.formats_, dst.attrib_);
+            uint8_t* v = out.vertices_.data() + base_vertex * out.stride_ + dst.offset_;
+            const size_t bytes = attribute_bytes(dst);
+            for(size_t n = 0; n < mesh.vertex_count_; ++n, v += out.stride_) {
+                if(src != nullptr) {
+                    std::memcpy(v, mesh.vertices_.data() + n * mesh.stride_ + src->offset_, bytes);
+                } else if(dst.attrib_ == mesh_colour) {
+                    std::memset(v, 0xff, bytes);
+                }
+            }
+        }
+
+        // Indices are rebased onto the merged vertex stream, simplified levels go after every full one.
+        rebase_indices(mesh, 0, mesh.index_count_, static_cast<uint32_t>(base_vertex), small, out.indices_.data() + first_index * index_size);
+        submesh& s = out.submeshes_.emplace_back();
+        s.lods_.push_back({ first_index, mesh.index_count_, 0.0f });
+        for(size_t n = 1; n < mesh.lods_.size(); ++n) {
+            const mesh_lod& lod = mesh.lods_[n];
+            rebase_indices(mesh, lod.first_index_, lod.index_count_, static_cast<uint32_t>(base_vertex), small, out.indices_.data() + lod_index * index_size);
+            s.lods_.push_back({ lod_index, lod.index_count_, lod.error_ });
+            lod_index += lod.index_count_;
+        }
+
+        s.first_index_ = first_index;
+        s.index_count_ = mesh.index_count_;
+        s.base_vertex_ = base_vertex;
+        s.vertex_count_ = mesh.vertex_count_;
+        s.material_ = mesh.material_;
+        s.bounds_min_ = mesh.bounds_min_;
+        s.bounds_max_ = mesh.bounds_max_;
+        out.bounds_min_ = glm::min(out.bounds_min_, mesh.bounds_min_);
+        out.bounds_max_ = glm::max(out.bounds_max_, mesh.bounds_max_);
+        base_vertex += mesh.vertex_count_;
+        first_index += mesh.index_count_;
+    }
+    return true;
+}
+
+bool write_mesh_file(std::string_view path, const baked_mesh& baked)
+{
+    mesh_file_header header{ };
+    std::memcpy(header.magic_, mesh_file_magic, sizeof(mesh_file_magic));
+    header.version_ = mesh_file_version;
+    header.stride_ = static_cast<uint32_t>(baked.stride_);
+    header.attribute_count_ = static_cast<uint32_t>(baked.formats_.size());
+    header.submesh_count_ = static_cast<uint32_t>(baked.submeshes_.size());
+    header.vertex_count_ = static_cast<uint32_t>(baked.vertex_count_);
+    header.index_count_ = static_cast<uint32_t>(baked.index_count_);
+    header.index_format_ = static_cast<uint32_t>(baked.index_format_);
+    header.full_index_count_ = static_cast<uint32_t>(baked.full_index_count_);
+    for(int c = 0; c < 3; ++c) {
+        header.bounds_min_[c] = baked.bounds_min_[c];
+        header.bounds_max_[c] = baked.bounds_max_[c];
+    }
+
+    std::vector<mesh_file_attribute> attributes(baked.formats_.size());
+    for(size_t n = 0; n < attributes.size(); ++n) {
+        const vertex_format& f = baked.formats_[n];
+        attributes[n] = { f.attrib_, f.count_, static_cast<int32_t>(f.type_), static_cast<int32_t>(f.conversion_), f.offset_, 0 };
+    }
+    std::vector<mesh_file_submesh> submeshes(baked.submeshes_.size());
+    std::vector<mesh_file_lod> lods;
+    for(size_t n = 0; n < submeshes.size(); ++n) {
+        const submesh& s = baked.submeshes_[n];
+        mesh_file_submesh& d = submeshes[n];
+        d.first_index_ = static_cast<uint32_t>(s.first_index_);
+        d.index_count_ = static_cast<uint32_t>(s.index_count_);
+        d.base_vertex_ = static_cast<uint32_t>(s.base_vertex_);
+        d.vertex_count_ = static_cast<uint32_t>(s.vertex_count_);
+        d.material_ = static_cast<uint32_t>(s.material_);
+        d.lod_first_ = static_cast<uint32_t>(lods.size());
+        d.lod_count_ = static_cast<uint32_t>(s.lods_.size());
+        for(const auto& lod : s.lods_) {
+            lods.push_back({ static_cast<uint32_t>(lod.first_index_), static_cast<uint32_t>(lod.index_count_), lod.error_, 0 });
+        }
+        for(int c = 0; c < 3; ++c) {
+            d.bounds_min_[c] = s.bounds_min_[c];
+            d.bounds_max_[c] = s.bounds_max_[c];
+        }
+    }
+
+    header.lod_count_ = static_cast<uint32_t>(lods.size());
+    const uint64_t tables_end = sizeof(header) + attributes.size() * sizeof(mesh_file_attribute) + submeshes.size() * sizeof(mesh_file_submesh)
+        + lods.size() * sizeof(mesh_file_lod);
+    header.vertex_offset_ = align(tables_end);
+    header.vertex_length_ = baked.vertices_.size();
+    header.index_offset_ = align(header.vertex_offset_ + header.vertex_length_);
+    header.index_length_ = baked.indices_.size();
+
+    std::ofstream f{ std::string(path), std::ios::out | std::ios::binary | std::ios::trunc };
+    if(!f.is_open()) {
+        spdlog::error("Unable to open \"{}\" for writing.", path);
+        return false;
+    }
+    const char zeros[mesh_file_alignment]{ };
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char*>(attributes.data()), static_cast<std::streamsize>(attributes.size() * sizeof(mesh_file_attribute)));
+    f.write(reinterpret_cast<const char*>(submeshes.data()), static_cast<std::streamsize>(submeshes.size() * sizeof(mesh_file_submesh)));
+    f.write(reinterpret_cast<const char*>(lods.data()), static_cast<std::streamsize>(lods.size() * sizeof(mesh_file_lod)));
+    f.write(zeros, static_cast<std::streamsize>(header.vertex_offset_ - tables_end));
+    f.write(reinterpret_cast<const char*>(baked.vertices_.data()), static_cast<std::streamsize>(baked.vertices_.size()));
+    f.write(zeros, static_cast<std::streamsize>(header.index_offset_ - header.vertex_offset_ - header.vertex_length_));
+    f.write(reinterpret_cast<const char*>(baked.indices_.data()), static_cast<std::streamsize>(baked.indices_.size()));
+    if(!f.good()) {
+        spdlog::error("Unable to write \"{}\".", path);
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "tr_data_format.h"
+#include "tr_memory.h"
+#include "tr_mesh_file.h"
+#include "tr_vertex.h"
+
+namespace tr {
+
+struct mesh_data;
+
+/// @brief Every mesh of a scene merged into the streams \c load_mesh_file() uploads.
+struct baked_mesh
+{
+    size_t stride_{ 0 };
+    vertex_format_list_t formats_{ };
+    size_t vertex_count_{ 0 };
+    tracked_vector<uint8_t> vertices_{ tracked_allocator<uint8_t>(memory_tag::vertex) };
+    data_format index_format_{ data_format::UINT32 };
+    size_t index_count_{ 0 };
+    /// @brief The leading indices that draw every submesh at full detail.
+    size_t full_index_count_{ 0 };
+    tracked_vector<uint8_t> indices_{ tracked_allocator<uint8_t>(memory_tag::vertex) };
+    std::vector<submesh> submeshes_{ };
+    glm::vec3 bounds_min_{ 0.0f };
+    glm::vec3 bounds_max_{ 0.0f };
+};
+
+/// @brief Merges converted meshes into one vertex and index stream, one submesh each.
+/// Attributes missing from some meshes are filled with zeros, or white for colours.
+/// Levels of detail follow all of the full detail indices.
+/// @return false if there are no triangles.
+bool bake_meshes(const std::vector<mesh_data>& meshes, baked_mesh& out);
+/// @brief Writes a baked mesh in the container \c load_mesh_file() reads.
+bool write_mesh_file(std::string_view path, const baked_mesh& baked);
+
+}
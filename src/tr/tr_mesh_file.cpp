@@ -0,0 +1,162 @@
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#include "tr_mesh_file.h"
+#include "tr_mapped_file.h"
+#include "resource.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    size_t index_size(uint32_t format)
+    {
+        switch(static_cast<data_format>(format)) {
+            case data_format::UINT16: return sizeof(uint16_t);
+            case data_format::UINT32: return sizeof(uint32_t);
+            default: return 0;
+        }
+    }
+}
+
+vertex_format_list_t mesh_file_view::formats() const
+{
+    vertex_format_list_t formats;
+    formats.reserve(attributes_.size());
+    for(const auto& a : attributes_) {
+        formats.emplace_back(a.attrib_, a.count_, static_cast<data_format>(a.type_), static_cast<vertex_format_conversion>(a.conversion_), a.offset_);
+    }
+    return formats;
+}
+
+std::vector<submesh> mesh_file_view::submeshes() const
+{
+    std::vector<submesh> out(submeshes_.size());
+    for(size_t n = 0; n < submeshes_.size(); ++n) {
+        const auto& s = submeshes_[n];
+        out[n].first_index_ = s.first_index_;
+        out[n].index_count_ = s.index_count_;
+        out[n].base_vertex_ = s.base_vertex_;
+        out[n].vertex_count_ = s.vertex_count_;
+        out[n].material_ = s.material_;
+        out[n].bounds_min_ = glm::vec3(s.bounds_min_[0], s.bounds_min_[1], s.bounds_min_[2]);
+        out[n].bounds_max_ = glm::vec3(s.bounds_max_[0], s.bounds_max_[1], s.bounds_max_[2]);
+        for(const auto& l : lods_.subspan(s.lod_first_, s.lod_count_)) {
+            out[n].lods_.push_back({ l.first_index_, l.index_count_, l.error_ });
+        }
+    }
+    return out;
+}
+
+bool parse_mesh_file(std::span<const uint8_t> data, mesh_file_view& view, std::string_view name)
+{
+    if(data.size() < sizeof(mesh_file_header)) {
+        spdlog::error("Baked mesh \"{}\" is too small for a header.", name);
+        return false;
+    }
+    // Mappings are page aligned, so the header and tables can be used in place.
+    static_assert(sizeof(mesh_file_header) % alignof(mesh_file_attribute) == 0);
+    static_assert(sizeof(mesh_file_attribute) % alignof(mesh_file_submesh) == 0);
+    static_assert(sizeof(mesh_file_submesh) % alignof(mesh_file_lod) == 0);
+    const auto* header = reinterpret_cast<const mesh_file_header*>(data.data());
+    if(std::memcmp(header->magic_, mesh_file_magic, sizeof(mesh_file_magic)) != 0) {
+        spdlog::error("\"{}\" isn't a baked mesh.", name);
+        return false;
+    }
+    if(header->version_ != mesh_file_version) {
+        spdlog::error("Baked mesh \"{}\" is version {}, expected {}.", name, header->version_, mesh_file_version);
+        return false;
+    }
+    const size_t indices = index_size(header->index_format_);
+    if(indices == 0 || header->stride_ == 0 || header->attribute_count_ == 0) {
+        spdlog::error("Baked mesh \"{}\" has an invalid header.", name);
+        return false;
+    }
+    const size_t tables_end = sizeof(mesh_file_header) + header->attribute_count_ * sizeof(mesh_file_attribute)
+        + header->submesh_count_ * sizeof(mesh_file_submesh) + header->lod_count_ * sizeof(mesh_file_lod);
+    if(data.size() < tables_end) {
+        spdlog::error("Baked mesh \"{}\" is truncated in its tables.", name);
+        return false;
+    }
+    const uint64_t vertex_length = uint64_t(header->vertex_count_) * header->stride_;
+    const uint64_t index_length = uint64_t(header->index_count_) * indices;
+    // Each offset is checked before the length that follows it, so a corrupt offset can't wrap the sum.
+    if(header->vertex_length_ != vertex_length || header->index_length_ != index_length
+        || header->vertex_offset_ < tables_end || header->vertex_offset_ > data.size() || vertex_length > data.size() - header->vertex_offset_
+        || header->index_offset_ < tables_end || header->index_offset_ > data.size() || index_length > data.size() - header->index_offset_) {
+        spdlog::error("Baked mesh \"{}\" has invalid streams.", name);
+        return false;
+    }
+
+    view.header_ = header;
+    const uint8_t* tables = data.data() + sizeof(mesh_file_header);
+    view.attributes_ = { reinterpret_cast<const mesh_file_attribute*>(tables), header->attribute_count_ };
+    tables += header->attribute_count_ * sizeof(mesh_file_attribute);
+    view.submeshes_ = { reinterpret_cast<const mesh_file_submesh*>(tables), header->submesh_count_ };
+    tables += header->submesh_count_ * sizeof(mesh_file_submesh);
+    view.lods_ = { reinterpret_cast<const mesh_file_lod*>(tables), header->lod_count_ };
+    view.vertices_ = data.subspan(static_cast<size_t>(header->vertex_offset_), static_cast<size_t>(vertex_length));
+    view.indices_ = data.subspan(static_cast<size_t>(header->index_offset_), static_cast<size_t>(index_length));
+
+    for(const auto& a : view.attributes_) {
+        if(a.offset_ < 0 || static_cast<uint32_t>(a.offset_) >= header->stride_) {
+            spdlog::error("Baked mesh \"{}\" has an attribute outside its vertex.", name);
+            return false;
+        }
+    }
+    for(const auto& s : view.submeshes_) {
+        if(uint64_t(s.first_index_) + s.index_count_ > header->full_index_count_
+            || uint64_t(s.lod_first_) + s.lod_count_ > header->lod_count_) {
+            spdlog::error("Baked mesh \"{}\" has a submesh outside its indices.", name);
+            return false;
+        }
+        if(uint64_t(s.base_vertex_) + s.vertex_count_ > header->vertex_count_) {
+            spdlog::error("Baked mesh \"{}\" has a submesh outside its vertices.", name);
+            return false;
+        }
+    }
+    if(header->full_index_count_ > header->index_count_) {
+        spdlog::error("Baked mesh \"{}\" has an invalid header.", name);
+        return false;
+    }
+    for(const auto& l : view.lods_) {
+        if(uint64_t(l.first_index_) + l.index_count_ > header->index_count_) {
+            spdlog::error("Baked mesh \"{}\" has a level of detail outside its indices.", name);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<loaded_mesh> load_mesh_file(std::string_view filename)
+{
+    TR_PROFILE_ZONE("load mesh file");
+    mapped_file file(resource::resolve(filename));
+    if(!file.is_open()) {
+        return std::nullopt;
+    }
+    mesh_file_view view;
+    if(!parse_mesh_file(file.bytes(), view, filename)) {
+        return std::nullopt;
+    }
+
+    const mesh_file_header& h = *view.header_;
+    loaded_mesh mesh{ vertex_object::create("opengl") };
+    mesh.stride_ = h.stride_;
+    mesh.formats_ = view.formats();
+    mesh.index_format_ = static_cast<data_format>(h.index_format_);
+    mesh.object_.add(mesh.stride_, mesh.formats_);
+    mesh.object_.build(true, mesh.index_format_);
+    mesh.object_.upload(vertex_object::update_type::vertex, 0, view.vertices_.data(), view.vertices_.size());
+    // Every level is drawable, a plain draw() of the object isn't meaningful with them all in one stream.
+    mesh.object_.upload(vertex_object::update_type::index, h.index_count_, view.indices_.data(), view.indices_.size());
+    mesh.submeshes_ = view.submeshes();
+    mesh.vertex_count_ = h.vertex_count_;
+    mesh.index_count_ = h.full_index_count_;
+    mesh.bounds_min_ = glm::vec3(h.bounds_min_[0], h.bounds_min_[1], h.bounds_min_[2]);
+    mesh.bounds_max_ = glm::vec3(h.bounds_max_[0], h.bounds_max_[1], h.bounds_max_[2]);
+    spdlog::debug("Loaded {} vertices, {} indices and {} submeshes from \"{}\"", mesh.vertex_count_, mesh.index_count_, mesh.submeshes_.size(), filename);
+    return mesh;
+}
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "tr_data_format.h"
+#include "tr_mesh_lod.h"
+#include "tr_vertex.h"
+
+namespace tr {
+
+// Baked mesh container, the vertex and index streams are stored exactly as
+// they are uploaded so the loader passes them to the driver straight from a
+// mapped file. Every mesh of a scene shares one interleaved vertex stream and
+// one index stream, submeshes are ranges of the indices, which already
+// include each submesh's base vertex. Every submesh's full detail indices
+// come first, so drawing the first \c full_index_count_ draws the whole mesh,
+// simplified levels follow as further ranges over the same vertices. All
+// values are little endian.
+//
+//  mesh_file_header
+//  mesh_file_attribute[attribute_count_]
+//  mesh_file_submesh[submesh_count_]
+//  mesh_file_lod[lod_count_]
+//  vertex stream, then index stream, each starting on a mesh_file_alignment boundary
+
+constexpr uint8_t mesh_file_magic[8] = { 'T', 'R', 'M', 'S', 'H', '\r', '\n', 0x1a };
+constexpr uint32_t mesh_file_version = 2;
+constexpr size_t mesh_file_alignment = 16;
+
+struct mesh_file_header
+{
+    uint8_t magic_[8];
+    uint32_t version_;
+    uint32_t stride_;
+    uint32_t attribute_count_;
+    uint32_t submesh_count_;
+    uint32_t vertex_count_;
+    uint32_t index_count_;
+    /// @brief A \c data_format value, UINT16 or UINT32.
+    uint32_t index_format_;
+    uint32_t lod_count_;
+    /// @brief Indices of every submesh at full detail, the rest are simplified levels.
+    uint32_t full_index_count_;
+    uint32_t reserved_;
+    float bounds_min_[3];
+    float bounds_max_[3];
+    uint64_t vertex_offset_;
+    uint64_t vertex_length_;
+    uint64_t index_offset_;
+    uint64_t index_length_;
+};
+
+/// @brief A \c vertex_format as stored.
+struct mesh_file_attribute
+{
+    int32_t attrib_;
+    int32_t count_;
+    /// @brief A \c data_format value.
+    int32_t type_;
+    /// @brief A \c vertex_format_conversion value.
+    int32_t conversion_;
+    int32_t offset_;
+    int32_t reserved_;
+};
+
+struct mesh_file_submesh
+{
+    uint32_t first_index_;
+    uint32_t index_count_;
+    uint32_t base_vertex_;
+    uint32_t vertex_count_;
+    uint32_t material_;
+    /// @brief The submesh's levels in the lod table, the first is its full detail.
+    uint32_t lod_first_;
+    uint32_t lod_count_;
+    uint32_t reserved_;
+    float bounds_min_[3];
+    float bounds_max_[3];
+};
+
+struct mesh_file_lod
+{
+    uint32_t first_index_;
+    uint32_t index_count_;
+    float error_;
+    uint32_t reserved_;
+};
+
+/// @brief A range of a baked mesh's indices drawn with one material.
+struct submesh
+{
+    size_t first_index_{ 0 };
+    size_t index_count_{ 0 };
+    size_t base_vertex_{ 0 };
+    size_t vertex_count_{ 0 };
+    size_t material_{ 0 };
+    glm::vec3 bounds_min_{ 0.0f };
+    glm::vec3 bounds_max_{ 0.0f };
+    /// @brief Levels of detail from the full submesh down, in the mesh's index stream.
+    std::vector<mesh_lod> lods_{ };
+};
+
+/// @brief A validated view of a baked mesh in memory.
+struct mesh_file_view
+{
+    const mesh_file_header* header_{ nullptr };
+    std::span<const mesh_file_attribute> attributes_{ };
+    std::span<const mesh_file_submesh> submeshes_{ };
+    std::span<const mesh_file_lod> lods_{ };
+    std::span<const uint8_t> vertices_{ };
+    std::span<const uint8_t> indices_{ };
+
+    /// @brief The vertex layout the streams were baked with.
+    vertex_format_list_t formats() const;
+    std::vector<submesh> submeshes() const;
+};
+
+/// @brief Checks a baked mesh's header, tables and streams against its size.
+/// @return false, having logged why, if the data isn't a usable baked mesh.
+bool parse_mesh_file(std::span<const uint8_t> data, mesh_file_view& view, std::string_view name = "mesh");
+
+struct loaded_mesh
+{
+    vertex_object object_;
+    std::vector<submesh> submeshes_{ };
+    /// @brief The vertex layout and index format \c object_ was built with.
+    size_t stride_{ 0 };
+    vertex_format_list_t formats_{ };
+    data_format index_format_{ data_format::UINT32 };
+    size_t vertex_count_{ 0 };
+    size_t index_count_{ 0 };
+    glm::vec3 bounds_min_{ 0.0f };
+    glm::vec3 bounds_max_{ 0.0f };
+};
+
+/// @brief Maps a baked mesh resource and uploads its streams directly from the mapping, on the GL thread.
+/// @return nothing if the file is missing or malformed.
+std::optional<loaded_mesh> load_mesh_file(std::string_view filename);
+
+}
@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <spdlog/spdlog.h>
+
+#include "tr_mesh_lod.h"
+#include "tr_scene_import.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Weight of the planes keeping open edges in place, against the surface's own.
+    constexpr double border_weight = 10.0;
+    /// @brief A collapse is refused if it turns a triangle's normal further than about 80 degrees.
+    constexpr double min_normal_dot = 0.2;
+
+    // Sum of squared distances to a set of planes, as the symmetric 4x4 matrix
+    // of Garland and Heckbert, each plane weighted by the area it came from.
+    struct quadric
+    {
+        double xx{ 0.0 }, xy{ 0.0 }, xz{ 0.0 }, xw{ 0.0 };
+        double yy{ 0.0 }, yz{ 0.0 }, yw{ 0.0 };
+        double zz{ 0.0 }, zw{ 0.0 };
+        double ww{ 0.0 };
+
+        void add_plane(const glm::dvec3& n, double d, double weight)
+        {
+            xx += weight * n.x * n.x; xy += weight * n.x * n.y; xz += weight * n.x * n.z; xw += weight * n.x * d;
+            yy += weight * n.y * n.y; yz += weight * n.y * n.z; yw += weight * n.y * d;
+            zz += weight * n.z * n.z; zw += weight * n.z * d;
+            ww += weight * d * d;
+        }
+
+        void add(const quadric& q)
+        {
+            xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+            yy += q.yy; yz += q.yz; yw += q.yw;
+            zz += q.zz; zw += q.zw;
+            ww += q.ww;
+        }
+
+        double error(const glm::dvec3& p) const
+        {
+            const double e = p.x * (xx * p.x + 2.0 * (xy * p.y + xz * p.z + xw))
+                + p.y * (yy * p.y + 2.0 * (yz * p.z + yw))
+                + p.z * (zz * p.z + 2.0 * zw)
+                + ww;
+            return std::max(e, 0.0);
+        }
+    };
+
+    struct collapse
+    {
+        uint32_t from_;
+        uint32_t to_;
+        /// @brief Orders the collapses, the squared distance plus the weighted change in attributes.
+        double cost_;
+        /// @brief Squared distance from the surface, which is what's limited.
+        double error_;
+    };
+
+    uint64_t edge_key(uint32_t a, uint32_t b)
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    float read_float(const uint8_t* p)
+    {
+        float f;
+        std::memcpy(&f, p, sizeof(f));
+        return f;
+    }
+
+    const vertex_format* find_float_attribute(const vertex_format_list_t& formats, int attrib, int count)
+    {
+        for(const auto& f : formats) {
+            if(f.attrib_ == attrib && f.type_ == data_format::FLOAT32 && f.count_ == count) {
+                return &f;
+            }
+        }
+        return nullptr;
+    }
+}
+
+float simplify(const uint8_t* vertices, size_t vertex_count, size_t stride, size_t position_offset, std::span<const size_t> attribute_offsets,
+    std::span<const float> attribute_weights, std::vector<uint32_t>& indices, size_t target_index_count, float target_error)
+{
+    TR_PROFILE_ZONE("simplify");
+    std::vector<glm::dvec3> positions(vertex_count);
+    glm::dvec3 lo(std::numeric_limits<double>::max());
+    glm::dvec3 hi(std::numeric_limits<double>::lowest());
+    for(size_t v = 0; v < vertex_count; ++v) {
+        const uint8_t* p = vertices + v * stride + position_offset;
+        positions[v] = glm::dvec3(read_float(p), read_float(p + 4), read_float(p + 8));
+        lo = glm::min(lo, positions[v]);
+        hi = glm::max(hi, positions[v]);
+    }
+    // Attribute changes are scaled by the mesh's size, so their cost is a distance like the quadric's.
+    const double scale = vertex_count > 0 ? glm::length(hi - lo) : 1.0;
+    const double attribute_scale = scale * scale;
+
+    // Vertices split only by their attributes share a position, the position is what collapses.
+    std::vector<uint32_t> position_id(vertex_count);
+    std::vector<uint32_t> wedges;
+    {
+        std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+        for(size_t v = 0; v < vertex_count; ++v) {
+            uint32_t bits[3];
+            const float p[3] = { static_cast<float>(positions[v].x), static_cast<float>(positions[v].y), static_cast<float>(positions[v].z) };
+            std::memcpy(bits, p, sizeof(bits));
+            const uint64_t hash = (uint64_t(bits[0]) * 73856093u) ^ (uint64_t(bits[1]) * 19349663u) ^ (uint64_t(bits[2]) * 83492791u);
+            auto& bucket = buckets[hash];
+            auto it = std::find_if(bucket.begin(), bucket.end(), [&](uint32_t id) { return positions[id] == positions[v]; });
+            if(it == bucket.end()) {
+                bucket.push_back(static_cast<uint32_t>(v));
+                position_id[v] = static_cast<uint32_t>(v);
+            } else {
+                position_id[v] = *it;
+            }
+        }
+        wedges.assign(vertex_count, 0);
+        for(size_t v = 0; v < vertex_count; ++v) {
+            ++wedges[position_id[v]];
+        }
+    }
+
+    std::vector<quadric> quadrics(vertex_count);
+    std::vector<double> areas(vertex_count, 0.0);
+    {
+        std::unordered_map<uint64_t, uint32_t> edges;
+        for(size_t t = 0; t + 2 < indices.size(); t += 3) {
+            for(size_t e = 0; e < 3; ++e) {
+                ++edges[edge_key(position_id[indices[t + e]], position_id[indices[t + (e + 1) % 3]])];
+            }
+        }
+        for(size_t t = 0; t + 2 < indices.size(); t += 3) {
+            const glm::dvec3& p0 = positions[indices[t]];
+            const glm::dvec3& p1 = positions[indices[t + 1]];
+            const glm::dvec3& p2 = positions[indices[t + 2]];
+            const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+            const double length = glm::length(cross);
+            if(length <= 0.0) {
+                continue;
+            }
+            const glm::dvec3 normal = cross / length;
+            const double area = 0.5 * length;
+            for(size_t e = 0; e < 3; ++e) {
+                const uint32_t a = position_id[indices[t + e]];
+                const uint32_t b = position_id[indices[t + (e + 1) % 3]];
+                quadrics[a].add_plane(normal, -glm::dot(normal, p0), area);
+                areas[a] += area;
+                // Open edges get a plane at right angles to the surface, so they keep their outline.
+                if(edges[edge_key(a, b)] == 1) {
+                    const glm::dvec3 edge = positions[b] - positions[a];
+                    const glm::dvec3 side = glm::cross(edge, normal);
+                    const double side_length = glm::length(side);
+                    if(side_length > 0.0) {
+                        const glm::dvec3 n = side / side_length;
+                        const double weight = border_weight * glm::dot(edge, edge);
+                        quadrics[a].add_plane(n, -glm::dot(n, positions[a]), weight);
+                        quadrics[b].add_plane(n, -glm::dot(n, positions[a]), weight);
+                    }
+                }
+            }
+        }
+    }
+
+    auto attribute_cost = [&](uint32_t a, uint32_t b) {
+        double cost = 0.0;
+        for(size_t n = 0; n < attribute_offsets.size(); ++n) {
+            const double d = read_float(vertices + a * stride + attribute_offsets[n]) - read_float(vertices + b * stride + attribute_offsets[n]);
+            cost += attribute_weights[n] * d * d;
+        }
+        return cost * attribute_scale;
+    };
+
+    std::vector<uint32_t> remap(vertex_count);
+    for(size_t v = 0; v < vertex_count; ++v) {
+        remap[v] = static_cast<uint32_t>(v);
+    }
+    std::vector<uint32_t> ring_start(vertex_count + 1);
+    std::vector<uint32_t> ring;
+    std::vector<uint8_t> border(vertex_count);
+    std::vector<uint8_t> locked(vertex_count);
+    std::vector<uint8_t> touched(vertex_count);
+    std::vector<collapse> candidates;
+    std::unordered_map<uint64_t, uint32_t> edges;
+    double result_error = 0.0;
+    const double target_cost = double(target_error) * target_error;
+
+    // Each pass collapses the cheapest edges whose neighbourhoods don't
+    // overlap, so every check in a pass sees the triangles as they are.
+    while(indices.size() > target_index_count) {
+        edges.clear();
+        for(size_t t = 0; t < indices.size(); t += 3) {
+            for(size_t e = 0; e < 3; ++e) {
+                ++edges[edge_key(position_id[indices[t + e]], position_id[indices[t + (e + 1) % 3]])];
+            }
+        }
+        std::fill(border.begin(), border.end(), 0);
+        std::fill(locked.begin(), locked.end(), 0);
+        for(const auto& [key, count] : edges) {
+            const uint32_t a = static_cast<uint32_t>(key >> 32);
+            const uint32_t b = static_cast<uint32_t>(key);
+            if(count == 1) {
+                border[a] = border[b] = 1;
+            } else if(count > 2) {
+                locked[a] = locked[b] = 1;
+            }
+        }
+
+        std::fill(ring_start.begin(), ring_start.end(), 0);
+        for(uint32_t v : indices) {
+            ++ring_start[v + 1];
+        }
+        for(size_t v = 0; v < vertex_count; ++v) {
+            ring_start[v + 1] += ring_start[v];
+        }
+        ring.resize(indices.size());
+        {
+            std::vector<uint32_t> fill(ring_start.begin(), ring_start.end() - 1);
+            for(size_t i = 0; i < indices.size(); ++i) {
+                ring[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // Only positions with a single vertex move, seams between attributes stay where they are.
+        candidates.clear();
+        auto consider = [&](uint32_t from, uint32_t to) {
+            const uint32_t pf = position_id[from];
+            const uint32_t pt = position_id[to];
+            if(pf == pt || wedges[pf] > 1 || locked[pf]) {
+                return;
+            }
+            // Open edges only slide along themselves.
+            if(border[pf] && edges[edge_key(pf, pt)] != 1) {
+                return;
+            }
+            const double error = quadrics[pf].error(positions[to]) / std::max(areas[pf], 1e-20);
+            candidates.push_back({ from, to, error + attribute_cost(from, to), error });
+        };
+        for(size_t t = 0; t < indices.size(); t += 3) {
+            for(size_t e = 0; e < 3; ++e) {
+                consider(indices[t + e], indices[t + (e + 1) % 3]);
+                consider(indices[t + (e + 1) % 3], indices[t + e]);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const collapse& a, const collapse& b) { return a.cost_ < b.cost_; });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        const size_t goal = (indices.size() - target_index_count) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+        for(const collapse& c : candidates) {
+            if(removed >= goal) {
+                break;
+            }
+            if(c.error_ > target_cost) {
+                continue;
+            }
+            const uint32_t pf = position_id[c.from_];
+            const uint32_t pt = position_id[c.to_];
+            if(touched[pf] || touched[pt]) {
+                continue;
+            }
+            size_t shared = 0;
+            bool flips = false;
+            for(uint32_t r = ring_start[c.from_]; r < ring_start[c.from_ + 1] && !flips; ++r) {
+                const uint32_t* tri = &indices[size_t(ring[r]) * 3];
+                if(position_id[tri[0]] == pt || position_id[tri[1]] == pt || position_id[tri[2]] == pt) {
+                    ++shared;
+                    continue;
+                }
+                glm::dvec3 p[3] = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+                const glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for(size_t k = 0; k < 3; ++k) {
+                    if(tri[k] == c.from_) {
+                        p[k] = positions[c.to_];
+                    }
+                }
+                const glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                const double lengths = glm::length(before) * glm::length(after);
+                flips = lengths <= 0.0 || glm::dot(before, after) < min_normal_dot * lengths;
+            }
+            // Anything but two shared triangles, one on an open edge, would pinch the surface.
+            if(flips || shared != (border[pf] ? 1u : 2u)) {
+                continue;
+            }
+
+            remap[c.from_] = c.to_;
+            quadrics[pt].add(quadrics[pf]);
+            areas[pt] += areas[pf];
+            for(uint32_t r = ring_start[c.from_]; r < ring_start[c.from_ + 1]; ++r) {
+                const uint32_t* tri = &indices[size_t(ring[r]) * 3];
+                touched[position_id[tri[0]]] = touched[position_id[tri[1]]] = touched[position_id[tri[2]]] = 1;
+            }
+            removed += shared;
+            result_error = std::max(result_error, c.error_);
+            ++applied;
+        }
+        if(applied == 0) {
+            break;
+        }
+
+        size_t out = 0;
+        for(size_t t = 0; t < indices.size(); t += 3) {
+            const uint32_t a = remap[indices[t]];
+            const uint32_t b = remap[indices[t + 1]];
+            const uint32_t c = remap[indices[t + 2]];
+            if(position_id[a] == position_id[b] || position_id[b] == position_id[c] || position_id[a] == position_id[c]) {
+                continue;
+            }
+            indices[out++] = a;
+            indices[out++] = b;
+            indices[out++] = c;
+        }
+        indices.resize(out);
+    }
+    return static_cast<float>(std::sqrt(result_error));
+}
+
+void build_lods(mesh_data& mesh, const lod_options& opts)
+{
+    TR_PROFILE_ZONE("build lods");
+    mesh.lods_.assign(1, mesh_lod{ 0, mesh.index_count_, 0.0f });
+    const vertex_format* position = find_float_attribute(mesh.formats_, mesh_position, 3);
+    if(position == nullptr || opts.levels_ == 0 || mesh.index_count_ == 0) {
+        return;
+    }
+    std::vector<size_t> offsets;
+    std::vector<float> weights;
+    if(const vertex_format* normal = find_float_attribute(mesh.formats_, mesh_normal, 3); normal != nullptr && opts.normal_weight_ > 0.0f) {
+        for(size_t c = 0; c < 3; ++c) {
+            offsets.push_back(normal->offset_ + c * sizeof(float));
+            weights.push_back(opts.normal_weight_);
+        }
+    }
+    if(const vertex_format* texcoord = find_float_attribute(mesh.formats_, mesh_texcoord, 2); texcoord != nullptr && opts.texcoord_weight_ > 0.0f) {
+        for(size_t c = 0; c < 2; ++c) {
+            offsets.push_back(texcoord->offset_ + c * sizeof(float));
+            weights.push_back(opts.texcoord_weight_);
+        }
+    }
+
+    const size_t index_size = mesh.index_format_ == data_format::UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    std::vector<uint32_t> current = read_indices(mesh, 0, mesh.index_count_);
+
+    const float max_error = opts.max_error_ * 0.5f * glm::length(mesh.bounds_max_ - mesh.bounds_min_);
+    float error = 0.0f;
+    for(size_t level = 0; level < opts.levels_; ++level) {
+        if(current.size() <= opts.min_triangles_ * 3 || error >= max_error) {
+            break;
+        }
+        const size_t target = std::max(static_cast<size_t>(current.size() / 3 * opts.reduction_), opts.min_triangles_) * 3;
+        std::vector<uint32_t> next = current;
+        // Each level is simplified from the last, so the errors add up.
+        const float level_error = simplify(mesh.vertices_.data(), mesh.vertex_count_, mesh.stride_, position->offset_, offsets, weights, next, target, max_error - error);
+        if(next.empty() || next.size() * 10 > current.size() * 9) {
+            break;
+        }
+        error += level_error;
+
+        mesh_lod& lod = mesh.lods_.emplace_back();
+        lod.first_index_ = mesh.indices_.size() / index_size;
+        lod.index_count_ = next.size();
+        lod.error_ = error;
+        write_indices(mesh, lod.first_index_, next);
+        current = std::move(next);
+    }
+    spdlog::debug("Mesh \"{}\" has {} levels of detail, {} to {} triangles", mesh.name_, mesh.lods_.size(),
+        mesh.lods_.front().index_count_ / 3, mesh.lods_.back().index_count_ / 3);
+}
+
+float projected_scale(const glm::mat4& model_view_projection, const glm::vec3& centre, const glm::vec2& viewport)
+{
+    const glm::vec4 clip = model_view_projection * glm::vec4(centre, 1.0f);
+    // Behind the eye nothing is seen, the coarsest level will do.
+    if(clip.w <= 0.0f) {
+        return 0.0f;
+    }
+    float stretch = 0.0f;
+    for(int axis = 0; axis < 3; ++axis) {
+        const glm::vec2 d(model_view_projection[axis].x * viewport.x, model_view_projection[axis].y * viewport.y);
+        stretch = std::max(stretch, glm::length(d));
+    }
+    // Clip space spans 2 units across the viewport.
+    return 0.5f * stretch / clip.w;
+}
+
+size_t select_lod(std::span<const mesh_lod> lods, float pixels_per_unit, float max_error_pixels)
+{
+    for(size_t n = lods.size(); n-- > 1;) {
+        if(lods[n].error_ * pixels_per_unit <= max_error_pixels) {
+            return n;
+        }
+    }
+    return 0;
+}
+
+}
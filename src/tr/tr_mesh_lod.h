@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace tr {
+
+struct mesh_data;
+
+/// @brief One level of detail, a range of a mesh's indices over its shared vertices.
+struct mesh_lod
+{
+    size_t first_index_{ 0 };
+    size_t index_count_{ 0 };
+    /// @brief The furthest, in object units, the level strays from the full mesh.
+    float error_{ 0.0f };
+};
+
+struct lod_options
+{
+    /// @brief Levels generated after the full mesh, 0 for none.
+    size_t levels_{ 0 };
+    /// @brief The fraction of the previous level's triangles each level aims for.
+    float reduction_{ 0.5f };
+    /// @brief The largest error allowed, as a fraction of the mesh's bounding radius.
+    float max_error_{ 0.05f };
+    /// @brief Weights of a change in normal and in texture co-ordinate against a change in position.
+    float normal_weight_{ 0.5f };
+    float texcoord_weight_{ 1.0f };
+    /// @brief Levels aren't made with fewer triangles than this.
+    size_t min_triangles_{ 16 };
+};
+
+/// @brief Simplifies triangles by collapsing edges onto existing vertices, in
+/// order of quadric error plus the weighted change in attributes. Only the
+/// quadric error is held to \c target_error, the attributes decide the order.
+/// @param position_offset Where three floats of position are in each \c stride bytes.
+/// @param attribute_offsets Floats compared when collapsing, each weighted by \c attribute_weights, may be empty.
+/// @param indices Triangles, replaced by the simplified ones.
+/// @return The error of the result, in the positions' units.
+float simplify(const uint8_t* vertices, size_t vertex_count, size_t stride, size_t position_offset, std::span<const size_t> attribute_offsets,
+    std::span<const float> attribute_weights, std::vector<uint32_t>& indices, size_t target_index_count, float target_error);
+
+/// @brief Appends a chain of simplified levels to a mesh's indices, filling \c mesh.lods_,
+/// whose first level is always the full mesh. Stops early once a level barely shrinks.
+void build_lods(mesh_data& mesh, const lod_options& opts);
+
+/// @brief Pixels covered by one object unit at \c centre, along the axis the projection stretches most.
+float projected_scale(const glm::mat4& model_view_projection, const glm::vec3& centre, const glm::vec2& viewport);
+/// @brief The coarsest level whose error, projected, is within \c max_error_pixels.
+size_t select_lod(std::span<const mesh_lod> lods, float pixels_per_unit, float max_error_pixels);
+
+}
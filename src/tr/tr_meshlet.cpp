@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+#include "tr_meshlet.h"
+#include "tr_scene_import.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Below this the triangles spread over more than a hemisphere, near enough, and the cone is useless.
+    constexpr float min_cone_spread = 0.1f;
+
+    glm::vec3 read_position(const uint8_t* vertices, size_t stride, size_t position_offset, uint32_t index)
+    {
+        float p[3];
+        std::memcpy(p, vertices + index * stride + position_offset, sizeof(p));
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    void compute_bounds(meshlet& m, const uint8_t* vertices, size_t stride, size_t position_offset, std::span<const uint32_t> indices)
+    {
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(std::numeric_limits<float>::lowest());
+        for(uint32_t index : indices) {
+            const glm::vec3 p = read_position(vertices, stride, position_offset, index);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        m.centre_ = (lo + hi) * 0.5f;
+        float radius = 0.0f;
+        for(uint32_t index : indices) {
+            radius = std::max(radius, glm::distance(m.centre_, read_position(vertices, stride, position_offset, index)));
+        }
+        m.radius_ = radius;
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(indices.size() / 3);
+        glm::vec3 sum(0.0f);
+        for(size_t t = 0; t + 2 < indices.size(); t += 3) {
+            const glm::vec3 p0 = read_position(vertices, stride, position_offset, indices[t]);
+            const glm::vec3 p1 = read_position(vertices, stride, position_offset, indices[t + 1]);
+            const glm::vec3 p2 = read_position(vertices, stride, position_offset, indices[t + 2]);
+            const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            const float length = glm::length(n);
+            if(length > 0.0f) {
+                normals.push_back(n / length);
+                sum += n / length;
+            }
+        }
+        const float length = glm::length(sum);
+        if(normals.empty() || length <= 0.0f) {
+            m.cone_axis_ = glm::vec3(0.0f, 0.0f, 1.0f);
+            m.cone_cutoff_ = 1.0f;
+            return;
+        }
+        m.cone_axis_ = sum / length;
+        float spread = 1.0f;
+        for(const auto& n : normals) {
+            spread = std::min(spread, glm::dot(n, m.cone_axis_));
+        }
+        m.cone_cutoff_ = spread <= min_cone_spread ? 1.0f : std::sqrt(1.0f - spread * spread);
+    }
+}
+
+std::vector<meshlet> build_meshlets(const uint8_t* vertices, size_t stride, size_t position_offset, std::vector<uint32_t>& indices,
+    const meshlet_options& opts)
+{
+    TR_PROFILE_ZONE("build meshlets");
+    const size_t triangles = indices.size() / 3;
+    uint32_t vertex_count = 0;
+    for(uint32_t index : indices) {
+        vertex_count = std::max(vertex_count, index + 1);
+    }
+
+    // Triangles using each vertex.
+    std::vector<uint32_t> adjacency_start(vertex_count + 1, 0);
+    for(uint32_t index : indices) {
+        ++adjacency_start[index + 1];
+    }
+    for(size_t v = 0; v < vertex_count; ++v) {
+        adjacency_start[v + 1] += adjacency_start[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(adjacency_start.begin(), adjacency_start.end() - 1);
+        for(size_t i = 0; i < indices.size(); ++i) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<meshlet> meshlets;
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    std::vector<uint8_t> used(triangles, 0);
+    // The meshlet a vertex was last added to, one more than its index so 0 is none.
+    std::vector<uint32_t> stamp(vertex_count, 0);
+    std::vector<uint32_t> candidates;
+
+    for(size_t seed = 0; seed < triangles; ++seed) {
+        if(used[seed]) {
+            continue;
+        }
+        meshlet& m = meshlets.emplace_back();
+        const uint32_t id = static_cast<uint32_t>(meshlets.size());
+        m.first_index_ = static_cast<uint32_t>(out.size());
+        candidates.clear();
+
+        auto new_vertices = [&](size_t t) {
+            uint32_t count = 0;
+            for(size_t k = 0; k < 3; ++k) {
+                count += stamp[indices[t * 3 + k]] != id ? 1 : 0;
+            }
+            return count;
+        };
+        auto add = [&](size_t t) {
+            used[t] = 1;
+            for(size_t k = 0; k < 3; ++k) {
+                const uint32_t v = indices[t * 3 + k];
+                out.push_back(v);
+                if(stamp[v] != id) {
+                    stamp[v] = id;
+                    ++m.vertex_count_;
+                    for(uint32_t a = adjacency_start[v]; a < adjacency_start[v + 1]; ++a) {
+                        if(!used[adjacency[a]]) {
+                            candidates.push_back(adjacency[a]);
+                        }
+                    }
+                }
+            }
+            m.index_count_ += 3;
+        };
+
+        add(seed);
+        while(m.index_count_ / 3 < opts.max_triangles_) {
+            // Take the neighbour adding the fewest vertices, dropping those used since they were found.
+            size_t best = SIZE_MAX;
+            uint32_t best_new = 4;
+            size_t kept = 0;
+            for(uint32_t t : candidates) {
+                if(used[t]) {
+                    continue;
+                }
+                candidates[kept++] = t;
+                const uint32_t added = new_vertices(t);
+                if(added < best_new) {
+                    best_new = added;
+                    best = t;
+                }
+            }
+            candidates.resize(kept);
+            if(best == SIZE_MAX || m.vertex_count_ + best_new > opts.max_vertices_) {
+                break;
+            }
+            add(best);
+        }
+        compute_bounds(m, vertices, stride, position_offset, std::span<const uint32_t>(out).subspan(m.first_index_, m.index_count_));
+    }
+    indices.swap(out);
+    return meshlets;
+}
+
+void build_meshlets(mesh_data& mesh, const meshlet_options& opts)
+{
+    mesh.meshlets_.clear();
+    const vertex_format* position = nullptr;
+    for(const auto& f : mesh.formats_) {
+        if(f.attrib_ == mesh_position && f.type_ == data_format::FLOAT32 && f.count_ == 3) {
+            position = &f;
+        }
+    }
+    if(position == nullptr || mesh.index_count_ == 0) {
+        return;
+    }
+    std::vector<uint32_t> indices = read_indices(mesh, 0, mesh.index_count_);
+    mesh.meshlets_ = build_meshlets(mesh.vertices_.data(), mesh.stride_, position->offset_, indices, opts);
+    write_indices(mesh, 0, indices);
+    spdlog::debug("Mesh \"{}\" has {} meshlets, {:.1f} triangles each", mesh.name_, mesh.meshlets_.size(),
+        static_cast<double>(mesh.index_count_ / 3) / static_cast<double>(std::max<size_t>(mesh.meshlets_.size(), 1)));
+}
+
+void cull_meshlets(std::span<const meshlet> meshlets, const frustum& view, std::vector<index_range>& visible, cull_stats& stats)
+{
+    const glm::vec3 eye(view.eye_.x, view.eye_.y, view.eye_.z);
+    const bool orthographic = view.eye_.w == 0.0f;
+    stats.meshlets_ += meshlets.size();
+    for(const auto& m : meshlets) {
+        if(!view.intersects(m.centre_, m.radius_)) {
+            ++stats.frustum_culled_;
+            continue;
+        }
+        // Every triangle faces away if the view direction is within the cone's
+        // cutoff of its axis, from anywhere on the bounding sphere.
+        if(m.cone_cutoff_ < 1.0f) {
+            bool back_facing;
+            if(orthographic) {
+                back_facing = glm::dot(-eye, m.cone_axis_) >= m.cone_cutoff_;
+            } else {
+                const glm::vec3 d = m.centre_ - eye;
+                back_facing = glm::dot(d, m.cone_axis_) >= m.cone_cutoff_ * glm::length(d) + m.radius_;
+            }
+            if(back_facing) {
+                ++stats.backface_culled_;
+                continue;
+            }
+        }
+        stats.triangles_ += m.index_count_ / 3;
+        if(!visible.empty() && visible.back().first_ + visible.back().count_ == m.first_index_) {
+            visible.back().count_ += m.index_count_;
+        } else {
+            visible.push_back({ m.first_index_, m.index_count_ });
+        }
+    }
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "tr_frustum.h"
+#include "tr_vertex.h"
+
+namespace tr {
+
+struct mesh_data;
+
+/// @brief A small cluster of triangles, a contiguous range of its mesh's indices.
+struct meshlet
+{
+    uint32_t first_index_{ 0 };
+    uint32_t index_count_{ 0 };
+    uint32_t vertex_count_{ 0 };
+    glm::vec3 centre_{ 0.0f };
+    float radius_{ 0.0f };
+    /// @brief The average facing of the triangles.
+    glm::vec3 cone_axis_{ 0.0f, 0.0f, 1.0f };
+    /// @brief The sine of the widest angle between a triangle's normal and the axis, 1 if the
+    /// triangles face too many ways for the cluster to ever be wholly back facing.
+    float cone_cutoff_{ 1.0f };
+};
+
+struct meshlet_options
+{
+    size_t max_vertices_{ 64 };
+    /// @brief 124 rather than 128 keeps the local indices of a cluster within 384 bytes as mesh shaders like.
+    size_t max_triangles_{ 124 };
+};
+
+/// @brief Groups triangles into meshlets and reorders \c indices so each is one contiguous range.
+/// Clusters grow from a seed across shared vertices, taking the triangle that adds the fewest new
+/// vertices next, so they stay compact and their bounds tight.
+std::vector<meshlet> build_meshlets(const uint8_t* vertices, size_t stride, size_t position_offset, std::vector<uint32_t>& indices,
+    const meshlet_options& opts = { });
+/// @brief Splits a mesh's full detail indices into meshlets, filling \c mesh.meshlets_.
+void build_meshlets(mesh_data& mesh, const meshlet_options& opts = { });
+
+struct cull_stats
+{
+    size_t meshlets_{ 0 };
+    size_t frustum_culled_{ 0 };
+    size_t backface_culled_{ 0 };
+    size_t triangles_{ 0 };
+};
+
+/// @brief Appends the ranges of the meshlets that may be seen, those outside the frustum or
+/// facing wholly away from its eye are dropped and neighbours are merged so fewer are drawn.
+/// @param view Frustum in the meshlets' object space.
+void cull_meshlets(std::span<const meshlet> meshlets, const frustum& view, std::vector<index_range>& visible, cull_stats& stats);
+
+}
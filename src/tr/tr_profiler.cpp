@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <json.hpp>
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+
+#include "tr_profiler.h"
+
+namespace tr {
+namespace profiler {
+
+namespace {
+    using clock = std::chrono::steady_clock;
+
+    /// @brief Zones a thread can record between two calls to end_frame(), must be a power of two.
+    constexpr size_t ring_capacity = 1 << 14;
+    /// @brief Frames kept for display and export.
+    constexpr size_t max_frames = 300;
+    /// @brief Frames of GPU queries in flight before results are abandoned.
+    constexpr size_t gpu_frames_in_flight = 5;
+
+    const clock::time_point epoch = clock::now();
+
+    // Single producer, the thread that owns it, and a single consumer, end_frame().
+    struct zone_ring
+    {
+        std::array<zone, ring_capacity> zones_{ };
+        std::atomic<size_t> head_{ 0 };
+        std::atomic<size_t> tail_{ 0 };
+        uint32_t thread_id_{ 0 };
+        /// @brief Guarded by the registry mutex.
+        std::string name_{ };
+
+        bool push(const zone& z)
+        {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            if(head - tail_.load(std::memory_order_acquire) == ring_capacity) {
+                return false;
+            }
+            zones_[head & (ring_capacity - 1)] = z;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        template<typename F>
+        void drain(F&& fn)
+        {
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            const size_t head = head_.load(std::memory_order_acquire);
+            for(size_t n = tail; n != head; ++n) {
+                fn(zones_[n & (ring_capacity - 1)]);
+            }
+            tail_.store(head, std::memory_order_release);
+        }
+    };
+
+    struct registry
+    {
+        std::mutex mutex_;
+        /// @brief Rings live as long as the process, threads are expected to be long lived.
+        std::vector<std::unique_ptr<zone_ring>> rings_{ };
+        uint32_t next_id_{ 1 };
+    };
+
+    registry& get_registry()
+    {
+        static registry r;
+        return r;
+    }
+
+    thread_local zone_ring* local_ring = nullptr;
+    thread_local uint32_t local_depth = 0;
+
+    zone_ring& get_ring()
+    {
+        if(local_ring == nullptr) {
+            auto& r = get_registry();
+            std::lock_guard lock(r.mutex_);
+            r.rings_.emplace_back(std::make_unique<zone_ring>());
+            local_ring = r.rings_.back().get();
+            local_ring->thread_id_ = r.next_id_++;
+            local_ring->name_ = fmt::format("thread {}", local_ring->thread_id_);
+        }
+        return *local_ring;
+    }
+
+    std::atomic<bool> is_enabled{ true };
+    std::atomic<bool> is_paused{ false };
+    std::atomic<size_t> dropped{ 0 };
+
+    // Everything below is only touched on the thread that owns the GL context.
+
+    struct gpu_record
+    {
+        const char* name_{ nullptr };
+        uint32_t depth_{ 0 };
+    };
+
+    struct gpu_pool
+    {
+        /// @brief Two timestamp queries per zone, begin and end.
+        std::vector<unsigned> queries_{ };
+        std::vector<gpu_record> zones_{ };
+        uint64_t frame_index_{ 0 };
+        /// @brief CPU minus GPU clock, sampled when the first zone was opened.
+        int64_t offset_ns_{ 0 };
+        bool pending_{ false };
+    };
+
+    std::array<gpu_pool, gpu_frames_in_flight> gpu_pools{ };
+    size_t gpu_current = 0;
+    uint32_t gpu_depth = 0;
+
+    /// @brief Guards the history, which the UI may read from another thread.
+    std::mutex history_mutex;
+    std::deque<frame> history{ };
+    frame current{ };
+
+    frame* find_frame(uint64_t index)
+    {
+        for(auto it = history.rbegin(); it != history.rend(); ++it) {
+            if(it->index_ == index) {
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    void reset_pool(gpu_pool& pool)
+    {
+        pool.zones_.clear();
+        pool.pending_ = false;
+    }
+
+    /// @brief Reads back pools whose queries have completed, oldest first.
+    void resolve_gpu()
+    {
+        for(size_t n = 0; n < gpu_frames_in_flight; ++n) {
+            gpu_pool& pool = gpu_pools[(gpu_current + n) % gpu_frames_in_flight];
+            if(!pool.pending_) {
+                continue;
+            }
+
+            // Queries complete in order, if the last isn't ready neither are newer pools.
+            GLint available = 0;
+            glGetQueryObjectiv(pool.queries_[pool.zones_.size() * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available) {
+                break;
+            }
+
+            frame* f = find_frame(pool.frame_index_);
+            if(f != nullptr) {
+                for(size_t z = 0; z < pool.zones_.size(); ++z) {
+                    GLuint64 begin = 0;
+                    GLuint64 end = 0;
+                    glGetQueryObjectui64v(pool.queries_[z * 2], GL_QUERY_RESULT, &begin);
+                    glGetQueryObjectui64v(pool.queries_[z * 2 + 1], GL_QUERY_RESULT, &end);
+                    zone gz;
+                    gz.name_ = pool.zones_[z].name_;
+                    gz.start_ns_ = static_cast<uint64_t>(static_cast<int64_t>(begin) + pool.offset_ns_);
+                    gz.end_ns_ = static_cast<uint64_t>(static_cast<int64_t>(end) + pool.offset_ns_);
+                    gz.depth_ = pool.zones_[z].depth_;
+                    gz.thread_id_ = gpu_thread_id;
+                    f->gpu_.emplace_back(gz);
+                }
+                f->gpu_resolved_ = true;
+            }
+            reset_pool(pool);
+        }
+    }
+}
+
+uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count());
+}
+
+void set_enabled(bool enabled)
+{
+    is_enabled = enabled;
+}
+
+bool enabled()
+{
+    return is_enabled;
+}
+
+void set_paused(bool paused)
+{
+    is_paused = paused;
+}
+
+bool paused()
+{
+    return is_paused;
+}
+
+void set_thread_name(std::string_view name)
+{
+    zone_ring& ring = get_ring();
+    std::lock_guard lock(get_registry().mutex_);
+    ring.name_ = name;
+}
+
+void end_frame()
+{
+    const uint64_t now = now_ns();
+
+    // Hand the current pool over to be resolved and move on to the next one.
+    gpu_pool& pool = gpu_pools[gpu_current];
+    if(!pool.zones_.empty()) {
+        pool.pending_ = true;
+        pool.frame_index_ = current.index_;
+    } else {
+        current.gpu_resolved_ = true;
+    }
+    gpu_current = (gpu_current + 1) % gpu_frames_in_flight;
+
+    current.end_ns_ = now;
+    {
+        auto& r = get_registry();
+        std::lock_guard lock(r.mutex_);
+        for(auto& ring : r.rings_) {
+            ring->drain([](const zone& z) {
+                current.cpu_.emplace_back(z);
+            });
+        }
+    }
+
+    std::lock_guard lock(history_mutex);
+    const uint64_t next_index = current.index_ + 1;
+    if(!is_paused) {
+        history.emplace_back(std::move(current));
+        while(history.size() > max_frames) {
+            history.pop_front();
+        }
+    }
+    current = frame{ };
+    current.index_ = next_index;
+    current.start_ns_ = now;
+
+    resolve_gpu();
+
+    // The pool about to be reused must be free, if the GPU is that far behind drop its results.
+    gpu_pool& next = gpu_pools[gpu_current];
+    if(next.pending_) {
+        reset_pool(next);
+    }
+}
+
+std::unique_lock<std::mutex> lock_frames()
+{
+    return std::unique_lock(history_mutex);
+}
+
+const std::deque<frame>& frames()
+{
+    return history;
+}
+
+const frame* last_resolved_frame()
+{
+    for(auto it = history.rbegin(); it != history.rend(); ++it) {
+        if(it->gpu_resolved_) {
+            return &*it;
+        }
+    }
+    return history.empty() ? nullptr : &history.back();
+}
+
+std::vector<thread_info> threads()
+{
+    std::vector<thread_info> result;
+    auto& r = get_registry();
+    std::lock_guard lock(r.mutex_);
+    for(auto& ring : r.rings_) {
+        result.emplace_back(thread_info{ ring->thread_id_, ring->name_ });
+    }
+    return result;
+}
+
+size_t dropped_zones()
+{
+    return dropped;
+}
+
+void shutdown()
+{
+    for(auto& pool : gpu_pools) {
+        if(!pool.queries_.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(pool.queries_.size()), pool.queries_.data());
+            pool.queries_.clear();
+        }
+        reset_pool(pool);
+    }
+}
+
+bool write_chrome_trace(std::string_view filename)
+{
+    std::ofstream f{ std::string(filename) };
+    if(!f.is_open()) {
+        spdlog::error("Unable to write trace to \"{}\"", filename);
+        return false;
+    }
+
+    f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto write_event = [&](const std::string& event) {
+        f << (first ? "" : ",\n") << event;
+        first = false;
+    };
+
+    // Metadata so the viewer shows thread names rather than numbers.
+    for(const auto& t : threads()) {
+        write_event(fmt::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":{}}}}})", t.id_, nlohmann::json(t.name_).dump()));
+    }
+    write_event(fmt::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"GPU"}}}})", gpu_thread_id));
+
+    std::lock_guard lock(history_mutex);
+    auto write_zone = [&](const zone& z) {
+        write_event(fmt::format(R"({{"name":{},"ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+            nlohmann::json(z.name_).dump(), z.thread_id_, z.start_ns_ / 1000.0, (z.end_ns_ - z.start_ns_) / 1000.0));
+    };
+    for(const auto& fr : history) {
+        for(const auto& z : fr.cpu_) {
+            write_zone(z);
+        }
+        for(const auto& z : fr.gpu_) {
+            write_zone(z);
+        }
+    }
+    f << "\n]}\n";
+
+    spdlog::info("Wrote {} frames of profiling data to \"{}\"", history.size(), filename);
+    return true;
+}
+
+cpu_zone::cpu_zone(const char* name)
+    : name_(name)
+{
+    if(is_enabled.load(std::memory_order_relaxed)) {
+        active_ = true;
+        depth_ = local_depth++;
+        start_ns_ = now_ns();
+    }
+}
+
+cpu_zone::~cpu_zone()
+{
+    end();
+}
+
+void cpu_zone::end()
+{
+    if(active_) {
+        active_ = false;
+        zone z;
+        z.name_ = name_;
+        z.start_ns_ = start_ns_;
+        z.end_ns_ = now_ns();
+        z.depth_ = depth_;
+        --local_depth;
+        zone_ring& ring = get_ring();
+        z.thread_id_ = ring.thread_id_;
+        if(!ring.push(z)) {
+            ++dropped;
+        }
+    }
+}
+
+gpu_zone::gpu_zone(const char* name)
+{
+    if(!is_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    gpu_pool& pool = gpu_pools[gpu_current];
+    if(pool.zones_.empty()) {
+        // Relate the GPU clock to ours once per frame, converting the results later.
+        GLint64 gpu_now = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+        pool.offset_ns_ = static_cast<int64_t>(now_ns()) - static_cast<int64_t>(gpu_now);
+    }
+
+    index_ = static_cast<int>(pool.zones_.size());
+    const size_t needed = (pool.zones_.size() + 1) * 2;
+    if(pool.queries_.size() < needed) {
+        const size_t old_size = pool.queries_.size();
+        pool.queries_.resize(std::max<size_t>(needed, old_size * 2));
+        glGenQueries(static_cast<GLsizei>(pool.queries_.size() - old_size), pool.queries_.data() + old_size);
+    }
+    pool.zones_.emplace_back(gpu_record{ name, gpu_depth++ });
+    glQueryCounter(pool.queries_[index_ * 2], GL_TIMESTAMP);
+}
+
+gpu_zone::~gpu_zone()
+{
+    if(index_ >= 0) {
+        --gpu_depth;
+        glQueryCounter(gpu_pools[gpu_current].queries_[index_ * 2 + 1], GL_TIMESTAMP);
+    }
+}
+
+}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Frame profiler with CPU and GPU zones.
+//
+// CPU zones are recorded with TR_PROFILE_ZONE("name") into a lock-free ring
+// owned by the recording thread, so recording never contends with other
+// threads. A zone that ends before its scope does is declared with
+// TR_PROFILE_NAMED_ZONE(var, "name") and closed with TR_PROFILE_END_ZONE(var). The rings are drained once per frame by end_frame().
+//
+// GPU zones (TR_PROFILE_GPU_ZONE) issue a pair of GL_TIMESTAMP queries from a
+// per-frame pool. Pools are only read once the driver reports their results
+// available, several frames later, so the profiler never stalls the pipeline.
+//
+// Zone names must be string literals, or otherwise outlive the profiler, as
+// only the pointer is recorded.
+//
+// With TR_PROFILER defined to 0 the macros compile to nothing.
+
+#ifndef TR_PROFILER
+#define TR_PROFILER 1
+#endif
+
+namespace tr {
+namespace profiler {
+
+/// @brief Identifier used for the GPU in place of a thread id.
+constexpr uint32_t gpu_thread_id = 0xFFFF;
+
+struct zone
+{
+    const char* name_{ nullptr };
+    /// @brief Start and end in nanoseconds since the profiler started.
+    uint64_t start_ns_{ 0 };
+    uint64_t end_ns_{ 0 };
+    /// @brief Nesting depth, 0 for an outermost zone.
+    uint32_t depth_{ 0 };
+    uint32_t thread_id_{ 0 };
+};
+
+struct frame
+{
+    uint64_t index_{ 0 };
+    uint64_t start_ns_{ 0 };
+    uint64_t end_ns_{ 0 };
+    std::vector<zone> cpu_{ };
+    /// @brief Filled in several frames after the frame itself completed.
+    std::vector<zone> gpu_{ };
+    bool gpu_resolved_{ false };
+};
+
+struct thread_info
+{
+    uint32_t id_{ 0 };
+    std::string name_{ };
+};
+
+/// @brief Nanoseconds since the profiler started.
+uint64_t now_ns();
+
+void set_enabled(bool enabled);
+bool enabled();
+/// @brief Pauses collection of new frames, the history is kept for inspection.
+void set_paused(bool paused);
+bool paused();
+/// @brief Names the calling thread in the views and exported traces.
+void set_thread_name(std::string_view name);
+
+/// @brief Marks the end of a frame. Must be called on the thread owning the GL context.
+void end_frame();
+/// @brief Locks the frame history against \c end_frame(). Hold it while using the results of
+/// \c frames() and \c last_resolved_frame() when frames end on another thread.
+std::unique_lock<std::mutex> lock_frames();
+/// @brief Frames kept for display and export, oldest first.
+const std::deque<frame>& frames();
+/// @brief The newest frame with its GPU zones resolved, or nullptr.
+const frame* last_resolved_frame();
+std::vector<thread_info> threads();
+/// @brief Zones lost because a thread's ring was full.
+size_t dropped_zones();
+/// @brief Releases the GPU queries, call while the GL context is still current.
+void shutdown();
+
+/// @brief Writes the retained frames in the Chrome trace event format,
+/// viewable in chrome://tracing or Perfetto.
+bool write_chrome_trace(std::string_view filename);
+
+class cpu_zone
+{
+public:
+    explicit cpu_zone(const char* name);
+    ~cpu_zone();
+    /// @brief Records the zone now, going out of scope afterwards records nothing.
+    void end();
+private:
+    const char* name_;
+    uint64_t start_ns_{ 0 };
+    uint32_t depth_{ 0 };
+    bool active_{ false };
+
+    cpu_zone(const cpu_zone&) = delete;
+    cpu_zone& operator=(const cpu_zone&) = delete;
+};
+
+class gpu_zone
+{
+public:
+    explicit gpu_zone(const char* name);
+    ~gpu_zone();
+private:
+    /// @brief Index of the zone within the frame's query pool, -1 if not recording.
+    int index_{ -1 };
+
+    gpu_zone(const gpu_zone&) = delete;
+    gpu_zone& operator=(const gpu_zone&) = delete;
+};
+
+}
+}
+
+#define TR_PROFILE_CONCAT_INNER(a, b) a##b
+#define TR_PROFILE_CONCAT(a, b) TR_PROFILE_CONCAT_INNER(a, b)
+
+#if TR_PROFILER
+#define TR_PROFILE_ZONE(name) ::tr::profiler::cpu_zone TR_PROFILE_CONCAT(tr_profile_zone_, __LINE__){ name }
+#define TR_PROFILE_NAMED_ZONE(var, name) ::tr::profiler::cpu_zone var{ name }
+#define TR_PROFILE_END_ZONE(var) var.end()
+#define TR_PROFILE_GPU_ZONE(name) ::tr::profiler::gpu_zone TR_PROFILE_CONCAT(tr_profile_gpu_zone_, __LINE__){ name }
+#else
+#define TR_PROFILE_ZONE(name)
+#define TR_PROFILE_NAMED_ZONE(var, name)
+#define TR_PROFILE_END_ZONE(var)
+#define TR_PROFILE_GPU_ZONE(name)
+#endif
@@ -0,0 +1,130 @@
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+#include "tr_readback.h"
+#include "tr_framebuffer.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Timeout used when flushing, generous as it is only used at shutdown.
+    constexpr GLuint64 flush_timeout_ns = 1000000000;
+}
+
+async_readback::async_readback(size_t ring_size)
+    : slots_(ring_size)
+{
+    if(ring_size == 0) {
+        spdlog::critical("Readback ring must contain at least one buffer.");
+        std::exit(1);
+    }
+    for(auto& s : slots_) {
+        glGenBuffers(1, &s.pbo_);
+    }
+}
+
+async_readback::~async_readback()
+{
+    for(auto& s : slots_) {
+        if(s.fence_ != nullptr) {
+            glDeleteSync(static_cast<GLsync>(s.fence_));
+        }
+        glDeleteBuffers(1, &s.pbo_);
+    }
+}
+
+bool async_readback::request(const framebuffer& fbo, readback_callback_t callback)
+{
+    if(pending_ == slots_.size()) {
+        return false;
+    }
+
+    slot& s = slots_[write_];
+    s.width_ = fbo.render_width();
+    s.height_ = fbo.render_height();
+    s.sequence_ = sequence_++;
+    s.callback_ = std::move(callback);
+
+    const size_t size = s.width_ * s.height_ * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo_);
+    if(s.capacity_.bytes() < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+        s.capacity_.set(size);
+    }
+
+    // With a pack buffer bound glReadPixels only schedules the copy.
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo.framebuffer_id());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, static_cast<GLsizei>(s.width_), static_cast<GLsizei>(s.height_), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    s.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    write_ = (write_ + 1) % slots_.size();
+    ++pending_;
+    return true;
+}
+
+void async_readback::poll()
+{
+    while(pending_ > 0) {
+        slot& s = slots_[read_];
+        const GLenum status = glClientWaitSync(static_cast<GLsync>(s.fence_), GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(status == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        if(status == GL_WAIT_FAILED) {
+            spdlog::error("Waiting on readback fence failed: {}", glGetError());
+        }
+        complete(s);
+    }
+}
+
+void async_readback::flush()
+{
+    while(pending_ > 0) {
+        slot& s = slots_[read_];
+        if(glClientWaitSync(static_cast<GLsync>(s.fence_), GL_SYNC_FLUSH_COMMANDS_BIT, flush_timeout_ns) == GL_TIMEOUT_EXPIRED) {
+            spdlog::warn("Timed out waiting for readback {}, dropping it.", s.sequence_);
+            glDeleteSync(static_cast<GLsync>(s.fence_));
+            s.fence_ = nullptr;
+            s.callback_ = nullptr;
+            read_ = (read_ + 1) % slots_.size();
+            --pending_;
+            continue;
+        }
+        complete(s);
+    }
+}
+
+void async_readback::complete(slot& s)
+{
+    glDeleteSync(static_cast<GLsync>(s.fence_));
+    s.fence_ = nullptr;
+
+    const size_t size = s.width_ * s.height_ * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo_);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT);
+    if(data != nullptr) {
+        if(s.callback_) {
+            readback_image img;
+            img.width_ = s.width_;
+            img.height_ = s.height_;
+            img.pitch_ = s.width_ * 4;
+            img.pixels_ = static_cast<const uint8_t*>(data);
+            img.sequence_ = s.sequence_;
+            s.callback_(img);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        spdlog::error("Unable to map readback buffer {}: {}", s.sequence_, glGetError());
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    s.callback_ = nullptr;
+    read_ = (read_ + 1) % slots_.size();
+    --pending_;
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+class framebuffer;
+
+/// @brief Pixels returned by an asynchronous read back.
+/// @note The pixels are only valid for the duration of the callback.
+struct readback_image
+{
+    size_t width_{ 0 };
+    size_t height_{ 0 };
+    /// @brief Distance, in bytes, from one row to the next.
+    size_t pitch_{ 0 };
+    /// @brief RGBA8 pixels, bottom row first as OpenGL returns them.
+    const uint8_t* pixels_{ nullptr };
+    /// @brief Sequence number of the request that produced the image.
+    uint64_t sequence_{ 0 };
+};
+
+typedef std::function<void(const readback_image&)> readback_callback_t;
+
+// Reads frame buffer contents back to the CPU without stalling the pipeline.
+// Each request copies the rendered region into a pixel buffer object and drops
+// a fence behind it; poll() maps the buffers whose fence has signalled, which
+// is typically one or more frames later.
+class async_readback
+{
+public:
+    explicit async_readback(size_t ring_size = 4);
+    ~async_readback();
+    /// @brief Queue a read of the rendered region of the frame buffer.
+    /// @return false if every buffer in the ring is still in flight.
+    bool request(const framebuffer& fbo, readback_callback_t callback);
+    /// @brief Completes finished reads, in request order, calling their callbacks.
+    void poll();
+    /// @brief Waits for and completes every outstanding read.
+    void flush();
+    /// @brief Number of reads still in flight.
+    size_t pending() const { return pending_; }
+private:
+    struct slot
+    {
+        unsigned pbo_{ 0 };
+        /// @brief Size of the pack buffer's storage.
+        gpu_allocation capacity_{ memory_tag::capture };
+        void* fence_{ nullptr };
+        size_t width_{ 0 };
+        size_t height_{ 0 };
+        uint64_t sequence_{ 0 };
+        readback_callback_t callback_{ };
+    };
+    /// @brief Maps the oldest slot and hands it to its callback.
+    void complete(slot& s);
+    std::vector<slot> slots_{ };
+    /// @brief Next slot to be written.
+    size_t write_{ 0 };
+    /// @brief Oldest slot still in flight.
+    size_t read_{ 0 };
+    size_t pending_{ 0 };
+    uint64_t sequence_{ 0 };
+
+    async_readback(const async_readback&) = delete;
+    async_readback(async_readback&&) = delete;
+    async_readback& operator=(const async_readback&) = delete;
+    async_readback& operator=(async_readback&&) = delete;
+};
+
+}
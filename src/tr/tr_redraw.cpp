@@ -0,0 +1,56 @@
+#include "tr_redraw.h"
+
+namespace tr {
+
+redraw_scheduler::redraw_scheduler(bool enabled, uint64_t linger_ms, uint32_t max_wait_ms)
+    : enabled_(enabled)
+    , linger_ns_(linger_ms * 1000000)
+    , max_wait_ms_(max_wait_ms)
+{
+    mark_dirty();
+}
+
+void redraw_scheduler::set_enabled(bool enabled)
+{
+    enabled_ = enabled;
+    mark_dirty();
+}
+
+void redraw_scheduler::mark_dirty()
+{
+    dirty_until_ns_ = SDL_GetTicksNS() + linger_ns_;
+}
+
+bool redraw_scheduler::should_render() const
+{
+    return !enabled_ || continuous_ || SDL_GetTicksNS() < dirty_until_ns_;
+}
+
+bool redraw_scheduler::wait(SDL_Event& e)
+{
+    const uint64_t start = SDL_GetTicksNS();
+    const bool has_event = SDL_WaitEventTimeout(&e, static_cast<Sint32>(max_wait_ms_));
+    idle_ns_ += SDL_GetTicksNS() - start;
+    idle_ = true;
+    if(has_event) {
+        mark_dirty();
+    }
+    return has_event;
+}
+
+void redraw_scheduler::sleep_until_event()
+{
+    const uint64_t start = SDL_GetTicksNS();
+    SDL_WaitEvent(nullptr);
+    idle_ns_ += SDL_GetTicksNS() - start;
+    idle_ = true;
+}
+
+void redraw_scheduler::frame_rendered()
+{
+    idle_ = false;
+    continuous_ = false;
+    ++frames_rendered_;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <SDL3/SDL.h>
+
+namespace tr {
+
+// Decides when an event driven loop has to render.
+// When enabled, frames are only drawn while something is dirty: input and
+// explicit mark_dirty() calls keep the loop drawing for a short linger period,
+// long enough for ImGui to settle hover, tooltip and layout state, and
+// continuous work such as a running simulation or a recording keeps it drawing
+// every frame. Otherwise the loop blocks in wait() until the next event. When
+// disabled every frame is drawn, as in the plain game loop.
+class redraw_scheduler
+{
+public:
+    explicit redraw_scheduler(bool enabled = false, uint64_t linger_ms = 500, uint32_t max_wait_ms = 1000);
+    void set_enabled(bool enabled);
+    bool enabled() const { return enabled_; }
+    /// @brief Something changed, keeps drawing for the linger period.
+    void mark_dirty();
+    /// @brief Draw every frame while set, for animation or work in progress. Cleared by \c frame_rendered().
+    void request_continuous() { continuous_ = true; }
+    /// @brief If this iteration of the loop has to draw a frame.
+    bool should_render() const;
+    /// @brief Blocks until the next event or up to \c max_wait_ms, which wakes the loop to re-check pending work.
+    /// @return If an event was stored in \c e, an event also marks the loop dirty.
+    bool wait(SDL_Event& e);
+    /// @brief Blocks until an event is queued, leaving it queued. For when nothing can be drawn, such as while minimised.
+    void sleep_until_event();
+    /// @brief Call after presenting a frame.
+    void frame_rendered();
+
+    /// @brief If the loop waited since the last frame, so frame timing should restart.
+    bool was_idle() const { return idle_; }
+    uint64_t frames_rendered() const { return frames_rendered_; }
+    /// @brief Total time spent blocked in \c wait(), in milliseconds.
+    double idle_ms() const { return static_cast<double>(idle_ns_) / 1e6; }
+private:
+    bool enabled_{ false };
+    uint64_t linger_ns_{ 0 };
+    uint32_t max_wait_ms_{ 1000 };
+    /// @brief SDL_GetTicksNS() until which frames are drawn.
+    uint64_t dirty_until_ns_{ 0 };
+    bool continuous_{ false };
+    bool idle_{ false };
+    uint64_t frames_rendered_{ 0 };
+    uint64_t idle_ns_{ 0 };
+};
+
+}
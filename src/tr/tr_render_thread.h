@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "tr_window.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+// Renders on its own thread, which takes over the window's GL context.
+// The main thread handles events and game logic and submits an immutable
+// snapshot of each frame, the render thread turns the snapshots into GL calls
+// and presents them. Snapshots pass through a bounded queue that counts the
+// one being rendered: with a depth of 2 the main thread builds frame N+1
+// while frame N is submitted and swapped, and blocks in submit() once it is a
+// whole frame ahead, so latency stays bounded. The context is handed back to
+// the constructing thread when this is destroyed.
+//
+// Swapping off the main thread works with SDL on Windows and Linux, not macOS.
+template<typename Snapshot>
+class render_thread
+{
+public:
+    typedef std::function<void(Snapshot&)> render_fn;
+
+    /// @param max_queued Snapshots queued or being rendered before \c submit() blocks, 2 or 3.
+    explicit render_thread(tr_window& wnd, render_fn render, size_t max_queued = 2)
+        : window_(wnd)
+        , render_(std::move(render))
+        , max_queued_(std::max<size_t>(max_queued, 1))
+    {
+        // A context may only be current on one thread at a time.
+        SDL_GL_MakeCurrent(window_.window(), nullptr);
+        thread_ = std::thread(&render_thread::run, this);
+    }
+
+    /// @brief Renders what is still queued, then returns the context to the calling thread.
+    ~render_thread()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        ready_cv_.notify_one();
+        thread_.join();
+        SDL_GL_MakeCurrent(window_.window(), window_.context());
+    }
+
+    /// @brief Queues a snapshot for rendering, blocking while the queue is full.
+    void submit(Snapshot&& snapshot)
+    {
+        const auto start = clock::now();
+        {
+            std::unique_lock lock(mutex_);
+            space_cv_.wait(lock, [this] { return queue_.size() + (busy_ ? 1 : 0) < max_queued_; });
+            queue_.emplace_back(std::move(snapshot));
+        }
+        ready_cv_.notify_one();
+        submit_wait_ms_ = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    /// @brief Blocks until every submitted snapshot has been rendered.
+    void flush()
+    {
+        std::unique_lock lock(mutex_);
+        space_cv_.wait(lock, [this] { return queue_.empty() && !busy_; });
+    }
+
+    /// @brief Snapshots waiting or being rendered.
+    size_t queued() const
+    {
+        std::lock_guard lock(mutex_);
+        return queue_.size() + (busy_ ? 1 : 0);
+    }
+
+    size_t max_queued() const { return max_queued_; }
+    /// @brief Time the last \c submit() was blocked by a full queue, in milliseconds.
+    double submit_wait_ms() const { return submit_wait_ms_; }
+private:
+    using clock = std::chrono::steady_clock;
+
+    void run()
+    {
+        profiler::set_thread_name("render");
+        SDL_GL_MakeCurrent(window_.window(), window_.context());
+
+        std::unique_lock lock(mutex_);
+        while(true) {
+            ready_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if(queue_.empty()) {
+                break;
+            }
+            Snapshot snapshot = std::move(queue_.front());
+            queue_.pop_front();
+            busy_ = true;
+
+            lock.unlock();
+            render_(snapshot);
+            lock.lock();
+
+            busy_ = false;
+            space_cv_.notify_all();
+        }
+
+        SDL_GL_MakeCurrent(window_.window(), nullptr);
+    }
+
+    tr_window& window_;
+    render_fn render_;
+    size_t max_queued_{ 2 };
+    double submit_wait_ms_{ 0.0 };
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::condition_variable space_cv_;
+    std::deque<Snapshot> queue_{ };
+    bool busy_{ false };
+    bool stop_{ false };
+    std::thread thread_;
+
+    render_thread(const render_thread&) = delete;
+    render_thread(render_thread&&) = delete;
+    render_thread& operator=(const render_thread&) = delete;
+    render_thread& operator=(render_thread&&) = delete;
+};
+
+}
@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <spdlog/spdlog.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include "tr_scene_import.h"
+#include "tr_mesh_file.h"
+#include "tr_upload_thread.h"
+#include "resource.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    double elapsed_ms(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    glm::mat4 to_glm(const aiMatrix4x4& m)
+    {
+        // Assimp's matrices are row major.
+        glm::mat4 out;
+        for(int row = 0; row < 4; ++row) {
+            for(int column = 0; column < 4; ++column) {
+                out[column][row] = m[row][column];
+            }
+        }
+        return out;
+    }
+
+    joint_transform decompose(const aiMatrix4x4& m)
+    {
+        aiVector3D scaling;
+        aiQuaternion rotation;
+        aiVector3D position;
+        m.Decompose(scaling, rotation, position);
+        joint_transform t;
+        t.translation_ = glm::vec3(position.x, position.y, position.z);
+        t.rotation_ = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+        t.scale_ = glm::vec3(scaling.x, scaling.y, scaling.z);
+        return t;
+    }
+
+    // Every node named by a mesh's bones is a joint, and so are their ancestors so
+    // each joint's parent is one too. Joints are added depth first from the
+    // root so parents come before their children.
+    void build_skeleton(const aiScene& scene, skeleton& out)
+    {
+        std::unordered_map<std::string, aiMatrix4x4> offsets;
+        for(unsigned n = 0; n < scene.mNumMeshes; ++n) {
+            const aiMesh& m = *scene.mMeshes[n];
+            for(unsigned b = 0; b < m.mNumBones; ++b) {
+                offsets.emplace(m.mBones[b]->mName.C_Str(), m.mBones[b]->mOffsetMatrix);
+            }
+        }
+        if(offsets.empty()) {
+            return;
+        }
+        std::unordered_set<const aiNode*> joints;
+        for(const auto& [name, offset] : offsets) {
+            const aiNode* node = scene.mRootNode->FindNode(name.c_str());
+            if(node == nullptr) {
+                spdlog::warn("Bone \"{}\" has no node, its vertices follow the root", name);
+            }
+            while(node != nullptr && joints.insert(node).second) {
+                node = node->mParent;
+            }
+        }
+
+        // Bind transforms in model space, for joints no mesh is bound to.
+        std::vector<glm::mat4> global;
+        std::vector<std::pair<const aiNode*, int32_t>> stack{ { scene.mRootNode, -1 } };
+        while(!stack.empty()) {
+            const auto [node, parent] = stack.back();
+            stack.pop_back();
+            int32_t index = parent;
+            if(joints.contains(node)) {
+                index = static_cast<int32_t>(out.size());
+                const std::string name = node->mName.C_Str();
+                const glm::mat4 local = to_glm(node->mTransformation);
+                global.push_back(parent >= 0 ? global[parent] * local : local);
+                out.names_.push_back(name);
+                out.parents_.push_back(parent);
+                out.bind_pose_.push_back(decompose(node->mTransformation));
+                const auto offset = offsets.find(name);
+                out.inverse_bind_.push_back(offset != offsets.end() ? to_glm(offset->second) : glm::inverse(global.back()));
+            }
+            for(unsigned c = node->mNumChildren; c > 0; --c) {
+                stack.emplace_back(node->mChildren[c - 1], index);
+            }
+        }
+    }
+
+    raw_clip convert_animation(const aiAnimation& a, const std::unordered_map<std::string, int32_t>& joints, size_t joint_count)
+    {
+        raw_clip clip;
+        clip.name_ = a.mName.C_Str();
+        // Assimp leaves the rate 0 when the file doesn't give one, 25 is what it assumes elsewhere.
+        const double ticks = a.mTicksPerSecond > 0.0 ? a.mTicksPerSecond : 25.0;
+        clip.duration_ = static_cast<float>(a.mDuration / ticks);
+        clip.joints_.resize(joint_count);
+        for(unsigned c = 0; c < a.mNumChannels; ++c) {
+            const aiNodeAnim& channel = *a.mChannels[c];
+            const auto joint = joints.find(channel.mNodeName.C_Str());
+            if(joint == joints.end()) {
+                continue;
+            }
+            joint_keys& keys = clip.joints_[joint->second];
+            for(unsigned k = 0; k < channel.mNumPositionKeys; ++k) {
+                const aiVectorKey& key = channel.mPositionKeys[k];
+                keys.translations_.emplace_back(static_cast<float>(key.mTime / ticks), glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for(unsigned k = 0; k < channel.mNumRotationKeys; ++k) {
+                const aiQuatKey& key = channel.mRotationKeys[k];
+                keys.rotations_.emplace_back(static_cast<float>(key.mTime / ticks), glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w));
+            }
+            for(unsigned k = 0; k < channel.mNumScalingKeys; ++k) {
+                const aiVectorKey& key = channel.mScalingKeys[k];
+                keys.scales_.emplace_back(static_cast<float>(key.mTime / ticks), glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+        }
+        return clip;
+    }
+
+    /// @brief A vertex's strongest joints, weakest replaced first.
+    struct influences
+    {
+        std::array<uint32_t, 4> joints_{ };
+        std::array<float, 4> weights_{ };
+
+        void add(uint32_t joint, float weight)
+        {
+            const auto weakest = std::min_element(weights_.begin(), weights_.end());
+            if(weight > *weakest) {
+                joints_[weakest - weights_.begin()] = joint;
+                *weakest = weight;
+            }
+        }
+    };
+
+    void convert_mesh(const aiMesh& m, const import_options& opts, const std::unordered_map<std::string, int32_t>& joints, size_t joint_count,
+        mesh_data& out)
+    {
+        out.name_ = m.mName.C_Str();
+        out.material_ = m.mMaterialIndex;
+        out.vertex_count_ = m.mNumVertices;
+
+        const bool normals = opts.normals_ && m.HasNormals();
+        const bool texcoords = opts.texcoords_ && m.HasTextureCoords(0);
+        const bool colours = opts.colours_ && m.HasVertexColors(0);
+        const bool skinned = opts.skinning_ && m.HasBones() && joint_count > 0;
+        const bool wide_joints = joint_count > std::numeric_limits<uint8_t>::max() + size_t(1);
+        int offset = 0;
+        out.formats_.clear();
+        out.formats_.emplace_back(mesh_position, 3, data_format::FLOAT32, offset);
+        offset += 3 * sizeof(float);
+        const int normal_offset = offset;
+        if(normals) {
+            out.formats_.emplace_back(mesh_normal, 3, data_format::FLOAT32, offset);
+            offset += 3 * sizeof(float);
+        }
+        const int texcoord_offset = offset;
+        if(texcoords) {
+            out.formats_.emplace_back(mesh_texcoord, 2, data_format::FLOAT32, offset);
+            offset += 2 * sizeof(float);
+        }
+        const int colour_offset = offset;
+        if(colours) {
+            out.formats_.emplace_back(mesh_colour, 4, data_format::UINT8, vertex_format_conversion::float_range, offset);
+            offset += 4;
+        }
+        const int joints_offset = offset;
+        const int weights_offset = offset + (wide_joints ? 4 * static_cast<int>(sizeof(uint16_t)) : 4);
+        if(skinned) {
+            out.formats_.emplace_back(mesh_joints, 4, wide_joints ? data_format::UINT16 : data_format::UINT8, vertex_format_conversion::integer, joints_offset);
+            out.formats_.emplace_back(mesh_weights, 4, data_format::UINT8, vertex_format_conversion::float_range, weights_offset);
+            offset = weights_offset + 4;
+        }
+        out.stride_ = static_cast<size_t>(offset);
+
+        std::vector<influences> weights(skinned ? out.vertex_count_ : 0);
+        for(unsigned b = 0; skinned && b < m.mNumBones; ++b) {
+            const aiBone& bone = *m.mBones[b];
+            const auto joint = joints.find(bone.mName.C_Str());
+            const uint32_t index = joint != joints.end() ? static_cast<uint32_t>(joint->second) : 0;
+            for(unsigned w = 0; w < bone.mNumWeights; ++w) {
+                if(bone.mWeights[w].mVertexId < weights.size()) {
+                    weights[bone.mWeights[w].mVertexId].add(index, bone.mWeights[w].mWeight);
+                }
+            }
+        }
+
+        out.vertices_.resize(out.vertex_count_ * out.stride_);
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(std::numeric_limits<float>::lowest());
+        for(size_t n = 0; n < out.vertex_count_; ++n) {
+            uint8_t* v = out.vertices_.data() + n * out.stride_;
+            const aiVector3D& p = m.mVertices[n];
+            const float position[3] = { p.x, p.y, p.z };
+            std::memcpy(v, position, sizeof(position));
+            lo = glm::min(lo, glm::vec3(p.x, p.y, p.z));
+            hi = glm::max(hi, glm::vec3(p.x, p.y, p.z));
+            if(normals) {
+                const aiVector3D& nm = m.mNormals[n];
+                const float normal[3] = { nm.x, nm.y, nm.z };
+                std::memcpy(v + normal_offset, normal, sizeof(normal));
+            }
+            if(texcoords) {
+                const aiVector3D& t = m.mTextureCoords[0][n];
+                const float texcoord[2] = { t.x, t.y };
+                std::memcpy(v + texcoord_offset, texcoord, sizeof(texcoord));
+            }
+            if(colours) {
+                const aiColor4D& c = m.mColors[0][n];
+                const float channels[4] = { c.r, c.g, c.b, c.a };
+                for(size_t i = 0; i < 4; ++i) {
+                    v[colour_offset + i] = static_cast<uint8_t>(std::clamp(channels[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+                }
+            }
+            if(skinned) {
+                // Weights are renormalised over the four kept and rounded to sum to exactly 255,
+                // a vertex no bone holds follows the root.
+                const influences& in = weights[n];
+                const float total = in.weights_[0] + in.weights_[1] + in.weights_[2] + in.weights_[3];
+                std::array<uint8_t, 4> quantised{ 255, 0, 0, 0 };
+                if(total > 0.0f) {
+                    int sum = 0;
+                    for(size_t k = 0; k < 4; ++k) {
+                        quantised[k] = static_cast<uint8_t>(in.weights_[k] / total * 255.0f + 0.5f);
+                        sum += quantised[k];
+                    }
+                    const size_t strongest = std::max_element(in.weights_.begin(), in.weights_.end()) - in.weights_.begin();
+                    quantised[strongest] = static_cast<uint8_t>(quantised[strongest] + 255 - sum);
+                }
+                for(size_t k = 0; k < 4; ++k) {
+                    const uint32_t joint = total > 0.0f ? in.joints_[k] : 0;
+                    if(wide_joints) {
+                        const uint16_t j16 = static_cast<uint16_t>(joint);
+                        std::memcpy(v + joints_offset + k * sizeof(uint16_t), &j16, sizeof(j16));
+                    } else {
+                        v[joints_offset + k] = static_cast<uint8_t>(joint);
+                    }
+                }
+                std::memcpy(v + weights_offset, quantised.data(), quantised.size());
+            }
+        }
+        out.bounds_min_ = out.vertex_count_ > 0 ? lo : glm::vec3(0.0f);
+        out.bounds_max_ = out.vertex_count_ > 0 ? hi : glm::vec3(0.0f);
+
+        // Points and lines sorted into the same mesh are dropped, only triangles are drawn.
+        size_t triangles = 0;
+        for(unsigned f = 0; f < m.mNumFaces; ++f) {
+            triangles += m.mFaces[f].mNumIndices == 3 ? 1 : 0;
+        }
+        const bool small = out.vertex_count_ <= std::numeric_limits<uint16_t>::max() + size_t(1);
+        out.index_format_ = small ? data_format::UINT16 : data_format::UINT32;
+        const size_t index_size = small ? sizeof(uint16_t) : sizeof(uint32_t);
+        out.index_count_ = triangles * 3;
+        out.indices_.resize(out.index_count_ * index_size);
+        uint8_t* dst = out.indices_.data();
+        for(unsigned f = 0; f < m.mNumFaces; ++f) {
+            const aiFace& face = m.mFaces[f];
+            if(face.mNumIndices != 3) {
+                continue;
+            }
+            for(unsigned i = 0; i < 3; ++i) {
+                if(small) {
+                    const uint16_t index = static_cast<uint16_t>(face.mIndices[i]);
+                    std::memcpy(dst, &index, sizeof(index));
+                } else {
+                    const uint32_t index = face.mIndices[i];
+                    std::memcpy(dst, &index, sizeof(index));
+                }
+                dst += index_size;
+            }
+        }
+    }
+}
+
+std::vector<uint32_t> read_indices(const mesh_data& mesh, size_t first, size_t count)
+{
+    std::vector<uint32_t> out(count);
+    if(mesh.index_format_ == data_format::UINT16) {
+        for(size_t n = 0; n < count; ++n) {
+            uint16_t i16;
+            std::memcpy(&i16, mesh.indices_.data() + (first + n) * sizeof(uint16_t), sizeof(i16));
+            out[n] = i16;
+        }
+    } else {
+        std::memcpy(out.data(), mesh.indices_.data() + first * sizeof(uint32_t), count * sizeof(uint32_t));
+    }
+    return out;
+}
+
+void write_indices(mesh_data& mesh, size_t first, std::span<const uint32_t> indices)
+{
+    const bool small = mesh.index_format_ == data_format::UINT16;
+    const size_t index_size = small ? sizeof(uint16_t) : sizeof(uint32_t);
+    const size_t end = (first + indices.size()) * index_size;
+    if(mesh.indices_.size() < end) {
+        mesh.indices_.resize(end);
+    }
+    uint8_t* dst = mesh.indices_.data() + first * index_size;
+    if(small) {
+        for(uint32_t index : indices) {
+            const uint16_t i16 = static_cast<uint16_t>(index);
+            std::memcpy(dst, &i16, sizeof(i16));
+            dst += sizeof(i16);
+        }
+    } else {
+        std::memcpy(dst, indices.data(), indices.size_bytes());
+    }
+}
+
+bool import_meshes(std::string_view filename, const import_options& opts, thread_pool& pool, imported_scene& out)
+{
+    TR_PROFILE_ZONE("import meshes");
+    out.path_ = filename;
+    auto start = std::chrono::steady_clock::now();
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(resource::resolve(filename), opts.post_process_ | aiProcess_Triangulate);
+    if(scene == nullptr || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) != 0) {
+        spdlog::error("Unable to import \"{}\": {}", filename, importer.GetErrorString());
+        return false;
+    }
+    out.timings_.read_ms_ = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    out.skeleton_ = { };
+    out.clips_.clear();
+    if(opts.skinning_) {
+        build_skeleton(*scene, out.skeleton_);
+    }
+    std::unordered_map<std::string, int32_t> joints;
+    for(size_t j = 0; j < out.skeleton_.size(); ++j) {
+        joints.emplace(out.skeleton_.names_[j], static_cast<int32_t>(j));
+    }
+    out.meshes_.resize(scene->mNumMeshes);
+    pool.parallel_for(scene->mNumMeshes, [&](size_t begin, size_t end) {
+        for(size_t n = begin; n < end; ++n) {
+            convert_mesh(*scene->mMeshes[n], opts, joints, out.skeleton_.size(), out.meshes_[n]);
+            // Meshlets reorder the full detail triangles, the levels of detail are simplified from them after.
+            if(opts.meshlets_) {
+                build_meshlets(out.meshes_[n], opts.meshlet_);
+            }
+            if(opts.lod_.levels_ > 0) {
+                build_lods(out.meshes_[n], opts.lod_);
+            }
+        }
+    });
+    if(!out.skeleton_.empty()) {
+        out.clips_.resize(scene->mNumAnimations);
+        pool.parallel_for(scene->mNumAnimations, [&](size_t begin, size_t end) {
+            for(size_t n = begin; n < end; ++n) {
+                out.clips_[n] = compress_clip(convert_animation(*scene->mAnimations[n], joints, out.skeleton_.size()), out.skeleton_, opts.clip_);
+            }
+        });
+    }
+    out.timings_.convert_ms_ = elapsed_ms(start);
+
+    out.triangles_ = 0;
+    for(const auto& mesh : out.meshes_) {
+        out.triangles_ += mesh.index_count_ / 3;
+    }
+    spdlog::debug("Imported {} meshes, {} triangles, {} joints and {} clips from \"{}\" in {:.2f} ms, converted in {:.2f} ms",
+        out.meshes_.size(), out.triangles_, out.skeleton_.size(), out.clips_.size(), filename, out.timings_.read_ms_, out.timings_.convert_ms_);
+    return true;
+}
+
+size_t imported_scene::drawn_meshes() const
+{
+    return static_cast<size_t>(std::count_if(meshes_.begin(), meshes_.end(), [](const mesh_data& m) { return m.index_count_ > 0; }));
+}
+
+bool load_baked_scene(std::string_view filename, imported_scene& out)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::optional<loaded_mesh> baked = load_mesh_file(filename);
+    if(!baked) {
+        return false;
+    }
+    out = imported_scene{ };
+    out.path_ = filename;
+    for(const auto& s : baked->submeshes_) {
+        if(s.index_count_ == 0) {
+            continue;
+        }
+        mesh_data& mesh = out.meshes_.emplace_back();
+        mesh.name_ = fmt::format("{} {}", filename, out.meshes_.size() - 1);
+        mesh.material_ = s.material_;
+        mesh.stride_ = baked->stride_;
+        mesh.formats_ = baked->formats_;
+        mesh.vertex_count_ = s.vertex_count_;
+        mesh.index_format_ = baked->index_format_;
+        mesh.index_count_ = s.index_count_;
+        mesh.first_index_ = s.first_index_;
+        // The file's levels are ranges of the whole index stream, here they start from the submesh's.
+        for(const auto& l : s.lods_) {
+            mesh.lods_.push_back({ l.first_index_ - s.first_index_, l.index_count_, l.error_ });
+        }
+        mesh.bounds_min_ = s.bounds_min_;
+        mesh.bounds_max_ = s.bounds_max_;
+        out.triangles_ += s.index_count_ / 3;
+    }
+    out.objects_.emplace_back(std::move(baked->object_));
+    out.timings_.build_ms_ = elapsed_ms(start);
+    out.timings_.total_ms_ = out.timings_.build_ms_;
+    spdlog::info("Loaded baked \"{}\", {} meshes and {} triangles in {:.2f} ms", filename, out.meshes_.size(), out.triangles_, out.timings_.total_ms_);
+    return true;
+}
+
+vertex_object build_vertex_object(const mesh_data& mesh)
+{
+    auto vo = vertex_object::create("opengl");
+    vo.add(mesh.stride_, mesh.formats_);
+    vo.build(true, mesh.index_format_);
+    vo.update(vertex_object::update_type::vertex, 0, mesh.vertices_.data(), mesh.vertices_.size());
+    vo.update(vertex_object::update_type::index, mesh.index_count_, mesh.indices_.data(), mesh.indices_.size());
+    return vo;
+}
+
+scene_importer::scene_importer(size_t threads)
+    : pool_(threads)
+{
+    thread_ = std::thread(&scene_importer::worker, this);
+}
+
+scene_importer::~scene_importer()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void scene_importer::import(std::string_view filename, const import_options& opts, ready_fn on_ready)
+{
+    {
+        std::lock_guard lock(mutex_);
+        job& j = queued_.emplace_back();
+        j.filename_ = filename;
+        j.options_ = opts;
+        j.on_ready_ = std::move(on_ready);
+        j.requested_ = std::chrono::steady_clock::now();
+    }
+    cv_.notify_one();
+}
+
+size_t scene_importer::poll(upload_thread* uploads)
+{
+    size_t first = 0;
+    {
+        // Moved across under the lock, so pending() counts them throughout.
+        std::lock_guard lock(mutex_);
+        first = uploading_.size();
+        for(auto& c : converted_) {
+            uploading_.emplace_back(std::move(c));
+        }
+        converted_.clear();
+    }
+    for(size_t n = first; n < uploading_.size(); ++n) {
+        TR_PROFILE_ZONE("build meshes");
+        const auto start = std::chrono::steady_clock::now();
+        job& j = uploading_[n];
+        imported_scene& scene = j.scene_;
+        for(const auto& mesh : scene.meshes_) {
+            if(mesh.index_count_ == 0) {
+                continue;
+            }
+            if(uploads == nullptr) {
+                scene.objects_.emplace_back(build_vertex_object(mesh));
+                continue;
+            }
+            // The meshes stay with the scene, held here until the writes from them are published.
+            vertex_object& vo = scene.objects_.emplace_back(vertex_object::create("opengl"));
+            vo.add(mesh.stride_, mesh.formats_);
+            vo.build(true, mesh.index_format_);
+            if(vo.allocate(vertex_object::update_type::vertex, 0, mesh.vertices_.size())) {
+                ++j.writes_;
+                uploads->write_buffer(vo.buffer_id(vertex_object::update_type::vertex), mesh.vertices_.data(), mesh.vertices_.size(), [&j]() { --j.writes_; });
+            } else {
+                vo.update(vertex_object::update_type::vertex, 0, mesh.vertices_.data(), mesh.vertices_.size());
+            }
+            vo.allocate(vertex_object::update_type::index, mesh.index_count_, mesh.indices_.size());
+            ++j.writes_;
+            uploads->write_buffer(vo.buffer_id(vertex_object::update_type::index), mesh.indices_.data(), mesh.indices_.size(), [&j]() { --j.writes_; });
+        }
+        scene.timings_.build_ms_ = elapsed_ms(start);
+    }
+
+    // Handed over in request order, a scene whose buffers are still being written holds up those after it.
+    size_t passed = 0;
+    while(!uploading_.empty() && uploading_.front().writes_ == 0) {
+        job j;
+        {
+            std::lock_guard lock(mutex_);
+            j = std::move(uploading_.front());
+            uploading_.pop_front();
+        }
+        imported_scene& scene = j.scene_;
+        scene.timings_.total_ms_ = elapsed_ms(j.requested_);
+        if(!scene.meshes_.empty()) {
+            spdlog::info("Imported \"{}\", {} meshes and {} triangles: read {:.2f} ms, convert {:.2f} ms, build {:.2f} ms, {:.2f} ms in all",
+                scene.path_, scene.meshes_.size(), scene.triangles_, scene.timings_.read_ms_, scene.timings_.convert_ms_,
+                scene.timings_.build_ms_, scene.timings_.total_ms_);
+        }
+        j.on_ready_(std::move(scene));
+        ++passed;
+    }
+    return passed;
+}
+
+size_t scene_importer::finish()
+{
+    {
+        std::unique_lock lock(mutex_);
+        done_cv_.wait(lock, [this] { return queued_.empty() && !busy_; });
+    }
+    return poll();
+}
+
+size_t scene_importer::pending() const
+{
+    std::lock_guard lock(mutex_);
+    return queued_.size() + converted_.size() + uploading_.size() + (busy_ ? 1 : 0);
+}
+
+void scene_importer::worker()
+{
+    profiler::set_thread_name("scene import");
+    std::unique_lock lock(mutex_);
+    while(true) {
+        cv_.wait(lock, [this] { return stop_ || !queued_.empty(); });
+        if(stop_) {
+            break;
+        }
+        job j = std::move(queued_.front());
+        queued_.pop_front();
+        busy_ = true;
+
+        lock.unlock();
+        if(!import_meshes(j.filename_, j.options_, pool_, j.scene_)) {
+            j.scene_.meshes_.clear();
+        }
+        lock.lock();
+
+        busy_ = false;
+        converted_.emplace_back(std::move(j));
+        done_cv_.notify_all();
+    }
+}
+
+}
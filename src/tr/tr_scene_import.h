@@ -0,0 +1,192 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <assimp/postprocess.h>
+#include <glm/glm.hpp>
+
+#include "tr_animation.h"
+#include "tr_data_format.h"
+#include "tr_memory.h"
+#include "tr_mesh_lod.h"
+#include "tr_meshlet.h"
+#include "tr_thread_pool.h"
+#include "tr_vertex.h"
+
+namespace tr {
+
+class upload_thread;
+
+/// @brief Attribute locations of imported meshes, shaders drawing them declare the same.
+enum mesh_attribute : int
+{
+    mesh_position = 0,
+    mesh_normal = 1,
+    mesh_texcoord = 2,
+    mesh_colour = 3,
+    /// @brief Four joints, unsigned integers, the skeleton's indices.
+    mesh_joints = 4,
+    /// @brief The joints' weights, normalised UINT8 summing to one.
+    mesh_weights = 5,
+};
+
+struct import_options
+{
+    /// @brief \c aiPostProcessSteps run by Assimp, triangulation is always added as only triangles are kept.
+    unsigned post_process_{ aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType
+        | aiProcess_GenSmoothNormals | aiProcess_ImproveCacheLocality };
+    bool normals_{ true };
+    /// @brief The first set of texture co-ordinates.
+    bool texcoords_{ true };
+    /// @brief The first set of vertex colours, as normalised RGBA8.
+    bool colours_{ false };
+    /// @brief Levels of detail generated for each mesh, none by default.
+    lod_options lod_{ };
+    /// @brief Split each mesh's full detail triangles into meshlets, for culling.
+    bool meshlets_{ false };
+    meshlet_options meshlet_{ };
+    /// @brief Import the skeleton, each vertex's four strongest joints and the animations.
+    bool skinning_{ true };
+    clip_options clip_{ };
+};
+
+/// @brief One converted mesh, interleaved vertices described by \c formats_ and triangle indices.
+struct mesh_data
+{
+    std::string name_{ };
+    size_t material_{ 0 };
+    size_t stride_{ 0 };
+    vertex_format_list_t formats_{ };
+    size_t vertex_count_{ 0 };
+    tracked_vector<uint8_t> vertices_{ tracked_allocator<uint8_t>(memory_tag::vertex) };
+    /// @brief UINT16 when every vertex can be reached with it, otherwise UINT32.
+    data_format index_format_{ data_format::UINT32 };
+    /// @brief Indices of the full mesh, which come first in \c indices_.
+    size_t index_count_{ 0 };
+    /// @brief Where the mesh's indices start in its vertex object, its levels of detail start from there too.
+    size_t first_index_{ 0 };
+    /// @brief The full mesh's indices followed by those of any other levels of detail.
+    tracked_vector<uint8_t> indices_{ tracked_allocator<uint8_t>(memory_tag::vertex) };
+    /// @brief Levels of detail from the full mesh down, empty if none were generated.
+    std::vector<mesh_lod> lods_{ };
+    /// @brief Clusters covering the full detail indices in order, empty if none were built.
+    std::vector<meshlet> meshlets_{ };
+    glm::vec3 bounds_min_{ 0.0f };
+    glm::vec3 bounds_max_{ 0.0f };
+};
+
+struct import_timings
+{
+    /// @brief Assimp's import and post processing.
+    double read_ms_{ 0.0 };
+    /// @brief Converting the meshes, in parallel.
+    double convert_ms_{ 0.0 };
+    /// @brief Creating the vertex objects on the GL thread, including copying the data unless the upload thread writes it.
+    double build_ms_{ 0.0 };
+    /// @brief From the request to the vertex objects being handed over, including any waiting.
+    double total_ms_{ 0.0 };
+};
+
+struct imported_scene
+{
+    std::string path_{ };
+    std::vector<mesh_data> meshes_{ };
+    /// @brief One for each mesh with triangles, in the same order, or one every mesh of a baked scene shares.
+    std::vector<vertex_object> objects_{ };
+    /// @brief Joints of every skinned mesh, empty if none are.
+    skeleton skeleton_{ };
+    std::vector<animation_clip> clips_{ };
+    import_timings timings_{ };
+    size_t triangles_{ 0 };
+
+    bool empty() const { return objects_.empty(); }
+    /// @brief The vertex object drawing the \c n th mesh with triangles.
+    const vertex_object& object(size_t n) const { return objects_.size() == 1 ? objects_.front() : objects_[n]; }
+    /// @brief Meshes with triangles, those that are drawn.
+    size_t drawn_meshes() const;
+};
+
+/// @brief Indices [first, first + count) of a mesh, widened to 32 bits.
+std::vector<uint32_t> read_indices(const mesh_data& mesh, size_t first, size_t count);
+/// @brief Overwrites a mesh's indices from \c first, growing \c indices_ as needed, in the mesh's index format.
+void write_indices(mesh_data& mesh, size_t first, std::span<const uint32_t> indices);
+
+/// @brief Reads a scene with Assimp and converts its meshes, spreading them over the pool.
+/// @return false if Assimp couldn't read the file.
+bool import_meshes(std::string_view filename, const import_options& opts, thread_pool& pool, imported_scene& out);
+/// @brief Loads a baked \c .trmesh resource with \c load_mesh_file(), on the GL thread. Each submesh
+/// becomes a mesh with no copy of its data, drawn from the one vertex object the streams were uploaded to.
+/// @return false if the file is missing or malformed.
+bool load_baked_scene(std::string_view filename, imported_scene& out);
+/// @brief Creates a vertex object holding a converted mesh and its levels of detail, on the GL thread.
+/// A plain \c draw() draws the full mesh.
+vertex_object build_vertex_object(const mesh_data& mesh);
+
+// Imports scenes off the GL thread. Assimp reads each file on a worker thread,
+// which then converts the meshes on the importer's own pool, so a large
+// conversion never holds up the frame's parallel work. Converted scenes wait
+// until poll() is called on the GL thread, which creates their vertex objects
+// and hands them to their callbacks in request order. Given the upload thread
+// poll() only allocates the buffers, the thread fills them and the scene is
+// handed over on a later poll() once every write has been published.
+class scene_importer
+{
+public:
+    typedef std::function<void(imported_scene&&)> ready_fn;
+
+    /// @param threads Workers converting meshes, 0 for one less than the hardware threads.
+    explicit scene_importer(size_t threads = 0);
+    /// @brief Drops queued requests and waits for the one being imported.
+    ~scene_importer();
+    /// @brief Queues a scene resource, one that fails to import is passed on empty.
+    void import(std::string_view filename, const import_options& opts, ready_fn on_ready);
+    /// @brief Builds the vertex objects of converted scenes and passes them to their callbacks.
+    /// @param uploads Fills the buffers off this thread, call its \c publish() before this.
+    /// @return The number of scenes passed on.
+    size_t poll(upload_thread* uploads = nullptr);
+    /// @brief Waits for every queued scene and passes them on, for callers that can't carry on without them.
+    size_t finish();
+    /// @brief Requests not yet passed on.
+    size_t pending() const;
+private:
+    struct job
+    {
+        std::string filename_{ };
+        import_options options_{ };
+        imported_scene scene_{ };
+        ready_fn on_ready_{ };
+        std::chrono::steady_clock::time_point requested_{ };
+        /// @brief Buffer writes queued on the upload thread and not yet published.
+        size_t writes_{ 0 };
+    };
+    void worker();
+
+    thread_pool pool_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    std::deque<job> queued_{ };
+    std::deque<job> converted_{ };
+    /// @brief Built on the GL thread and waiting for their buffers to be written, in request order.
+    std::deque<job> uploading_{ };
+    bool busy_{ false };
+    bool stop_{ false };
+    std::thread thread_;
+
+    scene_importer(const scene_importer&) = delete;
+    scene_importer(scene_importer&&) = delete;
+    scene_importer& operator=(const scene_importer&) = delete;
+    scene_importer& operator=(scene_importer&&) = delete;
+};
+
+}
@@ -1,6 +1,7 @@
 #include <fstream>
 #include <spdlog/spdlog.h>
 #include <glad/gl.h>
+#include <glm/gtc/type_ptr.hpp>
 #include "tr_shader.h"
 #include "resource.h"
 
@@ -14,7 +15,7 @@ struct shader
     virtual ~shader();
     explicit shader(std::string_view shader_name, const std::string& shader, unsigned type);
     /// @brief Construct a shader from a binary blob.
-    explicit shader(std::string_view shader_name, const std::vector<uint8_t>& shader, unsigned type);
+    explicit shader(std::string_view shader_name, const resource::byte_buffer_t& shader, unsigned type);
     void compile();
     unsigned index_ = 0;
     /// @brief Default entry point for shaders, can be overridden.
@@ -44,7 +45,7 @@ shader_ptr shader_factory(std::string_view shader_name, const std::string& conte
     return nullptr;
 }
 
-shader_ptr binary_shader_factory(std::string_view shader_name, const std::vector<uint8_t>& content, std::string_view type)
+shader_ptr binary_shader_factory(std::string_view shader_name, const resource::byte_buffer_t& content, std::string_view type)
 {
     if(content.empty() || content.size() == 0) {
         spdlog::critical("No shader binary data found for \"{}\"", shader_name);
@@ -95,7 +96,7 @@ shader::shader(std::string_view shader_name, const std::string& shader, unsigned
     }
 }
 
-shader::shader(std::string_view shader_name, const std::vector<uint8_t>& shader, unsigned type)
+shader::shader(std::string_view shader_name, const resource::byte_buffer_t& shader, unsigned type)
 {
     spdlog::debug("Compiling shader \"{}\" with the following source: {} bytes", shader_name, shader.size());
 
@@ -162,6 +163,131 @@ tr_shader::~tr_shader()
     glDeleteProgram(program_);
 }
 
+tr_shader::tr_shader(tr_shader&& rhs) noexcept
+    : name_(std::move(rhs.name_))
+    , program_(rhs.program_)
+    , uniforms_(std::move(rhs.uniforms_))
+{
+    rhs.program_ = 0;
+}
+
+tr_shader& tr_shader::operator=(tr_shader&& rhs) noexcept
+{
+    if(this != &rhs) {
+        glDeleteProgram(program_);
+        name_ = std::move(rhs.name_);
+        program_ = rhs.program_;
+        uniforms_ = std::move(rhs.uniforms_);
+        rhs.program_ = 0;
+    }
+    return *this;
+}
+
+int tr_shader::uniform_location(std::string_view name) const
+{
+    std::string key{ name };
+    if(auto it = uniforms_.find(key); it != uniforms_.end()) {
+        return it->second;
+    }
+    const int location = glGetUniformLocation(program_, key.c_str());
+    if(location < 0) {
+        spdlog::debug("Shader program \"{}\" has no active uniform \"{}\"", name_, key);
+    }
+    uniforms_.emplace(std::move(key), location);
+    return location;
+}
+
+void tr_shader::set_uniform(std::string_view name, int value) const
+{
+    set_uniform(uniform_location(name), value);
+}
+
+void tr_shader::set_uniform(std::string_view name, float value) const
+{
+    set_uniform(uniform_location(name), value);
+}
+
+void tr_shader::set_uniform(std::string_view name, const glm::vec2& value) const
+{
+    set_uniform(uniform_location(name), value);
+}
+
+void tr_shader::set_uniform(std::string_view name, const glm::vec4& value) const
+{
+    set_uniform(uniform_location(name), value);
+}
+
+void tr_shader::set_uniform(std::string_view name, const glm::mat4& value) const
+{
+    set_uniform(uniform_location(name), value);
+}
+
+void tr_shader::set_uniform(int location, int value) const
+{
+    if(location >= 0) {
+        if(GLAD_GL_ARB_separate_shader_objects) {
+            glProgramUniform1i(program_, location, value);
+        } else {
+            glUniform1i(location, value);
+        }
+    }
+}
+
+void tr_shader::set_uniform(int location, float value) const
+{
+    if(location >= 0) {
+        if(GLAD_GL_ARB_separate_shader_objects) {
+            glProgramUniform1f(program_, location, value);
+        } else {
+            glUniform1f(location, value);
+        }
+    }
+}
+
+void tr_shader::set_uniform(int location, const glm::vec2& value) const
+{
+    if(location >= 0) {
+        if(GLAD_GL_ARB_separate_shader_objects) {
+            glProgramUniform2fv(program_, location, 1, glm::value_ptr(value));
+        } else {
+            glUniform2fv(location, 1, glm::value_ptr(value));
+        }
+    }
+}
+
+void tr_shader::set_uniform(int location, const glm::vec4& value) const
+{
+    if(location >= 0) {
+        if(GLAD_GL_ARB_separate_shader_objects) {
+            glProgramUniform4fv(program_, location, 1, glm::value_ptr(value));
+        } else {
+            glUniform4fv(location, 1, glm::value_ptr(value));
+        }
+    }
+}
+
+void tr_shader::set_uniform(int location, const glm::mat4& value) const
+{
+    if(location >= 0) {
+        if(GLAD_GL_ARB_separate_shader_objects) {
+            glProgramUniformMatrix4fv(program_, location, 1, GL_FALSE, glm::value_ptr(value));
+        } else {
+            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+    }
+}
+
+bool tr_shader::bind_uniform_block(std::string_view block, unsigned binding) const
+{
+    const std::string name{ block };
+    const GLuint index = glGetUniformBlockIndex(program_, name.c_str());
+    if(index == GL_INVALID_INDEX) {
+        spdlog::debug("Shader program \"{}\" has no uniform block \"{}\"", name_, name);
+        return false;
+    }
+    glUniformBlockBinding(program_, index, binding);
+    return true;
+}
 
 // Expects objects, each object having a 'name' and 'shaders' attribute.
 // The name is the name of the shader program and the shaders is a list of objects
@@ -202,7 +328,7 @@ tr_shader_list load_shaders(const ryml::NodeRef& cfg)
 
                 if(is_binary_shader)
                 {
-                    shd = binary_shader_factory(shader_name, resource::load_binary(filename), shader_type);
+                    shd = binary_shader_factory(shader_name, resource::load_binary(filename, memory_tag::shader), shader_type);
                 }
                 else
                 {
@@ -4,8 +4,12 @@
 #include <vector>
 #include <memory>
 #include <string_view>
+#include <unordered_map>
+#include <glm/glm.hpp>
 #include <ryml.hpp>
 
+#include "tr_memory.h"
+
 namespace tr {
 
 struct shader;
@@ -17,9 +21,38 @@ public:
     explicit tr_shader(std::string_view name, const std::vector<shader_ptr>& shaders);
     ~tr_shader();
     void apply() const;
+    const std::string& name() const { return name_; }
+    /// @brief Location of a uniform, -1 if the program doesn't use it. Locations are cached.
+    int uniform_location(std::string_view name) const;
+    // Setting a uniform needs the program to be applied first unless
+    // GL_ARB_separate_shader_objects is available, in which case it is set directly.
+    void set_uniform(std::string_view name, int value) const;
+    void set_uniform(std::string_view name, float value) const;
+    void set_uniform(std::string_view name, const glm::vec2& value) const;
+    void set_uniform(std::string_view name, const glm::vec4& value) const;
+    void set_uniform(std::string_view name, const glm::mat4& value) const;
+    /// @brief Setting by location skips the lookup, locations of -1 are ignored.
+    void set_uniform(int location, int value) const;
+    void set_uniform(int location, float value) const;
+    void set_uniform(int location, const glm::vec2& value) const;
+    void set_uniform(int location, const glm::vec4& value) const;
+    void set_uniform(int location, const glm::mat4& value) const;
+    /// @brief Points a uniform block at a binding, where ranges of uniform buffers are bound.
+    /// @return false if the program has no such block.
+    bool bind_uniform_block(std::string_view block, unsigned binding) const;
+
+    // moveable, but not copyable as the program is owned.
+    tr_shader(tr_shader&& rhs) noexcept;
+    tr_shader& operator=(tr_shader&& rhs) noexcept;
 private:
     std::string name_;
     unsigned program_{ 0 };
+    /// @brief Uniform locations looked up so far.
+    mutable std::unordered_map<std::string, int, std::hash<std::string>, std::equal_to<std::string>,
+        tracked_allocator<std::pair<const std::string, int>>> uniforms_{ tracked_allocator<std::pair<const std::string, int>>(memory_tag::shader) };
+
+    tr_shader(const tr_shader&) = delete;
+    tr_shader& operator=(const tr_shader&) = delete;
 };
 
 typedef std::vector<tr_shader> tr_shader_list;
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TR_SIMD_SSE 1
+#else
+#define TR_SIMD_SSE 0
+#endif
+
+namespace tr {
+
+// Four floats operated on together, one lane for each of four items laid out
+// structure of arrays. SSE2 where the target has it, plain loops otherwise,
+// so the same code builds everywhere and the scalar path can be checked
+// against the vector one. Loads and stores are unaligned, comparisons give
+// masks of all ones or all zeros for use with select().
+struct simd4f
+{
+#if TR_SIMD_SSE
+    __m128 v_;
+#else
+    float v_[4];
+#endif
+
+    static simd4f load(const float* p)
+    {
+#if TR_SIMD_SSE
+        return { _mm_loadu_ps(p) };
+#else
+        return { { p[0], p[1], p[2], p[3] } };
+#endif
+    }
+    static simd4f splat(float f)
+    {
+#if TR_SIMD_SSE
+        return { _mm_set1_ps(f) };
+#else
+        return { { f, f, f, f } };
+#endif
+    }
+    static simd4f zero() { return splat(0.0f); }
+
+    void store(float* p) const
+    {
+#if TR_SIMD_SSE
+        _mm_storeu_ps(p, v_);
+#else
+        std::memcpy(p, v_, sizeof(v_));
+#endif
+    }
+    float lane(int n) const
+    {
+        float f[4];
+        store(f);
+        return f[n];
+    }
+};
+
+#if TR_SIMD_SSE
+inline simd4f operator+(simd4f a, simd4f b) { return { _mm_add_ps(a.v_, b.v_) }; }
+inline simd4f operator-(simd4f a, simd4f b) { return { _mm_sub_ps(a.v_, b.v_) }; }
+inline simd4f operator*(simd4f a, simd4f b) { return { _mm_mul_ps(a.v_, b.v_) }; }
+inline simd4f operator/(simd4f a, simd4f b) { return { _mm_div_ps(a.v_, b.v_) }; }
+inline simd4f operator&(simd4f a, simd4f b) { return { _mm_and_ps(a.v_, b.v_) }; }
+inline simd4f operator|(simd4f a, simd4f b) { return { _mm_or_ps(a.v_, b.v_) }; }
+inline simd4f operator^(simd4f a, simd4f b) { return { _mm_xor_ps(a.v_, b.v_) }; }
+inline simd4f min(simd4f a, simd4f b) { return { _mm_min_ps(a.v_, b.v_) }; }
+inline simd4f max(simd4f a, simd4f b) { return { _mm_max_ps(a.v_, b.v_) }; }
+inline simd4f sqrt(simd4f a) { return { _mm_sqrt_ps(a.v_) }; }
+inline simd4f operator<(simd4f a, simd4f b) { return { _mm_cmplt_ps(a.v_, b.v_) }; }
+inline simd4f operator>(simd4f a, simd4f b) { return { _mm_cmpgt_ps(a.v_, b.v_) }; }
+inline simd4f operator<=(simd4f a, simd4f b) { return { _mm_cmple_ps(a.v_, b.v_) }; }
+inline simd4f operator>=(simd4f a, simd4f b) { return { _mm_cmpge_ps(a.v_, b.v_) }; }
+/// @brief Lanes of \c a where \c mask is set, of \c b elsewhere.
+inline simd4f select(simd4f mask, simd4f a, simd4f b) { return { _mm_or_ps(_mm_and_ps(mask.v_, a.v_), _mm_andnot_ps(mask.v_, b.v_)) }; }
+/// @brief One bit for each lane whose mask is set, lane 0 in bit 0.
+inline int move_mask(simd4f mask) { return _mm_movemask_ps(mask.v_); }
+#else
+namespace simd_detail {
+    template<typename F>
+    simd4f map(simd4f a, simd4f b, F f)
+    {
+        simd4f r;
+        for(int n = 0; n < 4; ++n) {
+            r.v_[n] = f(a.v_[n], b.v_[n]);
+        }
+        return r;
+    }
+    template<typename F>
+    simd4f bits(simd4f a, simd4f b, F f)
+    {
+        simd4f r;
+        for(int n = 0; n < 4; ++n) {
+            uint32_t x, y;
+            std::memcpy(&x, &a.v_[n], sizeof(x));
+            std::memcpy(&y, &b.v_[n], sizeof(y));
+            const uint32_t z = f(x, y);
+            std::memcpy(&r.v_[n], &z, sizeof(z));
+        }
+        return r;
+    }
+    inline float mask(bool b)
+    {
+        const uint32_t m = b ? 0xffffffffu : 0u;
+        float f;
+        std::memcpy(&f, &m, sizeof(f));
+        return f;
+    }
+}
+inline simd4f operator+(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return x + y; }); }
+inline simd4f operator-(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return x - y; }); }
+inline simd4f operator*(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return x * y; }); }
+inline simd4f operator/(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return x / y; }); }
+inline simd4f operator&(simd4f a, simd4f b) { return simd_detail::bits(a, b, [](uint32_t x, uint32_t y) { return x & y; }); }
+inline simd4f operator|(simd4f a, simd4f b) { return simd_detail::bits(a, b, [](uint32_t x, uint32_t y) { return x | y; }); }
+inline simd4f operator^(simd4f a, simd4f b) { return simd_detail::bits(a, b, [](uint32_t x, uint32_t y) { return x ^ y; }); }
+inline simd4f min(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline simd4f max(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline simd4f sqrt(simd4f a) { return simd_detail::map(a, a, [](float x, float) { return std::sqrt(x); }); }
+inline simd4f operator<(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return simd_detail::mask(x < y); }); }
+inline simd4f operator>(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return simd_detail::mask(x > y); }); }
+inline simd4f operator<=(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return simd_detail::mask(x <= y); }); }
+inline simd4f operator>=(simd4f a, simd4f b) { return simd_detail::map(a, b, [](float x, float y) { return simd_detail::mask(x >= y); }); }
+inline simd4f select(simd4f mask, simd4f a, simd4f b) { return (mask & a) | simd_detail::bits(mask, b, [](uint32_t m, uint32_t y) { return ~m & y; }); }
+inline int move_mask(simd4f mask)
+{
+    int bits = 0;
+    for(int n = 0; n < 4; ++n) {
+        uint32_t m;
+        std::memcpy(&m, &mask.v_[n], sizeof(m));
+        bits |= (m >> 31) << n;
+    }
+    return bits;
+}
+#endif
+
+/// @brief a * b + c, rounded after each step like the scalar code it is checked against, never fused.
+inline simd4f madd(simd4f a, simd4f b, simd4f c) { return a * b + c; }
+/// @brief The sign bits of \c a, applied to another value with ^.
+inline simd4f sign_bits(simd4f a) { return a & simd4f::splat(-0.0f); }
+
+}
@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TR_BAKE_SSE 1
+#else
+#define TR_BAKE_SSE 0
+#endif
+
+#include "tr_texture_bake.h"
+#include "tr_texture_file.h"
+#include "tr_image.h"
+#include "tr_thread_pool.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    bool is_srgb(texture_format format)
+    {
+        return format == texture_format::srgb8_alpha8 || format == texture_format::bc1_srgb || format == texture_format::bc3_srgb;
+    }
+
+    const std::array<float, 256>& srgb_to_linear_table()
+    {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> t{ };
+            for(size_t n = 0; n < t.size(); ++n) {
+                const float c = static_cast<float>(n) / 255.0f;
+                t[n] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    uint8_t linear_to_srgb(float c)
+    {
+        c = std::clamp(c, 0.0f, 1.0f);
+        const float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(s * 255.0f + 0.5f);
+    }
+
+    uint8_t to_unorm8(float c)
+    {
+        return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    /// @brief Halves a level of float RGBA texels with a 2x2 box filter, edges clamped for odd sizes.
+    void downsample(const std::vector<float>& src, size_t width, size_t height, std::vector<float>& dst, size_t dst_width, size_t dst_height, thread_pool& pool)
+    {
+        dst.resize(dst_width * dst_height * 4);
+        pool.parallel_for(dst_height, [&](size_t begin, size_t end) {
+            for(size_t y = begin; y < end; ++y) {
+                const float* row0 = src.data() + std::min(y * 2, height - 1) * width * 4;
+                const float* row1 = src.data() + std::min(y * 2 + 1, height - 1) * width * 4;
+                float* out = dst.data() + y * dst_width * 4;
+                for(size_t x = 0; x < dst_width; ++x) {
+                    const size_t x0 = std::min(x * 2, width - 1) * 4;
+                    const size_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+#if TR_BAKE_SSE
+                    // One texel's four channels per register.
+                    __m128 sum = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+                    sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+                    _mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                    for(size_t c = 0; c < 4; ++c) {
+                        out[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+                    }
+#endif
+                }
+            }
+        }, 8);
+    }
+
+    uint16_t pack_565(const float* c)
+    {
+        const uint16_t r = static_cast<uint16_t>(std::clamp(c[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        const uint16_t g = static_cast<uint16_t>(std::clamp(c[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+        const uint16_t b = static_cast<uint16_t>(std::clamp(c[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    void unpack_565(uint16_t v, int* c)
+    {
+        const int r = (v >> 11) & 31;
+        const int g = (v >> 5) & 63;
+        const int b = v & 31;
+        c[0] = (r << 3) | (r >> 2);
+        c[1] = (g << 2) | (g >> 4);
+        c[2] = (b << 3) | (b >> 2);
+    }
+
+    /// @brief Picks the closest of the four palette colours for each texel.
+    /// @return The summed squared error.
+    int fit_bc1_indices(const uint8_t* rgba, uint16_t c0, uint16_t c1, uint32_t& indices)
+    {
+        indices = 0;
+        int palette[4][3];
+        unpack_565(std::max(c0, c1), palette[0]);
+        unpack_565(std::min(c0, c1), palette[1]);
+        for(size_t c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        }
+        int total = 0;
+        for(size_t n = 0; n < 16; ++n) {
+            uint32_t best = 0;
+            int best_error = 1 << 30;
+            // Equal endpoints only use the first.
+            const uint32_t choices = c0 == c1 ? 1 : 4;
+            for(uint32_t i = 0; i < choices; ++i) {
+                const int dr = palette[i][0] - rgba[n * 4];
+                const int dg = palette[i][1] - rgba[n * 4 + 1];
+                const int db = palette[i][2] - rgba[n * 4 + 2];
+                const int error = dr * dr + dg * dg + db * db;
+                if(error < best_error) {
+                    best_error = error;
+                    best = i;
+                }
+            }
+            indices |= best << (n * 2);
+            total += best_error;
+        }
+        // Indices are relative to the larger endpoint, flip them if the caller's order is the other way.
+        if(c0 < c1) {
+            indices ^= 0x55555555u;
+        }
+        return total;
+    }
+
+    /// @brief BC4 block from every \c stride th byte of 16 texels.
+    void encode_bc4_channel(const uint8_t* values, size_t stride, uint8_t* block)
+    {
+        uint8_t lo = 255;
+        uint8_t hi = 0;
+        for(size_t n = 0; n < 16; ++n) {
+            lo = std::min(lo, values[n * stride]);
+            hi = std::max(hi, values[n * stride]);
+        }
+        block[0] = hi;
+        block[1] = lo;
+        uint64_t indices = 0;
+        if(hi != lo) {
+            // With the first endpoint larger there are six interpolated values between them.
+            std::array<int, 8> palette{ hi, lo };
+            for(int i = 2; i < 8; ++i) {
+                palette[i] = ((8 - i) * hi + (i - 1) * lo + 3) / 7;
+            }
+            for(size_t n = 0; n < 16; ++n) {
+                const int v = values[n * stride];
+                uint64_t best = 0;
+                int best_error = 256;
+                for(uint64_t i = 0; i < 8; ++i) {
+                    const int error = std::abs(palette[i] - v);
+                    if(error < best_error) {
+                        best_error = error;
+                        best = i;
+                    }
+                }
+                indices |= best << (n * 3);
+            }
+        }
+        for(size_t n = 0; n < 6; ++n) {
+            block[2 + n] = static_cast<uint8_t>(indices >> (n * 8));
+        }
+    }
+}
+
+void encode_bc1_block(const uint8_t* rgba, uint8_t* block)
+{
+    float mean[3]{ };
+    for(size_t n = 0; n < 16; ++n) {
+        for(size_t c = 0; c < 3; ++c) {
+            mean[c] += rgba[n * 4 + c];
+        }
+    }
+    for(auto& m : mean) {
+        m /= 16.0f;
+    }
+    float cov[6]{ };
+    for(size_t n = 0; n < 16; ++n) {
+        const float r = rgba[n * 4] - mean[0];
+        const float g = rgba[n * 4 + 1] - mean[1];
+        const float b = rgba[n * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    // The principal axis by power iteration, a few steps are plenty for 16 points.
+    float axis[3]{ 1.0f, 1.0f, 1.0f };
+    for(int i = 0; i < 8; ++i) {
+        const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        const float length = std::max({ std::abs(x), std::abs(y), std::abs(z) });
+        if(length < 1e-6f) {
+            break;
+        }
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    size_t lo = 0;
+    size_t hi = 0;
+    float lo_dot = 1e30f;
+    float hi_dot = -1e30f;
+    for(size_t n = 0; n < 16; ++n) {
+        const float d = rgba[n * 4] * axis[0] + rgba[n * 4 + 1] * axis[1] + rgba[n * 4 + 2] * axis[2];
+        if(d < lo_dot) {
+            lo_dot = d;
+            lo = n;
+        }
+        if(d > hi_dot) {
+            hi_dot = d;
+            hi = n;
+        }
+    }
+    float e0[3];
+    float e1[3];
+    for(size_t c = 0; c < 3; ++c) {
+        // Pull the endpoints in a little, the extremes are rarely worth an exact match.
+        const float inset = (rgba[hi * 4 + c] - rgba[lo * 4 + c]) / 16.0f;
+        e0[c] = rgba[hi * 4 + c] - inset;
+        e1[c] = rgba[lo * 4 + c] + inset;
+    }
+
+    uint16_t c0 = pack_565(e0);
+    uint16_t c1 = pack_565(e1);
+    uint32_t indices = 0;
+    int error = fit_bc1_indices(rgba, c0, c1, indices);
+
+    // Refit the endpoints to the chosen indices by least squares, once, keeping it if it helps.
+    static constexpr float weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[3]{ }, bx[3]{ };
+    for(size_t n = 0; n < 16; ++n) {
+        const float a = weight[(indices >> (n * 2)) & 3];
+        const float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(size_t c = 0; c < 3; ++c) {
+            ax[c] += a * rgba[n * 4 + c];
+            bx[c] += b * rgba[n * 4 + c];
+        }
+    }
+    const float det = aa * bb - ab * ab;
+    if(std::abs(det) > 1e-6f) {
+        for(size_t c = 0; c < 3; ++c) {
+            e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+            e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+        }
+        const uint16_t r0 = pack_565(e0);
+        const uint16_t r1 = pack_565(e1);
+        uint32_t refit = 0;
+        const int refit_error = fit_bc1_indices(rgba, r0, r1, refit);
+        if(refit_error < error) {
+            c0 = r0;
+            c1 = r1;
+            indices = refit;
+            error = refit_error;
+        }
+    }
+    if(c0 < c1) {
+        // Swapping the endpoints swaps indices 0 and 1, and 2 and 3.
+        std::swap(c0, c1);
+        indices ^= 0x55555555u;
+    }
+
+    block[0] = static_cast<uint8_t>(c0);
+    block[1] = static_cast<uint8_t>(c0 >> 8);
+    block[2] = static_cast<uint8_t>(c1);
+    block[3] = static_cast<uint8_t>(c1 >> 8);
+    for(size_t n = 0; n < 4; ++n) {
+        block[4 + n] = static_cast<uint8_t>(indices >> (n * 8));
+    }
+}
+
+void encode_bc3_block(const uint8_t* rgba, uint8_t* block)
+{
+    encode_bc4_channel(rgba + 3, 4, block);
+    encode_bc1_block(rgba, block + 8);
+}
+
+void encode_bc4_block(const uint8_t* rgba, uint8_t* block)
+{
+    encode_bc4_channel(rgba, 4, block);
+}
+
+void encode_bc5_block(const uint8_t* rgba, uint8_t* block)
+{
+    encode_bc4_channel(rgba, 4, block);
+    encode_bc4_channel(rgba + 1, 4, block + 8);
+}
+
+bool bake_texture(const image& img, const bake_options& opts, thread_pool& pool, baked_texture& out)
+{
+    TR_PROFILE_ZONE("bake texture");
+    const texture_format format = opts.format_;
+    void (*encode)(const uint8_t*, uint8_t*) = nullptr;
+    switch(format) {
+        case texture_format::bc1:
+        case texture_format::bc1_srgb:  encode = encode_bc1_block; break;
+        case texture_format::bc3:
+        case texture_format::bc3_srgb:  encode = encode_bc3_block; break;
+        case texture_format::bc4:       encode = encode_bc4_block; break;
+        case texture_format::bc5:       encode = encode_bc5_block; break;
+        case texture_format::r8:
+        case texture_format::rg8:
+        case texture_format::rgba8:
+        case texture_format::srgb8_alpha8:
+            break;
+        default:
+            spdlog::error("Textures can't be baked to {}.", to_string(format));
+            return false;
+    }
+    if(img.empty()) {
+        spdlog::error("Nothing to bake in \"{}\".", img.path_);
+        return false;
+    }
+
+    out.desc_ = texture_desc{ };
+    out.desc_.width_ = img.width_;
+    out.desc_.height_ = img.height_;
+    out.desc_.format_ = format;
+    out.desc_.levels_ = opts.mipmaps_ ? mip_count(img.width_, img.height_) : 1;
+    out.levels_.clear();
+
+    // Filtering is done in linear space, averaging sRGB values darkens the smaller levels.
+    const bool srgb = is_srgb(format);
+    const auto& to_linear = srgb_to_linear_table();
+    std::vector<float> level(img.width_ * img.height_ * 4);
+    for(size_t n = 0; n < img.width_ * img.height_; ++n) {
+        for(size_t c = 0; c < 4; ++c) {
+            const uint8_t v = img.pixels_[n * 4 + c];
+            level[n * 4 + c] = srgb && c < 3 ? to_linear[v] : static_cast<float>(v) / 255.0f;
+        }
+    }
+    std::vector<float> next;
+    tracked_vector<uint8_t> texels{ tracked_allocator<uint8_t>(memory_tag::texture) };
+
+    size_t width = img.width_;
+    size_t height = img.height_;
+    for(size_t l = 0; l < out.desc_.levels_; ++l) {
+        if(l > 0) {
+            const size_t next_width = std::max<size_t>(width / 2, 1);
+            const size_t next_height = std::max<size_t>(height / 2, 1);
+            downsample(level, width, height, next, next_width, next_height, pool);
+            level.swap(next);
+            width = next_width;
+            height = next_height;
+        }
+
+        texels.resize(width * height * 4);
+        pool.parallel_for(height, [&](size_t begin, size_t end) {
+            for(size_t n = begin * width; n < end * width; ++n) {
+                for(size_t c = 0; c < 4; ++c) {
+                    texels[n * 4 + c] = srgb && c < 3 ? linear_to_srgb(level[n * 4 + c]) : to_unorm8(level[n * 4 + c]);
+                }
+            }
+        }, 8);
+
+        tracked_vector<uint8_t>& data = out.levels_.emplace_back(tracked_allocator<uint8_t>(memory_tag::texture));
+        data.resize(level_bytes(format, width, height));
+        if(encode == nullptr) {
+            const size_t channels = bytes_per_pixel(format);
+            for(size_t n = 0; n < width * height; ++n) {
+                std::memcpy(data.data() + n * channels, texels.data() + n * 4, channels);
+            }
+            continue;
+        }
+
+        const size_t blocks_x = (width + 3) / 4;
+        const size_t blocks_y = (height + 3) / 4;
+        const size_t block_size = bytes_per_block(format);
+        pool.parallel_for(blocks_y, [&](size_t begin, size_t end) {
+            uint8_t src[64];
+            for(size_t by = begin; by < end; ++by) {
+                for(size_t bx = 0; bx < blocks_x; ++bx) {
+                    // Blocks overhanging the edge repeat the last row and column.
+                    for(size_t y = 0; y < 4; ++y) {
+                        const size_t sy = std::min(by * 4 + y, height - 1);
+                        for(size_t x = 0; x < 4; ++x) {
+                            const size_t sx = std::min(bx * 4 + x, width - 1);
+                            std::memcpy(src + (y * 4 + x) * 4, texels.data() + (sy * width + sx) * 4, 4);
+                        }
+                    }
+                    encode(src, data.data() + (by * blocks_x + bx) * block_size);
+                }
+            }
+        });
+    }
+    return true;
+}
+
+bool write_texture_file(std::string_view path, const baked_texture& baked)
+{
+    texture_file_header header{ };
+    std::memcpy(header.magic_, texture_file_magic, sizeof(texture_file_magic));
+    header.version_ = texture_file_version;
+    header.format_ = static_cast<uint32_t>(baked.desc_.format_);
+    header.width_ = static_cast<uint32_t>(baked.desc_.width_);
+    header.height_ = static_cast<uint32_t>(baked.desc_.height_);
+    header.layers_ = static_cast<uint32_t>(baked.desc_.layers_);
+    header.levels_ = static_cast<uint32_t>(baked.levels_.size());
+
+    std::vector<texture_file_level> index(baked.levels_.size());
+    uint64_t offset = sizeof(header) + index.size() * sizeof(texture_file_level);
+    for(size_t n = 0; n < index.size(); ++n) {
+        offset = (offset + texture_file_alignment - 1) & ~uint64_t{ texture_file_alignment - 1 };
+        index[n].offset_ = offset;
+        index[n].length_ = baked.levels_[n].size();
+        offset += index[n].length_;
+    }
+
+    std::ofstream f{ std::string(path), std::ios::out | std::ios::binary | std::ios::trunc };
+    if(!f.is_open()) {
+        spdlog::error("Unable to open \"{}\" for writing.", path);
+        return false;
+    }
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(texture_file_level)));
+    for(size_t n = 0; n < index.size(); ++n) {
+        const std::streamoff padding = static_cast<std::streamoff>(index[n].offset_) - f.tellp();
+        const char zeros[texture_file_alignment]{ };
+        f.write(zeros, padding);
+        f.write(reinterpret_cast<const char*>(baked.levels_[n].data()), static_cast<std::streamsize>(baked.levels_[n].size()));
+    }
+    if(!f.good()) {
+        spdlog::error("Unable to write \"{}\".", path);
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "tr_gl_texture.h"
+#include "tr_memory.h"
+
+namespace tr {
+
+class thread_pool;
+struct image;
+
+struct bake_options
+{
+    /// @brief Output format, the sRGB formats are filtered in linear space.
+    texture_format format_{ texture_format::bc3_srgb };
+    bool mipmaps_{ true };
+};
+
+struct baked_texture
+{
+    texture_desc desc_{ };
+    /// @brief Texels or blocks of each level, largest first.
+    std::vector<tracked_vector<uint8_t>> levels_{ };
+};
+
+// Block encoders, each takes a 4x4 block of RGBA8 texels, rows top first.
+/// @brief BC1, the colour endpoints are fitted along the block's principal axis, alpha is dropped.
+void encode_bc1_block(const uint8_t* rgba, uint8_t* block);
+/// @brief BC3, BC1 colour with alpha encoded as a BC4 block.
+void encode_bc3_block(const uint8_t* rgba, uint8_t* block);
+/// @brief BC4 from the red channel.
+void encode_bc4_block(const uint8_t* rgba, uint8_t* block);
+/// @brief BC5 from the red and green channels.
+void encode_bc5_block(const uint8_t* rgba, uint8_t* block);
+
+/// @brief Builds the mip chain and encodes every level, spreading the work over the pool.
+/// @return false if the format can't be baked.
+bool bake_texture(const image& img, const bake_options& opts, thread_pool& pool, baked_texture& out);
+/// @brief Writes a baked texture in the container \c load_texture_file() reads.
+bool write_texture_file(std::string_view path, const baked_texture& baked);
+
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#include "tr_texture_file.h"
+#include "tr_mapped_file.h"
+#include "resource.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+bool parse_texture_file(std::span<const uint8_t> data, texture_file_view& view, std::string_view name)
+{
+    texture_file_header header;
+    if(data.size() < sizeof(header)) {
+        spdlog::error("Baked texture \"{}\" is too small for a header.", name);
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if(std::memcmp(header.magic_, texture_file_magic, sizeof(texture_file_magic)) != 0) {
+        spdlog::error("\"{}\" isn't a baked texture.", name);
+        return false;
+    }
+    if(header.version_ != texture_file_version) {
+        spdlog::error("Baked texture \"{}\" is version {}, expected {}.", name, header.version_, texture_file_version);
+        return false;
+    }
+    if(header.format_ > static_cast<uint32_t>(texture_format::bc5) || header.width_ == 0 || header.height_ == 0
+        || header.levels_ == 0 || header.levels_ > mip_count(header.width_, header.height_)) {
+        spdlog::error("Baked texture \"{}\" has an invalid header.", name);
+        return false;
+    }
+
+    const size_t index_end = sizeof(header) + header.levels_ * sizeof(texture_file_level);
+    if(data.size() < index_end) {
+        spdlog::error("Baked texture \"{}\" is truncated in its level index.", name);
+        return false;
+    }
+    // The index directly follows the 32 byte header, so it is suitably aligned in a mapping.
+    static_assert(sizeof(texture_file_header) % alignof(texture_file_level) == 0);
+    view.levels_ = std::span<const texture_file_level>(reinterpret_cast<const texture_file_level*>(data.data() + sizeof(header)), header.levels_);
+    view.base_ = data.data();
+    view.desc_.width_ = header.width_;
+    view.desc_.height_ = header.height_;
+    view.desc_.layers_ = header.layers_;
+    view.desc_.levels_ = header.levels_;
+    view.desc_.format_ = static_cast<texture_format>(header.format_);
+
+    const size_t layers = header.layers_ == 0 ? 1 : header.layers_;
+    for(size_t n = 0; n < header.levels_; ++n) {
+        const auto& l = view.levels_[n];
+        const size_t w = std::max<size_t>(header.width_ >> n, 1);
+        const size_t h = std::max<size_t>(header.height_ >> n, 1);
+        if(l.length_ != level_bytes(view.desc_.format_, w, h) * layers || l.offset_ < index_end || l.offset_ > data.size() || l.length_ > data.size() - l.offset_) {
+            spdlog::error("Baked texture \"{}\" has an invalid level {}.", name, n);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<gl_texture> load_texture_file(std::string_view filename)
+{
+    TR_PROFILE_ZONE("load texture file");
+    mapped_file file(resource::resolve(filename));
+    if(!file.is_open()) {
+        return nullptr;
+    }
+    texture_file_view view;
+    if(!parse_texture_file(file.bytes(), view, filename)) {
+        return nullptr;
+    }
+    if(!is_supported(view.desc_.format_)) {
+        spdlog::error("Baked texture \"{}\" is {}, which the driver doesn't support.", filename, to_string(view.desc_.format_));
+        return nullptr;
+    }
+
+    auto tex = std::make_unique<gl_texture>(view.desc_);
+    for(size_t n = 0; n < view.levels_.size(); ++n) {
+        const auto data = view.level(n);
+        const size_t layer_length = data.size() / tex->layers();
+        for(size_t layer = 0; layer < tex->layers(); ++layer) {
+            if(is_compressed(view.desc_.format_)) {
+                tex->upload_compressed(n, layer, data.data() + layer * layer_length, layer_length);
+            } else {
+                tex->upload(n, layer, 0, 0, tex->level_width(n), tex->level_height(n), data.data() + layer * layer_length);
+            }
+        }
+    }
+    spdlog::debug("Loaded {} {}x{} with {} levels from \"{}\"", to_string(view.desc_.format_), view.desc_.width_, view.desc_.height_, view.desc_.levels_, filename);
+    return tex;
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include "tr_gl_texture.h"
+
+namespace tr {
+
+// Baked texture container, laid out so levels can be handed to the driver
+// straight from a mapped file. Like KTX2 it is a header, a level index and the
+// level data, but without the data format descriptor and supercompression,
+// which the runtime has no use for. All values are little endian.
+//
+//  texture_file_header
+//  texture_file_level[levels_], largest first
+//  level data, each level starting on a texture_file_alignment boundary
+
+constexpr uint8_t texture_file_magic[8] = { 'T', 'R', 'T', 'E', 'X', '\r', '\n', 0x1a };
+constexpr uint32_t texture_file_version = 1;
+constexpr size_t texture_file_alignment = 16;
+
+struct texture_file_header
+{
+    uint8_t magic_[8];
+    uint32_t version_;
+    /// @brief A \c texture_format value.
+    uint32_t format_;
+    uint32_t width_;
+    uint32_t height_;
+    /// @brief 0 for a 2D texture, otherwise the layers of an array, stored one after another in each level.
+    uint32_t layers_;
+    uint32_t levels_;
+};
+
+struct texture_file_level
+{
+    uint64_t offset_;
+    uint64_t length_;
+};
+
+/// @brief A validated view of a baked texture in memory.
+struct texture_file_view
+{
+    texture_desc desc_{ };
+    std::span<const texture_file_level> levels_{ };
+    const uint8_t* base_{ nullptr };
+
+    std::span<const uint8_t> level(size_t n) const { return { base_ + levels_[n].offset_, static_cast<size_t>(levels_[n].length_) }; }
+};
+
+/// @brief Checks a baked texture's header and level index against its size.
+/// @return false, having logged why, if the data isn't a usable baked texture.
+bool parse_texture_file(std::span<const uint8_t> data, texture_file_view& view, std::string_view name = "texture");
+
+/// @brief Maps a baked texture resource and uploads its levels directly from the mapping.
+/// @return nullptr if the file is missing, malformed or its format isn't supported by the driver.
+std::unique_ptr<gl_texture> load_texture_file(std::string_view filename);
+
+}
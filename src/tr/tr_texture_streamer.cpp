@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <spdlog/spdlog.h>
+
+#include "tr_texture_streamer.h"
+#include "resource.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Updates a replaced texture is kept for, covering frames recorded but not yet replayed.
+    constexpr uint64_t retire_updates = 4;
+    /// @brief Updates a texture keeps its detail after it was last drawn, so it doesn't thrash at the edge of view.
+    constexpr uint64_t linger_updates = 60;
+
+    /// @brief Fills every layer of one level of \c tex with a level of a baked texture.
+    void fill_level(gl_texture& tex, size_t tex_level, const texture_file_view& view, size_t level, const uint8_t* data)
+    {
+        const size_t layer_length = static_cast<size_t>(view.levels_[level].length_) / tex.layers();
+        for(size_t layer = 0; layer < tex.layers(); ++layer) {
+            if(is_compressed(view.desc_.format_)) {
+                tex.upload_compressed(tex_level, layer, data + layer * layer_length, layer_length);
+            } else {
+                tex.upload(tex_level, layer, 0, 0, tex.level_width(tex_level), tex.level_height(tex_level), data + layer * layer_length);
+            }
+        }
+    }
+}
+
+texture_streamer::texture_streamer(size_t budget_bytes, size_t upload_bytes, size_t max_textures, size_t tail_size)
+    : entries_(std::make_unique<entry[]>(max_textures))
+    , max_textures_(max_textures)
+    , tail_size_(std::max<size_t>(tail_size, 1))
+    , upload_bytes_(upload_bytes)
+    , budget_bytes_(budget_bytes)
+{
+    stats_.budget_bytes_ = budget_bytes;
+    thread_ = std::thread(&texture_streamer::worker, this);
+}
+
+texture_streamer::~texture_streamer()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+texture_streamer::handle texture_streamer::register_texture(std::string_view filename)
+{
+    std::lock_guard lock(register_mutex_);
+    const size_t n = count_.load(std::memory_order_relaxed);
+    if(n == max_textures_) {
+        spdlog::error("Unable to stream \"{}\", all {} textures are in use.", filename, max_textures_);
+        return invalid_handle;
+    }
+    entry& e = entries_[n];
+    if(!e.file_.open(resource::resolve(filename))) {
+        return invalid_handle;
+    }
+    if(!parse_texture_file(e.file_.bytes(), e.view_, filename)) {
+        e.file_.close();
+        return invalid_handle;
+    }
+    if(!is_supported(e.view_.desc_.format_)) {
+        spdlog::error("Baked texture \"{}\" is {}, which the driver doesn't support.", filename, to_string(e.view_.desc_.format_));
+        e.file_.close();
+        return invalid_handle;
+    }
+    e.name_ = filename;
+    const size_t levels = e.view_.levels_.size();
+    e.tail_ = levels - 1;
+    while(e.tail_ > 0 && std::max(e.view_.desc_.width_ >> (e.tail_ - 1), e.view_.desc_.height_ >> (e.tail_ - 1)) <= tail_size_) {
+        --e.tail_;
+    }
+    e.requested_ = e.tail_;
+    e.wanted_ = e.tail_;
+    // Nothing is resident until the tail is uploaded.
+    e.resident_ = levels;
+    e.allocated_ = levels;
+    count_.store(n + 1, std::memory_order_release);
+    return n;
+}
+
+void texture_streamer::note_usage(handle h, float width, float height)
+{
+    if(h >= count_.load(std::memory_order_acquire)) {
+        return;
+    }
+    entry& e = entries_[h];
+    const float ratio = std::max(static_cast<float>(e.view_.desc_.width_) / std::max(width, 1.0f),
+        static_cast<float>(e.view_.desc_.height_) / std::max(height, 1.0f));
+    // Trilinear filtering at a ratio between two levels blends both, the finer one is the one needed.
+    const uint32_t level = ratio <= 1.0f ? 0 : static_cast<uint32_t>(std::floor(std::log2(ratio)));
+    uint32_t current = e.usage_.load(std::memory_order_relaxed);
+    while(level < current && !e.usage_.compare_exchange_weak(current, level, std::memory_order_relaxed)) {
+    }
+}
+
+unsigned texture_streamer::texture_id(handle h) const
+{
+    if(h >= count_.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    return entries_[h].id_.load(std::memory_order_acquire);
+}
+
+const std::string& texture_streamer::name(handle h) const
+{
+    return entries_[h].name_;
+}
+
+size_t texture_streamer::resident_level(handle h) const
+{
+    return entries_[h].resident_.load(std::memory_order_relaxed);
+}
+
+streaming_stats texture_streamer::stats() const
+{
+    std::lock_guard lock(stats_mutex_);
+    return stats_;
+}
+
+size_t texture_streamer::chain_bytes(const entry& e, size_t level)
+{
+    size_t bytes = 0;
+    for(size_t n = level; n < e.view_.levels_.size(); ++n) {
+        bytes += static_cast<size_t>(e.view_.levels_[n].length_);
+    }
+    return bytes;
+}
+
+void texture_streamer::create(entry& e)
+{
+    reallocate(e, e.tail_);
+    for(size_t level = e.view_.levels_.size(); level-- > e.tail_;) {
+        fill_level(*e.texture_, level - e.tail_, e.view_, level, e.view_.level(level).data());
+    }
+    e.resident_ = e.tail_;
+    e.texture_->set_base_level(0);
+}
+
+void texture_streamer::reallocate(entry& e, size_t level)
+{
+    texture_desc desc = e.view_.desc_;
+    desc.width_ = std::max<size_t>(desc.width_ >> level, 1);
+    desc.height_ = std::max<size_t>(desc.height_ >> level, 1);
+    desc.levels_ = e.view_.levels_.size() - level;
+    auto tex = std::make_unique<gl_texture>(desc);
+
+    // Resident levels finer than the new first level are dropped, the rest are carried over.
+    const size_t first = std::max(e.resident_.load(std::memory_order_relaxed), level);
+    for(size_t n = first; n < e.view_.levels_.size(); ++n) {
+        if(!e.texture_ || !tex->copy_level(n - level, *e.texture_, n - e.allocated_)) {
+            fill_level(*tex, n - level, e.view_, n, e.view_.level(n).data());
+        }
+    }
+    tex->set_base_level(first - level);
+
+    if(e.texture_) {
+        retired_.push_back({ std::move(e.texture_), frame_ });
+    }
+    e.texture_ = std::move(tex);
+    e.allocated_ = level;
+    e.resident_ = first;
+    e.id_.store(e.texture_->texture_id(), std::memory_order_release);
+}
+
+size_t texture_streamer::fit_budget()
+{
+    size_t wanted_bytes = 0;
+    for(size_t n = 0; n < created_; ++n) {
+        entry& e = entries_[n];
+        const uint32_t usage = e.usage_.exchange(UINT32_MAX, std::memory_order_relaxed);
+        if(usage != UINT32_MAX) {
+            e.requested_ = std::min<size_t>(usage, e.tail_);
+            e.last_used_ = frame_;
+        } else if(frame_ - e.last_used_ > linger_updates) {
+            e.requested_ = e.tail_;
+        }
+        e.wanted_ = e.requested_;
+        wanted_bytes += chain_bytes(e, e.wanted_);
+    }
+
+    // Over budget, give up the largest level wanted until it fits, which evens
+    // out the detail of the largest textures first.
+    const size_t budget = budget_bytes_.load(std::memory_order_relaxed);
+    size_t total = wanted_bytes;
+    if(total > budget) {
+        std::priority_queue<std::pair<size_t, size_t>> largest;
+        for(size_t n = 0; n < created_; ++n) {
+            const entry& e = entries_[n];
+            if(e.wanted_ < e.tail_) {
+                largest.emplace(static_cast<size_t>(e.view_.levels_[e.wanted_].length_), n);
+            }
+        }
+        while(total > budget && !largest.empty()) {
+            const size_t n = largest.top().second;
+            largest.pop();
+            entry& e = entries_[n];
+            total -= static_cast<size_t>(e.view_.levels_[e.wanted_].length_);
+            ++e.wanted_;
+            if(e.wanted_ < e.tail_) {
+                largest.emplace(static_cast<size_t>(e.view_.levels_[e.wanted_].length_), n);
+            }
+        }
+    }
+    return wanted_bytes;
+}
+
+void texture_streamer::update()
+{
+    TR_PROFILE_ZONE("texture streaming");
+    ++frame_;
+    const size_t count = count_.load(std::memory_order_acquire);
+    for(; created_ < count; ++created_) {
+        create(entries_[created_]);
+    }
+    while(!retired_.empty() && frame_ - retired_.front().frame_ > retire_updates) {
+        retired_.pop_front();
+    }
+
+    uint64_t loaded = 0;
+    uint64_t dropped = 0;
+    uint64_t bytes_streamed = 0;
+    {
+        std::lock_guard lock(mutex_);
+        std::move(read_.begin(), read_.end(), std::back_inserter(uploads_));
+        read_.clear();
+    }
+    // At least one level goes up each update, however large.
+    size_t uploaded = 0;
+    while(!uploads_.empty() && (uploaded == 0 || uploaded + uploads_.front().data_.size() <= upload_bytes_)) {
+        load l = std::move(uploads_.front());
+        uploads_.pop_front();
+        entry& e = entries_[l.handle_];
+        e.loading_ = false;
+        uploaded += l.data_.size();
+        // The texture may have been shrunk past this level while it was read.
+        if(l.level_ + 1 == e.resident_ && l.level_ >= e.allocated_) {
+            fill_level(*e.texture_, l.level_ - e.allocated_, e.view_, l.level_, l.data_.data());
+            e.texture_->set_base_level(l.level_ - e.allocated_);
+            e.resident_ = l.level_;
+            ++loaded;
+            bytes_streamed += l.data_.size();
+        }
+    }
+
+    const size_t wanted_bytes = fit_budget();
+
+    // Shrink first, so the memory is free before anything grows.
+    for(size_t n = 0; n < created_; ++n) {
+        entry& e = entries_[n];
+        if(e.wanted_ > e.allocated_) {
+            dropped += e.wanted_ - std::min(e.wanted_, e.resident_.load(std::memory_order_relaxed));
+            reallocate(e, e.wanted_);
+        }
+    }
+    size_t pending = 0;
+    size_t deferred = 0;
+    std::vector<load> reads;
+    for(size_t n = 0; n < created_; ++n) {
+        entry& e = entries_[n];
+        deferred += e.wanted_ - e.requested_;
+        if(e.wanted_ < e.resident_ && !e.loading_) {
+            if(e.allocated_ > e.wanted_) {
+                reallocate(e, e.wanted_);
+            }
+            load& l = reads.emplace_back();
+            l.handle_ = n;
+            l.level_ = e.resident_ - 1;
+            e.loading_ = true;
+        }
+        pending += e.loading_ ? 1 : 0;
+    }
+    if(!reads.empty()) {
+        {
+            std::lock_guard lock(mutex_);
+            std::move(reads.begin(), reads.end(), std::back_inserter(queued_));
+        }
+        cv_.notify_one();
+    }
+
+    size_t resident_bytes = 0;
+    for(size_t n = 0; n < created_; ++n) {
+        resident_bytes += entries_[n].texture_->size_bytes();
+    }
+    std::lock_guard lock(stats_mutex_);
+    stats_.textures_ = created_;
+    stats_.budget_bytes_ = budget_bytes_.load(std::memory_order_relaxed);
+    stats_.resident_bytes_ = resident_bytes;
+    stats_.wanted_bytes_ = wanted_bytes;
+    stats_.pending_loads_ = pending;
+    stats_.loaded_levels_ += loaded;
+    stats_.dropped_levels_ += dropped;
+    stats_.deferred_levels_ = deferred;
+    stats_.bytes_streamed_ += bytes_streamed;
+}
+
+void texture_streamer::worker()
+{
+    profiler::set_thread_name("texture streaming");
+    std::unique_lock lock(mutex_);
+    while(true) {
+        cv_.wait(lock, [this] { return stop_ || !queued_.empty(); });
+        if(stop_) {
+            break;
+        }
+        load l = std::move(queued_.front());
+        queued_.pop_front();
+
+        lock.unlock();
+        // Copying out of the mapping takes the page faults here rather than on the GL thread.
+        const auto src = entries_[l.handle_].view_.level(l.level_);
+        l.data_.assign(src.begin(), src.end());
+        lock.lock();
+
+        read_.emplace_back(std::move(l));
+    }
+}
+
+}
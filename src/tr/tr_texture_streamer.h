@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "tr_gl_texture.h"
+#include "tr_mapped_file.h"
+#include "tr_memory.h"
+#include "tr_texture_file.h"
+
+namespace tr {
+
+struct streaming_stats
+{
+    size_t textures_{ 0 };
+    size_t budget_bytes_{ 0 };
+    /// @brief GPU memory of every streamed texture's allocated levels.
+    size_t resident_bytes_{ 0 };
+    /// @brief What the recorded usage asked for, before fitting it to the budget.
+    size_t wanted_bytes_{ 0 };
+    /// @brief Textures with a level being read or waiting to be uploaded.
+    size_t pending_loads_{ 0 };
+    /// @brief Levels streamed in since startup.
+    uint64_t loaded_levels_{ 0 };
+    /// @brief Levels dropped since startup, because they weren't needed or to make room.
+    uint64_t dropped_levels_{ 0 };
+    /// @brief Levels kept from being loaded by the budget in the last update.
+    size_t deferred_levels_{ 0 };
+    uint64_t bytes_streamed_{ 0 };
+};
+
+// Keeps baked textures resident at the detail they are drawn at, within a
+// budget of GPU memory. Draws record how large each texture appears on screen
+// with note_usage(), and once a frame update() turns that into the finest
+// level each texture needs. When the total doesn't fit the budget the largest
+// levels are given up first.
+//
+// Only the levels in use are allocated. A texture gaining detail is replaced
+// by a larger one holding the resident levels, copied on the GPU, and the new
+// levels are read from the mapped file on a worker thread and uploaded one at
+// a time, coarsest first. Until a level arrives the base level clamps sampling
+// to what is resident, so a draw never sees an empty level. Losing detail
+// replaces the texture with a smaller one straight away. The smallest levels,
+// up to \c tail_size texels across, are always resident.
+//
+// A texture's GL name changes when it is replaced, draws look it up with
+// texture_id() when they are recorded. Replaced textures are kept for a few
+// updates, as draws recorded with their name may not have been replayed yet.
+//
+// register_texture(), note_usage() and texture_id() may be called on any
+// thread, update() is called on the GL thread.
+class texture_streamer
+{
+public:
+    typedef size_t handle;
+    static constexpr handle invalid_handle = ~size_t(0);
+
+    /// @param budget_bytes GPU memory the streamed textures may use.
+    /// @param upload_bytes Most bytes uploaded by one update.
+    /// @param max_textures Textures that can be registered, the table is allocated once so lookups need no lock.
+    texture_streamer(size_t budget_bytes, size_t upload_bytes = 8 << 20, size_t max_textures = 1024, size_t tail_size = 64);
+    /// @brief Drops queued reads and waits for the one in progress.
+    ~texture_streamer();
+    /// @brief Maps a baked texture, its tail levels are uploaded by the next update.
+    /// @return invalid_handle if the file is missing, malformed, unsupported or the table is full.
+    handle register_texture(std::string_view filename);
+    /// @brief Records that a texture is drawn covering about \c width by \c height pixels.
+    void note_usage(handle h, float width, float height);
+    /// @brief GL name of a texture, 0 until its tail levels are uploaded.
+    unsigned texture_id(handle h) const;
+    const std::string& name(handle h) const;
+    size_t textures() const { return count_.load(std::memory_order_acquire); }
+    /// @brief Finest level resident, relative to the full chain.
+    size_t resident_level(handle h) const;
+
+    void set_budget(size_t bytes) { budget_bytes_.store(bytes, std::memory_order_relaxed); }
+    size_t budget() const { return budget_bytes_.load(std::memory_order_relaxed); }
+
+    /// @brief Uploads finished reads, fits the recorded usage to the budget and starts the reads it needs.
+    void update();
+    streaming_stats stats() const;
+private:
+    struct entry
+    {
+        std::string name_{ };
+        mapped_file file_{ };
+        texture_file_view view_{ };
+        /// @brief Coarsest level streamed, the ones after it are the tail.
+        size_t tail_{ 0 };
+        std::unique_ptr<gl_texture> texture_{ };
+        /// @brief Level of the full chain held in the texture's first level.
+        size_t allocated_{ 0 };
+        /// @brief Finest level holding data, sampling is clamped to it.
+        std::atomic<size_t> resident_{ 0 };
+        /// @brief Finest level the recorded usage asks for.
+        size_t requested_{ 0 };
+        /// @brief The requested level once fitted to the budget.
+        size_t wanted_{ 0 };
+        bool loading_{ false };
+        uint64_t last_used_{ 0 };
+        /// @brief Finest level noted since the last update.
+        std::atomic<uint32_t> usage_{ UINT32_MAX };
+        std::atomic<unsigned> id_{ 0 };
+    };
+    struct load
+    {
+        handle handle_{ invalid_handle };
+        size_t level_{ 0 };
+        tracked_vector<uint8_t> data_{ tracked_allocator<uint8_t>(memory_tag::texture) };
+    };
+    struct retired
+    {
+        std::unique_ptr<gl_texture> texture_{ };
+        uint64_t frame_{ 0 };
+    };
+
+    /// @brief Bytes of the levels from \c level to the end of the chain.
+    static size_t chain_bytes(const entry& e, size_t level);
+    void create(entry& e);
+    /// @brief Replaces the texture with one whose first level is \c level, keeping the resident levels that fit.
+    void reallocate(entry& e, size_t level);
+    /// @brief Sets each texture's wanted level from its usage and lowers them until they fit the budget.
+    /// @return The bytes asked for before fitting.
+    size_t fit_budget();
+    void worker();
+
+    std::unique_ptr<entry[]> entries_;
+    const size_t max_textures_;
+    const size_t tail_size_;
+    const size_t upload_bytes_;
+    std::atomic<size_t> count_{ 0 };
+    std::mutex register_mutex_;
+    std::atomic<size_t> budget_bytes_;
+
+    // GL thread state.
+    size_t created_{ 0 };
+    uint64_t frame_{ 0 };
+    std::deque<retired> retired_{ };
+    std::deque<load> uploads_{ };
+
+    mutable std::mutex stats_mutex_;
+    streaming_stats stats_{ };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<load> queued_{ };
+    std::deque<load> read_{ };
+    bool stop_{ false };
+    std::thread thread_;
+
+    texture_streamer(const texture_streamer&) = delete;
+    texture_streamer(texture_streamer&&) = delete;
+    texture_streamer& operator=(const texture_streamer&) = delete;
+    texture_streamer& operator=(texture_streamer&&) = delete;
+};
+
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+
+#include "tr_texture_uploader.h"
+#include "tr_gl_texture.h"
+#include "tr_image.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    /// @brief How long to wait for a staging buffer before giving up on its fence.
+    constexpr GLuint64 stall_timeout_ns = 1'000'000'000;
+}
+
+texture_uploader::texture_uploader(size_t ring_size)
+{
+    slots_.resize(std::max<size_t>(ring_size, 1));
+    for(auto& s : slots_) {
+        glGenBuffers(1, &s.pbo_);
+    }
+}
+
+texture_uploader::~texture_uploader()
+{
+    for(auto& s : slots_) {
+        if(s.fence_ != nullptr) {
+            glDeleteSync(static_cast<GLsync>(s.fence_));
+        }
+        glDeleteBuffers(1, &s.pbo_);
+    }
+}
+
+void texture_uploader::upload(gl_texture& tex, size_t level, size_t layer, size_t x, size_t y, size_t width, size_t height, const void* pixels)
+{
+    TR_PROFILE_ZONE("texture upload");
+    slot& s = slots_[next_];
+    next_ = (next_ + 1) % slots_.size();
+
+    bool in_use = false;
+    if(s.fence_ != nullptr) {
+        const GLsync fence = static_cast<GLsync>(s.fence_);
+        if(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+            ++stalls_;
+            if(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, stall_timeout_ns) == GL_TIMEOUT_EXPIRED) {
+                spdlog::warn("Staging buffer still in use after {} ms, orphaning it.", stall_timeout_ns / 1'000'000);
+                in_use = true;
+            }
+        }
+        glDeleteSync(fence);
+        s.fence_ = nullptr;
+    }
+
+    const size_t length = width * height * bytes_per_pixel(tex.desc().format_);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo_);
+    // A buffer the GPU may still be reading is orphaned, the driver gives it new
+    // storage and frees the old once the reads are done.
+    if(length > s.capacity_.bytes() || in_use) {
+        const size_t capacity = std::max(length, s.capacity_.bytes());
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        s.capacity_.set(capacity);
+    }
+    // The fence has signalled or the storage is new, so nothing reads the buffer and the driver needn't synchronise.
+    void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, length, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(staging == nullptr) {
+        // Fall back to a plain upload rather than lose the texels.
+        spdlog::warn("Unable to map a staging buffer, uploading directly.");
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        tex.upload(level, layer, x, y, width, height, pixels);
+        return;
+    }
+    std::memcpy(staging, pixels, length);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // With the unpack buffer bound the pointer is an offset into it.
+    tex.upload(level, layer, x, y, width, height, nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    s.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    bytes_staged_ += length;
+}
+
+void texture_uploader::upload(gl_texture& tex, const image& img, size_t layer)
+{
+    upload(tex, 0, layer, 0, 0, img.width_, img.height_, img.pixels_.data());
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+class gl_texture;
+struct image;
+
+// Streams texel data to textures through a ring of pixel unpack buffers.
+// The pixels are copied into the next staging buffer and the texture is filled
+// from it by the driver in the background, a fence behind each copy tells when
+// the staging buffer can be written again. The ring only stalls when every
+// buffer is still in flight, which stalls() counts.
+class texture_uploader
+{
+public:
+    explicit texture_uploader(size_t ring_size = 4);
+    ~texture_uploader();
+    /// @brief Queues a region of one level of one layer, rows tightly packed.
+    void upload(gl_texture& tex, size_t level, size_t layer, size_t x, size_t y, size_t width, size_t height, const void* pixels);
+    /// @brief Queues a whole image into the first level of one layer.
+    void upload(gl_texture& tex, const image& img, size_t layer = 0);
+    /// @brief Bytes staged since startup.
+    uint64_t bytes_staged() const { return bytes_staged_; }
+    /// @brief Uploads that had to wait for a staging buffer.
+    size_t stalls() const { return stalls_; }
+private:
+    struct slot
+    {
+        unsigned pbo_{ 0 };
+        gpu_allocation capacity_{ memory_tag::texture };
+        void* fence_{ nullptr };
+    };
+    std::vector<slot> slots_{ };
+    size_t next_{ 0 };
+    uint64_t bytes_staged_{ 0 };
+    size_t stalls_{ 0 };
+
+    texture_uploader(const texture_uploader&) = delete;
+    texture_uploader(texture_uploader&&) = delete;
+    texture_uploader& operator=(const texture_uploader&) = delete;
+    texture_uploader& operator=(texture_uploader&&) = delete;
+};
+
+}
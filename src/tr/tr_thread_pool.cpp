@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#include "tr_thread_pool.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+thread_pool::thread_pool(size_t threads)
+{
+    if(threads == 0) {
+        const size_t hardware = std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 0;
+    }
+    for(size_t n = 0; n < threads; ++n) {
+        workers_.emplace_back(&thread_pool::worker, this, n);
+    }
+    spdlog::debug("Thread pool started with {} workers", threads);
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for(auto& t : workers_) {
+        t.join();
+    }
+}
+
+void thread_pool::parallel_for(size_t count, const range_fn& fn, size_t min_chunk)
+{
+    if(count == 0) {
+        return;
+    }
+    min_chunk = std::max<size_t>(min_chunk, 1);
+    if(workers_.empty() || count <= min_chunk) {
+        fn(0, count);
+        return;
+    }
+
+    std::lock_guard call(call_mutex_);
+    {
+        std::lock_guard lock(mutex_);
+        job_ = &fn;
+        count_ = count;
+        // A few chunks per thread evens out items that take different times.
+        chunk_ = std::max(min_chunk, count / (concurrency() * 4));
+        next_.store(0, std::memory_order_relaxed);
+        busy_ = workers_.size();
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    run_chunks();
+
+    std::unique_lock lock(mutex_);
+    done_cv_.wait(lock, [this] { return busy_ == 0; });
+    job_ = nullptr;
+}
+
+void thread_pool::worker(size_t index)
+{
+    profiler::set_thread_name(fmt::format("worker {}", index));
+    uint64_t seen = 0;
+    std::unique_lock lock(mutex_);
+    while(true) {
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if(stop_) {
+            return;
+        }
+        seen = generation_;
+
+        lock.unlock();
+        run_chunks();
+        lock.lock();
+
+        if(--busy_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+void thread_pool::run_chunks()
+{
+    TR_PROFILE_ZONE("parallel_for");
+    while(true) {
+        const size_t begin = next_.fetch_add(chunk_, std::memory_order_relaxed);
+        if(begin >= count_) {
+            break;
+        }
+        (*job_)(begin, std::min(begin + chunk_, count_));
+    }
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tr {
+
+// Fixed set of worker threads for data parallel work.
+// parallel_for() splits an index range into chunks that the workers and the
+// calling thread claim in turn, and returns once every chunk is done, so the
+// caller can use the results without further synchronisation. One
+// parallel_for() runs at a time, calls from several threads are serialised.
+class thread_pool
+{
+public:
+    typedef std::function<void(size_t, size_t)> range_fn;
+
+    /// @param threads Workers to start, 0 for one less than the hardware threads.
+    explicit thread_pool(size_t threads = 0);
+    ~thread_pool();
+    /// @brief Threads that work on a \c parallel_for(), the workers and the caller.
+    size_t concurrency() const { return workers_.size() + 1; }
+    /// @brief Calls \c fn(begin, end) for consecutive ranges covering [0, count), in parallel.
+    /// @param min_chunk Smallest range handed out, so cheap items aren't split too finely.
+    void parallel_for(size_t count, const range_fn& fn, size_t min_chunk = 1);
+private:
+    void worker(size_t index);
+    /// @brief Claims and runs chunks of the current job until none are left.
+    void run_chunks();
+
+    std::vector<std::thread> workers_{ };
+    /// @brief Serialises calls to parallel_for().
+    std::mutex call_mutex_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const range_fn* job_{ nullptr };
+    size_t count_{ 0 };
+    size_t chunk_{ 1 };
+    std::atomic<size_t> next_{ 0 };
+    /// @brief Workers still running the current job.
+    size_t busy_{ 0 };
+    /// @brief Incremented for every job, so a worker runs each one once.
+    uint64_t generation_{ 0 };
+    bool stop_{ false };
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool(thread_pool&&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    thread_pool& operator=(thread_pool&&) = delete;
+};
+
+}
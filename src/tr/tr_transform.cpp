@@ -0,0 +1,360 @@
+#include <mutex>
+#include <spdlog/spdlog.h>
+
+#include "tr_transform.h"
+#include "tr_simd.h"
+#include "tr_thread_pool.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+namespace {
+    /// @brief Groups of four slots a level needs before it is split across the pool.
+    constexpr size_t parallel_groups = 64;
+    /// @brief Fewest groups a worker is given.
+    constexpr size_t min_chunk_groups = 16;
+
+    void set_lane(soa_transform& t, size_t n, const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale)
+    {
+        t.tx_[n] = translation.x;
+        t.ty_[n] = translation.y;
+        t.tz_[n] = translation.z;
+        t.rx_[n] = rotation.x;
+        t.ry_[n] = rotation.y;
+        t.rz_[n] = rotation.z;
+        t.rw_[n] = rotation.w;
+        t.sx_[n] = scale.x;
+        t.sy_[n] = scale.y;
+        t.sz_[n] = scale.z;
+    }
+
+    void copy_lane(const soa_transform& from, size_t a, soa_transform& to, size_t b)
+    {
+        to.tx_[b] = from.tx_[a];
+        to.ty_[b] = from.ty_[a];
+        to.tz_[b] = from.tz_[a];
+        to.rx_[b] = from.rx_[a];
+        to.ry_[b] = from.ry_[a];
+        to.rz_[b] = from.rz_[a];
+        to.rw_[b] = from.rw_[a];
+        to.sx_[b] = from.sx_[a];
+        to.sy_[b] = from.sy_[a];
+        to.sz_[b] = from.sz_[a];
+    }
+
+    soa_transform identity_group()
+    {
+        soa_transform t;
+        for(size_t n = 0; n < 4; ++n) {
+            set_lane(t, n, glm::vec3(0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec3(1.0f));
+        }
+        return t;
+    }
+}
+
+void compose_matrices(const soa_transform& t, size_t count, glm::mat4* out)
+{
+    const simd4f one = simd4f::splat(1.0f);
+    const simd4f two = simd4f::splat(2.0f);
+    const simd4f x = simd4f::load(t.rx_);
+    const simd4f y = simd4f::load(t.ry_);
+    const simd4f z = simd4f::load(t.rz_);
+    const simd4f w = simd4f::load(t.rw_);
+    const simd4f sx = simd4f::load(t.sx_);
+    const simd4f sy = simd4f::load(t.sy_);
+    const simd4f sz = simd4f::load(t.sz_);
+    const simd4f xx = x * x, yy = y * y, zz = z * z;
+    const simd4f xy = x * y, xz = x * z, yz = y * z;
+    const simd4f wx = w * x, wy = w * y, wz = w * z;
+
+    float m[9][4];
+    ((one - two * (yy + zz)) * sx).store(m[0]);
+    (two * (xy + wz) * sx).store(m[1]);
+    (two * (xz - wy) * sx).store(m[2]);
+    (two * (xy - wz) * sy).store(m[3]);
+    ((one - two * (xx + zz)) * sy).store(m[4]);
+    (two * (yz + wx) * sy).store(m[5]);
+    (two * (xz + wy) * sz).store(m[6]);
+    (two * (yz - wx) * sz).store(m[7]);
+    ((one - two * (xx + yy)) * sz).store(m[8]);
+    for(size_t n = 0; n < count && n < 4; ++n) {
+        glm::mat4& local = out[n];
+        local[0] = glm::vec4(m[0][n], m[1][n], m[2][n], 0.0f);
+        local[1] = glm::vec4(m[3][n], m[4][n], m[5][n], 0.0f);
+        local[2] = glm::vec4(m[6][n], m[7][n], m[8][n], 0.0f);
+        local[3] = glm::vec4(t.tx_[n], t.ty_[n], t.tz_[n], 1.0f);
+    }
+}
+
+void multiply_matrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+    const simd4f a0 = simd4f::load(&a[0][0]);
+    const simd4f a1 = simd4f::load(&a[1][0]);
+    const simd4f a2 = simd4f::load(&a[2][0]);
+    const simd4f a3 = simd4f::load(&a[3][0]);
+    // Each column of the result only reads the same column of b, so out may be b.
+    for(int c = 0; c < 4; ++c) {
+        const glm::vec4 col = b[c];
+        const simd4f r = madd(a0, simd4f::splat(col.x), madd(a1, simd4f::splat(col.y),
+            madd(a2, simd4f::splat(col.z), a3 * simd4f::splat(col.w))));
+        r.store(&out[c][0]);
+    }
+}
+
+transform_id transform_hierarchy::create(transform_id parent)
+{
+    if(parent != invalid_transform && !valid(parent)) {
+        spdlog::error("Can't add a transform under {}, no such transform", parent);
+        return invalid_transform;
+    }
+    transform_id id;
+    if(!free_ids_.empty()) {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    } else {
+        id = static_cast<transform_id>(slots_.size());
+        slots_.push_back(invalid_transform);
+    }
+    // Added at the end for now, rebuild() moves it into its level.
+    const size_t slot = ids_.size();
+    slots_[id] = static_cast<uint32_t>(slot);
+    ids_.push_back(id);
+    parents_.push_back(parent == invalid_transform ? -1 : static_cast<int32_t>(slots_[parent]));
+    dirty_.push_back(1);
+    updated_.push_back(0);
+    world_.emplace_back(1.0f);
+    if(locals_.size() * 4 <= slot) {
+        locals_.push_back(identity_group());
+    }
+    set_lane(locals_[slot / 4], slot % 4, glm::vec3(0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec3(1.0f));
+    ++count_;
+    structure_dirty_ = true;
+    return id;
+}
+
+void transform_hierarchy::destroy(transform_id id)
+{
+    if(!valid(id)) {
+        return;
+    }
+    // Sorted, everything under the node comes after it, so one pass finds it all.
+    if(structure_dirty_) {
+        rebuild();
+    }
+    const uint32_t first = slots_[id];
+    for(size_t s = first; s < ids_.size(); ++s) {
+        if(ids_[s] == invalid_transform) {
+            continue;
+        }
+        const int32_t parent = parents_[s];
+        if(s == first || (parent >= 0 && ids_[parent] == invalid_transform)) {
+            slots_[ids_[s]] = invalid_transform;
+            free_ids_.push_back(ids_[s]);
+            ids_[s] = invalid_transform;
+            --count_;
+        }
+    }
+    structure_dirty_ = true;
+}
+
+bool transform_hierarchy::set_parent(transform_id id, transform_id parent)
+{
+    if(!valid(id) || (parent != invalid_transform && !valid(parent))) {
+        spdlog::error("Can't parent transform {} to {}, no such transform", id, parent);
+        return false;
+    }
+    const int32_t slot = static_cast<int32_t>(slots_[id]);
+    int32_t p = parent == invalid_transform ? -1 : static_cast<int32_t>(slots_[parent]);
+    for(int32_t up = p; up >= 0; up = parents_[up]) {
+        if(up == slot) {
+            spdlog::error("Can't parent transform {} to {}, which is under it", id, parent);
+            return false;
+        }
+    }
+    parents_[slot] = p;
+    dirty_[slot] = 1;
+    structure_dirty_ = true;
+    return true;
+}
+
+void transform_hierarchy::set_local(transform_id id, const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale)
+{
+    const uint32_t slot = slots_[id];
+    set_lane(locals_[slot / 4], slot % 4, translation, rotation, scale);
+    dirty_[slot] = 1;
+}
+
+void transform_hierarchy::set_translation(transform_id id, const glm::vec3& translation)
+{
+    const uint32_t slot = slots_[id];
+    soa_transform& t = locals_[slot / 4];
+    t.tx_[slot % 4] = translation.x;
+    t.ty_[slot % 4] = translation.y;
+    t.tz_[slot % 4] = translation.z;
+    dirty_[slot] = 1;
+}
+
+void transform_hierarchy::set_rotation(transform_id id, const glm::vec4& rotation)
+{
+    const uint32_t slot = slots_[id];
+    soa_transform& t = locals_[slot / 4];
+    t.rx_[slot % 4] = rotation.x;
+    t.ry_[slot % 4] = rotation.y;
+    t.rz_[slot % 4] = rotation.z;
+    t.rw_[slot % 4] = rotation.w;
+    dirty_[slot] = 1;
+}
+
+void transform_hierarchy::set_scale(transform_id id, const glm::vec3& scale)
+{
+    const uint32_t slot = slots_[id];
+    soa_transform& t = locals_[slot / 4];
+    t.sx_[slot % 4] = scale.x;
+    t.sy_[slot % 4] = scale.y;
+    t.sz_[slot % 4] = scale.z;
+    dirty_[slot] = 1;
+}
+
+void transform_hierarchy::rebuild()
+{
+    TR_PROFILE_ZONE("sort transforms");
+    const size_t slots = ids_.size();
+    // Depth of every live slot. Moved nodes may sit before their parents, so
+    // each walks up until it meets a depth already known.
+    std::vector<int32_t> depth(slots, -1);
+    std::vector<uint32_t> chain;
+    size_t max_depth = 0;
+    for(size_t s = 0; s < slots; ++s) {
+        if(ids_[s] == invalid_transform || depth[s] >= 0) {
+            continue;
+        }
+        chain.clear();
+        int32_t up = static_cast<int32_t>(s);
+        while(up >= 0 && depth[up] < 0) {
+            chain.push_back(static_cast<uint32_t>(up));
+            up = parents_[up];
+        }
+        int32_t d = up >= 0 ? depth[up] : -1;
+        for(auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            depth[*it] = ++d;
+        }
+        max_depth = std::max(max_depth, static_cast<size_t>(d));
+    }
+
+    // Counting sort by depth, slots of the same depth keep their order.
+    levels_.assign(count_ > 0 ? max_depth + 2 : 1, 0);
+    for(size_t s = 0; s < slots; ++s) {
+        if(ids_[s] != invalid_transform) {
+            ++levels_[depth[s] + 1];
+        }
+    }
+    for(size_t d = 1; d < levels_.size(); ++d) {
+        levels_[d] += levels_[d - 1];
+    }
+    std::vector<uint32_t> moved_to(slots, invalid_transform);
+    std::vector<uint32_t> next(levels_.begin(), levels_.end() - 1);
+    for(size_t s = 0; s < slots; ++s) {
+        if(ids_[s] != invalid_transform) {
+            moved_to[s] = next[depth[s]]++;
+        }
+    }
+
+    std::vector<soa_transform> locals((count_ + 3) / 4, identity_group());
+    std::vector<int32_t> parents(count_);
+    std::vector<transform_id> ids(count_);
+    std::vector<uint8_t> dirty(count_);
+    std::vector<uint32_t> updated(count_);
+    std::vector<glm::mat4> world(count_);
+    for(size_t s = 0; s < slots; ++s) {
+        const uint32_t to = moved_to[s];
+        if(to == invalid_transform) {
+            continue;
+        }
+        copy_lane(locals_[s / 4], s % 4, locals[to / 4], to % 4);
+        parents[to] = parents_[s] >= 0 ? static_cast<int32_t>(moved_to[parents_[s]]) : -1;
+        ids[to] = ids_[s];
+        dirty[to] = dirty_[s];
+        updated[to] = updated_[s];
+        world[to] = world_[s];
+        slots_[ids_[s]] = to;
+    }
+    locals_ = std::move(locals);
+    parents_ = std::move(parents);
+    ids_ = std::move(ids);
+    dirty_ = std::move(dirty);
+    updated_ = std::move(updated);
+    world_ = std::move(world);
+    structure_dirty_ = false;
+}
+
+void transform_hierarchy::update_slots(size_t begin, size_t end, size_t& lo, size_t& hi)
+{
+    glm::mat4 local[4];
+    for(size_t s = begin; s < end; ) {
+        const size_t group = s / 4;
+        const size_t group_end = std::min(end, group * 4 + 4);
+        // Recomputed if its own transform changed or its parent's world matrix did.
+        bool any = false;
+        for(size_t n = s; n < group_end; ++n) {
+            const int32_t parent = parents_[n];
+            if(parent >= 0 && updated_[parent] == epoch_) {
+                dirty_[n] = 1;
+            }
+            any |= dirty_[n] != 0;
+        }
+        if(any) {
+            compose_matrices(locals_[group], 4, local);
+            for(size_t n = s; n < group_end; ++n) {
+                if(dirty_[n] == 0) {
+                    continue;
+                }
+                const int32_t parent = parents_[n];
+                if(parent >= 0) {
+                    multiply_matrices(world_[parent], local[n % 4], world_[n]);
+                } else {
+                    world_[n] = local[n % 4];
+                }
+                dirty_[n] = 0;
+                updated_[n] = epoch_;
+                lo = std::min(lo, n);
+                hi = std::max(hi, n + 1);
+            }
+        }
+        s = group_end;
+    }
+}
+
+void transform_hierarchy::update(thread_pool* pool)
+{
+    TR_PROFILE_ZONE("update transforms");
+    if(structure_dirty_) {
+        rebuild();
+    }
+    ++epoch_;
+    first_changed_ = world_.size();
+    last_changed_ = 0;
+    // Each level only reads the one before, so the levels go in order and the
+    // slots within one are independent. Workers get whole groups of four, only
+    // the groups a level shares with its neighbours are split.
+    std::mutex changed_mutex;
+    for(size_t d = 0; d + 1 < levels_.size(); ++d) {
+        const size_t begin = levels_[d];
+        const size_t end = levels_[d + 1];
+        const size_t first_group = begin / 4;
+        const size_t groups = (end + 3) / 4 - first_group;
+        if(pool == nullptr || groups < parallel_groups) {
+            update_slots(begin, end, first_changed_, last_changed_);
+            continue;
+        }
+        pool->parallel_for(groups, [&](size_t g0, size_t g1) {
+            size_t lo = world_.size();
+            size_t hi = 0;
+            update_slots(std::max(begin, (first_group + g0) * 4), std::min(end, (first_group + g1) * 4), lo, hi);
+            std::lock_guard lock(changed_mutex);
+            first_changed_ = std::min(first_changed_, lo);
+            last_changed_ = std::max(last_changed_, hi);
+        }, min_chunk_groups);
+    }
+}
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace tr {
+
+class thread_pool;
+
+/// @brief Transforms of four items, one in each lane, so they are converted to matrices together.
+/// Rotations are quaternions as (x, y, z, w).
+struct soa_transform
+{
+    float tx_[4];
+    float ty_[4];
+    float tz_[4];
+    float rx_[4];
+    float ry_[4];
+    float rz_[4];
+    float rw_[4];
+    float sx_[4];
+    float sy_[4];
+    float sz_[4];
+};
+
+/// @brief Matrices of the first \c count lanes of \c t, rotation times scale with the translation last.
+void compose_matrices(const soa_transform& t, size_t count, glm::mat4* out);
+/// @brief \c a times \c b a column at a time, \c out may be either of them.
+void multiply_matrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+
+typedef uint32_t transform_id;
+constexpr transform_id invalid_transform = std::numeric_limits<transform_id>::max();
+
+// Local transforms, parents and world matrices of a tree of nodes, kept in
+// arrays sorted by depth so a node's parent is always in an earlier level.
+// update() walks the levels in order and recomputes only the nodes whose
+// local transform changed or whose parent was recomputed, four locals at a
+// time from the structure of arrays, and splits each level across the pool.
+// Adding, removing and moving nodes only marks the order stale, it is
+// re-sorted once at the next update(). Nodes are named by ids that stay the
+// same while their slot in the arrays moves.
+class transform_hierarchy
+{
+public:
+    transform_hierarchy() = default;
+    /// @brief Adds a node with an identity local transform.
+    /// @param parent invalid_transform for a root.
+    transform_id create(transform_id parent = invalid_transform);
+    /// @brief Removes a node and everything under it, their ids may be handed out again.
+    void destroy(transform_id id);
+    /// @return false if \c parent is \c id or under it, which would make a loop.
+    bool set_parent(transform_id id, transform_id parent);
+    void set_local(transform_id id, const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale);
+    void set_translation(transform_id id, const glm::vec3& translation);
+    void set_rotation(transform_id id, const glm::vec4& rotation);
+    void set_scale(transform_id id, const glm::vec3& scale);
+    /// @brief Brings the world matrices of every changed node and the nodes under them up to date.
+    /// @param pool Splits large levels across its workers, nullptr to update on the caller alone.
+    void update(thread_pool* pool = nullptr);
+
+    bool valid(transform_id id) const { return id < slots_.size() && slots_[id] != invalid_transform; }
+    size_t size() const { return count_; }
+    /// @brief Depths in the tree, the roots are level 0.
+    size_t levels() const { return levels_.empty() ? 0 : levels_.size() - 1; }
+    const glm::mat4& world(transform_id id) const { return world_[slots_[id]]; }
+    /// @brief Every node's world matrix as of the last update(), parents before children, for
+    /// culling or uploading as they are.
+    std::span<const glm::mat4> world() const { return world_; }
+    /// @brief Where a node's matrix is in world(), which changes when nodes are added, removed or moved.
+    uint32_t slot(transform_id id) const { return slots_[id]; }
+    /// @brief Whether the last update() recomputed the node's world matrix.
+    bool changed(transform_id id) const { return updated_[slots_[id]] == epoch_; }
+    /// @brief Slots [first, second) hold every matrix the last update() recomputed, empty if none,
+    /// so a buffer of world() is brought up to date with one upload.
+    std::pair<size_t, size_t> changed_range() const { return { first_changed_, std::max(first_changed_, last_changed_) }; }
+
+private:
+    /// @brief Re-sorts the nodes by depth, dropping removed ones.
+    void rebuild();
+    /// @brief Updates the slots [begin, end) of one level, widening \c lo and \c hi over those it recomputed.
+    void update_slots(size_t begin, size_t end, size_t& lo, size_t& hi);
+
+    /// @brief Each slot's local transform, slot s in lane s % 4 of group s / 4.
+    std::vector<soa_transform> locals_{ };
+    /// @brief Slot of each slot's parent, -1 for a root.
+    std::vector<int32_t> parents_{ };
+    /// @brief Id of the node in each slot, invalid_transform once removed.
+    std::vector<transform_id> ids_{ };
+    /// @brief Set when a slot's local transform changed since the last update().
+    std::vector<uint8_t> dirty_{ };
+    /// @brief The update() each slot was last recomputed by.
+    std::vector<uint32_t> updated_{ };
+    std::vector<glm::mat4> world_{ };
+    /// @brief Level d is the slots [levels_[d], levels_[d + 1]).
+    std::vector<uint32_t> levels_{ };
+    /// @brief Slot of each id, invalid_transform for ids not in use.
+    std::vector<uint32_t> slots_{ };
+    std::vector<transform_id> free_ids_{ };
+    size_t count_{ 0 };
+    bool structure_dirty_{ false };
+    uint32_t epoch_{ 0 };
+    size_t first_changed_{ 0 };
+    size_t last_changed_{ 0 };
+
+    transform_hierarchy(const transform_hierarchy&) = delete;
+    transform_hierarchy& operator=(const transform_hierarchy&) = delete;
+};
+
+}
@@ -0,0 +1,41 @@
+#include <glad/gl.h>
+
+#include "tr_uniform_buffer.h"
+
+namespace tr {
+
+uniform_buffer::uniform_buffer(memory_tag tag)
+    : storage_(tag)
+{
+    if(GLAD_GL_ARB_direct_state_access) {
+        glCreateBuffers(1, &buffer_);
+    } else {
+        glGenBuffers(1, &buffer_);
+    }
+}
+
+uniform_buffer::~uniform_buffer()
+{
+    glDeleteBuffers(1, &buffer_);
+}
+
+void uniform_buffer::write(const void* data, size_t length)
+{
+    if(GLAD_GL_ARB_direct_state_access) {
+        glNamedBufferData(buffer_, length, data, GL_STREAM_DRAW);
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, length, data, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    storage_.set(length);
+}
+
+size_t uniform_buffer::offset_alignment()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment > 0 ? static_cast<size_t>(alignment) : 256;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+#include "tr_memory.h"
+
+namespace tr {
+
+// A GL uniform buffer rewritten whole each frame, with a range of it bound for
+// each draw, such as one bone palette per character. Writing replaces the
+// storage rather than updating it, so the driver can hand out fresh memory
+// while draws of the previous frame still read the old contents.
+class uniform_buffer
+{
+public:
+    explicit uniform_buffer(memory_tag tag = memory_tag::other);
+    ~uniform_buffer();
+    /// @brief Replaces the contents, on the thread owning the GL context.
+    void write(const void* data, size_t length);
+    unsigned id() const { return buffer_; }
+    size_t size_bytes() const { return storage_.bytes(); }
+    /// @brief Ranges bound must start at a multiple of this, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+    static size_t offset_alignment();
+private:
+    unsigned buffer_{ 0 };
+    gpu_allocation storage_;
+
+    uniform_buffer(const uniform_buffer&) = delete;
+    uniform_buffer(uniform_buffer&&) = delete;
+    uniform_buffer& operator=(const uniform_buffer&) = delete;
+    uniform_buffer& operator=(uniform_buffer&&) = delete;
+};
+
+}
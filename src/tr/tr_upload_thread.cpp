@@ -0,0 +1,179 @@
+#include <spdlog/spdlog.h>
+#include <glad/gl.h>
+
+#include "tr_upload_thread.h"
+#include "tr_profiler.h"
+
+namespace tr {
+
+upload_thread::upload_thread(tr_window& wnd)
+{
+    shared_ = wnd.create_shared_context();
+    if(shared_.context_ == nullptr) {
+        spdlog::warn("No shared GL context, uploads will run on the render thread.");
+        return;
+    }
+    thread_ = std::thread(&upload_thread::run, this);
+}
+
+upload_thread::~upload_thread()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    ready_cv_.notify_one();
+    if(thread_.joinable()) {
+        thread_.join();
+    }
+    tr_window::destroy_shared_context(shared_);
+
+    // The objects belong to whoever queued the writes, only the fences are ours.
+    for(auto& r : queued_) {
+        glDeleteSync(static_cast<GLsync>(r.created_));
+    }
+    for(auto& r : uploaded_) {
+        glDeleteSync(static_cast<GLsync>(r.fence_));
+    }
+}
+
+void upload_thread::write_buffer(unsigned buffer, const void* data, size_t length, ready_fn on_ready)
+{
+    request r;
+    r.kind_ = upload_kind::buffer;
+    r.name_ = buffer;
+    r.data_ = data;
+    r.length_ = length;
+    r.on_ready_ = std::move(on_ready);
+    queue(std::move(r));
+}
+
+void upload_thread::write_texture(unsigned texture, size_t width, size_t height, const void* pixels, bool mipmaps, ready_fn on_ready)
+{
+    request r;
+    r.kind_ = upload_kind::texture;
+    r.name_ = texture;
+    r.data_ = pixels;
+    r.length_ = width * height * 4;
+    r.width_ = width;
+    r.height_ = height;
+    r.mipmaps_ = mipmaps;
+    r.on_ready_ = std::move(on_ready);
+    queue(std::move(r));
+}
+
+void upload_thread::queue(request&& r)
+{
+    if(threaded()) {
+        // The object was created by the context current here, the upload context waits for that before writing.
+        r.created_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+    }
+    {
+        std::lock_guard lock(mutex_);
+        queued_.emplace_back(std::move(r));
+    }
+    ready_cv_.notify_one();
+}
+
+size_t upload_thread::pending() const
+{
+    std::lock_guard lock(mutex_);
+    return queued_.size() + uploaded_.size();
+}
+
+void upload_thread::run()
+{
+    profiler::set_thread_name("upload");
+    // The shared context has a window of its own, the main window's is current on the thread rendering.
+    if(!SDL_GL_MakeCurrent(shared_.surface_, shared_.context_)) {
+        spdlog::error("Unable to make the upload context current, uploads will run on the render thread: {}", SDL_GetError());
+        inline_.store(true, std::memory_order_release);
+        return;
+    }
+
+    std::unique_lock lock(mutex_);
+    while(true) {
+        ready_cv_.wait(lock, [this] { return stop_ || !queued_.empty(); });
+        if(stop_) {
+            break;
+        }
+        request r = std::move(queued_.front());
+        queued_.pop_front();
+
+        lock.unlock();
+        upload(r);
+        lock.lock();
+
+        uploaded_.emplace_back(std::move(r));
+    }
+    lock.unlock();
+
+    SDL_GL_MakeCurrent(shared_.surface_, nullptr);
+}
+
+void upload_thread::upload(request& r)
+{
+    TR_PROFILE_ZONE("upload");
+    if(r.created_ != nullptr) {
+        glWaitSync(static_cast<GLsync>(r.created_), 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(static_cast<GLsync>(r.created_));
+        r.created_ = nullptr;
+    }
+    if(r.kind_ == upload_kind::buffer) {
+        // Any target will do to write the storage, the buffer is bound to another where it is drawn.
+        glBindBuffer(GL_COPY_WRITE_BUFFER, r.name_);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, r.length_, r.data_);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    } else {
+        GLint alignment = 4;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, r.name_);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, static_cast<GLsizei>(r.width_), static_cast<GLsizei>(r.height_), GL_RGBA, GL_UNSIGNED_BYTE, r.data_);
+        if(r.mipmaps_) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+    r.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Without a flush the fence may never reach the GPU, and other contexts would wait on it forever.
+    glFlush();
+
+    bytes_uploaded_.fetch_add(r.length_, std::memory_order_relaxed);
+    r.data_ = nullptr;
+}
+
+size_t upload_thread::publish()
+{
+    TR_PROFILE_ZONE("publish uploads");
+    std::unique_lock lock(mutex_);
+    if(!threaded()) {
+        while(!queued_.empty()) {
+            uploaded_.emplace_back(std::move(queued_.front()));
+            queued_.pop_front();
+            upload(uploaded_.back());
+        }
+    }
+
+    size_t published = 0;
+    while(!uploaded_.empty()) {
+        // Fences from one context signal in order, so the first unsignalled one ends the search.
+        const GLenum status = glClientWaitSync(static_cast<GLsync>(uploaded_.front().fence_), 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        request r = std::move(uploaded_.front());
+        uploaded_.pop_front();
+        glDeleteSync(static_cast<GLsync>(r.fence_));
+
+        lock.unlock();
+        r.on_ready_();
+        lock.lock();
+        ++published;
+    }
+    return published;
+}
+
+}
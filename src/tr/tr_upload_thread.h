@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "tr_window.h"
+
+namespace tr {
+
+// Fills buffers and textures on a thread with its own GL context, shared
+// with the window's, so large uploads don't stall the frame. The objects are
+// created, and their storage allocated, on the thread rendering, as vertex
+// arrays and frame buffers that refer to them aren't shared between contexts,
+// only their contents are written here. Each write is followed by a fence,
+// publish() is called by the thread rendering and calls back for the writes
+// whose fence has signalled, so the renderer never draws from an object the
+// driver is still filling.
+//
+// If a shared context can't be created, or made current on the thread, the
+// writes run inside publish() instead, so callers don't need a fallback of
+// their own.
+class upload_thread
+{
+public:
+    typedef std::function<void()> ready_fn;
+
+    /// @brief Creates the shared context, on the thread where the window's context is current.
+    explicit upload_thread(tr_window& wnd);
+    ~upload_thread();
+
+    /// @brief Queues \c length bytes for the start of a buffer whose storage is allocated.
+    /// @note \c data must stay valid until \c on_ready is called from \c publish().
+    void write_buffer(unsigned buffer, const void* data, size_t length, ready_fn on_ready);
+    /// @brief Queues tightly packed RGBA8 pixels for the whole first level of a 2D texture with
+    /// storage allocated, then fills the levels below from it if \c mipmaps is set.
+    /// @note \c pixels must stay valid until \c on_ready is called from \c publish().
+    void write_texture(unsigned texture, size_t width, size_t height, const void* pixels, bool mipmaps, ready_fn on_ready);
+    /// @brief Calls back for finished writes, on the thread rendering.
+    /// @return The number of writes published.
+    size_t publish();
+
+    /// @brief If writes run on their own thread rather than in \c publish().
+    bool threaded() const { return thread_.joinable() && !inline_.load(std::memory_order_acquire); }
+    /// @brief Writes queued or waiting on their fence.
+    size_t pending() const;
+    /// @brief Bytes uploaded since startup.
+    uint64_t bytes_uploaded() const { return bytes_uploaded_.load(std::memory_order_relaxed); }
+private:
+    enum class upload_kind : uint8_t
+    {
+        buffer,
+        texture,
+    };
+
+    struct request
+    {
+        upload_kind kind_{ upload_kind::buffer };
+        unsigned name_{ 0 };
+        const void* data_{ nullptr };
+        size_t length_{ 0 };
+        size_t width_{ 0 };
+        size_t height_{ 0 };
+        bool mipmaps_{ false };
+        ready_fn on_ready_{ };
+        /// @brief Signalled once the object created on the thread rendering can be seen here.
+        void* created_{ nullptr };
+        /// @brief Set once written.
+        void* fence_{ nullptr };
+    };
+
+    void run();
+    /// @brief Writes the object's contents, then fences them.
+    void upload(request& r);
+    void queue(request&& r);
+
+    shared_context shared_{ };
+    std::atomic<uint64_t> bytes_uploaded_{ 0 };
+    /// @brief Set when the thread couldn't make its context current and left the writes to \c publish().
+    std::atomic<bool> inline_{ false };
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::deque<request> queued_{ };
+    /// @brief Written, in write order, waiting for their fence.
+    std::deque<request> uploaded_{ };
+    bool stop_{ false };
+    std::thread thread_;
+
+    upload_thread(const upload_thread&) = delete;
+    upload_thread(upload_thread&&) = delete;
+    upload_thread& operator=(const upload_thread&) = delete;
+    upload_thread& operator=(upload_thread&&) = delete;
+};
+
+}
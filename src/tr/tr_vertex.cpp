@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <glad/gl.h>
 #include <spdlog/spdlog.h>
 #include <ranges>
 
 #include "tr_vertex.h"
+#include "tr_profiler.h"
+#include "tr_memory.h"
 
 namespace tr {
 
@@ -49,22 +52,32 @@ GLenum primitive_to_gl(primitive p)
 struct vertex_object_impl
 {
     virtual bool build(bool indexed, size_t index_size_bytes, const std::vector<vertex_specifier>& fmts) { return false; }
-    virtual void draw(bool indexed, size_t instance_count) {}
+    /// @brief Draws \c count indices from \c first, \c all_indices for every index uploaded.
+    virtual void draw(bool indexed, size_t instance_count, size_t first, size_t count) {}
+    virtual void draw_ranges(bool indexed, std::span<const index_range> ranges) {}
     virtual void update(vertex_object::update_type type, size_t index, const void* buffer, size_t length) {}
+    virtual void upload(vertex_object::update_type type, size_t index, const void* buffer, size_t length) { update(type, index, buffer, length); }
+    virtual bool allocate(vertex_object::update_type type, size_t index, size_t length) { return false; }
+    virtual unsigned buffer_id(vertex_object::update_type type, size_t index) const { return 0; }
 };
 
 
 struct gl_vertex_object_impl : public vertex_object_impl
 {
-    std::vector<std::vector<uint8_t>> vertex_buffers_{ };
+    std::vector<tracked_vector<uint8_t>> vertex_buffers_{ };
     std::vector<size_t> cumulative_length_{ };
-    std::vector<uint8_t> index_buffer_{ };
+    tracked_vector<uint8_t> index_buffer_{ tracked_allocator<uint8_t>(memory_tag::vertex) };
 
     unsigned vao_{ 0 };
     std::vector<unsigned> vbo_{ };
     unsigned ibo_{ 0 };
+    /// @brief Storage allocated for each vertex buffer.
+    std::vector<gpu_allocation> vbo_memory_{ };
+    /// @brief Storage allocated for the index buffer.
+    gpu_allocation ibo_memory_{ memory_tag::vertex };
     GLenum primitive_{ GL_TRIANGLES };
     GLenum index_format_{ GL_UNSIGNED_INT };
+    size_t index_size_{ sizeof(uint32_t) };
     size_t indicies_{ 0 };
     size_t vertex_count_{ 0 };
 
@@ -75,6 +88,11 @@ struct gl_vertex_object_impl : public vertex_object_impl
     bool index_dirty_{ true };
     /// @brief If the vertex buffers have been modified since the last draw call.
     std::vector<bool> vertex_dirty_{ };
+    /// @brief Vertex buffers written straight to the GPU, which have no copy here.
+    std::vector<bool> vertex_uploaded_{ };
+    /// @brief Counts and offsets passed to glMultiDrawElements(), kept to save allocating each draw.
+    std::vector<GLsizei> range_counts_{ };
+    std::vector<const void*> range_offsets_{ };
 
     gl_vertex_object_impl()
     {
@@ -90,6 +108,35 @@ struct gl_vertex_object_impl : public vertex_object_impl
         glDeleteVertexArrays(1, &vao_);
     }
 
+    /// @brief Grows a buffer's storage to at least \c length bytes, the contents are lost if it grows.
+    /// @return If the storage was reallocated.
+    bool reserve_buffer(GLenum target, unsigned buffer, gpu_allocation& storage, size_t length)
+    {
+        if(length <= storage.bytes()) {
+            return false;
+        }
+        if(GLAD_GL_ARB_direct_state_access) {
+            glNamedBufferData(buffer, length, nullptr, GL_DYNAMIC_DRAW);
+        } else {
+            glBindBuffer(target, buffer);
+            glBufferData(target, length, nullptr, GL_DYNAMIC_DRAW);
+        }
+        storage.set(length);
+        return true;
+    }
+
+    /// @brief Writes to a buffer, growing its storage first if it's too small.
+    void write_buffer(GLenum target, unsigned buffer, gpu_allocation& storage, size_t offset, const void* data, size_t length)
+    {
+        reserve_buffer(target, buffer, storage, offset + length);
+        if(GLAD_GL_ARB_direct_state_access) {
+            glNamedBufferSubData(buffer, offset, length, data);
+        } else {
+            glBindBuffer(target, buffer);
+            glBufferSubData(target, offset, length, data);
+        }
+    }
+
     // Abstract write structured data to the vertex buffer.
     void update(vertex_object::update_type type, size_t index, const void* buffer, size_t length) override
     {
@@ -107,18 +154,116 @@ struct gl_vertex_object_impl : public vertex_object_impl
         }
     }
 
-    void draw(bool indexed, size_t instance_count) override
+    // Writes straight to the GPU buffer without keeping a copy, for data that is loaded once.
+    void upload(vertex_object::update_type type, size_t index, const void* buffer, size_t length) override
+    {
+        if(type == vertex_object::update_type::vertex) {
+            // Without separate buffers the vertex data is laid out in one buffer on the first draw.
+            if(!GLAD_GL_ARB_vertex_attrib_binding) {
+                update(type, index, buffer, length);
+                return;
+            }
+            write_buffer(GL_ARRAY_BUFFER, vbo_[index], vbo_memory_[index], 0, buffer, length);
+            vertex_buffers_[index].clear();
+            vertex_dirty_[index] = false;
+            vertex_uploaded_[index] = true;
+        } else {
+            write_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo_, ibo_memory_, 0, buffer, length);
+            index_buffer_.clear();
+            index_dirty_ = false;
+            indicies_ = index;
+        }
+    }
+
+    // Allocates storage for data another context writes, the buffer then counts as uploaded.
+    bool allocate(vertex_object::update_type type, size_t index, size_t length) override
+    {
+        if(type == vertex_object::update_type::vertex) {
+            // Without separate buffers the vertex data is laid out in one buffer on the first draw.
+            if(!GLAD_GL_ARB_vertex_attrib_binding) {
+                return false;
+            }
+            reserve_buffer(GL_ARRAY_BUFFER, vbo_[index], vbo_memory_[index], length);
+            vertex_buffers_[index].clear();
+            vertex_dirty_[index] = false;
+            vertex_uploaded_[index] = true;
+        } else {
+            reserve_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo_, ibo_memory_, length);
+            index_buffer_.clear();
+            index_dirty_ = false;
+            indicies_ = index;
+        }
+        return true;
+    }
+
+    unsigned buffer_id(vertex_object::update_type type, size_t index) const override
+    {
+        return type == vertex_object::update_type::vertex ? vbo_[index] : ibo_;
+    }
+
+    void draw(bool indexed, size_t instance_count, size_t first, size_t count) override
+    {
+        prepare(indexed);
+
+        // Draw call, n.b. all draw calls use indexing.
+        const size_t total = indexed ? indicies_ : vertex_count_;
+        first = std::min(first, total);
+        count = std::min(count, total - first);
+        const void* offset = reinterpret_cast<const void*>(first * index_size_);
+        if(instance_count > 0) {
+            if(indexed) {
+                glDrawElementsInstanced(primitive_, count, index_format_, offset, instance_count);
+            } else {
+                glDrawArraysInstanced(primitive_, first, count, instance_count);
+            }
+        } else {
+            if(indexed) {
+                glDrawElements(primitive_, count, index_format_, offset);
+            } else {
+                glDrawArrays(primitive_, first, count);
+            }
+        }
+    }
+
+    void draw_ranges(bool indexed, std::span<const index_range> ranges) override
+    {
+        prepare(indexed);
+        const size_t total = indexed ? indicies_ : vertex_count_;
+        range_counts_.clear();
+        range_offsets_.clear();
+        for(const auto& r : ranges) {
+            const size_t first = std::min<size_t>(r.first_, total);
+            const size_t count = std::min<size_t>(r.count_, total - first);
+            if(count == 0) {
+                continue;
+            }
+            if(!indexed) {
+                glDrawArrays(primitive_, first, count);
+                continue;
+            }
+            range_counts_.push_back(static_cast<GLsizei>(count));
+            range_offsets_.push_back(reinterpret_cast<const void*>(first * index_size_));
+        }
+        if(!range_counts_.empty()) {
+            glMultiDrawElements(primitive_, range_counts_.data(), index_format_, range_offsets_.data(), static_cast<GLsizei>(range_counts_.size()));
+        }
+    }
+
+    /// @brief Brings the GL buffers up to date with any changes and binds the vertex array.
+    void prepare(bool indexed)
     {
         // We need to validate that the vertex buffers have been built before we can draw.
         if(!buffers_populated_) {
             buffers_populated_ = true;
+            size_t total_length = 0;
             for(size_t n = 0; n < vertex_buffers_.size(); ++n) {
-                if(vertex_buffers_[n].empty()) {
+                if(vertex_buffers_[n].empty() && !vertex_uploaded_[n]) {
                     spdlog::critical("Vertex buffer {} is empty, cannot draw.", n);
                     std::exit(1);
                 }
-                if(vertex_dirty_[n]) {
-                    cumulative_length_.emplace_back(vertex_buffers_[n].size());
+                if(vertex_dirty_[n] || vertex_uploaded_[n]) {
+                    cumulative_length_.emplace_back(total_length);
+                    total_length += vertex_buffers_[n].size();
                 } else {
                     buffers_populated_ = false;
                 }
@@ -130,51 +275,36 @@ struct gl_vertex_object_impl : public vertex_object_impl
             std::exit(1);
         }
 
+        // The element buffer binding is part of the vertex array state.
+        glBindVertexArray(vao_);
+
         // Update the opengl vertex if buffers have been modified.
         // Either glBufferSubData() or glNamedBufferSubData()
-        for(size_t n= 0; n < vertex_buffers_.size(); ++n) {
-            if(vertex_dirty_[n]) {
-                // If we have GL_ARB_direct_state_access then we can use glNamedBufferSubData() to update the buffer.
-                if(GLAD_GL_ARB_direct_state_access) {
-                    if(GLAD_GL_ARB_vertex_attrib_binding) {
-                        glNamedBufferSubData(vbo_[n], 0, vertex_buffers_[n].size(), vertex_buffers_[n].data());
-                    } else {
-                        glNamedBufferSubData(vbo_[0], cumulative_length_[n], vertex_buffers_[n].size(), vertex_buffers_[n].data());
-                    }
-                } else {
-                    if(GLAD_GL_ARB_vertex_attrib_binding) {
-                        glBindBuffer(GL_ARRAY_BUFFER, vbo_[n]);
-                        glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_buffers_[n].size(), vertex_buffers_[n].data());
-                    } else {
-                        glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
-                        glBufferSubData(GL_ARRAY_BUFFER, cumulative_length_[n], vertex_buffers_[n].size(), vertex_buffers_[n].data());
-                    }
+        if(GLAD_GL_ARB_vertex_attrib_binding) {
+            for(size_t n = 0; n < vertex_buffers_.size(); ++n) {
+                if(vertex_dirty_[n]) {
+                    write_buffer(GL_ARRAY_BUFFER, vbo_[n], vbo_memory_[n], 0, vertex_buffers_[n].data(), vertex_buffers_[n].size());
+                    vertex_dirty_[n] = false;
+                }
+            }
+        } else {
+            // All vertex data shares one buffer, growing it loses what was there so everything is rewritten.
+            const size_t total_length = cumulative_length_.empty() ? 0 : cumulative_length_.back() + vertex_buffers_.back().size();
+            if(reserve_buffer(GL_ARRAY_BUFFER, vbo_[0], vbo_memory_[0], total_length)) {
+                std::fill(vertex_dirty_.begin(), vertex_dirty_.end(), true);
+            }
+            for(size_t n = 0; n < vertex_buffers_.size(); ++n) {
+                if(vertex_dirty_[n]) {
+                    write_buffer(GL_ARRAY_BUFFER, vbo_[0], vbo_memory_[0], cumulative_length_[n], vertex_buffers_[n].data(), vertex_buffers_[n].size());
+                    vertex_dirty_[n] = false;
                 }
-                vertex_dirty_[n] = false;
             }
         }
 
         // Update the index buffer if it has been modified.
         if(indexed && index_dirty_) {
-            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_buffer_.size(), index_buffer_.data());
+            write_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo_, ibo_memory_, 0, index_buffer_.data(), index_buffer_.size());
             index_dirty_ = false;
-        }        
-
-        // Draw call, n.b. all draw calls use indexing.
-        if(instance_count > 0) {
-            glBindVertexArray(vao_);
-            if(indexed) {
-                glDrawElementsInstanced(primitive_, indicies_, index_format_, nullptr, instance_count);
-            } else {
-                glDrawArraysInstanced(primitive_, 0, vertex_count_, instance_count);
-            }
-        } else {
-            glBindVertexArray(vao_); 
-            if(indexed) {
-                glDrawElements(primitive_, indicies_, index_format_, nullptr);
-            } else {
-                glDrawArrays(primitive_, 0, vertex_count_);
-            }
         }
     }
 
@@ -185,51 +315,47 @@ struct gl_vertex_object_impl : public vertex_object_impl
 
         // Generate buffers based on the number of format lists passed in.
         // should be one singular vertex buffer if no GLAD_GL_ARB_vertex_attrib_binding
-        if(GLAD_GL_ARB_vertex_attrib_binding) {
-            vertex_buffers_.resize(fmts.size());
-            vertex_dirty_.resize(fmts.size());
-            vbo_.resize(fmts.size());
-            glGenBuffers(fmts.size(), vbo_.data());
+        const size_t buffer_count = GLAD_GL_ARB_vertex_attrib_binding ? fmts.size() : 1;
+        vertex_buffers_.resize(buffer_count, tracked_vector<uint8_t>(tracked_allocator<uint8_t>(memory_tag::vertex)));
+        vertex_dirty_.resize(buffer_count);
+        vertex_uploaded_.resize(buffer_count);
+        vbo_.resize(buffer_count);
+        for(size_t n = vbo_memory_.size(); n < buffer_count; ++n) {
+            vbo_memory_.emplace_back(memory_tag::vertex);
+        }
+        // Direct state access needs the objects to exist, which glGen*() only does on first bind.
+        if(GLAD_GL_ARB_direct_state_access) {
+            glCreateBuffers(buffer_count, vbo_.data());
         } else {
-            vertex_buffers_.resize(1);
-            vertex_dirty_.resize(1);
-            vbo_.resize(1);
-            glGenBuffers(1, vbo_.data());
+            glGenBuffers(buffer_count, vbo_.data());
         }
 
         // Create a Vertex Array
-        glGenVertexArrays(1, &vao_);
-        if(!GLAD_GL_ARB_direct_state_access) {
+        if(GLAD_GL_ARB_direct_state_access) {
+            glCreateVertexArrays(1, &vao_);
+        } else {
+            glGenVertexArrays(1, &vao_);
             glBindVertexArray(vao_);
         }
    
-        // if we had GL_ARB_buffer_storage and we knew the size of the index buffer in advance we can
-        // create the buffer and optionally assign data to it.
-        // Would require passing in the data size from the interface api though, which is doable.
-        // N.B. if we needed to change the buffer size then we would need to destroy the buffer index and re-create it.
+        // The index buffer's storage is allocated on the first upload, once its size is known.
+        // N.B. if we used GL_ARB_buffer_storage the storage would be immutable and the buffer
+        // would need re-creating whenever it grows.
         if(indexed) {
-            if(GLAD_GL_ARB_buffer_storage) {
+            if(GLAD_GL_ARB_direct_state_access) {
                 glCreateBuffers(1, &ibo_);
-                if(index_size_bytes > 0) {
-                    if(GLAD_GL_ARB_direct_state_access) {
-                        glNamedBufferStorage(ibo_, index_size_bytes, NULL, GL_DYNAMIC_STORAGE_BIT);
-                    } else {
-                        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, index_size_bytes, NULL, GL_DYNAMIC_STORAGE_BIT);
-                    }
-                }
+                glVertexArrayElementBuffer(vao_, ibo_);
             } else {
                 glGenBuffers(1, &ibo_);
-                if(GLAD_GL_ARB_direct_state_access) {
-                    glVertexArrayElementBuffer(vao_, ibo_);
-                } else {
-                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
-                }
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
             }
 
-            // Resize the underlying index buffer if we know the size
-            if(index_size_bytes > 0) {
-                index_buffer_.resize(index_size_bytes);
+            switch(index_size_bytes) {
+                case 1: index_format_ = GL_UNSIGNED_BYTE; break;
+                case 2: index_format_ = GL_UNSIGNED_SHORT; break;
+                default: index_format_ = GL_UNSIGNED_INT; break;
             }
+            index_size_ = index_size_bytes;
         }
 
         for (auto [fmt, buff, vbuffer] : std::views::zip(fmts, vbo_, vertex_buffers_)) {
@@ -247,7 +373,8 @@ struct gl_vertex_object_impl : public vertex_object_impl
                     GLenum atype = data_format_to_gl(attrib.type_);
                     glEnableVertexArrayAttrib(vao_, attrib.attrib_);
                     if(attrib.conversion_ == vertex_format_conversion::integer) {
-                        glVertexAttribIFormat(attrib.attrib_, 
+                        glVertexArrayAttribIFormat(vao_,
+                        attrib.attrib_, 
                         attrib.count_, 
                         atype, 
                         attrib.offset_);
@@ -373,7 +500,20 @@ void vertex_object::add(size_t stride, const vertex_format_list_t& fmts, size_t
 
 void vertex_object::draw(size_t instance_count) const
 {
-    pimpl_->draw(indexed_, instance_count);
+    TR_PROFILE_ZONE("vertex_object::draw");
+    pimpl_->draw(indexed_, instance_count, 0, all_indices);
+}
+
+void vertex_object::draw_range(size_t first, size_t count, size_t instance_count) const
+{
+    TR_PROFILE_ZONE("vertex_object::draw");
+    pimpl_->draw(indexed_, instance_count, first, count);
+}
+
+void vertex_object::draw_ranges(std::span<const index_range> ranges) const
+{
+    TR_PROFILE_ZONE("vertex_object::draw");
+    pimpl_->draw_ranges(indexed_, ranges);
 }
 
 bool vertex_object::build(bool indexed, data_format dfmt, size_t index_size)
@@ -425,6 +565,29 @@ void vertex_object::update(update_type type, size_t index, const void *buffer, s
     pimpl_->update(type, index, buffer, length);
 }
 
+void vertex_object::upload(update_type type, size_t index, const void *buffer, size_t length)
+{
+    if(type == update_type::vertex && index >= fmts_.size()) {
+        spdlog::critical("Index {} exceeds maximum vertex index {}", index, fmts_.size());
+        std::exit(1);
+    }
+    pimpl_->upload(type, index, buffer, length);
+}
+
+bool vertex_object::allocate(update_type type, size_t index, size_t length)
+{
+    if(type == update_type::vertex && index >= fmts_.size()) {
+        spdlog::critical("Index {} exceeds maximum vertex index {}", index, fmts_.size());
+        std::exit(1);
+    }
+    return pimpl_->allocate(type, index, length);
+}
+
+unsigned vertex_object::buffer_id(update_type type, size_t index) const
+{
+    return pimpl_->buffer_id(type, index);
+}
+
 
 vertex_format::vertex_format(int attrib, int count, data_format type, int offset)
     : attrib_(attrib)
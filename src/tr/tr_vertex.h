@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <string_view>
 #include <vector>
 #include <utility>
@@ -56,6 +59,13 @@ struct vertex_specifier
     vertex_format_list_t vformats_{ };
 };
 
+/// @brief A run of indices, or of vertices when not indexed.
+struct index_range
+{
+    uint32_t first_{ 0 };
+    uint32_t count_{ 0 };
+};
+
 struct vertex_object_impl;
 
 class vertex_object
@@ -68,11 +78,18 @@ public:
         /// @brief Update the index data.
         index,
     };
+    /// @brief A \c draw_range() count covering every index, or vertex, uploaded.
+    static constexpr size_t all_indices = SIZE_MAX;
+
     static vertex_object create(std::string_view pipeline);
     
     virtual ~vertex_object();
     void bind() const;
     void draw(size_t instance_count = 0) const;
+    /// @brief Draws \c count indices starting at \c first, clamped to those uploaded.
+    void draw_range(size_t first, size_t count, size_t instance_count = 0) const;
+    /// @brief Draws several ranges in one call, such as the clusters of a mesh that survived culling.
+    void draw_ranges(std::span<const index_range> ranges) const;
 
     void add(size_t stride, const vertex_format_list_t& fmts, size_t elements_ = 0);
     bool build(bool indexed, tr::data_format dfmt = tr::data_format::UINT32, size_t index_size = 0);
@@ -89,6 +106,16 @@ public:
     }
 
     void update(update_type type, size_t index, const void *buffer, size_t length);
+    /// @brief Writes straight to the GPU buffer, with no copy kept, for data that is loaded once and not changed.
+    /// @note Must be called on the thread owning the GL context, after \c build().
+    void upload(update_type type, size_t index, const void *buffer, size_t length);
+    /// @brief Allocates a buffer's storage for data written through \c buffer_id() from elsewhere, such as
+    /// the upload thread, with no copy kept. \c index is the number of indices for the index buffer.
+    /// @note Must be called on the thread owning the GL context, after \c build().
+    /// @return false if the buffer can't be written on its own, \c update() it instead.
+    bool allocate(update_type type, size_t index, size_t length);
+    /// @brief The GL name of a vertex buffer, or of the index buffer.
+    unsigned buffer_id(update_type type, size_t index = 0) const;
 
     // moveable
     vertex_object(vertex_object && rhs) noexcept;   
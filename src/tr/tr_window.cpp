@@ -2,6 +2,9 @@
 #include <glad/gl.h>
 
 #include "tr_window.h"
+#include "tr_profiler.h"
+#include "tr_image.h"
+#include "tr_texture_file.h"
 
 namespace {
 
@@ -71,7 +74,7 @@ namespace tr {
         SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
         
         SDL_WindowFlags window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIDDEN | SDL_WINDOW_HIGH_PIXEL_DENSITY; 
-        if(fullscreen_) {
+        if(fullscreen_ && !headless_) {
             window_flags |= SDL_WINDOW_FULLSCREEN;
         }
 
@@ -88,7 +91,13 @@ namespace tr {
                     spdlog::info("OpenGL renderer: {}", (const char*) glGetString(GL_RENDERER));
                     spdlog::info("OpenGL GLSL version: {}", (const char*) glGetString(GL_SHADING_LANGUAGE_VERSION));
                     
-                    SDL_GL_SetSwapInterval(1); // Enable vsync
+                    if(headless_) {
+                        // Nothing is presented, rendering goes to frame buffers only.
+                        set_swap_interval(0);
+                        return true;
+                    }
+
+                    set_swap_interval(swap_interval_);
                     SDL_SetWindowPosition(window_, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
                     SDL_ShowWindow(window_);
                     return true;
@@ -121,7 +130,15 @@ namespace tr {
 
     bool tr_window::init()
     {
-        if(!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD)) {
+        SDL_InitFlags init_flags = SDL_INIT_VIDEO | SDL_INIT_GAMEPAD;
+        if(headless_) {
+            // The offscreen driver creates its GL context through EGL, which works on
+            // machines without a display or GPU (e.g. Mesa llvmpipe). SDL_VIDEO_DRIVER
+            // set in the environment still takes precedence.
+            SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+            init_flags = SDL_INIT_VIDEO;
+        }
+        if(!SDL_Init(init_flags)) {
             spdlog::critical("SDL could not initialize! SDL error: {}\n", SDL_GetError());
             return false;
         }
@@ -138,17 +155,75 @@ namespace tr {
         }
     }
 
+    bool tr_window::set_swap_interval(int interval)
+    {
+        if(context_ != nullptr && !SDL_GL_SetSwapInterval(interval)) {
+            spdlog::warn("Unable to set swap interval {}: {}", interval, SDL_GetError());
+            return false;
+        }
+        swap_interval_ = interval;
+        return true;
+    }
+
+    shared_context tr_window::create_shared_context()
+    {
+        shared_context shared;
+        // Created with the same attributes as the window, so the context can be made current on it.
+        shared.surface_ = SDL_CreateWindow("shared context", 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if(shared.surface_ == nullptr) {
+            spdlog::warn("Unable to create a window for a shared GL context: {}", SDL_GetError());
+            return shared;
+        }
+
+        // Sharing is with whichever context is current when the new one is created.
+        SDL_GL_MakeCurrent(window_, context_);
+        SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+        shared.context_ = SDL_GL_CreateContext(shared.surface_);
+        SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+        if(shared.context_ == nullptr) {
+            spdlog::warn("Unable to create a shared GL context: {}", SDL_GetError());
+            destroy_shared_context(shared);
+        }
+        // Creating a context makes it current.
+        SDL_GL_MakeCurrent(window_, context_);
+        return shared;
+    }
+
+    void tr_window::destroy_shared_context(shared_context& shared)
+    {
+        if(shared.context_ != nullptr) {
+            SDL_GL_DestroyContext(shared.context_);
+            shared.context_ = nullptr;
+        }
+        if(shared.surface_ != nullptr) {
+            SDL_DestroyWindow(shared.surface_);
+            shared.surface_ = nullptr;
+        }
+    }
+
     void tr_window::swap()
     {
+        TR_PROFILE_ZONE("swap");
         SDL_GL_SwapWindow(window_);
     }
 
-    std::unique_ptr<tr_texture> tr_window::create_texture_from_file(std::string_view filename)
+    std::unique_ptr<gl_texture> tr_window::create_texture_from_file(std::string_view filename)
     {
-        //auto tex = std::make_unique<tr_texture>();
-        // if(tex->load_from_file(renderer_, filename)) {
-        //     return tex;
-        // }
-        return nullptr;
+        // Baked textures carry their own mip chain and go straight to the driver.
+        if(filename.ends_with(".trtex")) {
+            return load_texture_file(filename);
+        }
+        image img;
+        if(!load_image(filename, img)) {
+            return nullptr;
+        }
+        texture_desc desc;
+        desc.width_ = img.width_;
+        desc.height_ = img.height_;
+        desc.levels_ = 0;
+        auto tex = std::make_unique<gl_texture>(desc);
+        tex->upload(0, 0, 0, 0, img.width_, img.height_, img.pixels_.data());
+        tex->generate_mipmaps();
+        return tex;
     }
 }
@@ -6,10 +6,17 @@
 #include <string_view>
 #include <SDL3/SDL.h>
 
-#include "tr_texture.h"
+#include "tr_gl_texture.h"
 
 namespace tr {
 
+/// @brief A context sharing objects with a window's, with a hidden window of its own to be current on.
+struct shared_context
+{
+    SDL_Window* surface_{ nullptr };
+    SDL_GLContext context_{ nullptr };
+};
+
 class tr_window
 {
 public:
@@ -24,13 +31,31 @@ public:
     void destroy();
     void set_dimensions(size_t screen_width, size_t screen_height) { screen_width_ = screen_width; screen_height_ = screen_height; }
     void set_caption(std::string_view caption) { caption_ = caption; }
+    /// @brief Create an offscreen context with no visible window, must be set before \c init().
+    void set_headless(bool headless) { headless_ = headless; }
+    bool headless() const { return headless_; }
+    /// @brief 1 for vsync, -1 for adaptive vsync and 0 for none. Applied immediately if the
+    /// context exists, otherwise when it is created.
+    /// @return false if the driver rejected the interval.
+    bool set_swap_interval(int interval);
+    int swap_interval() const { return swap_interval_; }
     SDL_GLContext context() const { return context_; }
+    /// @brief Creates another context sharing objects with this one, for use on another thread. A
+    /// context can only be current on one thread per window, so it comes with a hidden window.
+    /// The window's context is current again afterwards.
+    /// @return A null context if the driver can't share contexts.
+    shared_context create_shared_context();
+    /// @brief Destroys a context from \c create_shared_context(), which mustn't be current anywhere.
+    static void destroy_shared_context(shared_context& shared);
     SDL_Window* window() const { return window_; }
     void set_render_hook(std::function<void(*)(SDL_Renderer*)> fn);
     const std::string& glsl_version() const { return glsl_version_; }
     void swap();
 
-    std::unique_ptr<tr_texture> create_texture_from_file(std::string_view filename);
+    /// @brief Decodes an image resource into a mipmapped RGBA8 texture, on the calling thread. Baked \c .trtex
+    /// textures are uploaded as stored.
+    /// @return nullptr if the image couldn't be decoded.
+    std::unique_ptr<gl_texture> create_texture_from_file(std::string_view filename);
 private:
     std::string caption_;
     size_t screen_width_{ 1024 };
@@ -40,6 +65,8 @@ private:
     std::string glsl_version_;
     bool initialised_{ false };
     bool fullscreen_{ true };
+    bool headless_{ false };
+    int swap_interval_{ 1 };
 
     tr_window(const tr_window&) = delete;
     tr_window(tr_window&&) = delete;